@@ -60,12 +60,11 @@ inline shared_ptr<float> CreateFPtr(size_t len) {
   return shared_ptr<float> ( new float[len], [](float* ptr) { delete[] ptr; } );
 }
 
-inline pair<shared_ptr<float>, shared_ptr<float>> GetNextBatch(ifstream& data_file_in, ifstream& label_file_in, size_t data_length, size_t label_length) {
-  auto data_ptr = CreateFPtr(data_length);
-  auto label_ptr = CreateFPtr(label_length);
-  data_file_in.read(reinterpret_cast<char*>(data_ptr.get()), data_length * sizeof(float));
-  label_file_in.read(reinterpret_cast<char*>(label_ptr.get()), label_length * sizeof(float));
-  return make_pair(data_ptr, label_ptr);
+// Reads minibatches of samples and labels from the MNIST files ahead of
+// training. A pass ends after `num_batches` batches.
+inline unique_ptr<DataPipeline> CreateMnistPipeline(const string& data_file, const string& label_file, int batch_size, int num_batches) {
+  auto reader = common::MakeUnique<RawFileReader>(vector<string>{data_file, label_file}, vector<Scale>{{784}, {10}}, batch_size, 2 * sizeof(int), num_batches);
+  return common::MakeUnique<DataPipeline>(move(reader), 1, 4);
 }
 
 inline void PrintImgAndLabel(shared_ptr<float> data_ptr, shared_ptr<float> label_ptr, int img_idx = 0) {
@@ -7,31 +7,19 @@
 int main(int argc, char** argv) {
   const auto& param = InitMnistApps(argc, argv);
   cout << param << endl;
-  size_t train_data_len = 28 * 28 * param.mb_size; // img size = 28x28
-  size_t train_label_len = 10 * param.mb_size; // 10 classes
-  size_t test_data_len = 28 * 28 * param.num_tests; // img size = 28x28
-  size_t test_label_len = 10 * param.num_tests; // 10 classes
-
   MnistMlpAlgo mlp_algo(param);
   mlp_algo.Init();
 
-  ifstream train_data_in(param.train_data_file.c_str(), ios::binary);
-  ifstream train_label_in(param.train_label_file.c_str(), ios::binary);
-  ifstream test_data_in(param.test_data_file.c_str(), ios::binary);
-  ifstream test_label_in(param.test_label_file.c_str(), ios::binary);
+  auto train_data = CreateMnistPipeline(param.train_data_file, param.train_label_file, param.mb_size, param.num_mb);
+  auto test_data = CreateMnistPipeline(param.test_data_file, param.test_label_file, param.num_tests, 1);
 
   cout << "Start training:" << endl;
   for (int epoch = 0; epoch < param.num_epochs; ++epoch) {
-    train_data_in.clear();
-    train_data_in.seekg(2 * sizeof(int), ios::beg);
-    train_label_in.clear();
-    train_label_in.seekg(2 * sizeof(int), ios::beg);
     cout << "Epoch #" << epoch << endl;
-    for (int mb = 0; mb < param.num_mb; ++mb) {
-      shared_ptr<float> data_ptr, label_ptr;
-      tie(data_ptr, label_ptr) = GetNextBatch(train_data_in, train_label_in, train_data_len, train_label_len);
-      NArray predict = mlp_algo.FF(data_ptr, false);
-      NArray label = mlp_algo.BP(label_ptr, false);
+    Batch batch;
+    for (int mb = 0; train_data->NextBatch(&batch); ++mb) {
+      NArray predict = mlp_algo.FF(batch.fields[0], false);
+      NArray label = mlp_algo.BP(batch.fields[1], false);
       if (mb % 20 == 0) {
         PrintAccuracy(predict, label, param);
       }
@@ -39,15 +27,11 @@ int main(int argc, char** argv) {
     }
     // Testing
     cout << "Testing:" << endl;
-    test_data_in.clear();
-    test_data_in.seekg(2 * sizeof(int), ios::beg);
-    test_label_in.clear();
-    test_label_in.seekg(2 * sizeof(int), ios::beg);
-    shared_ptr<float> data_ptr, label_ptr;
-    tie(data_ptr, label_ptr) = GetNextBatch(test_data_in, test_label_in, test_data_len, test_label_len);
-    NArray predict = mlp_algo.FF(data_ptr, true);
-    NArray label = mlp_algo.BP(label_ptr, true);
-    PrintAccuracy(predict, label, param, true);
+    while (test_data->NextBatch(&batch)) {
+      NArray predict = mlp_algo.FF(batch.fields[0], true);
+      NArray label = mlp_algo.BP(batch.fields[1], true);
+      PrintAccuracy(predict, label, param, true);
+    }
   }
   cout << "Training finished" << endl;
   return 0;
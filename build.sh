@@ -29,6 +29,9 @@ CXXFLAGS="$CXXFLAGS \
   -DBUILD_CPU_ONLY=$BUILD_CPU_ONLY \
   -DBUILD_WITH_BLAS=$BUILD_WITH_BLAS \
   -DBLAS_ROOT=$BLAS_ROOT \
+  -DBUILD_WITH_LMDB=$BUILD_WITH_LMDB \
+  -DLMDB_ROOT=$LMDB_ROOT \
+  -DBUILD_WITH_ZLIB=$BUILD_WITH_ZLIB \
   "
 
 while [[ $# -gt 0 ]]; do
@@ -1,5 +1,7 @@
 #include "backend.h"
 #include <memory>
+#include <vector>
+#include <dmlc/logging.h>
 #include "backend/backend_chunk.h"
 #include "op/physical_fn.h"
 
@@ -11,5 +13,34 @@ BackendChunk* Backend::CreateOne(BackendChunk* param, const Scale& result_size,
   return Create({param}, {result_size}, fn)[0];
 }
 
+vector<BackendChunk*> Backend::CreateBatch(const vector<BackendChunk*>& params,
+    const vector<BatchOp>& ops, const vector<size_t>& outputs) {
+  // Parameters are borrowed from the caller. Results are released once all
+  // ops of the batch are created.
+  vector<BackendChunk*> values(params);
+  for (auto& op : ops) {
+    auto inputs = Map<BackendChunk*>(op.inputs, [&](size_t i) {
+      return CHECK_NOTNULL(values.at(i));
+    });
+    auto results = CreateOp(inputs, op.result_sizes, op.op);
+    values.insert(values.end(), results.begin(), results.end());
+  }
+  auto ret = Map<BackendChunk*>(outputs, [&](size_t i) {
+    return values.at(i)->ShallowCopy();
+  });
+  for (size_t i = params.size(); i < values.size(); ++i) {
+    delete values[i];
+  }
+  return ret;
+}
+
+shared_ptr<float> Backend::GetValue(BackendChunk* chunk) {
+  shared_ptr<float> ret(new float[chunk->shape().Prod()], [](float* p) {
+    delete[] p;
+  });
+  GetValueInto(chunk, ret.get());
+  return ret;
+}
+
 }  // namespace minerva
 
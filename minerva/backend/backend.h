@@ -2,12 +2,21 @@
 #include <vector>
 #include <memory>
 #include "op/compute_fn.h"
+#include "op/physical.h"
 #include "backend/backend_chunk.h"
 #include "common/scale.h"
 #include "common/common.h"
 
 namespace minerva {
 
+// Op of a batch. The values of a batch are its parameters followed by the
+// results of its ops, in order, and `inputs` index them.
+struct BatchOp {
+  std::vector<size_t> inputs;
+  std::vector<Scale> result_sizes;
+  PhysicalOp op;
+};
+
 class Backend {
  public:
   Backend() = default;
@@ -17,9 +26,25 @@ class Backend {
       std::vector<Scale> const&, std::shared_ptr<ComputeFn>) = 0;
   virtual BackendChunk* CreateOne(BackendChunk*, Scale const&,
       std::shared_ptr<ComputeFn>);
+  // Creates the ops of a batch and returns chunks of the values indexed by
+  // `outputs`. Results neither read by a later op of the batch nor returned
+  // need not be computed.
+  virtual std::vector<BackendChunk*> CreateBatch(const std::vector<BackendChunk*>& params,
+      const std::vector<BatchOp>& ops, const std::vector<size_t>& outputs);
   virtual void Wait(BackendChunk*) = 0;
   virtual void WaitForAll() = 0;
-  virtual std::shared_ptr<float> GetValue(BackendChunk*) = 0;
+  // Copy of the value of a chunk in host memory
+  std::shared_ptr<float> GetValue(BackendChunk*);
+  // Copies the value of a chunk to host memory at `dst`
+  virtual void GetValueInto(BackendChunk*, float* dst) = 0;
+  // Read-only view of the value of a chunk, borrowed in place when it is held
+  // in host memory and copied otherwise
+  virtual std::shared_ptr<const float> BorrowValue(BackendChunk*) = 0;
+
+ protected:
+  // Creates an op on the device given by `op` rather than the current one
+  virtual std::vector<BackendChunk*> CreateOp(const std::vector<BackendChunk*>&,
+      const std::vector<Scale>&, const PhysicalOp&) = 0;
 };
 
 }  // namespace minerva
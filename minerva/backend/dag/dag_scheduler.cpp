@@ -1,6 +1,7 @@
 #include "dag_scheduler.h"
 #include <vector>
 #include <set>
+#include <algorithm>
 #include <memory>
 #include <dmlc/logging.h>
 #include "system/minerva_system.h"
@@ -13,7 +14,7 @@ using namespace std;
 
 namespace minerva {
 
-DagScheduler::DagScheduler(PhysicalDag* d, DeviceManager* dm) : dag_(d), dm_(dm), dispatcher_0(&DagScheduler::DispatcherRoutine, this), dispatcher_1(&DagScheduler::DispatcherRoutine, this), num_nodes_yet_to_finish_(0) {
+DagScheduler::DagScheduler(PhysicalDag* d, DeviceManager* dm, SchedulerTelemetry* t) : dag_(d), dm_(dm), telemetry_(t), dispatcher_0(&DagScheduler::DispatcherRoutine, this), dispatcher_1(&DagScheduler::DispatcherRoutine, this), num_nodes_yet_to_finish_(0) {
   dm->RegisterListener(this);
 }
 
@@ -26,9 +27,17 @@ DagScheduler::~DagScheduler() {
 
 vector<BackendChunk*> DagScheduler::Create(const vector<BackendChunk*>& params,
     const std::vector<Scale>& result_sizes, shared_ptr<ComputeFn> fn) {
-  auto current_device_id = MinervaSystem::Instance().current_device_id();
+  auto& ms = MinervaSystem::Instance();
+  return CreateOp(params, result_sizes, PhysicalOp{fn, ms.current_device_id(), ms.latency_critical()});
+}
+
+vector<BackendChunk*> DagScheduler::CreateOp(const vector<BackendChunk*>& params,
+    const std::vector<Scale>& result_sizes, const PhysicalOp& op) {
+  auto& ms = MinervaSystem::Instance();
+  // Ops without inputs generate data (possibly random) and always act as checkpoints
+  bool in_segment = ms.rematerialize() && !params.empty();
   auto rst_data_nodes = Map<PhysicalDataNode*>(result_sizes, [&](const Scale& size) {
-    return dag_->NewDataNode(PhysicalData(size, current_device_id, MinervaSystem::Instance().GenerateDataId()));
+    return dag_->NewDataNode(PhysicalData(size, op.device_id, ms.GenerateDataId()));
   });
   Iter(rst_data_nodes, [this](PhysicalDataNode* n) {
     OnCreateNode(n);
@@ -36,23 +45,156 @@ vector<BackendChunk*> DagScheduler::Create(const vector<BackendChunk*>& params,
   auto param_data_nodes = Map<PhysicalDataNode*>(params, [](BackendChunk* i) {
     return CHECK_NOTNULL(dynamic_cast<DagChunk*>(i))->node();
   });
-  set<PhysicalDataNode*> unique_predecessors(param_data_nodes.begin(), param_data_nodes.end());
+  shared_ptr<RematOp> remat_op;
+  if (in_segment) {
+    remat_op = make_shared<RematOp>();
+    remat_op->op = op;
+    for (auto i : params) {
+      remat_op->inputs.emplace_back(i->ShallowCopy());
+    }
+    remat_op->result_sizes = result_sizes;
+    remat_op->flops = op.compute_fn->EstimateFlops(Map<Scale>(param_data_nodes, [](PhysicalDataNode* n) {
+      return n->data_.size;
+    }), result_sizes);
+  }
   auto ret = Map<BackendChunk*>(rst_data_nodes, [](PhysicalDataNode* n) {
     return new DagChunk(n);
   });
+  unordered_map<uint64_t, PhysicalDataNode*> recomputed;
+  vector<uint64_t> gated, to_release;
+  while (true) {
+    for (auto n : param_data_nodes) {
+      if (!recomputed.count(n->node_id_) && NeedsRematerialize(n)) {
+        Rematerialize(n, !ms.rematerialize(), &recomputed, &gated);
+      }
+    }
+    auto input_data_nodes = Map<PhysicalDataNode*>(param_data_nodes, [&](PhysicalDataNode* n) {
+      auto it = recomputed.find(n->node_id_);
+      return it == recomputed.end() ? n : it->second;
+    });
+    set<PhysicalDataNode*> unique_predecessors(input_data_nodes.begin(), input_data_nodes.end());
+    {
+      MultiNodeLock lock(dag_, unique_predecessors);
+      // An input could have been dropped since it was checked
+      bool stale = false;
+      for (auto n : unique_predecessors) {
+        stale = stale || NeedsRematerialize(n);
+      }
+      if (stale) {
+        continue;
+      }
+      auto op_node = dag_->NewOpNode(input_data_nodes, rst_data_nodes, op);
+      DLOG(INFO) << "create new op node #" << op_node->node_id_ << " on device #" << op.device_id;
+      OnCreateNode(op_node);
+      Iter(unique_predecessors, [&](PhysicalDataNode* n) {
+        OnCreateEdge(n, op_node);
+      });
+      Iter(rst_data_nodes, [&](PhysicalDataNode* n) {
+        OnCreateEdge(op_node, n);
+      });
+      OnCreateOpLiveness(op_node);
+      if (in_segment) {
+        lock_guard<mutex> l(remat_mutex_);
+        for (size_t i = 0; i < rst_data_nodes.size(); ++i) {
+          remat_info_[rst_data_nodes[i]->node_id_] = RematInfo{remat_op, i, false};
+        }
+        remat_stats_.segment_flops += remat_op->flops;
+      }
+      if (!gated.empty()) {
+        // Inputs produced by the held back ops. Kept recomputations of earlier
+        // reads are counted as other inputs.
+        set<uint64_t> gated_ids(gated.begin(), gated.end());
+        int num_recomputed_inputs = 0;
+        for (auto n : unique_predecessors) {
+          num_recomputed_inputs += !n->predecessors_.empty() && gated_ids.count((*n->predecessors_.begin())->node_id_);
+        }
+        {
+          lock_guard<mutex> l(remat_mutex_);
+          gated_ops_[op_node->node_id_] = GatedOps{num_recomputed_inputs, gated};
+        }
+        TakeGatedOpsIfReady(op_node->node_id_, &to_release);
+      }
+      ProcessIfReady(op_node);
+    }
+    ReleaseGatedOps(to_release);
+    break;
+  }
+  return ret;
+}
+
+vector<BackendChunk*> DagScheduler::CreateBatch(const vector<BackendChunk*>& params,
+    const vector<BatchOp>& ops, const vector<size_t>& outputs) {
+  auto& ms = MinervaSystem::Instance();
+  auto param_data_nodes = Map<PhysicalDataNode*>(params, [](BackendChunk* i) {
+    return CHECK_NOTNULL(dynamic_cast<DagChunk*>(i))->node();
+  });
+  // Ops of segments and inputs that may be dropped are handled op by op.
+  // Existing nodes never become rematerializable, so this holds for the batch.
+  bool rematerializable = ms.rematerialize();
   {
-    MultiNodeLock lock(dag_, unique_predecessors);
-    auto op_node = dag_->NewOpNode(param_data_nodes, rst_data_nodes, {fn, current_device_id});
-    DLOG(INFO) << "create new op node #" << op_node->node_id_ << " on device #" << current_device_id;
+    lock_guard<mutex> l(remat_mutex_);
+    for (auto n : param_data_nodes) {
+      rematerializable = rematerializable || remat_info_.count(n->node_id_);
+    }
+  }
+  if (rematerializable) {
+    return Backend::CreateBatch(params, ops, outputs);
+  }
+  auto values = param_data_nodes;
+  for (auto& op : ops) {
+    for (auto& size : op.result_sizes) {
+      auto n = dag_->NewDataNode(PhysicalData(size, op.op.device_id, ms.GenerateDataId()));
+      OnCreateNode(n);
+      values.push_back(n);
+    }
+  }
+  auto ret = Map<BackendChunk*>(outputs, [&](size_t i) {
+    return new DagChunk(values.at(i));
+  });
+  set<PhysicalDataNode*> unique_params(param_data_nodes.begin(), param_data_nodes.end());
+  MultiNodeLock lock(dag_, unique_params);
+  // The new nodes are only reachable through the parameters until the first
+  // op is queued, so they are built without their own locks
+  vector<PhysicalOpNode*> op_nodes;
+  size_t num_values = params.size();
+  for (auto& op : ops) {
+    auto input_data_nodes = Map<PhysicalDataNode*>(op.inputs, [&](size_t i) {
+      CHECK_LT(i, num_values) << "op reads a value of a later op";
+      return values[i];
+    });
+    vector<PhysicalDataNode*> rst_data_nodes(values.begin() + num_values,
+        values.begin() + num_values + op.result_sizes.size());
+    num_values += op.result_sizes.size();
+    auto op_node = dag_->NewOpNode(input_data_nodes, rst_data_nodes, op.op);
+    DLOG(INFO) << "create new op node #" << op_node->node_id_ << " on device #" << op.op.device_id << " in batch";
     OnCreateNode(op_node);
+    set<PhysicalDataNode*> unique_predecessors(input_data_nodes.begin(), input_data_nodes.end());
     Iter(unique_predecessors, [&](PhysicalDataNode* n) {
       OnCreateEdge(n, op_node);
     });
     Iter(rst_data_nodes, [&](PhysicalDataNode* n) {
       OnCreateEdge(op_node, n);
     });
-    ProcessIfReady(op_node);
+    OnCreateOpLiveness(op_node);
+    op_nodes.push_back(op_node);
+  }
+  // Results that are neither read nor returned are dead from the start
+  set<size_t> returned(outputs.begin(), outputs.end());
+  for (size_t i = params.size(); i < values.size(); ++i) {
+    if (!returned.count(i)) {
+      OnExternRCLiveness(values[i]->node_id_, 0);
+    }
+  }
+  // Queued ops may trigger later ops of the batch right away
+  vector<PhysicalOpNode*> ready;
+  for (auto op_node : op_nodes) {
+    if (rt_info_.At(op_node->node_id_).num_triggers_needed == 0) {
+      ready.push_back(op_node);
+    }
   }
+  Iter(ready, [this](PhysicalOpNode* op_node) {
+    ProcessIfReady(op_node);
+  });
   return ret;
 }
 
@@ -78,14 +220,55 @@ void DagScheduler::WaitForAll() {
   }
 }
 
-shared_ptr<float> DagScheduler::GetValue(BackendChunk* chunk) {
-  auto& data = CHECK_NOTNULL(dynamic_cast<DagChunk*>(chunk))->node()->data_;
-  shared_ptr<float> ret(new float[data.size.Prod()], [](float* p) {
-    delete[] p;
-  });
+void DagScheduler::GetValueInto(BackendChunk* chunk, float* dst) {
+  auto node = CHECK_NOTNULL(dynamic_cast<DagChunk*>(chunk))->node();
+  bool rematerializable = false;
+  {
+    lock_guard<mutex> l(remat_mutex_);
+    rematerializable = remat_info_.count(node->node_id_);
+  }
+  bool pinned = false;
+  unique_ptr<DagChunk> recomputed;
+  if (rematerializable) {
+    {
+      MultiNodeLock lock(dag_, node);
+      if (!NeedsRematerialize(node)) {
+        // Keep the buffer from being dropped while it is read
+        ++rt_info_.At(node->node_id_).reference_count;
+        pinned = true;
+      }
+    }
+    if (!pinned) {
+      unordered_map<uint64_t, PhysicalDataNode*> recomputed_nodes;
+      vector<uint64_t> gated;
+      recomputed.reset(new DagChunk(Rematerialize(node, !MinervaSystem::Instance().rematerialize(), &recomputed_nodes, &gated)));
+      ReleaseGatedOps(gated);
+      Wait(recomputed.get());
+    }
+  }
+  auto& data = recomputed ? recomputed->node()->data_ : node->data_;
   auto dev_pair = MinervaSystem::Instance().GetPtr(data.device_id, data.data_id);
-  MinervaSystem::UniversalMemcpy(make_pair(Device::MemType::kCpu, ret.get()), dev_pair, data.size.Prod() * sizeof(float));
-  return ret;
+  MinervaSystem::UniversalMemcpy(make_pair(Device::MemType::kCpu, dst), dev_pair, data.size.Prod() * sizeof(float));
+  MinervaSystem::Instance().ReleasePtr(data.device_id, data.data_id);
+  if (pinned) {
+    MultiNodeLock lock(dag_, node);
+    if (--rt_info_.At(node->node_id_).reference_count == 0) {
+      DropIfRematerializable(node);
+    }
+  }
+}
+
+shared_ptr<const float> DagScheduler::BorrowValue(BackendChunk* chunk) {
+  auto node = CHECK_NOTNULL(dynamic_cast<DagChunk*>(chunk))->node();
+  {
+    lock_guard<mutex> l(remat_mutex_);
+    // Buffers of rematerialized data may be dropped at any time
+    if (remat_info_.count(node->node_id_)) {
+      return GetValue(chunk);
+    }
+  }
+  auto ret = MinervaSystem::Instance().BorrowHostPtr(node->data_.device_id, node->data_.data_id);
+  return ret ? ret : GetValue(chunk);
 }
 
 // Device listener
@@ -99,6 +282,7 @@ void DagScheduler::ExternRCUpdate(PhysicalDataNode* node, int delta) {
   auto node_id = node->node_id_;
   auto& ri = rt_info_.At(node_id);
   node->data_.extern_rc += delta;
+  OnExternRCLiveness(node_id, node->data_.extern_rc);
   switch (rt_info_.GetState(node_id)) {
     case NodeState::kCompleted: {
       // If node is in kCompleted state, that means the node has already been concretely
@@ -122,10 +306,16 @@ void DagScheduler::ExternRCUpdate(PhysicalDataNode* node, int delta) {
 void DagScheduler::FreeDataNodeRes(PhysicalDataNode* node) {
   DLOG(INFO) << "free data node resource for node #" << node->node_id_ << " data #" << node->data_.data_id;
   dm_->FreeData(node->data_.data_id);
+  telemetry_->Record(node->node_id_, SchedulerTelemetry::Event::kFreed);
 }
 
 void DagScheduler::OnCreateNode(DagNode* node) {
   rt_info_.AddNode(node->node_id_);
+  if (node->Type() == DagNode::NodeType::kOpNode) {
+    telemetry_->OnNodeCreated(node->node_id_, true, CHECK_NOTNULL(dynamic_cast<PhysicalOpNode*>(node))->op_.device_id);
+  } else {
+    telemetry_->OnNodeCreated(node->node_id_, false, CHECK_NOTNULL(dynamic_cast<PhysicalDataNode*>(node))->data_.device_id);
+  }
 }
 
 void DagScheduler::OnDeleteNode(DagNode* node) {
@@ -145,6 +335,7 @@ void DagScheduler::ProcessIfReady(PhysicalOpNode* target) {
   CHECK_EQ(rt_info_.GetState(node_id), NodeState::kReady) << "invalid state of node #" << node_id;
   if (rt_info_.At(node_id).num_triggers_needed == 0) {
     ++num_nodes_yet_to_finish_;
+    telemetry_->Record(node_id, SchedulerTelemetry::Event::kReady);
     dispatcher_queue_.Push({TaskType::kToRun, node_id});
     DLOG(INFO) << "node #" << node_id << " running right after creation";
   }
@@ -155,12 +346,20 @@ void DagScheduler::DispatcherRoutine() {
   // Pop queue while not exiting
   while (!dispatcher_queue_.Pop(task)) {
     DagNode* to_delete = 0;
+    vector<uint64_t> to_release;
+    shared_ptr<RematOp> remat_op;
+    unique_ptr<BackendChunk> remat_recomputed;
     {
       auto node_id = task.second;
       auto node = dag_->GetNode(node_id);
       MultiNodeLock lock(dag_, node);
       auto& ri = rt_info_.At(node_id);
-      if (task.first == TaskType::kToRun && node->Type() == DagNode::NodeType::kOpNode) {  // New task to dispatch
+      if (task.first == TaskType::kToRun && node->Type() == DagNode::NodeType::kOpNode &&
+          !TryDispatch(node_id)) {  // Results no longer needed
+        DLOG(INFO) << "cancel node #" << node_id;
+        telemetry_->Record(node_id, SchedulerTelemetry::Event::kCancelled);
+        dispatcher_queue_.Push({TaskType::kToComplete, node_id});
+      } else if (task.first == TaskType::kToRun && node->Type() == DagNode::NodeType::kOpNode) {  // New task to dispatch
         auto op_node = CHECK_NOTNULL(dynamic_cast<PhysicalOpNode*>(node));
         auto device_id = op_node->op_.device_id;
         Task* task = new Task();
@@ -174,6 +373,7 @@ void DagScheduler::DispatcherRoutine() {
         task->op = op_node->op_;
         task->id = node_id;
         DLOG(INFO) << "dispatching node #" << node_id << " to device #" << device_id;
+        telemetry_->Record(node_id, SchedulerTelemetry::Event::kDispatched);
         dm_->GetDevice(device_id)->PushTask(task);
       } else if (task.first == TaskType::kToComplete ||
           (task.first == TaskType::kToRun &&
@@ -188,19 +388,28 @@ void DagScheduler::DispatcherRoutine() {
             auto pred_node = CHECK_NOTNULL(dynamic_cast<PhysicalDataNode*>(pred));
             // Reference count decreasing to zero, not able to recover access anymore
             CHECK_EQ(pred_ri.num_triggers_needed, 0) << "#triggers incorrect for a completed data node";
-            if (--pred_ri.reference_count == 0 && pred_node->data_.extern_rc == 0) {
-              FreeDataNodeRes(pred_node);
-              ++num_nodes_yet_to_finish_;
-              dispatcher_queue_.Push({TaskType::kToDelete, pred_node->node_id_});
+            if (--pred_ri.reference_count == 0) {
+              if (pred_node->data_.extern_rc == 0) {
+                FreeDataNodeRes(pred_node);
+                ++num_nodes_yet_to_finish_;
+                dispatcher_queue_.Push({TaskType::kToDelete, pred_node->node_id_});
+              } else {
+                DropIfRematerializable(pred_node);
+              }
             }
           }
         } else {  // Data node
           auto data_node = CHECK_NOTNULL(dynamic_cast<PhysicalDataNode*>(node));
+          telemetry_->Record(node_id, SchedulerTelemetry::Event::kFinished);
           // Data node generated but not needed
-          if (ri.reference_count == 0 && data_node->data_.extern_rc == 0) {
-            FreeDataNodeRes(data_node);
-            ++num_nodes_yet_to_finish_;
-            dispatcher_queue_.Push({TaskType::kToDelete, data_node->node_id_});
+          if (ri.reference_count == 0) {
+            if (data_node->data_.extern_rc == 0) {
+              FreeDataNodeRes(data_node);
+              ++num_nodes_yet_to_finish_;
+              dispatcher_queue_.Push({TaskType::kToDelete, data_node->node_id_});
+            } else {
+              DropIfRematerializable(data_node);
+            }
           }
           CHECK_EQ(node->predecessors_.size(), 1) << "data node should have no more than one predecessor";
           auto pred_node = *node->predecessors_.begin();
@@ -218,22 +427,247 @@ void DagScheduler::DispatcherRoutine() {
           if (ri.state == NodeState::kReady && ri.num_triggers_needed == 0) {
             DLOG(INFO) << "trigger node #" << succ->node_id_;
             ++num_nodes_yet_to_finish_;
+            if (succ->Type() == DagNode::NodeType::kOpNode) {
+              telemetry_->Record(succ->node_id_, SchedulerTelemetry::Event::kReady);
+            }
             dispatcher_queue_.Push({TaskType::kToRun, succ->node_id_});
+          } else {
+            TakeGatedOpsIfReady(succ->node_id_, &to_release);
           }
         }
+        if (!to_release.empty()) {
+          // Counted until released so that waiting does not return early
+          ++num_nodes_yet_to_finish_;
+        }
         DecrNumNodesYetToFinish(node_id);
       } else if (task.first == TaskType::kToDelete) {
         CHECK_EQ(ri.state, NodeState::kCompleted);
         DLOG(INFO) << "dispatcher ready to delete node #" << node_id;
         OnDeleteNode(node);
         to_delete = dag_->RemoveNodeFromDag(node_id);
+        {
+          lock_guard<mutex> l(remat_mutex_);
+          auto it = remat_info_.find(node_id);
+          if (it != remat_info_.end()) {
+            if (it->second.dropped && !it->second.recomputed) {
+              remat_stats_.saved_bytes -= CHECK_NOTNULL(dynamic_cast<PhysicalDataNode*>(node))->data_.size.Prod() * sizeof(float);
+            }
+            // Released outside of the node locks since they hold references to other
+            // nodes. Counted until then so that waiting does not return early.
+            remat_op = move(it->second.op);
+            remat_recomputed = move(it->second.recomputed);
+            remat_info_.erase(it);
+            ++num_nodes_yet_to_finish_;
+          }
+        }
         DecrNumNodesYetToFinish(node_id);
       } else {
         LOG(FATAL) << "illegal task state";
       }
     }
     delete to_delete;
+    if (remat_op) {
+      remat_op.reset();
+      remat_recomputed.reset();
+      DecrNumNodesYetToFinish(task.second);
+    }
+    if (!to_release.empty()) {
+      ReleaseGatedOps(to_release);
+      DecrNumNodesYetToFinish(task.second);
+    }
+  }
+}
+
+RematStats DagScheduler::GetRematStats() {
+  lock_guard<mutex> l(remat_mutex_);
+  return remat_stats_;
+}
+
+void DagScheduler::ResetRematStats() {
+  lock_guard<mutex> l(remat_mutex_);
+  auto saved_bytes = remat_stats_.saved_bytes;
+  remat_stats_ = RematStats();
+  remat_stats_.saved_bytes = remat_stats_.peak_saved_bytes = saved_bytes;
+}
+
+bool DagScheduler::NeedsRematerialize(PhysicalDataNode* node) {
+  lock_guard<mutex> l(remat_mutex_);
+  auto it = remat_info_.find(node->node_id_);
+  return it != remat_info_.end() && it->second.dropped;
+}
+
+PhysicalDataNode* DagScheduler::Rematerialize(PhysicalDataNode* node, bool keep,
+    unordered_map<uint64_t, PhysicalDataNode*>* recomputed, vector<uint64_t>* gated) {
+  auto it = recomputed->find(node->node_id_);
+  if (it != recomputed->end()) {
+    return it->second;
+  }
+  shared_ptr<RematOp> remat_op;
+  size_t index;
+  {
+    lock_guard<mutex> l(remat_mutex_);
+    auto& info = remat_info_.at(node->node_id_);
+    if (info.recomputed) {
+      return (*recomputed)[node->node_id_] = CHECK_NOTNULL(dynamic_cast<DagChunk*>(info.recomputed.get()))->node();
+    }
+    remat_op = info.op;
+    index = info.index;
+  }
+  auto outputs = Map<PhysicalDataNode*>(remat_op->result_sizes, [&](const Scale& size) {
+    auto n = dag_->NewDataNode(PhysicalData(size, remat_op->op.device_id, MinervaSystem::Instance().GenerateDataId()));
+    OnCreateNode(n);
+    return n;
+  });
+  while (true) {
+    // Recompute from the retained checkpoints, reading inputs that are still resident
+    auto inputs = Map<PhysicalDataNode*>(remat_op->inputs, [&](const unique_ptr<BackendChunk>& c) {
+      auto n = CHECK_NOTNULL(dynamic_cast<DagChunk*>(c.get()))->node();
+      return NeedsRematerialize(n) ? Rematerialize(n, keep, recomputed, gated) : n;
+    });
+    set<PhysicalDataNode*> unique_predecessors(inputs.begin(), inputs.end());
+    MultiNodeLock lock(dag_, unique_predecessors);
+    // An input could have been dropped since it was checked
+    bool stale = false;
+    for (auto n : unique_predecessors) {
+      stale = stale || NeedsRematerialize(n);
+    }
+    if (stale) {
+      continue;
+    }
+    auto op_node = dag_->NewOpNode(inputs, outputs, remat_op->op);
+    DLOG(INFO) << "create op node #" << op_node->node_id_ << " to recompute node #" << node->node_id_;
+    OnCreateNode(op_node);
+    Iter(unique_predecessors, [&](PhysicalDataNode* n) {
+      OnCreateEdge(n, op_node);
+    });
+    Iter(outputs, [&](PhysicalDataNode* n) {
+      OnCreateEdge(op_node, n);
+    });
+    OnCreateOpLiveness(op_node);
+    // Held back until released by `ReleaseGatedOps`
+    ++rt_info_.At(op_node->node_id_).num_triggers_needed;
+    gated->push_back(op_node->node_id_);
+    break;
   }
+  // Keep the result so that later reads, and recomputations of the following
+  // ops, do not re-issue the op again
+  unique_ptr<BackendChunk> kept(keep ? new DagChunk(outputs[index]) : nullptr);
+  {
+    lock_guard<mutex> l(remat_mutex_);
+    ++remat_stats_.num_recomputed;
+    remat_stats_.recomputed_flops += remat_op->flops;
+    auto& info = remat_info_.at(node->node_id_);
+    if (kept && !info.recomputed) {
+      info.recomputed = move(kept);
+      remat_stats_.saved_bytes -= node->data_.size.Prod() * sizeof(float);
+    }
+  }
+  // Recomputed concurrently by another reader, released outside of the lock
+  kept.reset();
+  return (*recomputed)[node->node_id_] = outputs[index];
+}
+
+// Called with the node locked, after its reference count dropped to zero
+void DagScheduler::DropIfRematerializable(PhysicalDataNode* node) {
+  lock_guard<mutex> l(remat_mutex_);
+  auto it = remat_info_.find(node->node_id_);
+  if (it == remat_info_.end() || it->second.dropped) {
+    return;
+  }
+  DLOG(INFO) << "drop rematerializable node #" << node->node_id_;
+  it->second.dropped = true;
+  FreeDataNodeRes(node);
+  size_t bytes = node->data_.size.Prod() * sizeof(float);
+  ++remat_stats_.num_dropped;
+  remat_stats_.dropped_bytes += bytes;
+  remat_stats_.saved_bytes += bytes;
+  remat_stats_.peak_saved_bytes = max(remat_stats_.peak_saved_bytes, remat_stats_.saved_bytes);
+}
+
+// Called with the consumer locked
+bool DagScheduler::TakeGatedOpsIfReady(uint64_t consumer_id, vector<uint64_t>* ops) {
+  lock_guard<mutex> l(remat_mutex_);
+  auto it = gated_ops_.find(consumer_id);
+  if (it == gated_ops_.end() ||
+      rt_info_.At(consumer_id).num_triggers_needed != it->second.num_recomputed_inputs) {
+    return false;
+  }
+  ops->insert(ops->end(), it->second.op_ids.begin(), it->second.op_ids.end());
+  gated_ops_.erase(it);
+  return true;
+}
+
+void DagScheduler::ReleaseGatedOps(const vector<uint64_t>& ops) {
+  for (auto op_id : ops) {
+    auto node = dag_->GetNode(op_id);
+    MultiNodeLock lock(dag_, node);
+    if (--rt_info_.At(op_id).num_triggers_needed == 0) {
+      DLOG(INFO) << "release recompute node #" << op_id;
+      ++num_nodes_yet_to_finish_;
+      telemetry_->Record(op_id, SchedulerTelemetry::Event::kReady);
+      dispatcher_queue_.Push({TaskType::kToRun, op_id});
+    }
+  }
+}
+
+// Called with the inputs locked, before the new op and its outputs can be reached
+void DagScheduler::OnCreateOpLiveness(PhysicalOpNode* op_node) {
+  auto& op = rt_info_.At(op_node->node_id_);
+  for (auto pred : op_node->predecessors_) {
+    op.inputs.push_back(pred->node_id_);
+    ++rt_info_.At(pred->node_id_).live_consumers;
+  }
+  for (auto succ : op_node->successors_) {
+    rt_info_.At(succ->node_id_).producer = op_node->node_id_;
+  }
+  op.live_outputs = op_node->successors_.size();
+}
+
+// Called with the data node locked
+void DagScheduler::OnExternRCLiveness(uint64_t node_id, int extern_rc) {
+  auto& data = rt_info_.At(node_id);
+  data.extern_rc = extern_rc;
+  if (extern_rc == 0 && data.live_consumers == 0) {
+    KillDataNode(node_id);
+  }
+}
+
+// Kills the producer once all its outputs are dead, and in turn the inputs
+// that it was the last live consumer of. The nodes on the way are not locked,
+// so the runtime info map is held to keep them from being removed.
+void DagScheduler::KillDataNode(uint64_t node_id) {
+  vector<uint64_t> dead_data{node_id};
+  rt_info_.LockRead();
+  while (!dead_data.empty()) {
+    auto data = rt_info_.Find(dead_data.back());
+    dead_data.pop_back();
+    if (!data || data->dead.exchange(true)) {
+      continue;
+    }
+    auto op_id = data->producer;
+    auto op = rt_info_.Find(op_id);
+    if (!op || --op->live_outputs != 0) {
+      continue;
+    }
+    auto pending = OpLiveness::kPending;
+    if (!op->liveness.compare_exchange_strong(pending, OpLiveness::kDead)) {  // Already dispatched
+      continue;
+    }
+    DLOG(INFO) << "op node #" << op_id << " no longer needed";
+    for (auto input_id : op->inputs) {
+      auto input = rt_info_.Find(input_id);
+      if (input && --input->live_consumers == 0 && input->extern_rc == 0) {
+        dead_data.push_back(input_id);
+      }
+    }
+  }
+  rt_info_.UnlockRead();
+}
+
+// Called with the op node locked. Returns false if the op is dead.
+bool DagScheduler::TryDispatch(uint64_t op_id) {
+  auto pending = OpLiveness::kPending;
+  return rt_info_.At(op_id).liveness.compare_exchange_strong(pending, OpLiveness::kDispatched);
 }
 
 void DagScheduler::DecrNumNodesYetToFinish(uint64_t node_id) {
@@ -4,7 +4,9 @@
 #include <thread>
 #include <atomic>
 #include <memory>
+#include <unordered_map>
 #include "backend/dag/runtime_info_map.h"
+#include "backend/dag/remat_stats.h"
 #include "backend/backend.h"
 #include "device/device_listener.h"
 #include "dag/dag.h"
@@ -14,6 +16,7 @@
 #include "device/device_manager.h"
 #include "backend/dag/task_type.h"
 #include "backend/dag/priority_dispatcher_queue.h"
+#include "profiler/scheduler_telemetry.h"
 
 namespace minerva {
 
@@ -22,19 +25,29 @@ class DagScheduler :
   public DeviceListener {
  public:
   DagScheduler() = delete;
-  DagScheduler(PhysicalDag*, DeviceManager*);
+  DagScheduler(PhysicalDag*, DeviceManager*, SchedulerTelemetry*);
   DISALLOW_COPY_AND_ASSIGN(DagScheduler);
   ~DagScheduler();
   // Backend
   std::vector<BackendChunk*> Create(const std::vector<BackendChunk*>&,
       const std::vector<Scale>&, std::shared_ptr<ComputeFn>) override;
+  std::vector<BackendChunk*> CreateBatch(const std::vector<BackendChunk*>&,
+      const std::vector<BatchOp>&, const std::vector<size_t>&) override;
   void Wait(BackendChunk*) override;
   void WaitForAll() override;
-  std::shared_ptr<float> GetValue(BackendChunk*) override;
+  void GetValueInto(BackendChunk*, float*) override;
+  std::shared_ptr<const float> BorrowValue(BackendChunk*) override;
   // Device listener
   void OnOperationComplete(Task*) override;
   // Interface for `DagChunk`
   void ExternRCUpdate(PhysicalDataNode*, int);
+  // Rematerialization
+  RematStats GetRematStats();
+  void ResetRematStats();
+
+ protected:
+  std::vector<BackendChunk*> CreateOp(const std::vector<BackendChunk*>&,
+      const std::vector<Scale>&, const PhysicalOp&) override;
 
  private:
   void FreeDataNodeRes(PhysicalDataNode*);
@@ -46,6 +59,7 @@ class DagScheduler :
   PhysicalDag* dag_;
   // Device manager
   DeviceManager* dm_;
+  SchedulerTelemetry* telemetry_;
   // Runtime information
   RuntimeInfoMap rt_info_;
   // Scheduler dispatcher
@@ -59,6 +73,45 @@ class DagScheduler :
   uint64_t target_ = -1;
   std::mutex finish_mutex_;
   std::condition_variable finish_cond_;
+  // Rematerialization. Outputs of ops created in a rematerialization segment
+  // are dropped as soon as no queued op reads them. Reading a dropped output
+  // re-issues the recorded ops starting from the retained checkpoints. Outside
+  // of segments the recomputed buffer is kept until the array of the dropped
+  // output is freed, so the backward pass recomputes every op at most once.
+  struct RematOp {
+    PhysicalOp op;
+    // Keep the inputs alive so that the op can always be re-issued
+    std::vector<std::unique_ptr<BackendChunk>> inputs;
+    std::vector<Scale> result_sizes;
+    uint64_t flops;
+  };
+  struct RematInfo {
+    std::shared_ptr<RematOp> op;
+    size_t index;
+    bool dropped;
+    // Result of the last recomputation of a dropped output
+    std::unique_ptr<BackendChunk> recomputed;
+  };
+  // Recompute ops held back until all other inputs of their consumer are ready
+  struct GatedOps {
+    int num_recomputed_inputs;
+    std::vector<uint64_t> op_ids;
+  };
+  bool NeedsRematerialize(PhysicalDataNode*);
+  PhysicalDataNode* Rematerialize(PhysicalDataNode*, bool keep,
+      std::unordered_map<uint64_t, PhysicalDataNode*>*, std::vector<uint64_t>*);
+  void DropIfRematerializable(PhysicalDataNode*);
+  bool TakeGatedOpsIfReady(uint64_t, std::vector<uint64_t>*);
+  void ReleaseGatedOps(const std::vector<uint64_t>&);
+  std::unordered_map<uint64_t, RematInfo> remat_info_;
+  std::unordered_map<uint64_t, GatedOps> gated_ops_;
+  RematStats remat_stats_;
+  std::mutex remat_mutex_;
+  // Liveness of undispatched nodes, kept in `rt_info_`
+  void OnCreateOpLiveness(PhysicalOpNode*);
+  void OnExternRCLiveness(uint64_t, int);
+  void KillDataNode(uint64_t);
+  bool TryDispatch(uint64_t);
 };
 
 }  // namespace minerva
@@ -0,0 +1,20 @@
+#include "remat_stats.h"
+#include <sstream>
+
+using namespace std;
+
+namespace minerva {
+
+string RematStats::ToString() const {
+  ostringstream ss;
+  ss << "dropped " << num_dropped << " buffers (" << dropped_bytes << "B), ";
+  ss << "currently saving " << saved_bytes << "B (peak " << peak_saved_bytes << "B); ";
+  ss << "recomputed " << num_recomputed << " ops for " << recomputed_flops << " FLOPs";
+  if (segment_flops) {
+    ss << " (" << 100.0 * recomputed_flops / segment_flops << "% of the segment FLOPs)";
+  }
+  return ss.str();
+}
+
+}  // namespace minerva
+
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace minerva {
+
+// Memory saved by rematerialization against the extra computation it costs
+struct RematStats {
+  // Number of buffers dropped once no queued op read them
+  uint64_t num_dropped = 0;
+  // Total bytes released by dropping
+  uint64_t dropped_bytes = 0;
+  // Bytes of dropped buffers whose arrays are still referenced
+  uint64_t saved_bytes = 0;
+  // Peak of `saved_bytes`
+  uint64_t peak_saved_bytes = 0;
+  // FLOPs of ops issued inside rematerialization segments
+  uint64_t segment_flops = 0;
+  // Number of ops re-issued to recompute dropped buffers
+  uint64_t num_recomputed = 0;
+  // FLOPs spent on recomputation
+  uint64_t recomputed_flops = 0;
+  std::string ToString() const;
+};
+
+}  // namespace minerva
+
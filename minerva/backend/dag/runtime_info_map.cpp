@@ -17,11 +17,12 @@ ostream& operator<<(ostream& os, NodeState s) {
   }
 }
 
-RuntimeInfo::RuntimeInfo() : num_triggers_needed(0), reference_count(0), state(NodeState::kReady) {
+RuntimeInfo::RuntimeInfo() : num_triggers_needed(0), reference_count(0), state(NodeState::kReady),
+  extern_rc(0), live_consumers(0), dead(false), producer(-1), live_outputs(0), liveness(OpLiveness::kPending) {
 }
 
 void RuntimeInfoMap::AddNode(uint64_t id) {
-  CHECK(info_.Insert(make_pair(id, RuntimeInfo()))) << "node #" << id << " already existed in runtime info map";
+  CHECK(info_.Emplace(id)) << "node #" << id << " already existed in runtime info map";
 }
 
 void RuntimeInfoMap::RemoveNode(uint64_t id) {
@@ -36,5 +37,19 @@ NodeState RuntimeInfoMap::GetState(uint64_t id) {
   return info_.At(id).state;
 }
 
+void RuntimeInfoMap::LockRead() {
+  info_.LockRead();
+}
+
+void RuntimeInfoMap::UnlockRead() {
+  info_.UnlockRead();
+}
+
+RuntimeInfo* RuntimeInfoMap::Find(uint64_t id) {
+  auto& payload = info_.VolatilePayload();
+  auto it = payload.find(id);
+  return it == payload.end() ? nullptr : &it->second;
+}
+
 }  // namespace minerva
 
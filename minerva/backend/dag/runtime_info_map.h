@@ -3,6 +3,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <atomic>
+#include <vector>
 #include "common/common.h"
 #include "common/concurrent_unordered_map.h"
 
@@ -15,11 +16,31 @@ enum class NodeState {
 
 std::ostream& operator<<(std::ostream&, NodeState);
 
+enum class OpLiveness {
+  kPending,
+  kDispatched,
+  kDead
+};
+
 struct RuntimeInfo {
   RuntimeInfo();
   int num_triggers_needed;
   int reference_count;
   NodeState state;
+  // Liveness of nodes that have not been dispatched. A data node is dead once
+  // it has neither external references nor live consumers, and an op is dead
+  // once all its outputs are. Dead ops complete without being executed. The
+  // counters are atomic since they are also updated while killing nodes,
+  // without holding the node locks.
+  // Data node
+  std::atomic<int> extern_rc;
+  std::atomic<int> live_consumers;
+  std::atomic<bool> dead;
+  uint64_t producer;
+  // Op node
+  std::vector<uint64_t> inputs;
+  std::atomic<int> live_outputs;
+  std::atomic<OpLiveness> liveness;
 };
 
 class RuntimeInfoMap {
@@ -31,6 +52,11 @@ class RuntimeInfoMap {
   RuntimeInfo& At(uint64_t);
   NodeState GetState(uint64_t);
   void KillNode(uint64_t);
+  // No node is removed between `LockRead` and `UnlockRead`, during which
+  // `Find` looks nodes up without locking. Returns null if not found.
+  void LockRead();
+  void UnlockRead();
+  RuntimeInfo* Find(uint64_t);
 
  private:
   ConcurrentUnorderedMap<uint64_t, RuntimeInfo> info_;
@@ -4,6 +4,7 @@
 #include "simple_backend.h"
 #include "device/device_manager.h"
 #include "op/physical.h"
+#include "profiler/scheduler_telemetry.h"
 #include "system/minerva_system.h"
 
 using namespace std;
@@ -20,16 +21,24 @@ class SimpleChunk : public BackendChunk {
   std::shared_ptr<PhysicalData> data_;
 };
 
-SimpleBackend::SimpleBackend(DeviceManager& dm): device_manager_(dm) {
-  finished_flag_.store(false);
+SimpleBackend::SimpleBackend(DeviceManager& dm, SchedulerTelemetry* telemetry): device_manager_(dm), telemetry_(telemetry) {
   device_manager_.RegisterListener(this);
 }
 
 std::vector<BackendChunk*> SimpleBackend::Create(const std::vector<BackendChunk*>& input,
     const std::vector<Scale>& result_sizes, std::shared_ptr<ComputeFn> fn) {
-  auto current_device_id = MinervaSystem::Instance().current_device_id();
+  auto& ms = MinervaSystem::Instance();
+  return CreateOp(input, result_sizes, PhysicalOp{fn, ms.current_device_id(), ms.latency_critical()});
+}
+
+std::vector<BackendChunk*> SimpleBackend::CreateOp(const std::vector<BackendChunk*>& input,
+    const std::vector<Scale>& result_sizes, const PhysicalOp& op) {
   std::vector<BackendChunk*> result_chunks;
   Task* task = new Task();
+  // Op ids are drawn from the data ids, so that telemetry can tell them apart
+  task->id = MinervaSystem::Instance().GenerateDataId();
+  telemetry_->OnNodeCreated(task->id, true, op.device_id);
+  // light weight tasks are executed by the pushing thread before `PushTask` returns
   task->light = true;
   for (auto i : input) {
     auto c = CHECK_NOTNULL(dynamic_cast<SimpleChunk*>(i));
@@ -37,48 +46,52 @@ std::vector<BackendChunk*> SimpleBackend::Create(const std::vector<BackendChunk*
   }
   for (auto s : result_sizes) {
     auto data_id = MinervaSystem::Instance().GenerateDataId();
-    std::shared_ptr<PhysicalData> data_ptr( new PhysicalData(s, current_device_id, data_id),
-       [&] (PhysicalData* d) { device_manager_.FreeData(d->data_id); delete d; } );
+    std::shared_ptr<PhysicalData> data_ptr(new PhysicalData(s, op.device_id, data_id), [](PhysicalData* d) {
+      // Chunks may outlive the system at exit
+      if (MinervaSystem::IsAlive()) {
+        MinervaSystem::Instance().device_manager().FreeData(d->data_id);
+        MinervaSystem::Instance().telemetry().Record(d->data_id, SchedulerTelemetry::Event::kFreed);
+      }
+      delete d;
+    });
+    telemetry_->OnNodeCreated(data_id, false, op.device_id);
     SimpleChunk* o = new SimpleChunk(data_ptr);
     result_chunks.emplace_back(o);
     task->outputs.emplace_back(o->data(), 0);
   }
-  task->op = PhysicalOp{fn, current_device_id};
-  task->id = 0;
-  DLOG(INFO) << "executing task name=" << fn->Name() << " to device #" << current_device_id;
-  // wait for finish
-//  unique_lock<mutex> ul(finish_mutex_);
-//  finished_flag_.store(false);;
-  device_manager_.GetDevice(current_device_id)->PushTask(task);
-//  while(! finished_flag_.load()) {
-//    finish_cond_.wait(ul);
-//  }
+  task->op = op;
+  DLOG(INFO) << "executing task name=" << op.compute_fn->Name() << " to device #" << op.device_id;
+  telemetry_->Record(task->id, SchedulerTelemetry::Event::kReady);
+  telemetry_->Record(task->id, SchedulerTelemetry::Event::kDispatched);
+  device_manager_.GetDevice(op.device_id)->PushTask(task);
   return result_chunks;
 }
 
 void SimpleBackend::Wait(BackendChunk*) {
-  // do nothing
+  // results are always ready since ops are executed synchronously
 }
 
 void SimpleBackend::WaitForAll() {
-  // do nothing
+  // results are always ready since ops are executed synchronously
 }
 
-std::shared_ptr<float> SimpleBackend::GetValue(BackendChunk* chunk) {
+void SimpleBackend::GetValueInto(BackendChunk* chunk, float* dst) {
   auto& data = CHECK_NOTNULL(dynamic_cast<SimpleChunk*>(chunk))->data();
-  shared_ptr<float> ret(new float[data.size.Prod()], [](float* p) {
-    delete[] p;
-  });
   auto dev_pair = MinervaSystem::Instance().GetPtr(data.device_id, data.data_id);
-  MinervaSystem::UniversalMemcpy(make_pair(Device::MemType::kCpu, ret.get()), dev_pair, data.size.Prod() * sizeof(float));
-  return ret;
+  MinervaSystem::UniversalMemcpy(make_pair(Device::MemType::kCpu, dst), dev_pair, data.size.Prod() * sizeof(float));
+  MinervaSystem::Instance().ReleasePtr(data.device_id, data.data_id);
+}
+
+shared_ptr<const float> SimpleBackend::BorrowValue(BackendChunk* chunk) {
+  auto& data = CHECK_NOTNULL(dynamic_cast<SimpleChunk*>(chunk))->data();
+  auto ret = MinervaSystem::Instance().BorrowHostPtr(data.device_id, data.data_id);
+  return ret ? ret : GetValue(chunk);
 }
 
 void SimpleBackend::OnOperationComplete(Task* task) {
-  //lock_guard<mutex> ul(finish_mutex_);
-  //std::cout << "Callback flag=" << finished_flag_ << std::endl;
-//  finished_flag_.store(true);
-  //finish_cond_.notify_all();
+  for (auto& o : task->outputs) {
+    telemetry_->Record(o.physical_data.data_id, SchedulerTelemetry::Event::kFinished);
+  }
   delete task;
 }
 
@@ -1,31 +1,34 @@
 #pragma once
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-
 #include "backend.h"
 #include "device/device_listener.h"
 
 namespace minerva {
 
 class DeviceManager;
+class SchedulerTelemetry;
 
+// Eager backend for latency sensitive workloads. Every op is executed
+// synchronously on the calling thread as soon as it is created, so no DAG is
+// built and results are ready when `Create` returns. Telemetry sees ops and
+// data under their own ids, and ops become ready and are dispatched as soon as
+// they are created.
 class SimpleBackend : public Backend, public DeviceListener {
  public:
-  SimpleBackend(DeviceManager& dm);
+  SimpleBackend(DeviceManager& dm, SchedulerTelemetry* telemetry);
   std::vector<BackendChunk*> Create(const std::vector<BackendChunk*>&, const std::vector<Scale>&, std::shared_ptr<ComputeFn>) override;
   void Wait(BackendChunk*) override;
   void WaitForAll() override;
-  std::shared_ptr<float> GetValue(BackendChunk*) override;
+  void GetValueInto(BackendChunk*, float*) override;
+  std::shared_ptr<const float> BorrowValue(BackendChunk*) override;
 
   void OnOperationComplete(Task*) override;
 
+ protected:
+  std::vector<BackendChunk*> CreateOp(const std::vector<BackendChunk*>&, const std::vector<Scale>&, const PhysicalOp&) override;
+
  private:
   DeviceManager& device_manager_;
-
-  std::mutex finish_mutex_;
-  std::atomic<bool> finished_flag_;
-  std::condition_variable finish_cond_;
+  SchedulerTelemetry* telemetry_;
 
   DISALLOW_COPY_AND_ASSIGN(SimpleBackend);
 };
@@ -1,5 +1,7 @@
 #pragma once
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include "common/shared_mutex.h"
 #include "common/common.h"
 
@@ -21,6 +23,11 @@ class ConcurrentUnorderedMap {
     WriterLock lock(m_);
     return map_.insert(v).second;
   }
+  // Inserts a default constructed value, for values that cannot be copied
+  size_t Emplace(const K& k) {
+    WriterLock lock(m_);
+    return map_.emplace(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple()).second;
+  }
   V& At(const K& k) {
     ReaderLock lock(m_);
     return map_.at(k);
@@ -0,0 +1,39 @@
+#include "common/mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dmlc/logging.h>
+
+using namespace std;
+
+namespace minerva {
+namespace common {
+
+shared_ptr<float> MapFile(const string& filename, size_t offset, size_t length) {
+  CHECK_GT(length, 0) << "empty mapping of " << filename;
+  CHECK_EQ(offset % sizeof(float), 0) << "offset into " << filename << " not aligned to floats";
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "failed to open " << filename << ": " << strerror(errno);
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "failed to stat " << filename << ": " << strerror(errno);
+  CHECK_LE(offset + length, static_cast<size_t>(st.st_size)) << filename << " is too short";
+  // Mappings start at page boundaries
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t start = offset / page * page;
+  size_t mapped = offset - start + length;
+  void* ptr = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, start);
+  int error = errno;
+  close(fd);
+  CHECK_NE(ptr, MAP_FAILED) << "failed to map " << filename << ": " << strerror(error);
+  auto base = static_cast<char*>(ptr);
+  return shared_ptr<float>(reinterpret_cast<float*>(base + (offset - start)), [base, mapped](float*) {
+    munmap(base, mapped);
+  });
+}
+
+}  // namespace common
+}  // namespace minerva
+
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace minerva {
+namespace common {
+
+// Maps `length` bytes of a file starting `offset` bytes in. The mapping is
+// private: pages are shared with other processes through the page cache and
+// only copied when written. It is unmapped with the last reference.
+std::shared_ptr<float> MapFile(const std::string& filename, size_t offset, size_t length);
+
+}  // namespace common
+}  // namespace minerva
+
@@ -0,0 +1,190 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "common/common.h"
+
+namespace minerva {
+
+// Hash map split into shards that are replaced as a whole on every write.
+// Lookups never lock or wait: they announce themselves in the reader count of
+// the current epoch of a shard and read the shard they find. A writer
+// publishes its copy of the shard, starts a new epoch and frees the old copy
+// once the readers of the previous epoch are gone. Writes copy their shard,
+// so they take time linear in its size and are serialized per shard. Values
+// are copied in and out, so they stay valid while other threads modify the
+// map.
+template<typename K, typename V, size_t kNumShards = 64>
+class ShardedMap {
+ public:
+  ShardedMap() = default;
+  DISALLOW_COPY_AND_MOVE(ShardedMap);
+  ~ShardedMap() {
+    for (auto& shard : shards_) {
+      delete shard.table.load();
+    }
+  }
+  // Returns false if the key exists
+  bool Insert(const K& k, const V& v) {
+    auto& shard = ShardOf(k);
+    std::lock_guard<std::mutex> lck(shard.write_mutex);
+    const Table& table = *shard.table.load();
+    auto it = Find(table, k);
+    if (it != table.end() && it->first == k) {
+      return false;
+    }
+    auto copy = new Table();
+    copy->reserve(table.size() + 1);
+    copy->insert(copy->end(), table.cbegin(), it);
+    copy->emplace_back(k, v);
+    copy->insert(copy->end(), it, table.cend());
+    Publish(shard, copy);
+    return true;
+  }
+  // Copies the erased value to `v` unless null
+  size_t Erase(const K& k, V* v = nullptr) {
+    auto& shard = ShardOf(k);
+    std::lock_guard<std::mutex> lck(shard.write_mutex);
+    const Table& table = *shard.table.load();
+    auto it = Find(table, k);
+    if (it == table.end() || it->first != k) {
+      return 0;
+    }
+    if (v) {
+      *v = it->second;
+    }
+    auto copy = new Table();
+    copy->reserve(table.size() - 1);
+    copy->insert(copy->end(), table.cbegin(), it);
+    copy->insert(copy->end(), std::next(it), table.cend());
+    Publish(shard, copy);
+    return 1;
+  }
+  // Returns false if the key does not exist
+  bool Get(const K& k, V* v) const {
+    Snapshot snapshot(ShardOf(k));
+    auto& table = snapshot.table();
+    auto it = Find(table, k);
+    if (it == table.end() || it->first != k) {
+      return false;
+    }
+    *v = it->second;
+    return true;
+  }
+  // Calls `fn` on the value, default constructed if absent, with the other
+  // writers of its shard excluded. The entry is erased if `fn` returns false.
+  template<typename Fn>
+  void Update(const K& k, Fn fn) {
+    auto& shard = ShardOf(k);
+    std::lock_guard<std::mutex> lck(shard.write_mutex);
+    const Table& table = *shard.table.load();
+    auto it = Find(table, k);
+    bool found = it != table.end() && it->first == k;
+    V v = found ? it->second : V();
+    bool keep = fn(v);
+    if (!found && !keep) {
+      return;
+    }
+    auto copy = new Table();
+    copy->reserve(table.size() + 1);
+    copy->insert(copy->end(), table.cbegin(), it);
+    if (keep) {
+      copy->emplace_back(k, std::move(v));
+    }
+    copy->insert(copy->end(), found ? std::next(it) : it, table.cend());
+    Publish(shard, copy);
+  }
+  size_t Count(const K& k) const {
+    Snapshot snapshot(ShardOf(k));
+    auto& table = snapshot.table();
+    auto it = Find(table, k);
+    return it != table.end() && it->first == k;
+  }
+  // Calls `fn` on every entry, one shard at a time. Writers of a shard wait
+  // for `fn` to be done with it.
+  void ForEach(const std::function<void(const K&, const V&)>& fn) const {
+    for (auto& shard : shards_) {
+      Snapshot snapshot(shard);
+      for (auto& i : snapshot.table()) {
+        fn(i.first, i.second);
+      }
+    }
+  }
+  void Clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lck(shard.write_mutex);
+      Publish(shard, new Table());
+    }
+  }
+
+ private:
+  // Sorted by key, so that a copy takes a single allocation
+  using Table = std::vector<std::pair<K, V>>;
+  struct Shard {
+    std::atomic<Table*> table{new Table()};
+    std::atomic<uint64_t> epoch{0};
+    // Readers of even and odd epochs
+    mutable std::array<std::atomic<int>, 2> readers{{{0}, {0}}};
+    std::mutex write_mutex;
+    // Keeps the counters of neighboring shards on different cache lines
+    char padding[64];
+  };
+  // Keeps the table of a shard alive while in scope
+  class Snapshot {
+   public:
+    explicit Snapshot(const Shard& shard) : shard_(shard) {
+      while (true) {
+        epoch_ = shard_.epoch.load();
+        ++shard_.readers[epoch_ % 2];
+        // A writer that started a new epoch in between may not wait for us
+        if (shard_.epoch.load() == epoch_) {
+          break;
+        }
+        --shard_.readers[epoch_ % 2];
+      }
+      table_ = shard_.table.load();
+    }
+    DISALLOW_COPY_AND_MOVE(Snapshot);
+    ~Snapshot() {
+      --shard_.readers[epoch_ % 2];
+    }
+    const Table& table() const {
+      return *table_;
+    }
+
+   private:
+    const Shard& shard_;
+    uint64_t epoch_;
+    const Table* table_;
+  };
+  // Called with the write mutex of the shard held
+  static void Publish(Shard& shard, Table* table) {
+    auto old = shard.table.exchange(table);
+    auto epoch = shard.epoch++;
+    // Readers that may hold the old table counted themselves in its epoch
+    while (shard.readers[epoch % 2].load()) {
+      std::this_thread::yield();
+    }
+    delete old;
+  }
+  static typename Table::const_iterator Find(const Table& table, const K& k) {
+    return std::lower_bound(table.begin(), table.end(), k, [](const std::pair<K, V>& i, const K& k) {
+      return i.first < k;
+    });
+  }
+  Shard& ShardOf(const K& k) {
+    return shards_[std::hash<K>()(k) % kNumShards];
+  }
+  const Shard& ShardOf(const K& k) const {
+    return shards_[std::hash<K>()(k) % kNumShards];
+  }
+  std::array<Shard, kNumShards> shards_;
+};
+
+}  // namespace minerva
+
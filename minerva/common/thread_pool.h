@@ -12,9 +12,12 @@ class ThreadPool {
   typedef std::function<void(int)> Task;
   ThreadPool() = delete;
   DISALLOW_COPY_AND_ASSIGN(ThreadPool);
-  ThreadPool(size_t numthreads) : num_tasks_unfinished_(0) {
+  // Workers are numbered from `first_thrid` so that pools sharing per-thread
+  // resources can tell their threads apart. Each worker runs `init` before
+  // taking any task.
+  ThreadPool(size_t numthreads, int first_thrid = 0, std::function<void()> init = nullptr) : num_tasks_unfinished_(0), init_(init) {
     for(size_t thrid = 0; thrid < numthreads; ++thrid) {
-      workers_.emplace_back(&ThreadPool::SimpleWorker, this, thrid);
+      workers_.emplace_back(&ThreadPool::SimpleWorker, this, first_thrid + thrid);
     }
   }
   ~ThreadPool() {
@@ -33,13 +36,24 @@ class ThreadPool {
       std::this_thread::yield();
     }
   }
+  size_t NumThreads() const {
+    return workers_.size();
+  }
+  // Tasks pushed but not finished yet, including the running ones
+  int NumTasksUnfinished() const {
+    return num_tasks_unfinished_;
+  }
 
  private:
   std::vector<std::thread> workers_;
   ConcurrentBlockingQueue<Task> task_queue_;
   std::atomic<int> num_tasks_unfinished_;
+  std::function<void()> init_;
 
   void SimpleWorker(int thrid) {
+    if (init_) {
+      init_();
+    }
     Task task;
     while (!task_queue_.Pop(task)) {
       task(thrid);
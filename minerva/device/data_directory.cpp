@@ -0,0 +1,43 @@
+#include "device/data_directory.h"
+#include <algorithm>
+#include <dmlc/logging.h>
+
+using namespace std;
+
+namespace minerva {
+
+void DataDirectory::Add(uint64_t data_id, uint64_t device_id) {
+  holders_.Update(data_id, [&](vector<uint64_t>& devices) {
+    CHECK(find(devices.begin(), devices.end(), device_id) == devices.end()) << "data #" << data_id << " already on device #" << device_id;
+    devices.push_back(device_id);
+    return true;
+  });
+}
+
+bool DataDirectory::Remove(uint64_t data_id, uint64_t device_id) {
+  bool removed = false;
+  holders_.Update(data_id, [&](vector<uint64_t>& devices) {
+    auto it = find(devices.begin(), devices.end(), device_id);
+    if (it != devices.end()) {
+      devices.erase(it);
+      removed = true;
+    }
+    return !devices.empty();
+  });
+  return removed;
+}
+
+vector<uint64_t> DataDirectory::Holders(uint64_t data_id) const {
+  vector<uint64_t> ret;
+  holders_.Get(data_id, &ret);
+  return ret;
+}
+
+vector<uint64_t> DataDirectory::Erase(uint64_t data_id) {
+  vector<uint64_t> ret;
+  holders_.Erase(data_id, &ret);
+  return ret;
+}
+
+}  // namespace minerva
+
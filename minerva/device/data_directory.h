@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "common/common.h"
+#include "common/sharded_map.h"
+
+namespace minerva {
+
+// Devices holding a copy of each piece of data. The device computing the data
+// holds it first, and other devices hold replicas copied on demand.
+class DataDirectory {
+ public:
+  DataDirectory() = default;
+  DISALLOW_COPY_AND_ASSIGN(DataDirectory);
+  ~DataDirectory() = default;
+  void Add(uint64_t data_id, uint64_t device_id);
+  // Returns false if the device does not hold the data
+  bool Remove(uint64_t data_id, uint64_t device_id);
+  // In the order the devices got the data
+  std::vector<uint64_t> Holders(uint64_t data_id) const;
+  // Forgets the data and returns the devices holding it
+  std::vector<uint64_t> Erase(uint64_t data_id);
+
+ private:
+  ShardedMap<uint64_t, std::vector<uint64_t>> holders_;
+};
+
+}  // namespace minerva
+
@@ -1,54 +1,93 @@
 #include "data_store.h"
+#include <sstream>
 
 using namespace std;
 
 namespace minerva {
 
+string MemoryStats::ToString() const {
+  ostringstream ss;
+  ss << "device #" << device_id << ": live " << live_bytes << "B, pooled " << pooled_bytes
+    << "B, spilled " << spilled_bytes << "B, peak " << peak_live_bytes << "B, "
+    << num_allocations << " allocations, " << num_frees << " frees, fragmentation "
+    << fragmentation << endl;
+  for (auto& i : live_bytes_by_op) {
+    ss << "  " << i.first << ": " << i.second << "B" << endl;
+  }
+  return ss.str();
+}
+
 DataStore::DataStore(function<void*(size_t)> a, function<void(void*)> d) : allocator_(a), deallocator_(d) {
 }
 
 DataStore::~DataStore() {
-  for (auto& i : data_states_) {
-    deallocator_(i.second.ptr);
-  }
+  data_states_.ForEach([this](uint64_t, const DataState& ds) {
+    deallocator_(ds.ptr);
+  });
 }
 
 float* DataStore::CreateData(uint64_t id, size_t length) {
-  lock_guard<mutex> lck(access_mutex_);
   DLOG(INFO) << "create data #" << id << " length " << length;
-  auto it = data_states_.emplace(id, DataState());
-  CHECK(it.second) << "data already existed";
-  auto& ds = it.first->second;
-  ds.length = length;
-  ds.ptr = allocator_(length);
-  return static_cast<float*>(ds.ptr);
+  auto ptr = allocator_(length);
+  CHECK(data_states_.Insert(id, DataState{ptr, length})) << "data already existed";
+  RecordCreate(length);
+  return static_cast<float*>(ptr);
 }
 
 float* DataStore::GetData(uint64_t id) {
-  lock_guard<mutex> lck(access_mutex_);
-  auto& ds = data_states_.at(id);
+  DataState ds{nullptr, 0};
+  CHECK(data_states_.Get(id, &ds)) << "data #" << id << " does not exist";
   return static_cast<float*>(ds.ptr);
 }
 
 bool DataStore::ExistData(uint64_t id) const {
-  lock_guard<mutex> lck(access_mutex_);
-  return data_states_.find(id) != data_states_.end();
+  return data_states_.Count(id);
 }
 
 void DataStore::FreeData(uint64_t id) {
-  lock_guard<mutex> lck(access_mutex_);
-  auto& ds = data_states_.at(id);
+  DataState ds{nullptr, 0};
+  CHECK_EQ(data_states_.Erase(id, &ds), 1);
   deallocator_(ds.ptr);
-  CHECK_EQ(data_states_.erase(id), 1);
+  RecordFree(ds.length);
 }
 
 size_t DataStore::GetTotalBytes() const {
-  lock_guard<mutex> lck(access_mutex_);
-  size_t total_bytes = 0;
-  for (auto& it : data_states_) {
-    total_bytes += it.second.length;
+  return live_bytes_;
+}
+
+MemoryStats DataStore::GetStats() const {
+  MemoryStats stats;
+  stats.live_bytes = live_bytes_;
+  stats.peak_live_bytes = peak_live_bytes_;
+  stats.num_allocations = num_allocations_;
+  stats.num_frees = num_frees_;
+  return stats;
+}
+
+void DataStore::ResetStats() {
+  peak_live_bytes_ = live_bytes_.load();
+  num_allocations_ = 0;
+  num_frees_ = 0;
+}
+
+void DataStore::RecordCreate(size_t length) {
+  auto live = live_bytes_ += length;
+  auto peak = peak_live_bytes_.load();
+  while (peak < live && !peak_live_bytes_.compare_exchange_weak(peak, live)) {
   }
-  return total_bytes;
+  ++num_allocations_;
+}
+
+void DataStore::RecordFree(size_t length) {
+  live_bytes_ -= length;
+  ++num_frees_;
+}
+
+float* DataStore::PinData(uint64_t id) {
+  return GetData(id);
+}
+
+void DataStore::UnpinData(uint64_t) {
 }
 
 }  // namespace minerva
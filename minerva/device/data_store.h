@@ -1,4 +1,7 @@
 #pragma once
+#include <atomic>
+#include <map>
+#include <string>
 #include <unordered_map>
 #include <functional>
 #include <mutex>
@@ -6,9 +9,30 @@
 #include <cstddef>
 #include <dmlc/logging.h>
 #include "common/common.h"
+#include "common/sharded_map.h"
 
 namespace minerva {
 
+struct MemoryStats {
+  uint64_t device_id = 0;
+  // Requested by live buffers
+  size_t live_bytes = 0;
+  // Obtained from the allocator but not held by live buffers
+  size_t pooled_bytes = 0;
+  // Live buffers moved out of memory
+  size_t spilled_bytes = 0;
+  // Highest `live_bytes` since the last reset
+  size_t peak_live_bytes = 0;
+  // Since the last reset
+  uint64_t num_allocations = 0;
+  uint64_t num_frees = 0;
+  // Share of the pooled bytes outside of the largest free block
+  double fragmentation = 0;
+  // Live bytes by the type of the op that produced them
+  std::map<std::string, size_t> live_bytes_by_op;
+  std::string ToString() const;
+};
+
 class DataStore {
  public:
   DataStore(std::function<void*(size_t)> a, std::function<void(void*)> d);
@@ -18,15 +42,31 @@ class DataStore {
   virtual float* GetData(uint64_t);
   virtual bool ExistData(uint64_t id) const;
   virtual void FreeData(uint64_t);
+  // Bytes held in memory by live buffers
   virtual size_t GetTotalBytes() const;
+  virtual MemoryStats GetStats() const;
+  // Restarts the peak and the counters from the current state
+  void ResetStats();
+  // Buffers stay resident between `PinData` and `UnpinData`. Buffers returned
+  // by `CreateData` start pinned.
+  virtual float* PinData(uint64_t);
+  virtual void UnpinData(uint64_t);
 
  protected:
   struct DataState {
     void* ptr;
     size_t length;
   };
+  // Accounting of live buffers, done by every store
+  void RecordCreate(size_t);
+  void RecordFree(size_t);
+  std::atomic<size_t> live_bytes_{0};
+  std::atomic<size_t> peak_live_bytes_{0};
+  std::atomic<uint64_t> num_allocations_{0};
+  std::atomic<uint64_t> num_frees_{0};
+  // Guards the allocation state of derived stores
   mutable std::mutex access_mutex_;
-  std::unordered_map<uint64_t, DataState> data_states_;
+  ShardedMap<uint64_t, DataState> data_states_;
   std::function<void*(size_t)> allocator_;
   std::function<void(void*)> deallocator_;
 };
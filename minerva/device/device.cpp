@@ -4,6 +4,11 @@
 #include <mutex>
 #include <sstream>
 #include <cstring>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+#include <typeinfo>
+#include <cxxabi.h>
 
 #include <dmlc/logging.h>
 #include <gflags/gflags.h>
@@ -14,6 +19,9 @@
 #include "op/context.h"
 #include "common/cuda_utils.h"
 #include "device/pooled_data_store.h"
+#include "device/spilling_data_store.h"
+#include "device/huge_page_allocator.h"
+#include "device/numa.h"
 #include "profiler/wall_timer.h"
 #ifdef HAS_CUDA
 #include <cuda_runtime.h>
@@ -24,97 +32,306 @@
 
 #define DEFAULT_POOL_SIZE ((size_t) 5.8 * 1024 * 1024 * 1024)
 DEFINE_bool(no_execute, false, "Disable the actual computation (for performance debuggin)");
+DEFINE_int32(cpu_memory_budget_mb, 0, "Spill least recently used buffers of a CPU device to disk above this many MB (0 to disable)");
+DEFINE_string(spill_dir, "/tmp", "Directory of the scratch files for spilled buffers");
+DEFINE_int32(cpu_pool_mb, 4096, "Idle memory pooled by a CPU device is returned to the system above this many MB");
+DEFINE_bool(cpu_huge_pages, true, "Back the memory pool of a CPU device with 2MB pages when available");
+DEFINE_int32(cpu_prefault_mb, 0, "Map and pre-fault this many MB of memory for each CPU device at startup");
+DEFINE_int32(cpu_threads, 4, "Default number of threads running ops on a CPU device");
+DEFINE_bool(cpu_share_buffers, true, "CPU devices read buffers of other CPU devices on the same NUMA node in place instead of copying them");
+DEFINE_int32(partition_threshold, 0, "Split ops with at least this many output elements across idle CPU devices (0 to disable)");
 
 using namespace std;
 
 namespace minerva {
 
-Device::Device(uint64_t device_id, DeviceListener* l) : device_id_(device_id), data_store_{unique_ptr<DataStore>(nullptr)}, listener_(l) {
+Device::Device(uint64_t device_id, DeviceListener* l, DataDirectory* directory) : device_id_(device_id), data_store_{unique_ptr<DataStore>(nullptr)}, listener_(l), directory_(directory) {
 }
 
 pair<Device::MemType, float*> Device::GetPtr(uint64_t data_id) {
-  return make_pair(GetMemType(), data_store_->GetData(data_id));
+  return make_pair(GetMemType(), PinData(data_id));
+}
+
+void Device::ReleasePtr(uint64_t data_id) {
+  UnpinData(data_id);
+}
+
+shared_ptr<const float> Device::BorrowHostPtr(uint64_t data_id) {
+  if (GetMemType() != MemType::kCpu) {
+    return nullptr;
+  }
+  ResidentData d;
+  auto base = data_id;
+  if (residency_.Get(data_id, &d)) {
+    if (d.shared) {
+      return shared_ptr<const float>(d.shared, d.shared.get() + d.offset);
+    }
+    base = d.base;
+  }
+  AddBufferRef(base);
+  return shared_ptr<const float>(PinData(data_id), [this, base](const float*) {
+    // Borrowed buffers may outlive the system at exit
+    if (MinervaSystem::IsAlive()) {
+      data_store_->UnpinData(base);
+      ReleaseBuffer(base);
+    }
+  });
 }
 
 void Device::FreeDataIfExist(uint64_t data_id) {
-  auto d = local_data_.Erase(data_id) + remote_data_.Erase(data_id);
-  if (d == 1) {
-    data_store_->FreeData(data_id);
-  } else if (d != 0) {
-    LOG(FATAL) << "duplicate data";
+  ResidentData d;
+  if (residency_.Erase(data_id, &d) && !d.shared) {
+    ReleaseBuffer(d.base);
+  }
+}
+
+size_t Device::EvictReplicas() {
+  vector<uint64_t> replicas;
+  residency_.ForEach([&replicas](uint64_t id, const ResidentData& d) {
+    if (d.remote) {
+      replicas.push_back(id);
+    }
+  });
+  size_t bytes = 0;
+  for (auto id : replicas) {
+    ResidentData d;
+    // The data may be freed meanwhile
+    if (residency_.Erase(id, &d)) {
+      directory_->Remove(id, device_id_);
+      ReleaseBuffer(d.base);
+      bytes += d.bytes;
+    }
   }
+  return bytes;
 }
 
 string Device::GetMemUsage() const {
-  return common::FString("device #%d used %dB", device_id_, data_store_->GetTotalBytes());
+  return GetMemoryStats().ToString();
+}
+
+namespace {
+
+string OpTypeName(const char* mangled) {
+  int status;
+  unique_ptr<char, void(*)(void*)> demangled(abi::__cxa_demangle(mangled, nullptr, nullptr, &status), free);
+  if (status != 0) {  // Not a type name
+    return mangled;
+  }
+  string ret = demangled.get();
+  return ret.compare(0, 9, "minerva::") == 0 ? ret.substr(9) : ret;
+}
+
+// Largest power of two up to `max` that every buffer starts at a multiple of.
+// Views, mapped files and borrowed buffers may start anywhere past a float.
+size_t BufferAlignment(const DataList& in, const DataList& out, size_t max) {
+  uintptr_t bits = max;
+  for (auto& i : in) {
+    bits |= reinterpret_cast<uintptr_t>(i.data_);
+  }
+  for (auto& i : out) {
+    bits |= reinterpret_cast<uintptr_t>(i.data_);
+  }
+  return bits & (~bits + 1);
+}
+
+}  // namespace
+
+MemoryStats Device::GetMemoryStats() const {
+  auto stats = data_store_->GetStats();
+  stats.device_id = device_id_;
+  residency_.ForEach([&stats](uint64_t, const ResidentData& d) {
+    // Views hold no buffer of their own
+    if (d.bytes) {
+      stats.live_bytes_by_op[OpTypeName(d.producer)] += d.bytes;
+    }
+  });
+  return stats;
+}
+
+void Device::ResetMemoryStats() {
+  data_store_->ResetStats();
+}
+
+float* Device::PinData(uint64_t data_id) {
+  ResidentData d;
+  if (residency_.Get(data_id, &d)) {
+    if (d.shared) {
+      return d.shared.get() + d.offset;
+    } else if (d.base != data_id) {
+      return data_store_->PinData(d.base) + d.offset;
+    }
+  }
+  return data_store_->PinData(data_id);
+}
+
+void Device::UnpinData(uint64_t data_id) {
+  ResidentData d;
+  if (residency_.Get(data_id, &d)) {
+    if (d.shared) {
+      return;
+    } else if (d.base != data_id) {
+      data_store_->UnpinData(d.base);
+      return;
+    }
+  }
+  data_store_->UnpinData(data_id);
+}
+
+void Device::AddBufferRef(uint64_t base) {
+  buffer_refs_.Update(base, [](int& refs) {
+    refs = refs ? refs + 1 : 2;
+    return true;
+  });
+}
+
+void Device::ReleaseBuffer(uint64_t base) {
+  bool last = false;
+  buffer_refs_.Update(base, [&last](int& refs) {
+    last = refs <= 1;
+    return !last && --refs;
+  });
+  if (last) {
+    data_store_->FreeData(base);
+  }
 }
 
-ThreadedDevice::ThreadedDevice(uint64_t device_id, DeviceListener* l, size_t parallelism) : Device(device_id, l), pool_(parallelism) {
+ThreadedDevice::ThreadedDevice(uint64_t device_id, DeviceListener* l, DataDirectory* directory, size_t parallelism, function<void()> init) : Device(device_id, l, directory), pool_(parallelism, 0, init), latency_pool_(kLatencyLaneParallelism, parallelism, init) {
 }
 
 void ThreadedDevice::PushTask(Task* task) {
-  if (!task->light)
-    pool_.Push(bind(&ThreadedDevice::Execute, this, task, placeholders::_1));
-  else
+  if (task->light)
     // light weight tasks are executed directly to avoid thread switching
     Execute(task, 0);
-}
-
-void ThreadedDevice::FreeDataIfExist(uint64_t data_id) {
-  copy_locks_.Erase(data_id);
-  Device::FreeDataIfExist(data_id);
+  else if (latency_classifier_.UseLatencyLane(*task, pool_.NumTasksUnfinished(), pool_.NumThreads(), latency_pool_.NumTasksUnfinished(), latency_pool_.NumThreads()))
+    // small tasks must not queue up behind heavy ones
+    latency_pool_.Push(bind(&ThreadedDevice::Execute, this, task, placeholders::_1));
+  else
+    pool_.Push(bind(&ThreadedDevice::Execute, this, task, placeholders::_1));
 }
 
 void ThreadedDevice::Execute(Task* task, int thrid) {
+  // Tasks may still run while the system shuts down
+  auto ms = MinervaSystem::IsAlive() ? &MinervaSystem::Instance() : nullptr;
+  auto telemetry = ms ? &ms->telemetry() : nullptr;
+  if (telemetry) {
+    telemetry->OnTaskStarted(device_id_, task->id);
+  }
+  auto execute_start = chrono::steady_clock::now();
   PreExecute();
 #ifndef NDEBUG
   WallTimer memory_timer;
   memory_timer.Start();
 #endif
   DataList input_shards;
+  // Buffers accessed by the task must not be spilled until it finishes
+  vector<uint64_t> pinned;
+  // Buffers of other devices read in place, pinned on their owners
+  vector<pair<uint64_t, uint64_t>> borrowed;
   for (auto& i : task->inputs) {
     auto& input_data = i.physical_data;
     if (input_data.device_id == device_id_) {  // Input is local
       DLOG(INFO) << Name() << " input task data #" << i.id << " is local";
-      CHECK_EQ(local_data_.Count(input_data.data_id), 1);
-    } else {
-      lock_guard<mutex> lck(copy_locks_[input_data.data_id]);
-      if (!remote_data_.Count(input_data.data_id)) {  // Input is remote and not copied
+      CHECK_EQ(residency_.Count(input_data.data_id), 1);
+    } else if (!residency_.Count(input_data.data_id) && CanReadDirectly(*MinervaSystem::Instance().device_manager().GetDevice(input_data.device_id))) {
+      DLOG(INFO) << Name() << " input task data #" << i.id << " is remote and read in place";
+      // Consumers finish before the data is freed, so the pin keeps it valid
+      input_shards.emplace_back(MinervaSystem::Instance().GetPtr(input_data.device_id, input_data.data_id).second, input_data.size);
+      borrowed.emplace_back(input_data.device_id, input_data.data_id);
+      continue;
+    } else if (!residency_.Count(input_data.data_id)) {
+      lock_guard<mutex> lck(copy_locks_[input_data.data_id % kNumCopyLocks]);
+      if (!residency_.Count(input_data.data_id)) {  // Input is remote and not copied
         DLOG(INFO) << Name() << " input task data #" << i.id << " is remote and not copied";
         size_t size = input_data.size.Prod() * sizeof(float);
         auto ptr = data_store_->CreateData(input_data.data_id, size);
-        DoCopyRemoteData(ptr, MinervaSystem::Instance().GetPtr(input_data.device_id, input_data.data_id).second, size, thrid);
-        CHECK(remote_data_.Insert(input_data.data_id));
+        auto& ms = MinervaSystem::Instance();
+        auto source = ReplicaSource(input_data);
+        DoCopyRemoteData(ptr, ms.GetPtr(source, input_data.data_id).second, size, thrid);
+        ms.ReleasePtr(source, input_data.data_id);
+        data_store_->UnpinData(input_data.data_id);
+        CHECK(residency_.Insert(input_data.data_id, ResidentData{true, size, "remote copy", input_data.data_id, 0}));
+        directory_->Add(input_data.data_id, device_id_);
       }
     }
-    input_shards.emplace_back(data_store_->GetData(input_data.data_id), input_data.size);
+    input_shards.emplace_back(PinData(input_data.data_id), input_data.size);
+    pinned.push_back(input_data.data_id);
+  }
+  auto& op = task->op;
+  CHECK(op.compute_fn);
+  // Views share the buffer of their input if this device holds it
+  size_t view_offset = 0;
+  ResidentData view_of{};
+  bool view = task->inputs.size() == 1 && task->outputs.size() == 1 &&
+    op.compute_fn->IsView(task->inputs[0].physical_data.size, task->outputs[0].physical_data.size, &view_offset) &&
+    residency_.Get(task->inputs[0].physical_data.data_id, &view_of);
+  // Host buffers are kept alive by the residency of the data, which holds
+  // no bytes of the device
+  shared_ptr<float> shared;
+  if (GetMemType() == MemType::kCpu && task->outputs.size() == 1) {
+    shared = op.compute_fn->SharedOutput();
   }
   DataList output_shards;
+  auto& fn = *op.compute_fn;
+  const char* producer = typeid(fn).name();
   for (auto& i : task->outputs) {
+    auto data_id = i.physical_data.data_id;
+    if (view) {
+      DLOG(INFO) << Name() << " create view for task data #" << i.id;
+      if (!view_of.shared) {
+        AddBufferRef(view_of.base);
+      }
+      CHECK(residency_.Insert(data_id, ResidentData{false, 0, producer, view_of.base, view_of.offset + view_offset, view_of.shared}));
+      directory_->Add(data_id, device_id_);
+      continue;
+    } else if (shared) {
+      DLOG(INFO) << Name() << " share host buffer for task data #" << i.id;
+      CHECK(residency_.Insert(data_id, ResidentData{false, 0, producer, data_id, 0, shared}));
+      directory_->Add(data_id, device_id_);
+      continue;
+    }
     size_t size = i.physical_data.size.Prod() * sizeof(float);
     DLOG(INFO) << Name() << " create output for task data #" << i.id;
-    auto ptr = data_store_->CreateData(i.physical_data.data_id, size);
-    CHECK(local_data_.Insert(i.physical_data.data_id));
+    auto ptr = data_store_->CreateData(data_id, size);
+    CHECK(residency_.Insert(data_id, ResidentData{false, size, producer, data_id, 0}));
+    directory_->Add(data_id, device_id_);
     output_shards.emplace_back(ptr, i.physical_data.size);
+    pinned.push_back(data_id);
   }
-  auto& op = task->op;
-  CHECK(op.compute_fn);
-  if(!FLAGS_no_execute) {
+  if (!FLAGS_no_execute && !view && !shared) {
 #ifndef NDEBUG
     Barrier(thrid);
     memory_timer.Stop();
-    MinervaSystem::Instance().profiler().RecordTime(TimerType::kMemory, op.compute_fn->Name(), memory_timer);
+    if (ms) {
+      ms->profiler().RecordTime(TimerType::kMemory, op.compute_fn->Name(), memory_timer);
+    }
     WallTimer calculate_timer;
     calculate_timer.Start();
 #endif
     DLOG(INFO) << Name() << " execute task #" << task->id << ": " << op.compute_fn->Name();
-    DoExecute(input_shards, output_shards, op, thrid);
+    if (LatencyClassifier::Enabled()) {
+      auto start = chrono::steady_clock::now();
+      DoExecute(input_shards, output_shards, op, thrid);
+      latency_classifier_.RecordTime(*task, chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    } else {
+      DoExecute(input_shards, output_shards, op, thrid);
+    }
     DLOG(INFO) << Name() << " finished execute task #" << task->id << ": " << op.compute_fn->Name();
 #ifndef NDEBUG
     calculate_timer.Stop();
-    MinervaSystem::Instance().profiler().RecordTime(TimerType::kCalculation, op.compute_fn->Name(), calculate_timer);
+    if (ms) {
+      ms->profiler().RecordTime(TimerType::kCalculation, op.compute_fn->Name(), calculate_timer);
+    }
 #endif
   }
+  for (auto id : pinned) {
+    UnpinData(id);
+  }
+  for (auto& i : borrowed) {
+    MinervaSystem::Instance().ReleasePtr(i.first, i.second);
+  }
+  if (telemetry) {
+    telemetry->OnTaskFinished(device_id_, task->id, chrono::duration<double, micro>(chrono::steady_clock::now() - execute_start).count());
+  }
   listener_->OnOperationComplete(task);
 }
 
@@ -124,6 +341,25 @@ void ThreadedDevice::PreExecute() {
 void ThreadedDevice::Barrier(int) {
 }
 
+uint64_t ThreadedDevice::ReplicaSource(const PhysicalData& data) const {
+  auto& dm = MinervaSystem::Instance().device_manager();
+  if (dm.GetDevice(data.device_id)->GetMemType() == GetMemType()) {
+    return data.device_id;
+  }
+  // Replicas are only dropped while no task runs, so a holder stays valid
+  // throughout the copy
+  for (auto holder : directory_->Holders(data.data_id)) {
+    if (holder != device_id_ && dm.GetDevice(holder)->GetMemType() == GetMemType()) {
+      return holder;
+    }
+  }
+  return data.device_id;
+}
+
+bool ThreadedDevice::CanReadDirectly(const Device&) const {
+  return false;
+}
+
 #ifdef HAS_CUDA
 
 struct GpuDevice::Impl {
@@ -133,15 +369,16 @@ struct GpuDevice::Impl {
   inline void ActivateDevice() const;
 
   static size_t constexpr kParallelism = 4;
+  static size_t constexpr kNumStreams = kParallelism + ThreadedDevice::kLatencyLaneParallelism;
   int const device;
-  array<cudaStream_t, kParallelism> stream;
-  array<cublasHandle_t, kParallelism> cublas_handle;
-  array<cudnnHandle_t, kParallelism> cudnn_handle;
+  array<cudaStream_t, kNumStreams> stream;
+  array<cublasHandle_t, kNumStreams> cublas_handle;
+  array<cudnnHandle_t, kNumStreams> cudnn_handle;
 };
 
 GpuDevice::Impl::Impl(int d) : device(d) {
   ActivateDevice();
-  for (size_t i = 0; i < kParallelism; ++i) {
+  for (size_t i = 0; i < kNumStreams; ++i) {
     CUDA_CALL(cudaStreamCreate(&stream[i]));
     CUBLAS_CALL(cublasCreate(&cublas_handle[i]));
     CUBLAS_CALL(cublasSetStream(cublas_handle[i], stream[i]));
@@ -152,7 +389,7 @@ GpuDevice::Impl::Impl(int d) : device(d) {
 
 GpuDevice::Impl::~Impl() {
   ActivateDevice();
-  for (size_t i = 0; i < kParallelism; ++i) {
+  for (size_t i = 0; i < kNumStreams; ++i) {
     CUDNN_CALL(cudnnDestroy(cudnn_handle[i]));
     CUBLAS_CALL(cublasDestroy(cublas_handle[i]));
     CUDA_CALL(cudaStreamDestroy(stream[i]));
@@ -163,7 +400,7 @@ void GpuDevice::Impl::ActivateDevice() const {
   CUDA_CALL(cudaSetDevice(device));
 }
 
-GpuDevice::GpuDevice(uint64_t device_id, DeviceListener* l, int gpu_id) : ThreadedDevice{device_id, l, Impl::kParallelism}, impl_{common::MakeUnique<Impl>(gpu_id)} {
+GpuDevice::GpuDevice(uint64_t device_id, DeviceListener* l, DataDirectory* directory, int gpu_id) : ThreadedDevice{device_id, l, directory, Impl::kParallelism}, impl_{common::MakeUnique<Impl>(gpu_id)} {
   impl_->ActivateDevice();
   cudaFree(0);  // Initialize
   auto allocator = [this](size_t len) -> void* {
@@ -182,6 +419,7 @@ GpuDevice::GpuDevice(uint64_t device_id, DeviceListener* l, int gpu_id) : Thread
 GpuDevice::~GpuDevice() {
   impl_->ActivateDevice();
   pool_.WaitForAllFinished();
+  latency_pool_.WaitForAllFinished();
   // `data_store_` has to be deallocated before `impl_` does, because the `deallocator` of `data_store_` depends on `impl_`
   data_store_.reset();
 }
@@ -210,6 +448,7 @@ void GpuDevice::DoCopyRemoteData(float* dst, float* src, size_t size, int thrid)
 void GpuDevice::DoExecute(const DataList& in, const DataList& out, PhysicalOp& op, int thrid) {
   Context ctx;
   ctx.impl_type = ImplType::kCuda;
+  ctx.alignment = BufferAlignment(in, out, PooledDataStore::kMinBlockSize);
   ctx.stream = impl_->stream[thrid];
   ctx.cublas_handle = impl_->cublas_handle[thrid];
   ctx.cudnn_handle = impl_->cudnn_handle[thrid];
@@ -219,19 +458,57 @@ void GpuDevice::DoExecute(const DataList& in, const DataList& out, PhysicalOp& o
 
 #endif
 
-CpuDevice::CpuDevice(uint64_t device_id, DeviceListener* l) : ThreadedDevice(device_id, l, kDefaultThreadNum) {
-  auto allocator = [](size_t len) -> void* {
-    void* ret = malloc(len);
-    return ret;
-  };
-  auto deallocator = [](void* ptr) {
-    free(ptr);
+size_t constexpr ThreadedDevice::kNumCopyLocks;
+size_t constexpr CpuDevice::kAlignment;
+
+namespace {
+
+size_t NumThreads(const CpuDeviceOptions& options) {
+  return options.num_threads ? options.num_threads : FLAGS_cpu_threads;
+}
+
+function<void()> PinTo(const vector<int>& cpus) {
+  if (cpus.empty()) {
+    return nullptr;
+  }
+  return [cpus]() {
+    SetThreadAffinity(pthread_self(), cpus);
   };
-  data_store_ = common::MakeUnique<DataStore>(allocator, deallocator);
+}
+
+}  // namespace
+
+CpuDevice::CpuDevice(uint64_t device_id, DeviceListener* l, DataDirectory* directory, const CpuDeviceOptions& options) : ThreadedDevice(device_id, l, directory, NumThreads(options), PinTo(options.cpus)), num_threads_(NumThreads(options)), pin_(PinTo(options.cpus)), numa_node_(options.numa_node) {
+  if (FLAGS_cpu_memory_budget_mb) {
+    // Buffers are placed on the node of the pinned threads that first touch them
+    auto allocator = [](size_t len) -> void* {
+      void* ret = nullptr;
+      CHECK_EQ(posix_memalign(&ret, kAlignment, len), 0);
+      return ret;
+    };
+    auto deallocator = [](void* ptr) {
+      free(ptr);
+    };
+    data_store_ = common::MakeUnique<SpillingDataStore>(static_cast<size_t>(FLAGS_cpu_memory_budget_mb) << 20, FLAGS_spill_dir, allocator, deallocator);
+  } else {
+    // Arenas are 2MB aligned and carved into blocks of multiples of 256 bytes
+    static_assert(PooledDataStore::kMinBlockSize % kAlignment == 0, "blocks not aligned");
+    auto host = make_shared<HugePageAllocator>(FLAGS_cpu_huge_pages, 0 < FLAGS_cpu_prefault_mb, options.numa_node);
+    auto allocator = [host](size_t len) {
+      return host->Allocate(len);
+    };
+    auto deallocator = [host](void* ptr) {
+      host->Free(ptr);
+    };
+    auto pool = common::MakeUnique<PooledDataStore>(static_cast<size_t>(FLAGS_cpu_pool_mb) << 20, allocator, deallocator);
+    pool->Reserve(static_cast<size_t>(FLAGS_cpu_prefault_mb) << 20);
+    data_store_ = move(pool);
+  }
 }
 
 CpuDevice::~CpuDevice() {
   pool_.WaitForAllFinished();
+  latency_pool_.WaitForAllFinished();
 }
 
 Device::MemType CpuDevice::GetMemType() const {
@@ -242,6 +519,29 @@ string CpuDevice::Name() const {
   return common::FString("CPU device #%d", device_id_);
 }
 
+bool CpuDevice::IsIdle() const {
+  return pool_.NumTasksUnfinished() < static_cast<int>(pool_.NumThreads());
+}
+
+void CpuDevice::PushPartition(const function<void()>& fn) {
+  // Only devices helping with partitioned ops start the threads
+  call_once(partition_pool_created_, [this]() {
+    partition_pool_ = common::MakeUnique<ThreadPool>(num_threads_, 0, pin_);
+  });
+  partition_pool_->Push([fn](int) {
+    fn();
+  });
+}
+
+bool CpuDevice::CanReadDirectly(const Device& source) const {
+  auto cpu = dynamic_cast<const CpuDevice*>(&source);
+  if (!FLAGS_cpu_share_buffers || !cpu) {
+    return false;
+  }
+  // A local replica is faster to read than memory of another node
+  return numa_node_ < 0 || cpu->numa_node_ < 0 || numa_node_ == cpu->numa_node_;
+}
+
 void CpuDevice::DoCopyRemoteData(float* dst, float* src, size_t size, int) {
 #ifdef HAS_CUDA
   CUDA_CALL(cudaMemcpy(dst, src, size, cudaMemcpyDefault));
@@ -251,10 +551,98 @@ void CpuDevice::DoCopyRemoteData(float* dst, float* src, size_t size, int) {
 }
 
 void CpuDevice::DoExecute(const DataList& in, const DataList& out, PhysicalOp& op, int) {
+  vector<bool> split;
+  if (0 < FLAGS_partition_threshold && !out.empty() &&
+      FLAGS_partition_threshold <= out[0].size_.Prod() &&
+      op.compute_fn->Partitionable(Map<Scale>(in, [](const DataShard& i) { return i.size_; }), &split)) {
+    vector<CpuDevice*> helpers;
+    for (auto d : MinervaSystem::Instance().device_manager().GetDevices()) {
+      auto cpu = dynamic_cast<CpuDevice*>(d);
+      if (cpu && cpu != this && cpu->IsIdle()) {
+        helpers.push_back(cpu);
+      }
+    }
+    if (!helpers.empty()) {
+      DoExecutePartitioned(in, out, op, split, helpers);
+      return;
+    }
+  }
   Context ctx;
   ctx.impl_type = ImplType::kBasic;
+  ctx.alignment = BufferAlignment(in, out, kAlignment);
   op.compute_fn->Execute(in, out, ctx);
 }
 
+void CpuDevice::DoExecutePartitioned(const DataList& in, const DataList& out, PhysicalOp& op, const vector<bool>& split, const vector<CpuDevice*>& helpers) {
+  // Column major storage makes every range along the last dimension a
+  // contiguous view, so partitions read and write the original buffers
+  // directly and no reassembly is needed
+  int last = out[0].size_[out[0].size_.NumDims() - 1];
+  for (auto& i : out) {
+    CHECK_EQ(i.size_[i.size_.NumDims() - 1], last) << "outputs of different length";
+  }
+  CHECK_EQ(split.size(), in.size());
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (split[i]) {
+      CHECK_EQ(in[i].size_[in[i].size_.NumDims() - 1], last) << "inputs of different length";
+    }
+  }
+  int num_parts = min(static_cast<int>(helpers.size()) + 1, last);
+  if (num_parts < 2) {
+    Context ctx;
+    ctx.impl_type = ImplType::kBasic;
+    ctx.alignment = BufferAlignment(in, out, kAlignment);
+    op.compute_fn->Execute(in, out, ctx);
+    return;
+  }
+  DLOG(INFO) << Name() << " splits " << op.compute_fn->Name() << " into " << num_parts << " parts";
+  // `DataShard` holds a reference to its size, so sizes are kept alive here
+  vector<vector<Scale>> in_sizes(num_parts), out_sizes(num_parts);
+  vector<DataList> in_parts(num_parts), out_parts(num_parts);
+  // Partitions start inside the buffers, so each has its own alignment
+  vector<Context> contexts(num_parts);
+  auto slice = [last](const DataShard& shard, int begin, int end, vector<Scale>& sizes, DataList& list) {
+    auto size = shard.size_;
+    size[size.NumDims() - 1] = end - begin;
+    sizes.push_back(size);
+    list.emplace_back(shard.data_ + static_cast<size_t>(shard.size_.Prod() / last) * begin, sizes.back());
+  };
+  for (int p = 0; p < num_parts; ++p) {
+    int begin = static_cast<int>(static_cast<int64_t>(last) * p / num_parts);
+    int end = static_cast<int>(static_cast<int64_t>(last) * (p + 1) / num_parts);
+    in_sizes[p].reserve(in.size());
+    out_sizes[p].reserve(out.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+      if (split[i]) {
+        slice(in[i], begin, end, in_sizes[p], in_parts[p]);
+      } else {
+        in_parts[p].emplace_back(in[i].data_, in[i].size_);
+      }
+    }
+    for (auto& i : out) {
+      slice(i, begin, end, out_sizes[p], out_parts[p]);
+    }
+    contexts[p].impl_type = ImplType::kBasic;
+    contexts[p].alignment = BufferAlignment(in_parts[p], out_parts[p], kAlignment);
+  }
+  mutex m;
+  condition_variable cv;
+  int remaining = num_parts - 1;
+  for (int p = 1; p < num_parts; ++p) {
+    helpers[p - 1]->PushPartition([&, p]() {
+      op.compute_fn->Execute(in_parts[p], out_parts[p], contexts[p]);
+      lock_guard<mutex> lck(m);
+      if (--remaining == 0) {
+        cv.notify_all();
+      }
+    });
+  }
+  op.compute_fn->Execute(in_parts[0], out_parts[0], contexts[0]);
+  unique_lock<mutex> lck(m);
+  while (remaining) {
+    cv.wait(lck);
+  }
+}
+
 }  // namespace minerva
 
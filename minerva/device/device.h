@@ -1,17 +1,21 @@
 #pragma once
+#include <array>
 #include <string>
 #include <utility>
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <functional>
 #include "device/task.h"
 #include "device/data_store.h"
+#include "device/data_directory.h"
 #include "device/device_listener.h"
+#include "device/latency_classifier.h"
 #include "op/physical_fn.h"
 #include "common/common.h"
 #include "common/thread_pool.h"
 #include "common/concurrent_blocking_queue.h"
-#include "common/concurrent_unordered_set.h"
-#include "common/concurrent_unordered_map.h"
+#include "common/sharded_map.h"
 
 namespace minerva {
 
@@ -23,46 +27,91 @@ class Device {
   };
   Device() = delete;
   DISALLOW_COPY_AND_ASSIGN(Device);
-  Device(uint64_t device_id, DeviceListener*);
+  // Copies of data kept by the device are registered in `directory`
+  Device(uint64_t device_id, DeviceListener*, DataDirectory* directory);
   virtual ~Device() = default;
   virtual void PushTask(Task*) = 0;
+  // The data stays resident until released by `ReleasePtr`
   virtual std::pair<MemType, float*> GetPtr(uint64_t data_id);
+  virtual void ReleasePtr(uint64_t data_id);
+  // The buffer of host data stays pinned and allocated, even once the data is
+  // freed, until the view returned is released. Null for other memory.
+  std::shared_ptr<const float> BorrowHostPtr(uint64_t data_id);
   virtual void FreeDataIfExist(uint64_t data_id);
+  // Drops the copies of data computed by other devices and returns the bytes
+  // freed. Tasks reading them must not be running.
+  size_t EvictReplicas();
   virtual std::string GetMemUsage() const;
+  MemoryStats GetMemoryStats() const;
+  void ResetMemoryStats();
   virtual std::string Name() const = 0;
   virtual MemType GetMemType() const = 0;
 
  protected:
-  ConcurrentUnorderedSet<uint64_t> local_data_;
-  ConcurrentUnorderedSet<uint64_t> remote_data_;
+  struct ResidentData {
+    // Copied from another device
+    bool remote;
+    size_t bytes;
+    // Mangled type name of the op that produced the data, demangled only when
+    // statistics are taken
+    const char* producer;
+    // Data owning the buffer, which differs for views of other data
+    uint64_t base;
+    // Floats into the buffer
+    size_t offset;
+    // Host buffer not owned by the data store
+    std::shared_ptr<float> shared;
+  };
+  // Resolves views to the buffer of their base
+  float* PinData(uint64_t data_id);
+  void UnpinData(uint64_t data_id);
+  void AddBufferRef(uint64_t base);
+  // Frees the buffer once released by its owner and all views
+  void ReleaseBuffer(uint64_t base);
+  ShardedMap<uint64_t, ResidentData> residency_;
+  // Views and borrowers of each buffer plus one for its owner, only kept for
+  // buffers with views or borrowers
+  ShardedMap<uint64_t, int> buffer_refs_;
   uint64_t device_id_;
   std::unique_ptr<DataStore> data_store_;
   DeviceListener* listener_;
+  DataDirectory* directory_;
 };
 
 class ThreadedDevice : public Device {
  public:
+  // Threads reserved for latency critical tasks, numbered after the threads
+  // of the main pool
+  static size_t constexpr kLatencyLaneParallelism = 1;
   ThreadedDevice() = delete;
-  ThreadedDevice(uint64_t device_id, DeviceListener*, size_t parallelism);
+  // Every worker thread runs `init` before taking any task
+  ThreadedDevice(uint64_t device_id, DeviceListener*, DataDirectory*, size_t parallelism, std::function<void()> init = nullptr);
   DISALLOW_COPY_AND_ASSIGN(ThreadedDevice);
   ~ThreadedDevice() = default;
   void PushTask(Task*) override;
-  void FreeDataIfExist(uint64_t data_id) override;
 
  protected:
   virtual void Execute(Task*, int thrid);
   virtual void PreExecute();
   virtual void Barrier(int);
+  // Device to copy remote data from, preferring one of the same memory type
+  uint64_t ReplicaSource(const PhysicalData&) const;
+  // Whether buffers of the device can be read in place instead of copied
+  virtual bool CanReadDirectly(const Device&) const;
   virtual void DoCopyRemoteData(float*, float*, size_t, int) = 0;
   virtual void DoExecute(const DataList&, const DataList&, PhysicalOp&, int) = 0;
-  ConcurrentUnorderedMap<uint64_t, std::mutex> copy_locks_;
+  // Striped by data id, serializing copies of the same remote data
+  static size_t constexpr kNumCopyLocks = 64;
+  std::array<std::mutex, kNumCopyLocks> copy_locks_;
+  LatencyClassifier latency_classifier_;
   ThreadPool pool_;
+  ThreadPool latency_pool_;
 };
 
 #ifdef HAS_CUDA
 class GpuDevice : public ThreadedDevice {
  public:
-  GpuDevice(uint64_t device_id, DeviceListener*, int gpu_id);
+  GpuDevice(uint64_t device_id, DeviceListener*, DataDirectory*, int gpu_id);
   DISALLOW_COPY_AND_ASSIGN(GpuDevice);
   ~GpuDevice();
   MemType GetMemType() const override;
@@ -78,18 +127,43 @@ class GpuDevice : public ThreadedDevice {
 };
 #endif
 
+struct CpuDeviceOptions {
+  // Threads running ops, 0 for `--cpu_threads`
+  size_t num_threads = 0;
+  // CPUs the threads are pinned to, not pinned if empty
+  std::vector<int> cpus;
+  // NUMA node holding the device memory, left to first touch if negative
+  int numa_node = -1;
+};
+
 class CpuDevice : public ThreadedDevice {
  public:
-  CpuDevice(uint64_t device_id, DeviceListener*);
+  CpuDevice(uint64_t device_id, DeviceListener*, DataDirectory*, const CpuDeviceOptions& = CpuDeviceOptions());
   DISALLOW_COPY_AND_ASSIGN(CpuDevice);
   ~CpuDevice();
   MemType GetMemType() const override;
   std::string Name() const override;
+  // Whether the device has spare threads to help executing a partitioned op
+  bool IsIdle() const;
+  // Run a partition of an op owned by another CPU device
+  void PushPartition(const std::function<void()>&);
+  // Buffers of CPU devices start at multiples of this many bytes
+  static size_t constexpr kAlignment = 64;
+  int numa_node() const { return numa_node_; }
 
  private:
-  static size_t constexpr kDefaultThreadNum = 4;
+  bool CanReadDirectly(const Device&) const override;
   void DoCopyRemoteData(float*, float*, size_t, int) override;
   void DoExecute(const DataList&, const DataList&, PhysicalOp&, int) override;
+  void DoExecutePartitioned(const DataList&, const DataList&, PhysicalOp&, const std::vector<bool>&, const std::vector<CpuDevice*>&);
+  // Partitions never block, so they get their own lane to avoid waiting on
+  // tasks that are themselves waiting for partitions. Created on the first
+  // partition pushed.
+  std::unique_ptr<ThreadPool> partition_pool_;
+  std::once_flag partition_pool_created_;
+  size_t const num_threads_;
+  std::function<void()> const pin_;
+  int const numa_node_;
 };
 
 }  // namespace minerva
@@ -1,6 +1,7 @@
 #include "device_manager.h"
 #include <dmlc/logging.h>
 #include "device/device.h"
+#include "device/numa.h"
 #include "common/cuda_utils.h"
 #include "common/common.h"
 #ifdef HAS_CUDA
@@ -23,17 +24,29 @@ DeviceManager::~DeviceManager() {
   }
 }
 
-uint64_t DeviceManager::CreateCpuDevice() {
+uint64_t DeviceManager::CreateCpuDevice(const CpuDeviceOptions& options) {
   auto id = GenerateDeviceId();
-  Device* d = new CpuDevice(id, listener_);
+  Device* d = new CpuDevice(id, listener_, &directory_, options);
   CHECK(device_storage_.emplace(id, d).second);
   return id;
 }
 
+vector<uint64_t> DeviceManager::CreateCpuDevicesPerNumaNode() {
+  vector<uint64_t> ids;
+  for (auto& node : GetNumaNodes()) {
+    CpuDeviceOptions options;
+    options.num_threads = node.cpus.size();
+    options.cpus = node.cpus;
+    options.numa_node = node.id;
+    ids.push_back(CreateCpuDevice(options));
+  }
+  return ids;
+}
+
 uint64_t DeviceManager::CreateGpuDevice(int gid) {
 #ifdef HAS_CUDA
   auto id = GenerateDeviceId();
-  Device* d = new GpuDevice(id, listener_, gid);
+  Device* d = new GpuDevice(id, listener_, &directory_, gid);
   CHECK(device_storage_.emplace(id, d).second);
   return id;
 #else
@@ -55,9 +68,17 @@ Device* DeviceManager::GetDevice(uint64_t id) {
   return device_storage_.at(id);
 }
 
-void DeviceManager::FreeData(uint64_t id) {
+vector<Device*> DeviceManager::GetDevices() {
+  vector<Device*> ret;
   for (auto i : device_storage_) {
-    i.second->FreeDataIfExist(id);
+    ret.push_back(i.second);
+  }
+  return ret;
+}
+
+void DeviceManager::FreeData(uint64_t id) {
+  for (auto device_id : directory_.Erase(id)) {
+    device_storage_.at(device_id)->FreeDataIfExist(id);
   }
 }
 
@@ -1,7 +1,9 @@
 #pragma once
 #include <unordered_map>
+#include <vector>
 #include "device/device.h"
 #include "device/device_listener.h"
+#include "device/data_directory.h"
 #include "common/common.h"
 
 namespace minerva {
@@ -10,16 +12,22 @@ class DeviceManager {
  public:
   DeviceManager();
   ~DeviceManager();
-  uint64_t CreateCpuDevice();
+  uint64_t CreateCpuDevice(const CpuDeviceOptions& = CpuDeviceOptions());
+  // One device per NUMA node, using all CPUs and the memory of that node
+  std::vector<uint64_t> CreateCpuDevicesPerNumaNode();
   uint64_t CreateGpuDevice(int gid);
   int GetGpuDeviceCount();
   Device* GetDevice(uint64_t id);
+  std::vector<Device*> GetDevices();
+  // Frees the data on every device holding a copy
   void FreeData(uint64_t id);
+  const DataDirectory& directory() const { return directory_; }
   void RegisterListener(DeviceListener* l) { listener_ = l; }
 
  private:
   uint64_t GenerateDeviceId();
   DeviceListener* listener_;
+  DataDirectory directory_;
   std::unordered_map<uint64_t, Device*> device_storage_;
   DISALLOW_COPY_AND_ASSIGN(DeviceManager);
 };
@@ -0,0 +1,82 @@
+#include "device/huge_page_allocator.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <dmlc/logging.h>
+#include "device/numa.h"
+
+using namespace std;
+
+namespace minerva {
+
+size_t constexpr HugePageAllocator::kHugePageSize;
+
+HugePageAllocator::HugePageAllocator(bool use_huge_pages, bool prefault, int numa_node) : use_huge_pages_(use_huge_pages), prefault_(prefault), numa_node_(numa_node), try_hugetlb_(use_huge_pages) {
+}
+
+HugePageAllocator::~HugePageAllocator() {
+  for (auto& i : mappings_) {
+    munmap(i.first, i.second);
+  }
+}
+
+void* HugePageAllocator::Allocate(size_t len) {
+  len = (len + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* ret = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (try_hugetlb_) {
+    ret = mmap(nullptr, len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (ret == MAP_FAILED) {
+      DLOG(INFO) << "no explicit huge pages available, falling back to transparent huge pages";
+      try_hugetlb_ = false;
+    }
+  }
+#endif
+  if (ret == MAP_FAILED) {
+    // Over-map so that the mapping can be trimmed to a 2MB boundary
+    auto mapped = mmap(nullptr, len + kHugePageSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapped == MAP_FAILED) {
+      return nullptr;
+    }
+    auto begin = reinterpret_cast<uintptr_t>(mapped);
+    auto aligned = (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    if (begin < aligned) {
+      munmap(mapped, aligned - begin);
+    }
+    if (aligned + len < begin + len + kHugePageSize) {
+      munmap(reinterpret_cast<void*>(aligned + len), begin + kHugePageSize - aligned);
+    }
+    ret = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    if (use_huge_pages_) {
+      madvise(ret, len, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  if (0 <= numa_node_) {
+    BindToNumaNode(ret, len, numa_node_);
+  }
+  if (prefault_) {
+    memset(ret, 0, len);
+  }
+  lock_guard<mutex> l(mutex_);
+  mappings_[ret] = len;
+  return ret;
+}
+
+void HugePageAllocator::Free(void* ptr) {
+  size_t len;
+  {
+    lock_guard<mutex> l(mutex_);
+    auto it = mappings_.find(ptr);
+    CHECK(it != mappings_.end()) << "unknown mapping";
+    len = it->second;
+    mappings_.erase(it);
+  }
+  CHECK_EQ(munmap(ptr, len), 0);
+}
+
+}  // namespace minerva
+
@@ -0,0 +1,36 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include "common/common.h"
+
+namespace minerva {
+
+// Maps host memory in multiples of 2MB, aligned to 2MB. Explicit huge pages
+// are used when the system has some reserved, otherwise transparent huge pages
+// are requested for the mapping.
+class HugePageAllocator {
+ public:
+  static size_t constexpr kHugePageSize = 2 << 20;
+  // `prefault` touches every page of a new mapping before returning it.
+  // Mappings are placed on `numa_node` unless it is negative.
+  HugePageAllocator(bool use_huge_pages, bool prefault, int numa_node = -1);
+  DISALLOW_COPY_AND_ASSIGN(HugePageAllocator);
+  ~HugePageAllocator();
+  // Returns `nullptr` on failure
+  void* Allocate(size_t);
+  void Free(void*);
+
+ private:
+  bool use_huge_pages_;
+  bool prefault_;
+  int numa_node_;
+  // Whether explicit huge pages are worth trying
+  std::atomic<bool> try_hugetlb_;
+  std::mutex mutex_;
+  std::unordered_map<void*, size_t> mappings_;
+};
+
+}  // namespace minerva
+
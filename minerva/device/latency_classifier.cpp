@@ -0,0 +1,92 @@
+#include "device/latency_classifier.h"
+#include <typeindex>
+#include <typeinfo>
+#include <gflags/gflags.h>
+#include "op/compute_fn.h"
+
+DEFINE_double(latency_lane_threshold, 0, "Ops expected to finish within this many microseconds may run on the latency lane (0 to only run tagged ops there)");
+DEFINE_int32(latency_lane_max_elements, 1024, "Ops never timed before are small if they read and write at most this many elements");
+
+using namespace std;
+
+namespace minerva {
+
+bool LatencyClassifier::Enabled() {
+  return 0 < FLAGS_latency_lane_threshold;
+}
+
+bool LatencyClassifier::IsSmall(const Task& task) {
+  if (!Enabled()) {
+    return false;
+  }
+  auto key = Key(task);
+  {
+    lock_guard<mutex> lck(m_);
+    auto it = average_time_.find(key);
+    if (it != average_time_.end()) {
+      return it->second.average <= FLAGS_latency_lane_threshold;
+    }
+  }
+  // Stop as soon as the limit is passed so large shapes cannot overflow the sum
+  int64_t num_elements = 0;
+  for (auto list : {&task.inputs, &task.outputs}) {
+    for (auto& i : *list) {
+      num_elements += i.physical_data.size.Prod();
+      if (FLAGS_latency_lane_max_elements < num_elements) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool LatencyClassifier::UseLatencyLane(const Task& task, int main_unfinished, int main_threads, int lane_unfinished, int lane_threads) {
+  if (task.op.latency_critical) {
+    return true;
+  }
+  return main_unfinished >= main_threads && lane_unfinished < lane_threads && IsSmall(task);
+}
+
+void LatencyClassifier::RecordTime(const Task& task, double microseconds) {
+  static double constexpr kDecay = 0.8;
+  auto key = Key(task);
+  lock_guard<mutex> lck(m_);
+  auto it = average_time_.find(key);
+  if (it != average_time_.end()) {
+    it->second.average = kDecay * it->second.average + (1 - kDecay) * microseconds;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+    return;
+  }
+  if (capacity_ <= average_time_.size()) {
+    average_time_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(key);
+  average_time_.emplace(key, Timing{microseconds, lru_.begin()});
+}
+
+size_t LatencyClassifier::NumTimed() {
+  lock_guard<mutex> lck(m_);
+  return average_time_.size();
+}
+
+uint64_t LatencyClassifier::Key(const Task& task) {
+  // Op names may contain closure values, so the type is used instead
+  auto& fn = *task.op.compute_fn;
+  uint64_t key = type_index(typeid(fn)).hash_code();
+  auto combine = [&key](uint64_t v) {
+    key ^= v + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+  };
+  combine(task.inputs.size());
+  for (auto list : {&task.inputs, &task.outputs}) {
+    for (auto& i : *list) {
+      combine(i.physical_data.size.NumDims());
+      for (auto d : i.physical_data.size) {
+        combine(d);
+      }
+    }
+  }
+  return key;
+}
+
+}  // namespace minerva
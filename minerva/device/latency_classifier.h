@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include "device/task.h"
+#include "common/common.h"
+
+namespace minerva {
+
+// Decides whether a task belongs to the latency lane of a device. Tasks
+// tagged latency critical always do. Other tasks are classified only when
+// --latency_lane_threshold is set, based on the historical execution time of
+// the same op on the same input and output sizes, falling back to their
+// sizes for ops never seen before. Only the most recently timed `capacity`
+// op and size combinations are remembered.
+class LatencyClassifier {
+ public:
+  explicit LatencyClassifier(size_t capacity = 4096) : capacity_(capacity) {}
+  DISALLOW_COPY_AND_ASSIGN(LatencyClassifier);
+  ~LatencyClassifier() = default;
+  // Whether tasks are classified, and so have to be timed
+  static bool Enabled();
+  bool IsSmall(const Task&);
+  // Small tasks only take an idle lane thread, and only when all threads of
+  // the main pool are busy, so that the lane never serializes them
+  bool UseLatencyLane(const Task&, int main_unfinished, int main_threads, int lane_unfinished, int lane_threads);
+  void RecordTime(const Task&, double microseconds);
+  size_t NumTimed();
+
+ private:
+  struct Timing {
+    // Exponential moving average of execution time in microseconds
+    double average;
+    // Position in `lru_`
+    std::list<uint64_t>::iterator lru_it;
+  };
+  // Hash of the op type and the input and output sizes. A collision only
+  // mixes up the timings of two op and size combinations.
+  static uint64_t Key(const Task&);
+  size_t capacity_;
+  std::mutex m_;
+  // Keys of `average_time_`, most recently timed first
+  std::list<uint64_t> lru_;
+  std::unordered_map<uint64_t, Timing> average_time_;
+};
+
+}  // namespace minerva
@@ -0,0 +1,94 @@
+#include "device/numa.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <dmlc/logging.h>
+
+using namespace std;
+
+namespace minerva {
+
+vector<NumaNode> GetNumaNodes() {
+  vector<NumaNode> nodes;
+  if (auto dir = opendir("/sys/devices/system/node")) {
+    while (auto entry = readdir(dir)) {
+      int id;
+      char rest;
+      if (sscanf(entry->d_name, "node%d%c", &id, &rest) != 1) {
+        continue;
+      }
+      ifstream f(string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+      string cpulist;
+      if (getline(f, cpulist)) {
+        auto cpus = ParseCpuList(cpulist);
+        if (!cpus.empty()) {
+          nodes.push_back(NumaNode{id, cpus});
+        }
+      }
+    }
+    closedir(dir);
+  }
+  if (nodes.empty()) {
+    NumaNode node{0, {}};
+    for (unsigned i = 0; i < max(thread::hardware_concurrency(), 1u); ++i) {
+      node.cpus.push_back(i);
+    }
+    nodes.push_back(node);
+  }
+  sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) {
+    return a.id < b.id;
+  });
+  return nodes;
+}
+
+vector<int> ParseCpuList(const string& list) {
+  vector<int> cpus;
+  istringstream ss(list);
+  string range;
+  while (getline(ss, range, ',')) {
+    int first, last;
+    int n = sscanf(range.c_str(), "%d-%d", &first, &last);
+    if (n == 1) {
+      cpus.push_back(first);
+    } else if (n == 2) {
+      for (int i = first; i <= last; ++i) {
+        cpus.push_back(i);
+      }
+    }
+  }
+  return cpus;
+}
+
+bool SetThreadAffinity(thread::native_handle_type handle, const vector<int>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto i : cpus) {
+    CPU_SET(i, &set);
+  }
+  int err = pthread_setaffinity_np(handle, sizeof(set), &set);
+  if (err) {
+    LOG(WARNING) << "failed to set thread affinity: " << err;
+  }
+  return !err;
+}
+
+bool BindToNumaNode(void* ptr, size_t len, int node) {
+  unsigned long mask[16] = {0};
+  size_t bits = sizeof(unsigned long) * 8;
+  CHECK_LT(static_cast<size_t>(node), sizeof(mask) * 8) << "node id out of range";
+  mask[node / bits] |= 1ul << (node % bits);
+  if (syscall(SYS_mbind, ptr, len, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0)) {
+    DLOG(INFO) << "failed to bind memory to node #" << node;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace minerva
+
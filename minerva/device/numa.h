@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace minerva {
+
+struct NumaNode {
+  int id;
+  std::vector<int> cpus;
+};
+
+// Nodes with at least one online CPU. Falls back to a single node holding all
+// CPUs when the topology is not exposed.
+std::vector<NumaNode> GetNumaNodes();
+// Parses a CPU list such as "0-3,8,10-11"
+std::vector<int> ParseCpuList(const std::string&);
+// Pins the thread to the given CPUs
+bool SetThreadAffinity(std::thread::native_handle_type, const std::vector<int>&);
+// Places the pages of the range on the node, falling back to other nodes when
+// it runs out of memory. Must be called before the pages are touched.
+bool BindToNumaNode(void*, size_t, int node);
+
+}  // namespace minerva
+
@@ -1,67 +1,262 @@
 #include "device/pooled_data_store.h"
+#include <algorithm>
+#include <iterator>
 
 using namespace std;
 
 namespace minerva {
 
+size_t constexpr PooledDataStore::kMinBlockSize;
+size_t constexpr PooledDataStore::kArenaSize;
+size_t constexpr PooledDataStore::kMaxCachedBlock;
+size_t constexpr PooledDataStore::kNumCachedClasses;
+size_t constexpr PooledDataStore::kSlotsPerClass;
+
+double PoolStats::ExternalFragmentation() const {
+  size_t free_bytes = reserved_bytes - block_bytes;
+  return free_bytes ? 1 - static_cast<double>(largest_free_block) / free_bytes : 0;
+}
+
+double PoolStats::InternalFragmentation() const {
+  return block_bytes ? 1 - static_cast<double>(allocated_bytes) / block_bytes : 0;
+}
+
 PooledDataStore::PooledDataStore(size_t threshold, function<void*(size_t)> a, function<void(void*)> d) : DataStore(a, d), threshold_(threshold) {
+  for (auto& slots : cache_) {
+    for (auto& slot : slots) {
+      slot = nullptr;
+    }
+  }
 }
 
 PooledDataStore::~PooledDataStore() {
-  for (auto& i : free_space_) {
-    while (i.second.size()) {
-      deallocator_(i.second.front());
-      i.second.pop();
-    }
+  for (auto& i : arenas_) {
+    deallocator_(i.first);
   }
+  // Buffers live inside the arenas
+  data_states_.Clear();
 }
 
 float* PooledDataStore::CreateData(uint64_t id, size_t length) {
-  lock_guard<mutex> lck(access_mutex_);
   DLOG(INFO) << "create data #" << id << " length " << length;
-  auto it = data_states_.emplace(id, DataState());
-  CHECK(it.second) << "data already existed";
-  auto& ds = it.first->second;
-  ds.length = length;
-  auto find_free_space_ = free_space_.find(length);
-  if (find_free_space_ != free_space_.end()) {
-    // Reuse
-    ds.ptr = find_free_space_->second.front();
-    find_free_space_->second.pop();
-    if (!find_free_space_->second.size()) {
-      free_space_.erase(find_free_space_);
-    }
-  } else {
-    ds.ptr = allocator_(length);
-    total_ += length;
-    if (threshold_ < total_) {
-      ReleaseFreeSpace();
-    }
+  auto size = SizeClass(length);
+  char* ptr = TakeCached(size);
+  if (!ptr) {
+    lock_guard<mutex> lck(access_mutex_);
+    ptr = Allocate(size);
   }
-  return static_cast<float*>(ds.ptr);
+  allocated_ += length;
+  CHECK(data_states_.Insert(id, DataState{ptr, length})) << "data already existed";
+  RecordCreate(length);
+  return reinterpret_cast<float*>(ptr);
 }
 
 void PooledDataStore::FreeData(uint64_t id) {
+  DataState ds{nullptr, 0};
+  CHECK_EQ(data_states_.Erase(id, &ds), 1);
+  allocated_ -= ds.length;
+  RecordFree(ds.length);
+  if (!PutCached(SizeClass(ds.length), static_cast<char*>(ds.ptr))) {
+    lock_guard<mutex> lck(access_mutex_);
+    Deallocate(static_cast<char*>(ds.ptr));
+  }
+}
+
+MemoryStats PooledDataStore::GetStats() const {
+  auto stats = DataStore::GetStats();
+  PoolStats pool;
+  {
+    lock_guard<mutex> lck(access_mutex_);
+    pool = CollectPoolStats();
+  }
+  stats.pooled_bytes = pool.reserved_bytes - pool.allocated_bytes;
+  stats.fragmentation = pool.ExternalFragmentation();
+  return stats;
+}
+
+PoolStats PooledDataStore::GetPoolStats() {
   lock_guard<mutex> lck(access_mutex_);
-  auto& ds = data_states_.at(id);
-  free_space_[ds.length].push(ds.ptr);
-  CHECK_EQ(data_states_.erase(id), 1);
+  FlushCache();
+  return CollectPoolStats();
+}
+
+PoolStats PooledDataStore::CollectPoolStats() const {
+  PoolStats stats;
+  stats.reserved_bytes = reserved_;
+  stats.allocated_bytes = allocated_;
+  stats.block_bytes = block_bytes_;
+  stats.largest_free_block = free_blocks_.empty() ? 0 : free_blocks_.rbegin()->first;
+  stats.num_arenas = arenas_.size();
+  stats.num_idle_arenas = idle_arenas_.size();
+  stats.num_trimmed_arenas = num_trimmed_arenas_;
+  return stats;
 }
 
-size_t PooledDataStore::GetTotalBytes() const {
+void PooledDataStore::Reserve(size_t bytes) {
   lock_guard<mutex> lck(access_mutex_);
-  return total_;
+  bytes = min(bytes, threshold_);
+  while (reserved_ < bytes) {
+    NewArena(kArenaSize);
+  }
+}
+
+size_t PooledDataStore::SizeClass(size_t length) {
+  if (length <= kMinBlockSize) {
+    return kMinBlockSize;
+  }
+  size_t power = kMinBlockSize;
+  while (power * 2 < length) {
+    power *= 2;
+  }
+  // Keep every class a multiple of the minimum block size to preserve alignment
+  size_t step = max(power / 4, kMinBlockSize);
+  return (length + step - 1) / step * step;
 }
 
-void PooledDataStore::ReleaseFreeSpace() {
-  for (auto& i : free_space_) {
-    while (i.second.size()) {
-      deallocator_(i.second.front());
-      i.second.pop();
-      total_ -= i.first;
+size_t PooledDataStore::CacheIndex(size_t size) {
+  if (kMaxCachedBlock < size) {
+    return kNumCachedClasses;
+  }
+  size_t index = 0;
+  size_t power = kMinBlockSize;
+  while (power * 2 < size) {
+    power *= 2;
+    index += 4;
+  }
+  return index + (size - power) / max(power / 4, kMinBlockSize);
+}
+
+char* PooledDataStore::TakeCached(size_t size) {
+  auto index = CacheIndex(size);
+  if (index == kNumCachedClasses) {
+    return nullptr;
+  }
+  for (auto& slot : cache_[index]) {
+    char* ptr = slot.load(memory_order_relaxed);
+    if (ptr && (ptr = slot.exchange(nullptr, memory_order_acquire))) {
+      return ptr;
     }
   }
-  free_space_.clear();
+  return nullptr;
+}
+
+bool PooledDataStore::PutCached(size_t size, char* ptr) {
+  auto index = CacheIndex(size);
+  if (index == kNumCachedClasses) {
+    return false;
+  }
+  for (auto& slot : cache_[index]) {
+    char* empty = nullptr;
+    if (slot.compare_exchange_strong(empty, ptr, memory_order_release, memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PooledDataStore::FlushCache() {
+  for (auto& slots : cache_) {
+    for (auto& slot : slots) {
+      if (auto ptr = slot.exchange(nullptr, memory_order_acquire)) {
+        Deallocate(ptr);
+      }
+    }
+  }
+}
+
+char* PooledDataStore::Allocate(size_t size) {
+  auto it = free_blocks_.lower_bound(make_pair(size, static_cast<char*>(nullptr)));
+  if (it == free_blocks_.end()) {
+    // Coalesce the blocks in the slots before reserving more
+    FlushCache();
+    it = free_blocks_.lower_bound(make_pair(size, static_cast<char*>(nullptr)));
+  }
+  if (it == free_blocks_.end()) {
+    NewArena(max(size, kArenaSize));
+    it = free_blocks_.lower_bound(make_pair(size, static_cast<char*>(nullptr)));
+  }
+  char* ptr = it->second;
+  free_blocks_.erase(it);
+  auto& block = blocks_.at(ptr);
+  if (kMinBlockSize <= block.size - size) {
+    // Split off the remainder
+    blocks_.emplace(ptr + size, Block{block.arena, block.size - size, true});
+    free_blocks_.emplace(block.size - size, ptr + size);
+    block.size = size;
+  }
+  block.free = false;
+  auto& arena = arenas_.at(block.arena);
+  if (arena.used == 0) {
+    idle_arenas_.erase(arena.idle_it);
+  }
+  arena.used += block.size;
+  block_bytes_ += block.size;
+  return ptr;
+}
+
+void PooledDataStore::Deallocate(char* ptr) {
+  auto it = blocks_.find(ptr);
+  CHECK(it != blocks_.end() && !it->second.free) << "invalid block";
+  auto arena_ptr = it->second.arena;
+  auto& arena = arenas_.at(arena_ptr);
+  arena.used -= it->second.size;
+  block_bytes_ -= it->second.size;
+  it->second.free = true;
+  // Coalesce with free neighbors in the same arena
+  auto next = std::next(it);
+  if (next != blocks_.end() && next->second.arena == arena_ptr && next->second.free) {
+    free_blocks_.erase(make_pair(next->second.size, next->first));
+    it->second.size += next->second.size;
+    blocks_.erase(next);
+  }
+  if (it != blocks_.begin()) {
+    auto prev = std::prev(it);
+    if (prev->second.arena == arena_ptr && prev->second.free) {
+      free_blocks_.erase(make_pair(prev->second.size, prev->first));
+      prev->second.size += it->second.size;
+      blocks_.erase(it);
+      it = prev;
+    }
+  }
+  free_blocks_.emplace(it->second.size, it->first);
+  if (arena.used == 0) {
+    idle_arenas_.push_front(arena_ptr);
+    arena.idle_it = idle_arenas_.begin();
+  }
+}
+
+void PooledDataStore::NewArena(size_t size) {
+  if (threshold_ < reserved_ + size) {
+    Trim(threshold_ < size ? 0 : threshold_ - size);
+  }
+  auto ptr = static_cast<char*>(allocator_(size));
+  if (!ptr) {
+    // Give back everything that is cached and retry
+    Trim(0);
+    ptr = static_cast<char*>(allocator_(size));
+  }
+  CHECK(ptr) << "failed to allocate " << size << " bytes";
+  DLOG(INFO) << "new arena of " << size << " bytes";
+  idle_arenas_.push_front(ptr);
+  arenas_.emplace(ptr, Arena{size, 0, idle_arenas_.begin()});
+  blocks_.emplace(ptr, Block{ptr, size, true});
+  free_blocks_.emplace(size, ptr);
+  reserved_ += size;
+}
+
+void PooledDataStore::Trim(size_t target) {
+  while (target < reserved_ && !idle_arenas_.empty()) {
+    auto ptr = idle_arenas_.back();
+    idle_arenas_.pop_back();
+    auto size = arenas_.at(ptr).size;
+    // An idle arena is a single free block
+    free_blocks_.erase(make_pair(size, ptr));
+    blocks_.erase(ptr);
+    arenas_.erase(ptr);
+    deallocator_(ptr);
+    reserved_ -= size;
+    ++num_trimmed_arenas_;
+  }
 }
 
 }  // namespace minerva
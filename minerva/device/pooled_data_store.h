@@ -1,9 +1,39 @@
 #pragma once
-#include <queue>
+#include <array>
+#include <atomic>
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
 #include "device/data_store.h"
 
 namespace minerva {
 
+struct PoolStats {
+  // Obtained from the underlying allocator
+  size_t reserved_bytes = 0;
+  // Requested by live buffers
+  size_t allocated_bytes = 0;
+  // Held by live buffers after rounding up to size classes
+  size_t block_bytes = 0;
+  size_t largest_free_block = 0;
+  size_t num_arenas = 0;
+  size_t num_idle_arenas = 0;
+  uint64_t num_trimmed_arenas = 0;
+  // Share of the free bytes outside of the largest free block
+  double ExternalFragmentation() const;
+  // Share of the block bytes lost to rounding
+  double InternalFragmentation() const;
+};
+
+// Carves buffers out of large arenas obtained from the underlying allocator.
+// Requests are rounded up to size classes, four per power of two, and served
+// from the smallest free block that fits, splitting off the remainder. Freed
+// blocks are coalesced with their free neighbors. Once the reserved memory
+// exceeds the threshold, arenas without live buffers are returned to the
+// allocator, least recently used first. Freed blocks of up to
+// `kMaxCachedBlock` bytes are kept in per size class slots first, and reused
+// from there without taking the lock.
 class PooledDataStore final : public DataStore {
  public:
   PooledDataStore(size_t threshold, std::function<void*(size_t)> a, std::function<void(void*)> d);
@@ -11,13 +41,57 @@ class PooledDataStore final : public DataStore {
   virtual ~PooledDataStore();
   float* CreateData(uint64_t, size_t) override;
   void FreeData(uint64_t) override;
-  size_t GetTotalBytes() const override;
+  // Blocks in the slots count as in use
+  MemoryStats GetStats() const override;
+  // Returns the blocks in the slots to the pool first
+  PoolStats GetPoolStats();
+  // Reserves idle arenas up front
+  void Reserve(size_t);
+  static size_t SizeClass(size_t);
+  static size_t constexpr kMinBlockSize = 256;
+  static size_t constexpr kArenaSize = 2 << 20;
+  static size_t constexpr kMaxCachedBlock = 256 << 10;
 
  private:
+  struct Arena {
+    size_t size;
+    size_t used;
+    // Position in `idle_arenas_` when no block is in use
+    std::list<char*>::iterator idle_it;
+  };
+  struct Block {
+    char* arena;
+    size_t size;
+    bool free;
+  };
+  // Index of the slots of a size class
+  static size_t CacheIndex(size_t);
+  // The following take a block from or put it to the slots of its size class
+  char* TakeCached(size_t);
+  bool PutCached(size_t, char*);
+  // The following are called with the lock held
+  void FlushCache();
+  PoolStats CollectPoolStats() const;
+  char* Allocate(size_t);
+  void Deallocate(char*);
+  void NewArena(size_t);
+  void Trim(size_t);
   size_t threshold_;
-  size_t total_ = 0;
-  std::unordered_map<size_t, std::queue<void*>> free_space_;
-  void ReleaseFreeSpace();
+  size_t reserved_ = 0;
+  std::atomic<size_t> allocated_{0};
+  size_t block_bytes_ = 0;
+  uint64_t num_trimmed_arenas_ = 0;
+  std::unordered_map<char*, Arena> arenas_;
+  // Arenas without blocks in use, most recently used first
+  std::list<char*> idle_arenas_;
+  // All blocks, ordered by address so that neighbors can be coalesced
+  std::map<char*, Block> blocks_;
+  // Free blocks, ordered by size for best fit
+  std::set<std::pair<size_t, char*>> free_blocks_;
+  // Size classes up to `kMaxCachedBlock`
+  static size_t constexpr kNumCachedClasses = 41;
+  static size_t constexpr kSlotsPerClass = 8;
+  std::array<std::array<std::atomic<char*>, kSlotsPerClass>, kNumCachedClasses> cache_;
 };
 
 }  // namespace minerva
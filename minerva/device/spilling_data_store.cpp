@@ -0,0 +1,316 @@
+#include "device/spilling_data_store.h"
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace minerva {
+
+SpillingDataStore::SpillingDataStore(size_t budget, const string& scratch_dir, function<void*(size_t)> a, function<void(void*)> d) : DataStore(a, d), budget_(budget), page_size_(sysconf(_SC_PAGESIZE)) {
+  string path = scratch_dir + "/minerva_spill_XXXXXX";
+  vector<char> path_buf(path.begin(), path.end());
+  path_buf.push_back('\0');
+  fd_ = mkstemp(path_buf.data());
+  CHECK_NE(fd_, -1) << "cannot create scratch file in " << scratch_dir << ": " << strerror(errno);
+  // The file goes away with the descriptor
+  CHECK_EQ(unlink(path_buf.data()), 0);
+}
+
+SpillingDataStore::~SpillingDataStore() {
+  fresh_states_.ForEach([this](uint64_t, const FreshState& fs) {
+    deallocator_(fs.ptr);
+  });
+  for (auto& i : spill_states_) {
+    if (!i.second.spilled) {
+      deallocator_(i.second.ptr);
+    }
+  }
+  close(fd_);
+}
+
+float* SpillingDataStore::CreateData(uint64_t id, size_t length) {
+  DLOG(INFO) << "create data #" << id << " length " << length;
+  if (!ReserveResident(length)) {
+    unique_lock<mutex> lck(access_mutex_);
+    MakeRoom(length, lck);
+    resident_bytes_ += length;
+  }
+  FreshState fs;
+  fs.ptr = allocator_(length);
+  fs.length = length;
+  fs.pins = 1;
+  CHECK(fresh_states_.Insert(id, fs)) << "data already existed";
+  RecordCreate(length);
+  return static_cast<float*>(fs.ptr);
+}
+
+float* SpillingDataStore::GetData(uint64_t id) {
+  FreshState fs;
+  if (fresh_states_.Get(id, &fs)) {
+    return static_cast<float*>(fs.ptr);
+  }
+  unique_lock<mutex> lck(access_mutex_);
+  auto& ss = MakeResident(id, lck);
+  if (!ss.pins) {
+    lru_.splice(lru_.begin(), lru_, ss.lru_it);
+  }
+  return static_cast<float*>(ss.ptr);
+}
+
+bool SpillingDataStore::ExistData(uint64_t id) const {
+  if (fresh_states_.Count(id)) {
+    return true;
+  }
+  lock_guard<mutex> lck(access_mutex_);
+  return spill_states_.count(id);
+}
+
+void SpillingDataStore::FreeData(uint64_t id) {
+  FreshState fs;
+  if (fresh_states_.Erase(id, &fs)) {
+    deallocator_(fs.ptr);
+    resident_bytes_ -= fs.length;
+    RecordFree(fs.length);
+    return;
+  }
+  unique_lock<mutex> lck(access_mutex_);
+  auto& ss = WaitForTransit(id, lck);
+  if (ss.spilled) {
+    FreeExtent(ss.offset, ExtentLength(ss.length));
+    spilled_bytes_ -= ss.length;
+  } else {
+    if (!ss.pins) {
+      lru_.erase(ss.lru_it);
+    }
+    deallocator_(ss.ptr);
+    resident_bytes_ -= ss.length;
+  }
+  RecordFree(ss.length);
+  spill_states_.erase(id);
+}
+
+size_t SpillingDataStore::GetTotalBytes() const {
+  return resident_bytes_;
+}
+
+float* SpillingDataStore::PinData(uint64_t id) {
+  void* ptr = nullptr;
+  fresh_states_.Update(id, [&ptr](FreshState& fs) {
+    if (!fs.ptr) {
+      return false;
+    }
+    ++fs.pins;
+    ptr = fs.ptr;
+    return true;
+  });
+  if (ptr) {
+    return static_cast<float*>(ptr);
+  }
+  unique_lock<mutex> lck(access_mutex_);
+  auto& ss = MakeResident(id, lck);
+  if (!ss.pins++) {
+    lru_.erase(ss.lru_it);
+  }
+  return static_cast<float*>(ss.ptr);
+}
+
+void SpillingDataStore::UnpinData(uint64_t id) {
+  FreshState fs;
+  if (fresh_states_.Get(id, &fs) && 1 < fs.pins) {
+    bool unpinned = false;
+    fresh_states_.Update(id, [&unpinned](FreshState& f) {
+      if (1 < f.pins) {
+        --f.pins;
+        unpinned = true;
+      }
+      return f.ptr != nullptr;
+    });
+    if (unpinned) {
+      return;
+    }
+  }
+  unique_lock<mutex> lck(access_mutex_);
+  // The last unpin of a new buffer hands it over to the LRU
+  bool fresh = false;
+  fs = FreshState();
+  fresh_states_.Update(id, [&fresh, &fs](FreshState& f) {
+    if (!f.ptr) {
+      return false;
+    }
+    fresh = true;
+    if (1 < f.pins) {
+      --f.pins;
+      return true;
+    }
+    fs = f;
+    return false;
+  });
+  if (fresh) {
+    if (fs.ptr) {
+      auto& ss = spill_states_[id];
+      ss.ptr = fs.ptr;
+      ss.length = fs.length;
+      ss.pins = 0;
+      ss.spilled = false;
+      ss.in_transit = false;
+      lru_.push_front(id);
+      ss.lru_it = lru_.begin();
+      MakeRoom(0, lck);
+    }
+    return;
+  }
+  auto it = spill_states_.find(id);
+  if (it == spill_states_.end()) {
+    // Freed while pinned
+    return;
+  }
+  auto& ss = it->second;
+  CHECK_GT(ss.pins, 0) << "data #" << id << " is not pinned";
+  if (!--ss.pins) {
+    lru_.push_front(id);
+    ss.lru_it = lru_.begin();
+    // Catch up on spilling that was blocked by pinned buffers
+    MakeRoom(0, lck);
+  }
+}
+
+MemoryStats SpillingDataStore::GetStats() const {
+  auto stats = DataStore::GetStats();
+  stats.spilled_bytes = GetSpilledBytes();
+  return stats;
+}
+
+size_t SpillingDataStore::GetSpilledBytes() const {
+  lock_guard<mutex> lck(access_mutex_);
+  return spilled_bytes_;
+}
+
+bool SpillingDataStore::ReserveResident(size_t length) {
+  auto resident = resident_bytes_.load();
+  while (resident + length <= budget_) {
+    if (resident_bytes_.compare_exchange_weak(resident, resident + length)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SpillingDataStore::MakeRoom(size_t length, unique_lock<mutex>& lck) {
+  while (budget_ < resident_bytes_ + length && !lru_.empty()) {
+    Spill(lru_.back(), lck);
+  }
+}
+
+void SpillingDataStore::Spill(uint64_t id, unique_lock<mutex>& lck) {
+  auto& ss = spill_states_.at(id);
+  lru_.erase(ss.lru_it);
+  // Counted as spilled right away so that concurrent callers make room elsewhere
+  ss.spilled = true;
+  ss.in_transit = true;
+  resident_bytes_ -= ss.length;
+  spilled_bytes_ += ss.length;
+  auto extent_length = ExtentLength(ss.length);
+  if (extent_length) {
+    ss.offset = AllocateExtent(extent_length);
+    lck.unlock();
+    void* dst = mmap(nullptr, extent_length, PROT_WRITE, MAP_SHARED, fd_, ss.offset);
+    CHECK_NE(dst, MAP_FAILED) << "cannot map scratch file: " << strerror(errno);
+    memcpy(dst, ss.ptr, ss.length);
+    CHECK_EQ(munmap(dst, extent_length), 0);
+    lck.lock();
+  }
+  DLOG(INFO) << "spill data #" << id << " length " << ss.length;
+  deallocator_(ss.ptr);
+  ss.ptr = nullptr;
+  ss.in_transit = false;
+  transit_cond_.notify_all();
+}
+
+void SpillingDataStore::PageIn(uint64_t id, unique_lock<mutex>& lck) {
+  auto& ss = spill_states_.at(id);
+  ss.in_transit = true;
+  MakeRoom(ss.length, lck);
+  ss.ptr = allocator_(ss.length);
+  resident_bytes_ += ss.length;
+  auto extent_length = ExtentLength(ss.length);
+  if (extent_length) {
+    lck.unlock();
+    void* src = mmap(nullptr, extent_length, PROT_READ, MAP_SHARED, fd_, ss.offset);
+    CHECK_NE(src, MAP_FAILED) << "cannot map scratch file: " << strerror(errno);
+    memcpy(ss.ptr, src, ss.length);
+    CHECK_EQ(munmap(src, extent_length), 0);
+    lck.lock();
+    FreeExtent(ss.offset, extent_length);
+  }
+  DLOG(INFO) << "page in data #" << id << " length " << ss.length;
+  ss.spilled = false;
+  ss.in_transit = false;
+  ss.pins = 0;
+  lru_.push_front(id);
+  ss.lru_it = lru_.begin();
+  spilled_bytes_ -= ss.length;
+  transit_cond_.notify_all();
+}
+
+SpillingDataStore::SpillState& SpillingDataStore::MakeResident(uint64_t id, unique_lock<mutex>& lck) {
+  while (true) {
+    auto& ss = WaitForTransit(id, lck);
+    if (!ss.spilled) {
+      return ss;
+    }
+    PageIn(id, lck);
+  }
+}
+
+SpillingDataStore::SpillState& SpillingDataStore::WaitForTransit(uint64_t id, unique_lock<mutex>& lck) {
+  auto& ss = spill_states_.at(id);
+  transit_cond_.wait(lck, [&ss] {
+    return !ss.in_transit;
+  });
+  return ss;
+}
+
+size_t SpillingDataStore::AllocateExtent(size_t length) {
+  for (auto it = free_extents_.begin(); it != free_extents_.end(); ++it) {
+    if (length <= it->second) {
+      auto offset = it->first;
+      if (length < it->second) {
+        free_extents_.emplace(offset + length, it->second - length);
+      }
+      free_extents_.erase(it);
+      return offset;
+    }
+  }
+  auto offset = file_size_;
+  file_size_ += length;
+  CHECK_EQ(ftruncate(fd_, file_size_), 0) << "cannot grow scratch file: " << strerror(errno);
+  return offset;
+}
+
+void SpillingDataStore::FreeExtent(size_t offset, size_t length) {
+  auto it = free_extents_.emplace(offset, length).first;
+  // Coalesce with the neighbours
+  auto next = std::next(it);
+  if (next != free_extents_.end() && it->first + it->second == next->first) {
+    it->second += next->second;
+    free_extents_.erase(next);
+  }
+  if (it != free_extents_.begin()) {
+    auto prev = std::prev(it);
+    if (prev->first + prev->second == it->first) {
+      prev->second += it->second;
+      free_extents_.erase(it);
+    }
+  }
+}
+
+size_t SpillingDataStore::ExtentLength(size_t length) const {
+  // Extents are mapped separately, so they have to start on page boundaries
+  return (length + page_size_ - 1) / page_size_ * page_size_;
+}
+
+}  // namespace minerva
+
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include "device/data_store.h"
+
+namespace minerva {
+
+// Keeps the resident buffers within a budget by spilling the least recently
+// used unpinned buffers to a scratch file. Spilled buffers are paged back in
+// when they are accessed again. Buffers are copied without holding the lock,
+// and accesses to a buffer wait while it is being copied. New buffers are
+// pinned, so they are only tracked by the lock once first unpinned, and are
+// created and freed without the lock while within budget.
+class SpillingDataStore final : public DataStore {
+ public:
+  SpillingDataStore(size_t budget, const std::string& scratch_dir, std::function<void*(size_t)> a, std::function<void(void*)> d);
+  DISALLOW_COPY_AND_ASSIGN(SpillingDataStore);
+  virtual ~SpillingDataStore();
+  float* CreateData(uint64_t, size_t) override;
+  float* GetData(uint64_t) override;
+  bool ExistData(uint64_t) const override;
+  void FreeData(uint64_t) override;
+  // Bytes of the resident buffers
+  size_t GetTotalBytes() const override;
+  MemoryStats GetStats() const override;
+  float* PinData(uint64_t) override;
+  void UnpinData(uint64_t) override;
+  size_t GetSpilledBytes() const;
+
+ private:
+  // Created and not unpinned since
+  struct FreshState {
+    void* ptr = nullptr;
+    size_t length = 0;
+    int pins = 0;
+  };
+  struct SpillState {
+    // Null when spilled
+    void* ptr;
+    size_t length;
+    int pins;
+    bool spilled;
+    // Offset in the scratch file when spilled
+    size_t offset;
+    // Being spilled or paged in
+    bool in_transit;
+    // Position in `lru_` when resident and unpinned
+    std::list<uint64_t>::iterator lru_it;
+  };
+  // Counts new resident bytes unless they exceed the budget
+  bool ReserveResident(size_t);
+  // The following may release the lock while copying
+  void MakeRoom(size_t, std::unique_lock<std::mutex>&);
+  void Spill(uint64_t, std::unique_lock<std::mutex>&);
+  void PageIn(uint64_t, std::unique_lock<std::mutex>&);
+  // Waits for the buffer to be resident, paging it in if needed
+  SpillState& MakeResident(uint64_t, std::unique_lock<std::mutex>&);
+  SpillState& WaitForTransit(uint64_t, std::unique_lock<std::mutex>&);
+  size_t AllocateExtent(size_t);
+  void FreeExtent(size_t, size_t);
+  size_t ExtentLength(size_t) const;
+  size_t budget_;
+  std::atomic<size_t> resident_bytes_{0};
+  size_t spilled_bytes_ = 0;
+  size_t page_size_;
+  int fd_;
+  size_t file_size_ = 0;
+  // Free ranges of the scratch file, from offset to length
+  std::map<size_t, size_t> free_extents_;
+  // Resident and unpinned buffers, most recently used first
+  std::list<uint64_t> lru_;
+  ShardedMap<uint64_t, FreshState> fresh_states_;
+  std::unordered_map<uint64_t, SpillState> spill_states_;
+  std::condition_variable transit_cond_;
+};
+
+}  // namespace minerva
+
@@ -0,0 +1,259 @@
+#include "io/data_pipeline.h"
+#include <dmlc/logging.h>
+#include "common/cuda_utils.h"
+#ifdef HAS_CUDA
+#include <cuda_runtime.h>
+#endif
+
+using namespace std;
+
+namespace minerva {
+
+// Keeps up to `capacity` released buffers of each field. Page-locked memory is
+// expensive to allocate, so batches reuse the buffers of earlier ones.
+class DataPipeline::BufferPool : public enable_shared_from_this<DataPipeline::BufferPool> {
+ public:
+  BufferPool(const vector<Scale>& field_sizes, size_t capacity) : field_sizes_(field_sizes), free_(field_sizes.size()), capacity_(capacity) {
+#ifdef HAS_CUDA
+    // Pageable memory without GPUs, where page-locking is not available
+    int num_gpus = 0;
+    page_locked_ = cudaGetDeviceCount(&num_gpus) == cudaSuccess && num_gpus > 0;
+    cudaGetLastError();
+#endif
+  }
+  DISALLOW_COPY_AND_ASSIGN(BufferPool);
+  ~BufferPool() {
+    for (auto& buffers : free_) {
+      for (auto p : buffers) {
+        Delete(p);
+      }
+    }
+  }
+  shared_ptr<float> Allocate(size_t field) {
+    float* ptr = nullptr;
+    {
+      lock_guard<mutex> lock(mutex_);
+      if (!free_[field].empty()) {
+        ptr = free_[field].back();
+        free_[field].pop_back();
+      }
+    }
+    if (!ptr) {
+      ptr = New(field_sizes_[field].Prod() * sizeof(float));
+    }
+    auto pool = shared_from_this();
+    return shared_ptr<float>(ptr, [pool, field](float* p) {
+      pool->Release(field, p);
+    });
+  }
+
+ private:
+  void Release(size_t field, float* ptr) {
+    {
+      lock_guard<mutex> lock(mutex_);
+      if (free_[field].size() < capacity_) {
+        free_[field].push_back(ptr);
+        return;
+      }
+    }
+    Delete(ptr);
+  }
+  float* New(size_t bytes) {
+#ifdef HAS_CUDA
+    if (page_locked_) {
+      float* ptr;
+      CUDA_CALL(cudaMallocHost(&ptr, bytes));
+      return ptr;
+    }
+#endif
+    return new float[bytes / sizeof(float)];
+  }
+  void Delete(float* ptr) {
+#ifdef HAS_CUDA
+    if (page_locked_) {
+      CUDA_CALL(cudaFreeHost(ptr));
+      return;
+    }
+#endif
+    delete[] ptr;
+  }
+  vector<Scale> field_sizes_;
+  mutex mutex_;
+  vector<vector<float*>> free_;
+  size_t capacity_;
+  bool page_locked_ = false;
+};
+
+DataPipeline::DataPipeline(unique_ptr<BatchReader> reader, size_t num_workers, size_t prefetch)
+  : reader_(move(reader)), field_sizes_(reader_->FieldSizes()), prefetch_(prefetch),
+    buffer_pool_(make_shared<BufferPool>(field_sizes_, prefetch)), workers_(num_workers) {
+  CHECK_GT(num_workers, 0) << "data pipeline needs a worker";
+  CHECK_GT(prefetch, 0) << "data pipeline needs room for a batch";
+  reader_thread_ = thread(&DataPipeline::ReaderLoop, this);
+}
+
+DataPipeline::~DataPipeline() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  reader_thread_.join();
+  workers_.WaitForAllFinished();
+}
+
+bool DataPipeline::NextBatch(Batch* batch) {
+  CHECK(staged_.empty()) << "batches are taken as arrays";
+  auto slot = Take();
+  if (slot.end) {
+    return false;
+  }
+  *batch = move(slot.batch);
+  return true;
+}
+
+bool DataPipeline::Next(vector<NArray>* arrays) {
+  Slot slot;
+  while (staged_.size() < prefetch_ && TryTake(&slot)) {
+    Stage(slot);
+  }
+  if (staged_.empty()) {
+    slot = Take();
+    Stage(slot);
+  }
+  auto front = move(staged_.front());
+  staged_.pop_front();
+  if (front.empty()) {
+    return false;
+  }
+  *arrays = move(front);
+  return true;
+}
+
+void DataPipeline::ReaderLoop() {
+  for (uint64_t seq = 0;; ++seq) {
+    {
+      unique_lock<mutex> lock(mutex_);
+      cv_.wait(lock, [this]() {
+        return stop_ || in_flight_ < prefetch_;
+      });
+      if (stop_) {
+        return;
+      }
+      ++in_flight_;
+    }
+    auto slot = make_shared<Slot>();
+    for (size_t i = 0; i < field_sizes_.size(); ++i) {
+      slot->batch.fields.push_back(buffer_pool_->Allocate(i));
+    }
+    slot->batch.num_samples = field_sizes_[0][field_sizes_[0].NumDims() - 1];
+    slot->end = !reader_->Read(slot->batch);
+    if (slot->end) {
+      slot->batch = Batch();
+      Finish(seq, move(*slot));
+      continue;
+    }
+    workers_.Push([this, seq, slot](int thrid) {
+      reader_->Transform(slot->batch, thrid);
+      slot->batch.records.clear();
+      Finish(seq, move(*slot));
+    });
+  }
+}
+
+void DataPipeline::Finish(uint64_t seq, Slot&& slot) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    done_.emplace(seq, move(slot));
+  }
+  cv_.notify_all();
+}
+
+bool DataPipeline::TryTake(Slot* slot) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto it = done_.find(next_seq_);
+    if (it == done_.end()) {
+      return false;
+    }
+    *slot = move(it->second);
+    done_.erase(it);
+    ++next_seq_;
+    --in_flight_;
+  }
+  cv_.notify_all();
+  return true;
+}
+
+DataPipeline::Slot DataPipeline::Take() {
+  Slot slot;
+  {
+    unique_lock<mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+      return done_.count(next_seq_) != 0;
+    });
+    auto it = done_.find(next_seq_);
+    slot = move(it->second);
+    done_.erase(it);
+    ++next_seq_;
+    --in_flight_;
+  }
+  cv_.notify_all();
+  return slot;
+}
+
+void DataPipeline::Stage(Slot& slot) {
+  vector<NArray> arrays;
+  if (!slot.end) {
+    for (size_t i = 0; i < field_sizes_.size(); ++i) {
+      auto size = field_sizes_[i];
+      size[size.NumDims() - 1] = slot.batch.num_samples;
+      arrays.push_back(NArray::MakeNArray(size, slot.batch.fields[i]));
+    }
+  }
+  staged_.push_back(move(arrays));
+}
+
+RawFileReader::RawFileReader(const vector<string>& files, const vector<Scale>& sample_sizes, int batch_size, size_t header_bytes, int num_batches)
+  : sample_sizes_(sample_sizes), batch_size_(batch_size), header_bytes_(header_bytes), num_batches_(num_batches) {
+  CHECK_EQ(files.size(), sample_sizes.size()) << "#files and #sample sizes differ";
+  for (auto& f : files) {
+    files_.emplace_back(f, ios::binary);
+    CHECK(files_.back()) << "failed to open " << f;
+  }
+  Rewind();
+}
+
+vector<Scale> RawFileReader::FieldSizes() const {
+  return Map<Scale>(sample_sizes_, [this](const Scale& s) {
+    return s.Concat(batch_size_);
+  });
+}
+
+bool RawFileReader::Read(Batch& batch) {
+  if (num_batches_ && batch_idx_ == num_batches_) {
+    Rewind();
+    return false;
+  }
+  for (size_t i = 0; i < files_.size(); ++i) {
+    streamsize bytes = sample_sizes_[i].Prod() * batch_size_ * sizeof(float);
+    files_[i].read(reinterpret_cast<char*>(batch.fields[i].get()), bytes);
+    if (files_[i].gcount() != bytes) {
+      Rewind();
+      return false;
+    }
+  }
+  ++batch_idx_;
+  return true;
+}
+
+void RawFileReader::Rewind() {
+  for (auto& f : files_) {
+    f.clear();
+    f.seekg(header_bytes_, ios::beg);
+  }
+  batch_idx_ = 0;
+}
+
+}  // namespace minerva
+
@@ -0,0 +1,119 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "narray/narray.h"
+#include "common/common.h"
+#include "common/scale.h"
+#include "common/thread_pool.h"
+
+namespace minerva {
+
+// A minibatch on its way through a `DataPipeline`
+struct Batch {
+  // Host buffers of the fields of the batch, e.g. samples and labels. They are
+  // page-locked when there are GPUs, so they are copied to devices directly,
+  // and return to the pipeline for reuse once released.
+  std::vector<std::shared_ptr<float>> fields;
+  // Samples in the batch, the last dimension of each field. The last batch of
+  // a pass may hold fewer than the batch size, at the start of the buffers.
+  int num_samples = 0;
+  // Encoded samples left by the reader for the transform to decode
+  std::vector<std::string> records;
+};
+
+// Source of the batches of a `DataPipeline`
+class BatchReader {
+ public:
+  virtual ~BatchReader() = default;
+  // Sizes of the fields of every batch
+  virtual std::vector<Scale> FieldSizes() const = 0;
+  // Reads the next batch into `batch`, whose fields are allocated. Returns
+  // false at the end of the data, after which reading starts over. Only called
+  // by the reader thread, in order.
+  virtual bool Read(Batch& batch) = 0;
+  // Decodes and augments a batch read. Called concurrently by workers numbered
+  // from 0.
+  virtual void Transform(Batch&, int /* thrid */) {}
+};
+
+// Reads batches on a background thread and transforms them on a pool of
+// workers, keeping up to `prefetch` batches ahead of the consumer. Batches come
+// out in the order they are read.
+class DataPipeline {
+ public:
+  DataPipeline(std::unique_ptr<BatchReader> reader, size_t num_workers, size_t prefetch);
+  DISALLOW_COPY_AND_ASSIGN(DataPipeline);
+  ~DataPipeline();
+  // Takes the next batch in host memory. Returns false once at the end of each
+  // pass over the data.
+  bool NextBatch(Batch* batch);
+  // Takes the next batch as arrays on the current device. Batches already
+  // prefetched are loaded to the device ahead, so they are ready when taken.
+  // Do not mix with `NextBatch`.
+  bool Next(std::vector<NArray>* arrays);
+  const std::vector<Scale>& FieldSizes() const {
+    return field_sizes_;
+  }
+
+ private:
+  struct Slot {
+    Batch batch;
+    // Marks the end of a pass instead of holding a batch
+    bool end;
+  };
+  // Recycles the host buffers of the fields
+  class BufferPool;
+  void ReaderLoop();
+  void Finish(uint64_t seq, Slot&& slot);
+  bool TryTake(Slot* slot);
+  Slot Take();
+  void Stage(Slot& slot);
+  std::unique_ptr<BatchReader> reader_;
+  std::vector<Scale> field_sizes_;
+  size_t prefetch_;
+  // Shared with the deleters of the buffers, which may outlive the pipeline
+  std::shared_ptr<BufferPool> buffer_pool_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // Transformed batches by sequence number
+  std::map<uint64_t, Slot> done_;
+  // Batches being read, transformed or waiting to be taken
+  size_t in_flight_ = 0;
+  uint64_t next_seq_ = 0;
+  bool stop_ = false;
+  // Arrays of batches taken ahead by `Next`, empty at the end of a pass
+  std::deque<std::vector<NArray>> staged_;
+  ThreadPool workers_;
+  std::thread reader_thread_;
+};
+
+// Reads fixed size samples of floats from raw files, one file per field, like
+// the MNIST files of the apps
+class RawFileReader : public BatchReader {
+ public:
+  // File `i` holds samples of `sample_sizes[i]` after `header_bytes`. A pass
+  // ends after `num_batches` batches if nonzero, or when a file runs out.
+  RawFileReader(const std::vector<std::string>& files, const std::vector<Scale>& sample_sizes, int batch_size, size_t header_bytes = 0, int num_batches = 0);
+  std::vector<Scale> FieldSizes() const override;
+  bool Read(Batch&) override;
+
+ private:
+  void Rewind();
+  std::vector<std::ifstream> files_;
+  std::vector<Scale> sample_sizes_;
+  int batch_size_;
+  size_t header_bytes_;
+  int num_batches_;
+  int batch_idx_ = 0;
+};
+
+}  // namespace minerva
+
@@ -0,0 +1,158 @@
+#include "io/datum.h"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <dmlc/logging.h>
+
+using namespace std;
+
+namespace minerva {
+
+namespace {
+
+uint64_t ReadVarint(const unsigned char*& p, const unsigned char* end) {
+  uint64_t v = 0;
+  for (int shift = 0;; shift += 7) {
+    CHECK(p < end && shift < 64) << "malformed datum";
+    auto b = *p++;
+    v |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return v;
+    }
+  }
+}
+
+void AppendFloats(const unsigned char* p, size_t len, vector<float>* v) {
+  CHECK_EQ(len % sizeof(float), 0) << "malformed datum";
+  auto n = v->size();
+  v->resize(n + len / sizeof(float));
+  memcpy(v->data() + n, p, len);
+}
+
+}  // namespace
+
+void ParseDatum(const string& record, Datum* datum) {
+  *datum = Datum();
+  auto p = reinterpret_cast<const unsigned char*>(record.data());
+  auto end = p + record.size();
+  while (p < end) {
+    auto key = ReadVarint(p, end);
+    auto field = key >> 3;
+    switch (key & 7) {
+      case 0: {
+        auto v = ReadVarint(p, end);
+        if (field == 1) {
+          datum->channels = v;
+        } else if (field == 2) {
+          datum->height = v;
+        } else if (field == 3) {
+          datum->width = v;
+        } else if (field == 5) {
+          datum->labels.push_back(static_cast<int32_t>(v));
+        } else if (field == 7) {
+          CHECK(!v) << "encoded datums are not supported";
+        }
+        break;
+      }
+      case 2: {
+        auto len = ReadVarint(p, end);
+        CHECK_LE(len, static_cast<uint64_t>(end - p)) << "malformed datum";
+        if (field == 4) {
+          datum->data = p;
+          datum->data_size = len;
+        } else if (field == 5) {
+          // Packed labels
+          auto q = p;
+          while (q < p + len) {
+            datum->labels.push_back(static_cast<int32_t>(ReadVarint(q, p + len)));
+          }
+        } else if (field == 6) {
+          AppendFloats(p, len, &datum->float_data);
+        }
+        p += len;
+        break;
+      }
+      case 5:
+        CHECK_LE(sizeof(float), static_cast<size_t>(end - p)) << "malformed datum";
+        if (field == 6) {
+          AppendFloats(p, sizeof(float), &datum->float_data);
+        }
+        p += sizeof(float);
+        break;
+      case 1:
+        CHECK_LE(sizeof(uint64_t), static_cast<size_t>(end - p)) << "malformed datum";
+        p += sizeof(uint64_t);
+        break;
+      default:
+        LOG(FATAL) << "malformed datum";
+    }
+  }
+}
+
+DatumBatchDecoder::DatumBatchDecoder(const DatumTransform& transform, const Datum& first, int batch_size)
+  : transform_(transform), channels_(first.channels), height_(first.height), width_(first.width),
+    num_labels_(first.labels.size()), crop_(transform.crop_size), batch_size_(batch_size) {
+  CHECK(channels_ > 0 && height_ > 0 && width_ > 0) << "datum without a shape";
+  CHECK(crop_ <= height_ && crop_ <= width_) << "crop larger than the images";
+  auto& mean = transform_.mean;
+  CHECK(mean.empty() || mean.size() == static_cast<size_t>(channels_) || mean.size() == static_cast<size_t>(channels_ * height_ * width_))
+    << "mean size does not match the images";
+}
+
+vector<Scale> DatumBatchDecoder::FieldSizes() const {
+  return {
+    {crop_ ? crop_ : width_, crop_ ? crop_ : height_, channels_, batch_size_},
+    {num_labels_, batch_size_}
+  };
+}
+
+void DatumBatchDecoder::Decode(Batch& batch) const {
+  auto sizes = FieldSizes();
+  auto sample_size = sizes[0].Prod() / batch_size_;
+  Datum datum;
+  for (size_t i = 0; i < batch.records.size(); ++i) {
+    ParseDatum(batch.records[i], &datum);
+    DecodeOne(datum, batch.fields[0].get() + i * sample_size, batch.fields[1].get() + i * num_labels_);
+  }
+}
+
+void DatumBatchDecoder::DecodeOne(const Datum& datum, float* sample, float* labels) const {
+  CHECK(datum.channels == channels_ && datum.height == height_ && datum.width == width_) << "datums differ in shape";
+  CHECK_EQ(datum.labels.size(), num_labels_) << "datums differ in #labels";
+  size_t image_size = channels_ * height_ * width_;
+  bool bytes = datum.data_size > 0;
+  CHECK_EQ(bytes ? datum.data_size : datum.float_data.size(), image_size) << "datum size mismatch";
+  thread_local mt19937 engine(random_device{}());
+  int out_h = crop_ ? crop_ : height_;
+  int out_w = crop_ ? crop_ : width_;
+  int off_h = (height_ - out_h) / 2;
+  int off_w = (width_ - out_w) / 2;
+  if (transform_.random_crop) {
+    off_h = uniform_int_distribution<int>(0, height_ - out_h)(engine);
+    off_w = uniform_int_distribution<int>(0, width_ - out_w)(engine);
+  }
+  bool mirror = transform_.mirror && bernoulli_distribution(0.5)(engine);
+  auto& mean = transform_.mean;
+  for (int c = 0; c < channels_; ++c) {
+    for (int h = 0; h < out_h; ++h) {
+      int src_row = (c * height_ + h + off_h) * width_ + off_w;
+      float* dst = sample + (c * out_h + h) * out_w;
+      for (int w = 0; w < out_w; ++w) {
+        int src = src_row + w;
+        float pixel = bytes ? datum.data[src] : datum.float_data[src];
+        if (mean.size() == image_size) {
+          pixel -= mean[src];
+        } else if (!mean.empty()) {
+          pixel -= mean[c];
+        }
+        dst[mirror ? out_w - 1 - w : w] = pixel;
+      }
+    }
+  }
+  for (int i = 0; i < num_labels_; ++i) {
+    labels[i] = datum.labels[i];
+  }
+}
+
+}  // namespace minerva
+
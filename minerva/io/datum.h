@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "io/data_pipeline.h"
+#include "common/scale.h"
+
+namespace minerva {
+
+// Caffe's Datum message, parsed without protobuf
+struct Datum {
+  int channels = 0;
+  int height = 0;
+  int width = 0;
+  // Pixels in channel, row, column order, pointing into the parsed record
+  const unsigned char* data = nullptr;
+  size_t data_size = 0;
+  std::vector<int> labels;
+  // Pixels as floats, used when there are no bytes of `data`
+  std::vector<float> float_data;
+};
+
+// Parses a serialized Datum. Encoded images are not supported.
+void ParseDatum(const std::string& record, Datum* datum);
+
+// Turns datums into samples like Caffe's TransformationParameter
+struct DatumTransform {
+  // Side of the square cropped out of each image, or 0 to keep it whole
+  int crop_size = 0;
+  // Crop at random offsets rather than at the center
+  bool random_crop = false;
+  // Flip half of the samples horizontally at random
+  bool mirror = false;
+  // Subtracted from the pixels. Either one value per channel, or a mean image
+  // of channels x height x width, or empty.
+  std::vector<float> mean;
+};
+
+// Decodes batches of serialized datums into a field of samples of
+// {crop, crop, channels, batch} and a field of labels of {#labels, batch}
+class DatumBatchDecoder {
+ public:
+  // The shape of the images and the number of labels are taken from `first`
+  DatumBatchDecoder(const DatumTransform& transform, const Datum& first, int batch_size);
+  std::vector<Scale> FieldSizes() const;
+  // Decodes the records of `batch`. Safe to call concurrently.
+  void Decode(Batch& batch) const;
+
+ private:
+  void DecodeOne(const Datum& datum, float* sample, float* labels) const;
+  DatumTransform transform_;
+  int channels_;
+  int height_;
+  int width_;
+  int num_labels_;
+  int crop_;
+  int batch_size_;
+};
+
+}  // namespace minerva
+
@@ -0,0 +1,95 @@
+#include "io/lmdb_reader.h"
+#include <dmlc/logging.h>
+
+using namespace std;
+
+namespace minerva {
+
+#ifdef HAS_LMDB
+bool const kHasLmdb = true;
+#else
+bool const kHasLmdb = false;
+#endif
+
+unique_ptr<BatchReader> CreateLmdbDatumReader(const string& source, int batch_size, const DatumTransform& transform) {
+#ifdef HAS_LMDB
+  return common::MakeUnique<LmdbDatumReader>(source, batch_size, transform);
+#else
+  LOG(FATAL) << "Minerva is built without LMDB";
+  return nullptr;
+#endif
+}
+
+}  // namespace minerva
+
+#ifdef HAS_LMDB
+#define MDB_CALL(func) { \
+  int rc = (func); \
+  CHECK_EQ(rc, MDB_SUCCESS) << "LMDB: " << mdb_strerror(rc); \
+}
+
+namespace minerva {
+
+LmdbDatumReader::LmdbDatumReader(const string& source, int batch_size, const DatumTransform& transform)
+  : source_(source), batch_size_(batch_size) {
+  MDB_CALL(mdb_env_create(&env_));
+  // Reads happen on the reader thread of the pipeline
+  int rc = mdb_env_open(env_, source.c_str(), MDB_RDONLY | MDB_NOTLS, 0664);
+  CHECK_EQ(rc, MDB_SUCCESS) << "failed to open " << source << ": " << mdb_strerror(rc);
+  MDB_CALL(mdb_txn_begin(env_, nullptr, MDB_RDONLY, &txn_));
+  MDB_CALL(mdb_dbi_open(txn_, nullptr, 0, &dbi_));
+  MDB_CALL(mdb_cursor_open(txn_, dbi_, &cursor_));
+  MDB_val value;
+  CHECK(Get(&value)) << source << " is empty";
+  op_ = MDB_FIRST;
+  Datum first;
+  ParseDatum(string(static_cast<const char*>(value.mv_data), value.mv_size), &first);
+  decoder_.reset(new DatumBatchDecoder(transform, first, batch_size));
+}
+
+LmdbDatumReader::~LmdbDatumReader() {
+  mdb_cursor_close(cursor_);
+  mdb_txn_abort(txn_);
+  mdb_env_close(env_);
+}
+
+vector<Scale> LmdbDatumReader::FieldSizes() const {
+  return decoder_->FieldSizes();
+}
+
+bool LmdbDatumReader::Read(Batch& batch) {
+  MDB_val value;
+  while (!exhausted_ && static_cast<int>(batch.records.size()) < batch_size_) {
+    if (!Get(&value)) {
+      exhausted_ = true;
+      break;
+    }
+    batch.records.emplace_back(static_cast<const char*>(value.mv_data), value.mv_size);
+  }
+  if (batch.records.empty()) {
+    exhausted_ = false;
+    op_ = MDB_FIRST;
+    return false;
+  }
+  batch.num_samples = batch.records.size();
+  return true;
+}
+
+void LmdbDatumReader::Transform(Batch& batch, int) {
+  decoder_->Decode(batch);
+}
+
+bool LmdbDatumReader::Get(MDB_val* value) {
+  MDB_val key;
+  int rc = mdb_cursor_get(cursor_, &key, value, op_);
+  op_ = MDB_NEXT;
+  if (rc == MDB_NOTFOUND) {
+    return false;
+  }
+  CHECK_EQ(rc, MDB_SUCCESS) << "failed to read " << source_ << ": " << mdb_strerror(rc);
+  return true;
+}
+
+}  // namespace minerva
+
+#endif
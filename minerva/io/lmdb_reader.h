@@ -0,0 +1,47 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "io/data_pipeline.h"
+#include "io/datum.h"
+#ifdef HAS_LMDB
+#include <lmdb.h>
+#endif
+
+namespace minerva {
+
+// Whether Minerva is built with LMDB
+extern bool const kHasLmdb;
+
+// Creates an `LmdbDatumReader`, failing if Minerva is built without LMDB
+std::unique_ptr<BatchReader> CreateLmdbDatumReader(const std::string& source, int batch_size, const DatumTransform& transform);
+
+#ifdef HAS_LMDB
+// Reads batches of Caffe datums from an LMDB database in key order, and
+// decodes them on the workers of the pipeline. The last batch of a pass holds
+// the samples left.
+class LmdbDatumReader : public BatchReader {
+ public:
+  LmdbDatumReader(const std::string& source, int batch_size, const DatumTransform& transform);
+  DISALLOW_COPY_AND_ASSIGN(LmdbDatumReader);
+  ~LmdbDatumReader();
+  std::vector<Scale> FieldSizes() const override;
+  bool Read(Batch&) override;
+  void Transform(Batch&, int) override;
+
+ private:
+  // Reads the next record into `value`. Returns false at the end.
+  bool Get(MDB_val* value);
+  std::string source_;
+  int batch_size_;
+  MDB_env* env_ = nullptr;
+  MDB_txn* txn_ = nullptr;
+  MDB_dbi dbi_;
+  MDB_cursor* cursor_ = nullptr;
+  MDB_cursor_op op_ = MDB_FIRST;
+  bool exhausted_ = false;
+  std::unique_ptr<DatumBatchDecoder> decoder_;
+};
+#endif
+
+}  // namespace minerva
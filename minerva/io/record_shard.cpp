@@ -0,0 +1,237 @@
+#include "io/record_shard.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <dmlc/logging.h>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace minerva {
+
+#ifdef HAS_ZLIB
+bool const kHasZlib = true;
+#else
+bool const kHasZlib = false;
+#endif
+
+namespace {
+
+char constexpr kMagic[8] = {'M', 'N', 'V', 'S', 'H', 'R', 'D', '\0'};
+size_t constexpr kRecordHeaderSize = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+size_t constexpr kTrailerSize = 2 * sizeof(uint64_t) + sizeof(kMagic);
+// Bytes read from a shard at a time by `ShardDatumReader`
+size_t constexpr kReadBufferSize = 8 << 20;
+
+template<typename T>
+void Put(ostream& out, const T& v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template<typename T>
+T Get(const char* p) {
+  T v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Returns the #records and the offset of the index of a shard
+pair<uint64_t, uint64_t> ReadTrailer(ifstream& in, const string& filename) {
+  char trailer[kTrailerSize];
+  in.seekg(-static_cast<streamoff>(kTrailerSize), ios::end);
+  in.read(trailer, kTrailerSize);
+  CHECK(in && memcmp(trailer + 2 * sizeof(uint64_t), kMagic, sizeof(kMagic)) == 0) << filename << " is not a record shard";
+  return {Get<uint64_t>(trailer), Get<uint64_t>(trailer + sizeof(uint64_t))};
+}
+
+}  // namespace
+
+RecordShardWriter::RecordShardWriter(const string& filename, RecordCodec codec)
+  : filename_(filename), out_(filename, ios::binary | ios::trunc), codec_(codec) {
+  CHECK(out_) << "failed to create " << filename;
+  CHECK(codec != RecordCodec::kZlib || kHasZlib) << "Minerva is built without zlib";
+}
+
+RecordShardWriter::~RecordShardWriter() {
+  Close();
+}
+
+void RecordShardWriter::Write(const string& record) {
+  CHECK(!closed_) << filename_ << " is closed";
+  const string* stored = &record;
+  auto codec = RecordCodec::kNone;
+#ifdef HAS_ZLIB
+  string compressed;
+  if (codec_ == RecordCodec::kZlib) {
+    auto len = compressBound(record.size());
+    compressed.resize(len);
+    CHECK_EQ(compress2(reinterpret_cast<Bytef*>(&compressed[0]), &len, reinterpret_cast<const Bytef*>(record.data()), record.size(), Z_DEFAULT_COMPRESSION), Z_OK) << "failed to compress a record";
+    if (len < record.size()) {
+      compressed.resize(len);
+      stored = &compressed;
+      codec = RecordCodec::kZlib;
+    }
+  }
+#endif
+  offsets_.push_back(offset_);
+  Put(out_, static_cast<uint32_t>(stored->size()));
+  Put(out_, static_cast<uint32_t>(record.size()));
+  Put(out_, static_cast<uint8_t>(codec));
+  out_.write(stored->data(), stored->size());
+  CHECK(out_) << "failed to write " << filename_;
+  offset_ += kRecordHeaderSize + stored->size();
+}
+
+void RecordShardWriter::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  for (auto o : offsets_) {
+    Put(out_, o);
+  }
+  Put(out_, static_cast<uint64_t>(offsets_.size()));
+  Put(out_, offset_);
+  out_.write(kMagic, sizeof(kMagic));
+  out_.close();
+  CHECK(out_) << "failed to write " << filename_;
+}
+
+RecordShardReader::RecordShardReader(const string& filename) : filename_(filename), in_(filename, ios::binary) {
+  CHECK(in_) << "failed to open " << filename;
+  auto trailer = ReadTrailer(in_, filename);
+  offsets_.resize(trailer.first);
+  in_.seekg(trailer.second);
+  in_.read(reinterpret_cast<char*>(offsets_.data()), offsets_.size() * sizeof(uint64_t));
+  CHECK(in_) << "truncated index of " << filename;
+}
+
+string RecordShardReader::Read(size_t i) {
+  CHECK_LT(i, offsets_.size()) << "record #" << i << " out of " << filename_;
+  char header[kRecordHeaderSize];
+  in_.seekg(offsets_[i]);
+  in_.read(header, kRecordHeaderSize);
+  string stored(header, kRecordHeaderSize);
+  stored.resize(kRecordHeaderSize + Get<uint32_t>(header));
+  in_.read(&stored[kRecordHeaderSize], stored.size() - kRecordHeaderSize);
+  CHECK(in_) << "failed to read record #" << i << " of " << filename_;
+  return UnpackRecord(stored);
+}
+
+string UnpackRecord(const string& stored) {
+  CHECK_GE(stored.size(), kRecordHeaderSize) << "truncated record";
+  auto stored_size = Get<uint32_t>(stored.data());
+  auto codec = static_cast<RecordCodec>(stored[2 * sizeof(uint32_t)]);
+  CHECK_EQ(stored.size(), kRecordHeaderSize + stored_size) << "truncated record";
+  switch (codec) {
+    case RecordCodec::kNone:
+      return stored.substr(kRecordHeaderSize);
+    case RecordCodec::kZlib: {
+#ifdef HAS_ZLIB
+      auto raw_size = Get<uint32_t>(stored.data() + sizeof(uint32_t));
+      string raw(raw_size, '\0');
+      uLongf len = raw_size;
+      CHECK_EQ(uncompress(reinterpret_cast<Bytef*>(&raw[0]), &len, reinterpret_cast<const Bytef*>(stored.data() + kRecordHeaderSize), stored_size), Z_OK) << "corrupt record";
+      CHECK_EQ(len, raw_size) << "corrupt record";
+      return raw;
+#else
+      LOG(FATAL) << "Minerva is built without zlib";
+#endif
+    }
+    default:
+      LOG(FATAL) << "unknown record codec " << static_cast<int>(codec);
+  }
+  return string();
+}
+
+ShardDatumReader::ShardDatumReader(const vector<string>& shards, int batch_size, size_t shuffle_size, const DatumTransform& transform)
+  : shards_(shards), batch_size_(batch_size), shuffle_size_(shuffle_size > 1 ? max<size_t>(shuffle_size, batch_size) : 0),
+    order_(shards.size()), io_buffer_(kReadBufferSize), engine_(random_device{}()) {
+  CHECK(!shards.empty()) << "no record shards";
+  iota(order_.begin(), order_.end(), 0);
+  Datum first;
+  RecordShardReader reader(shards[0]);
+  CHECK_GT(reader.NumRecords(), 0) << shards[0] << " is empty";
+  auto record = reader.Read(0);
+  ParseDatum(record, &first);
+  decoder_.reset(new DatumBatchDecoder(transform, first, batch_size));
+  StartPass();
+}
+
+vector<Scale> ShardDatumReader::FieldSizes() const {
+  return decoder_->FieldSizes();
+}
+
+bool ShardDatumReader::Read(Batch& batch) {
+  string stored;
+  while (!exhausted_ && shuffle_.size() < max<size_t>(shuffle_size_, batch_size_)) {
+    if (!NextStored(&stored)) {
+      exhausted_ = true;
+      break;
+    }
+    shuffle_.push_back(move(stored));
+  }
+  if (shuffle_.empty()) {
+    StartPass();
+    return false;
+  }
+  while (static_cast<int>(batch.records.size()) < batch_size_ && !shuffle_.empty()) {
+    if (shuffle_size_) {
+      swap(shuffle_.front(), shuffle_[uniform_int_distribution<size_t>(0, shuffle_.size() - 1)(engine_)]);
+    }
+    batch.records.push_back(move(shuffle_.front()));
+    shuffle_.pop_front();
+  }
+  batch.num_samples = batch.records.size();
+  return true;
+}
+
+void ShardDatumReader::Transform(Batch& batch, int) {
+  for (auto& r : batch.records) {
+    r = UnpackRecord(r);
+  }
+  decoder_->Decode(batch);
+}
+
+void ShardDatumReader::StartPass() {
+  if (shuffle_size_) {
+    shuffle(order_.begin(), order_.end(), engine_);
+  }
+  shard_idx_ = 0;
+  remaining_ = 0;
+  exhausted_ = false;
+}
+
+bool ShardDatumReader::NextStored(string* stored) {
+  while (!remaining_) {
+    if (shard_idx_ == order_.size()) {
+      return false;
+    }
+    OpenShard(shards_[order_[shard_idx_++]]);
+  }
+  char header[kRecordHeaderSize];
+  in_.read(header, kRecordHeaderSize);
+  stored->assign(header, kRecordHeaderSize);
+  stored->resize(kRecordHeaderSize + Get<uint32_t>(header));
+  in_.read(&(*stored)[kRecordHeaderSize], stored->size() - kRecordHeaderSize);
+  CHECK(in_) << "failed to read " << shards_[order_[shard_idx_ - 1]];
+  --remaining_;
+  return true;
+}
+
+void ShardDatumReader::OpenShard(const string& filename) {
+  if (in_.is_open()) {
+    in_.close();
+  }
+  in_.clear();
+  in_.rdbuf()->pubsetbuf(io_buffer_.data(), io_buffer_.size());
+  in_.open(filename, ios::binary);
+  CHECK(in_) << "failed to open " << filename;
+  remaining_ = ReadTrailer(in_, filename).first;
+  in_.seekg(0);
+}
+
+}  // namespace minerva
+
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "io/data_pipeline.h"
+#include "io/datum.h"
+#include "common/common.h"
+
+namespace minerva {
+
+// A record shard holds opaque records, each stored as
+//   uint32 stored bytes, uint32 raw bytes, uint8 codec, stored bytes
+// followed by an index with the uint64 offset of each record, and a trailer
+//   uint64 #records, uint64 offset of the index, "MNVSHRD\0"
+// Numbers are in host byte order.
+enum class RecordCodec : uint8_t {
+  kNone = 0,
+  kZlib = 1,
+};
+
+// Whether Minerva is built with zlib to compress records
+extern bool const kHasZlib;
+
+class RecordShardWriter {
+ public:
+  // Records are compressed with `codec` when that makes them smaller
+  explicit RecordShardWriter(const std::string& filename, RecordCodec codec = RecordCodec::kNone);
+  DISALLOW_COPY_AND_ASSIGN(RecordShardWriter);
+  ~RecordShardWriter();
+  void Write(const std::string& record);
+  // Writes the index. Called on destruction if not before.
+  void Close();
+
+ private:
+  std::string filename_;
+  std::ofstream out_;
+  RecordCodec codec_;
+  std::vector<uint64_t> offsets_;
+  uint64_t offset_ = 0;
+  bool closed_ = false;
+};
+
+// Random access to the records of a shard through its index
+class RecordShardReader {
+ public:
+  explicit RecordShardReader(const std::string& filename);
+  DISALLOW_COPY_AND_ASSIGN(RecordShardReader);
+  size_t NumRecords() const {
+    return offsets_.size();
+  }
+  std::string Read(size_t i);
+
+ private:
+  std::string filename_;
+  std::ifstream in_;
+  std::vector<uint64_t> offsets_;
+};
+
+// Decodes a record as stored in a shard, header included
+std::string UnpackRecord(const std::string& stored);
+
+// Reads Caffe datums from record shards in large sequential reads. Records
+// pass through an in-memory buffer of `shuffle_size` records, from which
+// batches are drawn at random, and the shards are visited in a random order
+// each pass. With a `shuffle_size` of at most 1 the records keep their order.
+// Records are decompressed and decoded on the workers of the pipeline.
+class ShardDatumReader : public BatchReader {
+ public:
+  ShardDatumReader(const std::vector<std::string>& shards, int batch_size, size_t shuffle_size, const DatumTransform& transform);
+  std::vector<Scale> FieldSizes() const override;
+  bool Read(Batch&) override;
+  void Transform(Batch&, int) override;
+
+ private:
+  void StartPass();
+  // Reads the next record as stored. Returns false at the end of the pass.
+  bool NextStored(std::string* stored);
+  void OpenShard(const std::string& filename);
+  std::vector<std::string> shards_;
+  int batch_size_;
+  size_t shuffle_size_;
+  std::vector<size_t> order_;
+  size_t shard_idx_ = 0;
+  std::vector<char> io_buffer_;
+  std::ifstream in_;
+  uint64_t remaining_ = 0;
+  std::deque<std::string> shuffle_;
+  bool exhausted_ = false;
+  std::mt19937 engine_;
+  std::unique_ptr<DatumBatchDecoder> decoder_;
+};
+
+}  // namespace minerva
+
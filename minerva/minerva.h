@@ -2,8 +2,14 @@
 
 #include "dag/dag_printer.h"
 #include "narray/narray.h"
+#include "narray/checkpoint.h"
+#include "narray/graph_builder.h"
 #include "narray/narray_elewise.h"
 #include "narray/image_batch.h"
 #include "narray/convolution.h"
 #include "narray/convolution_info.h"
+#include "io/data_pipeline.h"
+#include "io/datum.h"
+#include "io/lmdb_reader.h"
+#include "io/record_shard.h"
 #include "system/minerva_system.h"
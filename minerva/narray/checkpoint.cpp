@@ -0,0 +1,382 @@
+#include "narray/checkpoint.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dmlc/logging.h>
+#include "op/physical_op.h"
+#include "common/mapped_file.h"
+#include "narray/graph_builder.h"
+#include "system/minerva_system.h"
+
+using namespace std;
+
+namespace minerva {
+
+namespace {
+
+char constexpr kMagic[8] = {'M', 'N', 'V', 'C', 'K', 'P', 'T', '\0'};
+uint32_t constexpr kVersion = 1;
+uint32_t constexpr kFloat32 = 0;
+size_t constexpr kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+// Threads writing arrays of a checkpoint
+size_t constexpr kIoThreads = 4;
+// Host copies in flight per writing thread
+size_t constexpr kCopyWindow = 2;
+
+uint32_t Crc32(const char* data, size_t len) {
+  static array<uint32_t, 256> const table = []() {
+    array<uint32_t, 256> t;
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; ++i) {
+    crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+size_t Align(size_t offset) {
+  return (offset + kCheckpointAlignment - 1) / kCheckpointAlignment * kCheckpointAlignment;
+}
+
+template<typename T>
+void Append(string* buf, const T& v) {
+  buf->append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template<typename T>
+T Consume(const string& buf, size_t* pos) {
+  CHECK_LE(*pos + sizeof(T), buf.size()) << "truncated checkpoint index";
+  T v;
+  memcpy(&v, buf.data() + *pos, sizeof(T));
+  *pos += sizeof(T);
+  return v;
+}
+
+void WriteAll(int fd, const char* data, size_t len, size_t offset) {
+  while (len) {
+    auto n = pwrite(fd, data, len, offset);
+    CHECK_GT(n, 0) << "failed to write checkpoint: " << strerror(errno);
+    data += n;
+    len -= n;
+    offset += n;
+  }
+}
+
+struct Entry {
+  string name;
+  Scale size;
+  size_t offset;
+  size_t bytes;
+  uint32_t crc;
+  // Released once copied
+  NArray array;
+  // The copy to host memory, and its buffer until written
+  NArray copy;
+  shared_ptr<float> data;
+  future<void> ready;
+};
+
+// Issues the copy of an entry to `data`, which holds its floats
+using CopyFn = function<void(Entry*)>;
+
+// Host buffers of the copies in flight, recycled once their arrays are written
+class HostBuffers {
+ public:
+  explicit HostBuffers(size_t limit) : limit_(limit) {
+  }
+  // Blocks until fewer than `limit` buffers are taken. Returns null if
+  // `failed` is raised meanwhile.
+  shared_ptr<float> Take(size_t size, const atomic<bool>& failed) {
+    unique_lock<mutex> lck(m_);
+    while (num_taken_ == limit_) {
+      if (failed) {
+        return nullptr;
+      }
+      cv_.wait_for(lck, chrono::milliseconds(100));
+    }
+    ++num_taken_;
+    // Free buffers are sorted by size, so the smallest one that fits is reused
+    auto it = lower_bound(free_.begin(), free_.end(), size, [](const pair<size_t, shared_ptr<float>>& b, size_t size) {
+      return b.first < size;
+    });
+    if (it != free_.end()) {
+      auto ret = move(it->second);
+      free_.erase(it);
+      return ret;
+    }
+    // None fits, so the largest one is replaced to keep within the limit
+    if (num_taken_ + free_.size() > limit_) {
+      free_.pop_back();
+    }
+    return shared_ptr<float>(new float[size], [](float* p) {
+      delete[] p;
+    });
+  }
+  // Returns a buffer of at least `size` floats
+  void Give(shared_ptr<float> buf, size_t size) {
+    {
+      lock_guard<mutex> lck(m_);
+      --num_taken_;
+      auto it = lower_bound(free_.begin(), free_.end(), size, [](const pair<size_t, shared_ptr<float>>& b, size_t size) {
+        return b.first < size;
+      });
+      free_.emplace(it, size, move(buf));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  mutex m_;
+  condition_variable cv_;
+  size_t const limit_;
+  size_t num_taken_ = 0;
+  vector<pair<size_t, shared_ptr<float>>> free_;
+};
+
+string SerializeIndex(const vector<Entry>& entries) {
+  string index;
+  for (auto& e : entries) {
+    Append(&index, static_cast<uint32_t>(e.name.size()));
+    index.append(e.name);
+    Append(&index, kFloat32);
+    Append(&index, static_cast<uint32_t>(e.size.NumDims()));
+    for (size_t i = 0; i < e.size.NumDims(); ++i) {
+      Append(&index, static_cast<int32_t>(e.size[i]));
+    }
+    Append(&index, static_cast<uint64_t>(e.offset));
+    Append(&index, static_cast<uint64_t>(e.bytes));
+    Append(&index, e.crc);
+  }
+  return index;
+}
+
+void WriteArrays(int fd, vector<Entry>& entries, const CopyFn& copy) {
+  // Arrays are copied to host memory in the order they are requested, as
+  // long as buffers are left, and written in parallel in the same order,
+  // each as soon as its copy is done. Errors are raised once all workers
+  // stopped, which they do as soon as one of them fails.
+  HostBuffers buffers(kIoThreads * kCopyWindow);
+  atomic<size_t> next{0};
+  atomic<size_t> num_copied{0};
+  atomic<bool> failed{false};
+  exception_ptr error;
+  mutex error_mutex;
+  auto fail = [&]() {
+    lock_guard<mutex> lck(error_mutex);
+    if (!error) {
+      error = current_exception();
+    }
+    failed = true;
+  };
+  vector<thread> workers;
+  for (size_t t = 0; t < min(kIoThreads, entries.size()); ++t) {
+    workers.emplace_back([&]() {
+      try {
+        size_t i;
+        while (!failed && (i = next++) < entries.size()) {
+          auto& e = entries[i];
+          // Copies are issued in order, and the earlier ones are taken by
+          // workers, so buffers are returned while this one waits
+          while (num_copied <= i) {
+            if (failed) {
+              return;
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+          }
+          while (e.ready.wait_for(chrono::milliseconds(100)) != future_status::ready) {
+            if (failed) {
+              return;
+            }
+          }
+          // Throws if the copy was dropped without running
+          e.ready.get();
+          auto data = reinterpret_cast<const char*>(e.data.get());
+          e.crc = Crc32(data, e.bytes);
+          WriteAll(fd, data, e.bytes, e.offset);
+          buffers.Give(move(e.data), e.size.Prod());
+          e.copy = NArray();
+        }
+      } catch (...) {
+        fail();
+      }
+    });
+  }
+  try {
+    for (auto& e : entries) {
+      e.data = buffers.Take(e.size.Prod(), failed);
+      if (!e.data) {
+        break;
+      }
+      copy(&e);
+      ++num_copied;
+    }
+  } catch (...) {
+    fail();
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+}
+
+void WriteCheckpoint(const string& filename, vector<Entry>& entries, size_t file_size, const CopyFn& copy) {
+  auto tmp = filename + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK_NE(fd, -1) << "failed to create " << tmp << ": " << strerror(errno);
+  try {
+    CHECK_EQ(ftruncate(fd, file_size), 0) << "failed to resize " << tmp << ": " << strerror(errno);
+    WriteArrays(fd, entries, copy);
+    // The index holds the checksums, so it goes last
+    string header(kMagic, sizeof(kMagic));
+    auto index = SerializeIndex(entries);
+    Append(&header, kVersion);
+    Append(&header, static_cast<uint32_t>(entries.size()));
+    Append(&header, static_cast<uint64_t>(index.size()));
+    header += index;
+    WriteAll(fd, header.data(), header.size(), 0);
+    CHECK_EQ(fsync(fd), 0) << "failed to sync " << tmp << ": " << strerror(errno);
+    close(fd);
+    fd = -1;
+    CHECK_EQ(rename(tmp.c_str(), filename.c_str()), 0) << "failed to rename " << tmp << ": " << strerror(errno);
+  } catch (...) {
+    if (fd != -1) {
+      close(fd);
+    }
+    remove(tmp.c_str());
+    throw;
+  }
+}
+
+}  // namespace
+
+CheckpointWriter::CheckpointWriter(const string& filename, const map<string, NArray>& arrays) {
+  auto entries = make_shared<vector<Entry>>();
+  size_t index_size = 0;
+  for (auto& i : arrays) {
+    Entry e;
+    e.name = i.first;
+    e.size = i.second.Size();
+    e.bytes = e.size.Prod() * sizeof(float);
+    e.crc = 0;
+    // Copies are created by the writer, so lazy transposes are computed here
+    i.second.Compact();
+    e.array = i.second;
+    index_size += 3 * sizeof(uint32_t) + e.name.size() + e.size.NumDims() * sizeof(int32_t) + 2 * sizeof(uint64_t) + sizeof(uint32_t);
+    entries->push_back(move(e));
+  }
+  size_t offset = Align(kHeaderSize + index_size);
+  for (auto& e : *entries) {
+    e.offset = offset;
+    offset = Align(offset + e.bytes);
+  }
+  auto device_id = MinervaSystem::Instance().current_device_id();
+  writer_ = thread([this, filename, entries, offset, device_id]() {
+    try {
+      WriteCheckpoint(filename, *entries, offset, [device_id](Entry* e) {
+        auto done = make_shared<promise<void>>();
+        e->ready = done->get_future();
+        e->copy = CopyToHost(e->array, device_id, e->data, done);
+        e->array = NArray();
+      });
+    } catch (...) {
+      error_ = current_exception();
+    }
+    // Arrays left by a failure are released before the writer is joined
+    entries->clear();
+  });
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  try {
+    Wait();
+  } catch (const exception& e) {
+    LOG(ERROR) << e.what();
+  }
+}
+
+void CheckpointWriter::Wait() {
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    rethrow_exception(error);
+  }
+}
+
+NArray CheckpointWriter::CopyToHost(const NArray& array, uint64_t device_id,
+    shared_ptr<float> dst, shared_ptr<promise<void>> done) {
+  auto op = new CopyToHostOp();
+  op->closure = {dst, done};
+  // The device current when the writer was created, rather than now
+  BatchOp copy{{0}, {Scale{1}}, PhysicalOp{shared_ptr<ComputeFn>(op), device_id, false}};
+  auto chunks = MinervaSystem::Instance().backend().CreateBatch({GraphBuilder::Resolve(CHECK_NOTNULL(array.data_))}, {copy}, {1});
+  return NArray(chunks[0]);
+}
+
+map<string, NArray> LoadCheckpoint(const string& filename, bool verify) {
+  ifstream in(filename, ios::binary);
+  CHECK(in) << "failed to open " << filename;
+  string header(kHeaderSize, '\0');
+  in.read(&header[0], kHeaderSize);
+  CHECK(in && header.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) == 0) << filename << " is not a checkpoint";
+  size_t pos = sizeof(kMagic);
+  auto version = Consume<uint32_t>(header, &pos);
+  CHECK_EQ(version, kVersion) << "unsupported checkpoint version of " << filename;
+  auto num_arrays = Consume<uint32_t>(header, &pos);
+  string index(Consume<uint64_t>(header, &pos), '\0');
+  in.read(&index[0], index.size());
+  CHECK(in) << "truncated checkpoint " << filename;
+  map<string, NArray> ret;
+  pos = 0;
+  for (uint32_t i = 0; i < num_arrays; ++i) {
+    string name(Consume<uint32_t>(index, &pos), '\0');
+    CHECK_LE(pos + name.size(), index.size()) << "truncated checkpoint index";
+    index.copy(&name[0], name.size(), pos);
+    pos += name.size();
+    CHECK_EQ(Consume<uint32_t>(index, &pos), kFloat32) << "unsupported type of " << name;
+    vector<int> dims(Consume<uint32_t>(index, &pos));
+    for (auto& d : dims) {
+      d = Consume<int32_t>(index, &pos);
+    }
+    auto offset = Consume<uint64_t>(index, &pos);
+    auto bytes = Consume<uint64_t>(index, &pos);
+    auto crc = Consume<uint32_t>(index, &pos);
+    Scale size(dims);
+    CHECK_EQ(size.Prod() * sizeof(float), bytes) << "size mismatch of " << name;
+    if (verify) {
+      auto data = common::MapFile(filename, offset, bytes);
+      CHECK_EQ(Crc32(reinterpret_cast<const char*>(data.get()), bytes), crc) << "checksum mismatch of " << name << " in " << filename;
+    }
+    ret.emplace(name, NArray::FromFile(filename, size, offset));
+  }
+  return ret;
+}
+
+}  // namespace minerva
+
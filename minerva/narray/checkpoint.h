@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include "narray/narray.h"
+#include "common/common.h"
+
+namespace minerva {
+
+// A checkpoint file holds named arrays. It starts with a header
+//   "MNVCKPT\0", uint32 version, uint32 #arrays, uint64 bytes of the index
+// followed by the index, with an entry for each array
+//   uint32 name length, name, uint32 dtype, uint32 #dims, int32 dims[],
+//   uint64 offset, uint64 bytes, uint32 CRC-32 of the bytes
+// Arrays start at multiples of `kCheckpointAlignment` bytes, so they can be
+// mapped in place. Numbers are in host byte order.
+size_t constexpr kCheckpointAlignment = 4096;
+
+class CheckpointWriter {
+ public:
+  // Starts writing the arrays to `filename` without waiting for them to be
+  // computed. Background threads copy the arrays to host memory on the
+  // current device, a few at a time in the order of their names, and write
+  // each copy once ready. The host buffers are reused as writes finish, so
+  // only a bounded number of copies are in flight. The file only appears
+  // under its name once complete.
+  CheckpointWriter(const std::string& filename, const std::map<std::string, NArray>& arrays);
+  DISALLOW_COPY_AND_ASSIGN(CheckpointWriter);
+  ~CheckpointWriter();
+  // Blocks until the file is complete. Throws if it could not be written, in
+  // which case no file is left behind.
+  void Wait();
+
+ private:
+  // Creates the op copying `array` to `dst` on `device_id`. The returned
+  // array keeps the op from being pruned.
+  static NArray CopyToHost(const NArray& array, uint64_t device_id,
+      std::shared_ptr<float> dst, std::shared_ptr<std::promise<void>> done);
+  std::thread writer_;
+  // Raised by `Wait`
+  std::exception_ptr error_;
+};
+
+// Maps the arrays of a checkpoint, which are read lazily. Checksums are
+// verified if `verify`, reading the whole file.
+std::map<std::string, NArray> LoadCheckpoint(const std::string& filename, bool verify = false);
+
+}  // namespace minerva
+
@@ -0,0 +1,437 @@
+#include "graph_builder.h"
+#include <mutex>
+#include <dmlc/logging.h>
+#include "backend/backend.h"
+#include "narray/narray.h"
+#include "op/physical_op.h"
+#include "system/minerva_system.h"
+
+using namespace std;
+
+namespace minerva {
+
+// Ops recorded on a thread since its last flush, or into a plan. Results are
+// numbered in the order they are recorded. Values read by the ops are
+// parameters, or results encoded as `~result` to tell them apart.
+class Recording : public enable_shared_from_this<Recording> {
+ public:
+  explicit Recording(bool planned = false) : planned_(planned) {
+    ++GraphBuilder::num_active_;
+  }
+  DISALLOW_COPY_AND_ASSIGN(Recording);
+  ~Recording();
+  bool planned() const {
+    return planned_;
+  }
+  // Returns false without recording the op once the ops have been created
+  bool Record(const vector<BackendChunk*>&, const vector<Scale>&,
+      shared_ptr<ComputeFn>, vector<BackendChunk*>*);
+  void Submit();
+  BackendChunk* Resolve(size_t value);
+  void AddRef(size_t value);
+  void Release(size_t value);
+  // Interface for `PlanBuilder`
+  BackendChunk* AddInput(BackendChunk*);
+  void BindParam(BackendChunk*, size_t param, float coef);
+  Plan* BuildPlan(const vector<BackendChunk*>& outputs);
+  void Abandon();
+
+ private:
+  void SubmitLocked();
+  // Value of `chunk` in the recording, adding it to the parameters if it is
+  // read from outside
+  size_t ValueLocked(BackendChunk* chunk);
+  mutex m_;
+  bool planned_;
+  bool submitted_ = false;
+  // Inputs read from outside of the recording
+  vector<BackendChunk*> params_;
+  vector<BatchOp> ops_;
+  // Number of chunks referring to each result. Results with chunks left are
+  // returned by the batch, and kept until their last chunk is released.
+  vector<int> num_refs_;
+  vector<unique_ptr<BackendChunk>> created_;
+  // Op resulting in each result, and parameters that are inputs of the plan
+  vector<size_t> result_ops_;
+  vector<size_t> input_params_;
+  vector<Plan::BoundConst> bound_;
+};
+
+namespace {
+
+class RecordedChunk : public BackendChunk {
+ public:
+  // Takes a reference counted by the caller
+  RecordedChunk(shared_ptr<Recording> recording, size_t value, const Scale& shape)
+    : recording_(move(recording)), value_(value), shape_(shape) {
+  }
+  DISALLOW_COPY_AND_ASSIGN(RecordedChunk);
+  ~RecordedChunk() {
+    recording_->Release(value_);
+  }
+  BackendChunk* ShallowCopy() const override {
+    recording_->AddRef(value_);
+    return new RecordedChunk(recording_, value_, shape_);
+  }
+  const Scale& shape() const override {
+    return shape_;
+  }
+  Recording* recording() const {
+    return recording_.get();
+  }
+  size_t value() const {
+    return value_;
+  }
+  BackendChunk* Resolve() const {
+    return recording_->Resolve(value_);
+  }
+
+ private:
+  shared_ptr<Recording> recording_;
+  size_t value_;
+  Scale shape_;
+};
+
+// Recording of the open builders of the thread
+struct ThreadGraph {
+  int num_builders = 0;
+  shared_ptr<Recording> recording;
+};
+
+thread_local ThreadGraph thread_graph;
+
+// Results of other recordings are created before taking the lock of a
+// recording, since their threads may in turn be reading results of this one
+BackendChunk* ResolveForeign(Recording* recording, BackendChunk* c) {
+  auto recorded = dynamic_cast<RecordedChunk*>(c);
+  return recorded && recorded->recording() != recording ? recorded->Resolve() : c;
+}
+
+}  // namespace
+
+Recording::~Recording() {
+  for (auto p : params_) {
+    delete p;
+  }
+  --GraphBuilder::num_active_;
+}
+
+bool Recording::Record(const vector<BackendChunk*>& params, const vector<Scale>& result_sizes,
+    shared_ptr<ComputeFn> fn, vector<BackendChunk*>* results) {
+  auto resolved = Map<BackendChunk*>(params, [this](BackendChunk* c) {
+    return ResolveForeign(this, c);
+  });
+  auto& ms = MinervaSystem::Instance();
+  lock_guard<mutex> l(m_);
+  if (submitted_) {
+    return false;
+  }
+  auto inputs = Map<size_t>(resolved, [this](BackendChunk* c) {
+    return ValueLocked(c);
+  });
+  ops_.push_back(BatchOp{move(inputs), result_sizes, PhysicalOp{fn, ms.current_device_id(), ms.latency_critical()}});
+  results->clear();
+  for (auto& size : result_sizes) {
+    num_refs_.push_back(1);
+    result_ops_.push_back(ops_.size() - 1);
+    results->push_back(new RecordedChunk(shared_from_this(), ~(num_refs_.size() - 1), size));
+  }
+  return true;
+}
+
+void Recording::Submit() {
+  lock_guard<mutex> l(m_);
+  SubmitLocked();
+}
+
+BackendChunk* Recording::Resolve(size_t value) {
+  CHECK(!planned_) << "arrays recorded into a plan can not be read";
+  lock_guard<mutex> l(m_);
+  SubmitLocked();
+  return CHECK_NOTNULL(created_[~value].get());
+}
+
+void Recording::AddRef(size_t value) {
+  lock_guard<mutex> l(m_);
+  if (~value < num_refs_.size()) {
+    ++num_refs_[~value];
+  }
+}
+
+void Recording::Release(size_t value) {
+  unique_ptr<BackendChunk> released;
+  {
+    lock_guard<mutex> l(m_);
+    // Inputs of plans are not counted
+    if (~value < num_refs_.size() && --num_refs_[~value] == 0 && submitted_ && !planned_) {
+      released = move(created_[~value]);
+    }
+  }
+}
+
+BackendChunk* Recording::AddInput(BackendChunk* chunk) {
+  auto resolved = ResolveForeign(this, chunk);
+  CHECK(!dynamic_cast<RecordedChunk*>(resolved)) << "results of a plan can not be its inputs";
+  lock_guard<mutex> l(m_);
+  CHECK(!submitted_) << "inputs are added to a plan before it is built";
+  params_.push_back(resolved->ShallowCopy());
+  input_params_.push_back(params_.size() - 1);
+  return new RecordedChunk(shared_from_this(), params_.size() - 1, resolved->shape());
+}
+
+void Recording::BindParam(BackendChunk* chunk, size_t param, float coef) {
+  auto recorded = dynamic_cast<RecordedChunk*>(chunk);
+  CHECK(recorded && recorded->recording() == this) << "only results of a plan have constants bound";
+  lock_guard<mutex> l(m_);
+  CHECK(!submitted_) << "constants are bound before the plan is built";
+  CHECK_LT(~recorded->value(), num_refs_.size()) << "inputs of a plan have no constants";
+  auto op = result_ops_[~recorded->value()];
+  CHECK(dynamic_cast<ArithmeticConstOp*>(ops_[op].op.compute_fn.get())) << "only arithmetic ops with a number have constants bound";
+  bound_.push_back(Plan::BoundConst{op, param, coef});
+}
+
+Plan* Recording::BuildPlan(const vector<BackendChunk*>& outputs) {
+  auto resolved = Map<BackendChunk*>(outputs, [this](BackendChunk* c) {
+    return ResolveForeign(this, c);
+  });
+  lock_guard<mutex> l(m_);
+  CHECK(!submitted_) << "a plan is built once";
+  submitted_ = true;
+  unique_ptr<Plan> plan(new Plan());
+  auto output_values = Map<size_t>(resolved, [this](BackendChunk* c) {
+    return ValueLocked(c);
+  });
+  // Runs would keep the values that other arrays had while recording
+  CHECK_EQ(params_.size(), input_params_.size()) << "the plan reads arrays that are not its inputs";
+  size_t num_params = params_.size();
+  auto batch_value = [num_params](size_t value) {
+    return value >= num_params ? num_params + ~value : value;
+  };
+  for (auto& op : ops_) {
+    for (auto& i : op.inputs) {
+      i = batch_value(i);
+    }
+  }
+  plan->outputs_ = Map<size_t>(output_values, batch_value);
+  // Inputs are given again to each run
+  vector<bool> read(num_params, false);
+  for (auto& op : ops_) {
+    for (auto i : op.inputs) {
+      if (i < num_params) {
+        read[i] = true;
+      }
+    }
+  }
+  for (auto i : input_params_) {
+    plan->input_sizes_.push_back(params_[i]->shape());
+    plan->input_read_.push_back(read[i]);
+    delete params_[i];
+    params_[i] = nullptr;
+  }
+  plan->params_ = move(params_);
+  plan->input_params_ = move(input_params_);
+  plan->ops_ = move(ops_);
+  plan->bound_ = move(bound_);
+  params_.clear();
+  return plan.release();
+}
+
+void Recording::Abandon() {
+  lock_guard<mutex> l(m_);
+  submitted_ = true;
+  for (auto p : params_) {
+    delete p;
+  }
+  params_.clear();
+  ops_.clear();
+}
+
+void Recording::SubmitLocked() {
+  CHECK(!planned_) << "arrays can not be read while recording a plan";
+  if (submitted_) {
+    return;
+  }
+  submitted_ = true;
+  size_t num_params = params_.size();
+  for (auto& op : ops_) {
+    for (auto& i : op.inputs) {
+      if (i >= num_params) {
+        i = num_params + ~i;
+      }
+    }
+  }
+  vector<size_t> outputs;
+  for (size_t i = 0; i < num_refs_.size(); ++i) {
+    if (num_refs_[i]) {
+      outputs.push_back(num_params + i);
+    }
+  }
+  created_.resize(num_refs_.size());
+  auto chunks = MinervaSystem::Instance().backend().CreateBatch(params_, ops_, outputs);
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    created_[outputs[i] - num_params].reset(chunks[i]);
+  }
+  // The created nodes hold on to what they read
+  for (auto p : params_) {
+    delete p;
+  }
+  params_.clear();
+  ops_.clear();
+}
+
+size_t Recording::ValueLocked(BackendChunk* chunk) {
+  auto recorded = dynamic_cast<RecordedChunk*>(chunk);
+  if (recorded) {
+    return recorded->value();
+  }
+  params_.push_back(chunk->ShallowCopy());
+  return params_.size() - 1;
+}
+
+atomic<int> GraphBuilder::num_active_{0};
+
+GraphBuilder::GraphBuilder() {
+  ++num_active_;
+  ++thread_graph.num_builders;
+}
+
+GraphBuilder::~GraphBuilder() {
+  Close();
+}
+
+void GraphBuilder::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  --num_active_;
+  if (--thread_graph.num_builders == 0) {
+    Flush();
+  }
+}
+
+void GraphBuilder::Flush() {
+  CHECK(!thread_graph.recording || !thread_graph.recording->planned()) << "arrays can not be read while recording a plan";
+  auto recording = move(thread_graph.recording);
+  if (recording) {
+    recording->Submit();
+  }
+}
+
+vector<BackendChunk*> GraphBuilder::Create(const vector<BackendChunk*>& params,
+    const vector<Scale>& result_sizes, shared_ptr<ComputeFn> fn) {
+  auto& graph = thread_graph;
+  if (graph.num_builders == 0) {
+    auto resolved = Map<BackendChunk*>(params, Resolve);
+    return MinervaSystem::Instance().backend().Create(resolved, result_sizes, fn);
+  }
+  vector<BackendChunk*> results;
+  // Ops of the recording may have been created by a read on another thread
+  while (!graph.recording || !graph.recording->Record(params, result_sizes, fn, &results)) {
+    graph.recording = make_shared<Recording>();
+  }
+  return results;
+}
+
+BackendChunk* GraphBuilder::Resolve(BackendChunk* chunk) {
+  auto recorded = dynamic_cast<RecordedChunk*>(chunk);
+  return recorded ? recorded->Resolve() : chunk;
+}
+
+Plan::~Plan() {
+  for (auto p : params_) {
+    delete p;
+  }
+}
+
+vector<NArray> Plan::Run(const vector<NArray>& inputs, const vector<float>& params) const {
+  CHECK_EQ(inputs.size(), input_params_.size()) << "wrong number of plan inputs";
+  auto batch_params = params_;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    CHECK(!input_read_[i] || inputs[i].Size() == input_sizes_[i]) << "size of plan input #" << i << " differs from when it was recorded";
+    inputs[i].Compact();
+    batch_params[input_params_[i]] = GraphBuilder::Resolve(CHECK_NOTNULL(inputs[i].data_));
+  }
+  // The ops of each run get their own constants, so that runs may overlap
+  auto ops = ops_;
+  for (auto& b : bound_) {
+    CHECK_LT(b.param, params.size()) << "missing plan parameter #" << b.param;
+    auto& fn = ops[b.op].op.compute_fn;
+    auto op = new ArithmeticConstOp();
+    op->closure = static_cast<ArithmeticConstOp*>(fn.get())->closure;
+    op->closure.val = b.coef * params[b.param];
+    fn.reset(op);
+  }
+  auto results = MinervaSystem::Instance().backend().CreateBatch(batch_params, ops, outputs_);
+  return Map<NArray>(results, [](BackendChunk* c) { return NArray(c); });
+}
+
+PlanBuilder::PlanBuilder() : recording_(make_shared<Recording>(true)) {
+  CHECK_EQ(thread_graph.num_builders, 0) << "plans are not recorded in graphs";
+  thread_graph.num_builders = 1;
+  thread_graph.recording = recording_;
+}
+
+PlanBuilder::~PlanBuilder() {
+  Close();
+  if (recording_) {
+    recording_->Abandon();
+  }
+}
+
+NArray PlanBuilder::Input(const NArray& a) {
+  CHECK(recording_) << "inputs are added to a plan before it is built";
+  a.Compact();
+  return NArray(recording_->AddInput(CHECK_NOTNULL(a.data_)));
+}
+
+void PlanBuilder::BindParam(const NArray& a, size_t param, float coef) {
+  CHECK(recording_) << "constants are bound before the plan is built";
+  recording_->BindParam(CHECK_NOTNULL(a.data_), param, coef);
+}
+
+void PlanBuilder::Pause() {
+  CHECK(!closed_ && !paused_) << "only a recording plan builder is paused";
+  paused_ = true;
+  paused_builders_ = thread_graph.num_builders;
+  thread_graph.num_builders = 0;
+  thread_graph.recording.reset();
+}
+
+void PlanBuilder::Resume() {
+  CHECK(paused_) << "the plan builder is not paused";
+  CHECK_EQ(thread_graph.num_builders, 0) << "graphs opened while paused are closed first";
+  paused_ = false;
+  thread_graph.num_builders = paused_builders_;
+  thread_graph.recording = recording_;
+}
+
+void PlanBuilder::Close() {
+  if (closed_) {
+    return;
+  }
+  if (paused_) {
+    Resume();
+  }
+  closed_ = true;
+  --thread_graph.num_builders;
+  thread_graph.recording.reset();
+}
+
+Plan* PlanBuilder::Build(const vector<NArray>& outputs) {
+  CHECK(recording_ && !closed_) << "a plan builder builds a single plan";
+  if (paused_) {
+    Resume();
+  }
+  // Transposes of the outputs are recorded too
+  auto chunks = Map<BackendChunk*>(outputs, [](const NArray& a) {
+    a.Compact();
+    return CHECK_NOTNULL(a.data_);
+  });
+  Close();
+  auto plan = recording_->BuildPlan(chunks);
+  recording_.reset();
+  return plan;
+}
+
+}  // namespace minerva
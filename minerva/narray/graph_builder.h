@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "backend/backend.h"
+#include "backend/backend_chunk.h"
+#include "common/common.h"
+#include "common/scale.h"
+#include "op/compute_fn.h"
+
+namespace minerva {
+
+class NArray;
+class Recording;
+
+// While a builder is open, the ops that arrays create on its thread are
+// recorded instead of being created one by one. The recorded ops are created
+// by a single `Backend::CreateBatch` call when the outermost builder is closed,
+// when the thread flushes, or when one of their results is read. Builders of a
+// thread nest and are closed on the thread that opened them. Arrays go
+// through the builder only while one is open or recorded chunks are alive, so
+// the eager path is unchanged otherwise.
+class GraphBuilder {
+ public:
+  GraphBuilder();
+  DISALLOW_COPY_AND_MOVE(GraphBuilder);
+  ~GraphBuilder();
+  // Closes the builder, creating the recorded ops if it is the outermost one.
+  // Unlike the destructor, lets errors of the backend propagate.
+  void Close();
+  // Creates the ops recorded on this thread so far
+  static void Flush();
+  // Interface for `NArray`. Records the op if a builder is open on this
+  // thread, and creates it otherwise.
+  static std::vector<BackendChunk*> Create(const std::vector<BackendChunk*>&,
+      const std::vector<Scale>&, std::shared_ptr<ComputeFn>);
+  // Chunk of the backend holding the value of `chunk`, valid as long as
+  // `chunk` is. Creates the recorded ops first if `chunk` is a recorded result.
+  static BackendChunk* Resolve(BackendChunk* chunk);
+  // Whether a builder is open or a recording is alive on any thread. Recorded
+  // chunks only exist while this holds.
+  static bool Active() {
+    return num_active_.load(std::memory_order_relaxed) > 0;
+  }
+
+ private:
+  friend class Recording;
+  // Open builders and live recordings of all threads
+  static std::atomic<int> num_active_;
+  bool closed_ = false;
+};
+
+// Ops recorded by a `PlanBuilder`, created again by each run on new inputs of
+// the same shapes
+class Plan {
+ public:
+  DISALLOW_COPY_AND_MOVE(Plan);
+  ~Plan();
+  // Creates all the ops in a single `Backend::CreateBatch` call, on `inputs`
+  // in the order they were declared. Inputs that ops read keep their sizes.
+  // Constants bound to parameters take their value from `params`. Returns the
+  // values of the outputs. Runs do not change the plan, and may overlap.
+  std::vector<NArray> Run(const std::vector<NArray>& inputs, const std::vector<float>& params) const;
+  size_t NumOps() const {
+    return ops_.size();
+  }
+
+ private:
+  friend class Recording;
+  Plan() = default;
+  // Constant of an op that is `coef` times a parameter of the run
+  struct BoundConst {
+    size_t op;
+    size_t param;
+    float coef;
+  };
+  // Parameters of the batch, with null slots for the inputs of the run
+  std::vector<BackendChunk*> params_;
+  std::vector<size_t> input_params_;
+  std::vector<Scale> input_sizes_;
+  // Whether ops read the input, rather than only returning it
+  std::vector<bool> input_read_;
+  std::vector<BatchOp> ops_;
+  std::vector<BoundConst> bound_;
+  // Values of the batch returned as outputs
+  std::vector<size_t> outputs_;
+};
+
+// Records the ops that arrays create on its thread into a `Plan`, to be
+// created by its runs rather than now. Arrays of the recording can not be
+// read, nor be given to ops once it stopped; the runs return new values for
+// its outputs. Ops only read inputs of the plan and results of earlier ops.
+// Plans are recorded outside of graph builders.
+class PlanBuilder {
+ public:
+  PlanBuilder();
+  DISALLOW_COPY_AND_MOVE(PlanBuilder);
+  ~PlanBuilder();
+  // Input of the plan, with the value of `a` while recording. Ops recorded on
+  // the result read the input given to each run.
+  NArray Input(const NArray& a);
+  // Makes the constant of the op resulting in `a`, which is an arithmetic op
+  // of an array and a number, `coef` times parameter `param` of each run
+  void BindParam(const NArray& a, size_t param, float coef);
+  // Creates the ops of this thread right away until `Resume`, e.g. to load
+  // the inputs
+  void Pause();
+  void Resume();
+  // Plan of the ops recorded so far, returning the values of `outputs` at
+  // this point. Stops recording, and a builder destroyed before has no plan.
+  // Fails if an op read, or an output is, an array from outside the plan.
+  Plan* Build(const std::vector<NArray>& outputs);
+
+ private:
+  void Close();
+  std::shared_ptr<Recording> recording_;
+  int paused_builders_ = 0;
+  bool paused_ = false;
+  bool closed_ = false;
+};
+
+}  // namespace minerva
+
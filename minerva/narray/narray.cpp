@@ -2,15 +2,44 @@
 #include <fstream>
 #include <iomanip>
 #include <memory>
+#include <mutex>
 #include <dmlc/logging.h>
 #include "op/physical_op.h"
 #include "common/common.h"
+#include "common/mapped_file.h"
+#include "narray/graph_builder.h"
 #include "system/minerva_system.h"
 
 using namespace std;
 
 namespace minerva {
 
+namespace {
+
+// Ops and reads go through the graph builder only while it may be recording
+vector<BackendChunk*> CreateChunks(const vector<BackendChunk*>& params,
+    const vector<Scale>& result_sizes, shared_ptr<ComputeFn> fn) {
+  if (GraphBuilder::Active()) {
+    return GraphBuilder::Create(params, result_sizes, fn);
+  }
+  return MinervaSystem::Instance().backend().Create(params, result_sizes, fn);
+}
+
+BackendChunk* BackendData(BackendChunk* chunk) {
+  return GraphBuilder::Active() ? GraphBuilder::Resolve(chunk) : chunk;
+}
+
+}  // namespace
+
+// Transpose computed by the first copy of a lazily transposed array to be read
+struct NArray::TransposeCache {
+  ~TransposeCache() {
+    delete compacted;
+  }
+  mutex m;
+  BackendChunk* compacted = nullptr;
+};
+
 // Static constructors
 NArray NArray::Constant(const Scale& size, float val) {
   FillOp* fill_op = new FillOp();
@@ -46,6 +75,12 @@ NArray NArray::MakeNArray(const Scale& size, shared_ptr<float> array) {
   return NArray::GenerateOne(size, loader_op);
 }
 
+NArray NArray::FromFile(const std::string& filename, const Scale& size, size_t offset) {
+  MappedLoaderOp* loader_op = new MappedLoaderOp();
+  loader_op->closure = {common::MapFile(filename, offset, size.Prod() * sizeof(float))};
+  return NArray::GenerateOne(size, loader_op);
+}
+
 NArray NArray::PushGradAndPullWeight(const NArray& grad, const std::string& layer_name) {
   SyncWithPSOp* op = new SyncWithPSOp();
   op->closure = {layer_name};
@@ -57,9 +92,11 @@ vector<NArray> NArray::Compute(
     const vector<NArray>& params,
     const vector<Scale>& result_sizes,
     ComputeFn* fn) {
-  auto& ms = MinervaSystem::Instance();
-  auto param_mdata = Map<BackendChunk*>(params, [](const NArray& a) { return CHECK_NOTNULL(a.data_); });
-  auto result_mdata = ms.backend().Create(param_mdata, result_sizes, shared_ptr<ComputeFn>(fn));
+  auto param_mdata = Map<BackendChunk*>(params, [](const NArray& a) {
+    a.Compact();
+    return CHECK_NOTNULL(a.data_);
+  });
+  auto result_mdata = CreateChunks(param_mdata, result_sizes, shared_ptr<ComputeFn>(fn));
   return Map<NArray>(result_mdata, [](BackendChunk* md) { return NArray(md); });
 }
 
@@ -72,9 +109,9 @@ NArray NArray::GenerateOne(const Scale& size, ComputeFn* fn) {
 }
 
 // Constructors and destructors
-NArray::NArray() : data_(nullptr) {}
+NArray::NArray() : data_(nullptr), transposed_(false) {}
 
-NArray::NArray(const NArray& other) {
+NArray::NArray(const NArray& other) : transposed_(other.transposed_), transposed_size_(other.transposed_size_), transpose_cache_(other.transpose_cache_) {
   if (other.data_ == 0) {
     data_ = 0;
   } else {
@@ -82,7 +119,7 @@ NArray::NArray(const NArray& other) {
   }
 }
 
-NArray::NArray(NArray&& other) : data_(other.data_) {
+NArray::NArray(NArray&& other) : data_(other.data_), transposed_(other.transposed_), transposed_size_(other.transposed_size_), transpose_cache_(move(other.transpose_cache_)) {
   other.data_ = nullptr;
 }
 
@@ -95,6 +132,9 @@ NArray& NArray::operator=(const NArray& other) {
   } else {
     data_ = other.data_->ShallowCopy();
   }
+  transposed_ = other.transposed_;
+  transposed_size_ = other.transposed_size_;
+  transpose_cache_ = other.transpose_cache_;
   return *this;
 }
 
@@ -104,6 +144,9 @@ NArray& NArray::operator=(NArray&& other) {
   }
   delete data_;
   data_ = other.data_;
+  transposed_ = other.transposed_;
+  transposed_size_ = other.transposed_size_;
+  transpose_cache_ = move(other.transpose_cache_);
   other.data_ = nullptr;
   return *this;
 }
@@ -119,7 +162,10 @@ NArray operator*(const NArray& lhs, const NArray& rhs) {
   CHECK_EQ(lhs.Size(1), rhs.Size(0)) << "size must match";
   Scale newsize = {lhs.Size(0), rhs.Size(1)};
   MatMultOp* matmult_op = new MatMultOp();
-  return NArray::ComputeOne({lhs, rhs}, newsize, matmult_op);
+  // Transposed operands are read in place
+  matmult_op->closure = {lhs.transposed_, rhs.transposed_};
+  auto result = CreateChunks({CHECK_NOTNULL(lhs.data_), CHECK_NOTNULL(rhs.data_)}, {newsize}, shared_ptr<ComputeFn>(matmult_op));
+  return NArray(result[0]);
 }
 
 NArray& NArray::operator*=(const NArray& rhs) {
@@ -175,9 +221,15 @@ NArray NArray::Reshape(const Scale& dims) const {
 
 NArray NArray::Trans() const {
   CHECK_EQ(Size().NumDims(), 2) << "eligible only for 2D";
-  Scale newsize = {Size(1), Size(0)};
-  TransOp* trans_op = new TransOp();
-  return NArray::ComputeOne({*this}, newsize, trans_op);
+  NArray ret(*this);
+  ret.transposed_size_ = {Size(1), Size(0)};
+  ret.transposed_ = !transposed_;
+  if (ret.transposed_) {
+    ret.transpose_cache_ = make_shared<TransposeCache>();
+  } else {
+    ret.transpose_cache_.reset();
+  }
+  return ret;
 }
 
 NArray NArray::Select(std::vector<int> const& indices) const {
@@ -215,19 +267,32 @@ NArray NArray::NormArithmetic(const NArray& rhs, ArithmeticType type) const {
 
 // System
 void NArray::Wait() const {
-  MinervaSystem::Instance().backend().Wait(CHECK_NOTNULL(data_));
+  MinervaSystem::Instance().backend().Wait(BackendData(CHECK_NOTNULL(data_)));
 }
 
 shared_ptr<float> NArray::Get() const {
+  Compact();
+  Wait();
+  return MinervaSystem::Instance().backend().GetValue(BackendData(CHECK_NOTNULL(data_)));
+}
+
+void NArray::GetInto(float* dst) const {
+  Compact();
+  Wait();
+  MinervaSystem::Instance().backend().GetValueInto(BackendData(CHECK_NOTNULL(data_)), dst);
+}
+
+shared_ptr<const float> NArray::Borrow() const {
+  Compact();
   Wait();
-  return MinervaSystem::Instance().backend().GetValue(CHECK_NOTNULL(data_));
+  return MinervaSystem::Instance().backend().BorrowValue(BackendData(CHECK_NOTNULL(data_)));
 }
 
 void NArray::ToStream(ostream& out, const FileFormat& format) const {
-  shared_ptr<float> ptr = Get();
-  float* value = ptr.get();
+  auto ptr = Borrow();
+  const float* value = ptr.get();
   if (format.binary) {
-    out.write(reinterpret_cast<char*>(value), Size().Prod() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(value), Size().Prod() * sizeof(float));
   } else {
     for (int i = 0; i < Size().Prod(); ++i) {
       if (i != 0 && i % 10 == 0)
@@ -243,10 +308,29 @@ void NArray::ToFile(const std::string& filename, const FileFormat& format) const
   fout.close();
 }
 
-NArray::NArray(BackendChunk* data) : data_(data) {
+NArray::NArray(BackendChunk* data) : data_(data), transposed_(false) {
   CHECK_NOTNULL(data_);
 }
 
+void NArray::Compact() const {
+  if (!transposed_) {
+    return;
+  }
+  BackendChunk* compacted;
+  {
+    lock_guard<mutex> lck(transpose_cache_->m);
+    if (!transpose_cache_->compacted) {
+      auto result = CreateChunks({CHECK_NOTNULL(data_)}, {transposed_size_}, shared_ptr<ComputeFn>(new TransOp()));
+      transpose_cache_->compacted = result[0];
+    }
+    compacted = transpose_cache_->compacted->ShallowCopy();
+  }
+  delete data_;
+  data_ = compacted;
+  transposed_ = false;
+  transpose_cache_.reset();
+}
+
 NArray NArray::operator[](const int idx) {
   CHECK_GT(Size(0), idx) << "invalid index";
   CHECK_GT(Size().NumDims(), 1) << "not eligible for less than 2D";
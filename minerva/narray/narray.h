@@ -16,6 +16,9 @@ struct FileFormat {
 class NArray {
   friend class Elewise;
   friend class Convolution;
+  friend class CheckpointWriter;
+  friend class Plan;
+  friend class PlanBuilder;
 
  public:
   // Static constructors
@@ -25,6 +28,9 @@ class NArray {
   static NArray Zeros(const Scale& size);
   static NArray Ones(const Scale& size);
   static NArray MakeNArray(const Scale& size, std::shared_ptr<float> array);
+  // Maps the floats of a file written by `ToFile` in binary format, starting
+  // `offset` bytes in. CPU devices read the mapping without copying it.
+  static NArray FromFile(const std::string& filename, const Scale& size, size_t offset = 0);
   static NArray PushGradAndPullWeight(const NArray& grad, const std::string& layer_name);
   // DAG generating operations
   static std::vector<NArray> Compute(
@@ -75,9 +81,11 @@ class NArray {
   friend NArray Concat(const std::vector<NArray>& params, int concat_dim);
   friend NArray Slice(const NArray& src, int slice_dim, int st_off, int slice_count);
   // Shape
-  const Scale& Size() const { return CHECK_NOTNULL(data_)->shape(); }
-  int Size(int dim) const { return CHECK_NOTNULL(data_)->shape()[dim]; }
+  const Scale& Size() const { return transposed_ ? transposed_size_ : CHECK_NOTNULL(data_)->shape(); }
+  int Size(int dim) const { return Size()[dim]; }
+  // Views sharing the buffer of this array
   NArray Reshape(const Scale& dims) const;
+  // Only computed when read by other ops than matrix multiplications
   NArray Trans() const;
   NArray Select(std::vector<int> const&) const;
   // Lazy reductions
@@ -96,12 +104,28 @@ class NArray {
   // System
   void Wait() const;
   std::shared_ptr<float> Get() const;
+  // Copies the value to `dst`, which holds `Size().Prod()` floats
+  void GetInto(float* dst) const;
+  // Read-only view of the value. Arrays on CPU devices are viewed in place and
+  // their buffers are kept until the view is released; others are copied.
+  std::shared_ptr<const float> Borrow() const;
   void ToStream(std::ostream& out, const FileFormat& format) const;
   void ToFile(const std::string& filename, const FileFormat& format) const;
+  // Computes the transpose of `data_` if the array is lazily transposed. Reads
+  // of the array compact it first, so callers reading an array that other
+  // threads may also read compact it beforehand, while they own it alone.
+  // Copies of the same `Trans()` result share the computed transpose.
+  void Compact() const;
 
  private:
+  struct TransposeCache;
   NArray(BackendChunk*);
-  BackendChunk* data_;
+  mutable BackendChunk* data_;
+  // `data_` holds the transpose of the array
+  mutable bool transposed_;
+  Scale transposed_size_;
+  // Set while `transposed_`
+  mutable std::shared_ptr<TransposeCache> transpose_cache_;
 };
 
 // Matmult
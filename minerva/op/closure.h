@@ -1,4 +1,5 @@
 #pragma once
+#include <future>
 #include <memory>
 #include "common/scale.h"
 #include "narray/convolution_info.h"
@@ -44,6 +45,9 @@ struct SyncWithPSClosure {
 };
 
 struct MatMultClosure {
+  // Operands are stored transposed
+  bool trans_left;
+  bool trans_right;
 };
 
 struct TransposeClosure {
@@ -171,6 +175,12 @@ struct SelectClosure {
   std::vector<int> indices;
 };
 
+struct CopyToHostClosure {
+  std::shared_ptr<float> dst;
+  // Fulfilled once `dst` holds the input
+  std::shared_ptr<std::promise<void>> done;
+};
+
 }  // end of namespace minerva
 
 
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
 #include "op/basic_fn.h"
 #include "op/data_shard.h"
 
@@ -9,7 +12,31 @@ struct Context;
 class ComputeFn : public BasicFn {
  public:
   virtual void Execute(DataList const&, DataList const&, Context const&) = 0;
+  // An op is partitionable if every slice along the last dimension of its
+  // outputs can be computed independently. On success `split` is filled with
+  // whether each input is sliced alongside the outputs (true) or read as a
+  // whole by every partition (false). `inputs` are the sizes of the inputs.
+  virtual bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const {
+    return false;
+  }
+  // A view shares the buffer of its only input, starting `offset` floats in,
+  // instead of computing its output
+  virtual bool IsView(const Scale& input, const Scale& output, size_t* offset) const {
+    return false;
+  }
+  // Host buffer holding the only output, which host devices read in place
+  // instead of computing the output
+  virtual std::shared_ptr<float> SharedOutput() const {
+    return nullptr;
+  }
+  // Rough number of floating point operations, used for reporting only
+  virtual uint64_t EstimateFlops(const std::vector<Scale>& inputs, const std::vector<Scale>& outputs) const {
+    uint64_t flops = 0;
+    for (auto& s : outputs) {
+      flops += s.Prod();
+    }
+    return flops;
+  }
 };
 
 }  // namespace minerva
-
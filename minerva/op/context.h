@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <iostream>
 #ifdef HAS_CUDA
 #include <cuda_runtime.h>
@@ -27,6 +28,8 @@ inline std::ostream& operator<<(std::ostream& os, ImplType t) {
 
 struct Context {
   ImplType impl_type;
+  // Every buffer passed to the kernel starts at a multiple of this many bytes
+  size_t alignment = sizeof(float);
 #ifdef HAS_CUDA
   cudaStream_t stream;
   cublasHandle_t cublas_handle;
@@ -139,17 +139,19 @@ void MatMult(const DataList& inputs, const DataList& outputs, MatMultClosure& cl
   float* res_data = outputs[0].data_;
   int m = outputs[0].size_[0];
   int n = outputs[0].size_[1];
-  int o = inputs[0].size_[1];
+  int o = closure.trans_left ? inputs[0].size_[0] : inputs[0].size_[1];
   // ATTENTION: the data is column major !!
 #ifdef HAS_CBLAS
   memset(res_data, 0, sizeof(float) * m * n);
-  cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, m, n, o, 1.0, left_data, m, right_data, o, 0.0, res_data, m);
+  cblas_sgemm(CblasColMajor, closure.trans_left ? CblasTrans : CblasNoTrans, closure.trans_right ? CblasTrans : CblasNoTrans, m, n, o, 1.0, left_data, closure.trans_left ? o : m, right_data, closure.trans_right ? n : o, 0.0, res_data, m);
 #else
   for (int i = 0; i < m; ++i) {
     for (int j = 0; j < n; ++j) {
       res_data[i + j * m] = 0;
       for (int k = 0; k < o; ++k) {
-        res_data[i + j * m] += left_data[i + k * m] * right_data[k + j * o];
+        float l = closure.trans_left ? left_data[k + i * o] : left_data[i + k * m];
+        float r = closure.trans_right ? right_data[j + k * n] : right_data[k + j * o];
+        res_data[i + j * m] += l * r;
       }
     }
   }
@@ -230,15 +232,15 @@ void SoftmaxForward(const DataList& inputs, const DataList& outputs, SoftmaxForw
     //exp(x - max), also sum the result
     cur = accumulator;
     float sum_exp = 0;
-    while (cur.IncrDimensions(in_max, dim_to_norm)) {
+    do {
       res_data[in_range.Flatten(cur)] = expf(in_data[in_range.Flatten(cur)] - tmp);
       sum_exp += res_data[in_range.Flatten(cur)];
-    }
+    } while (cur.IncrDimensions(in_max, dim_to_norm));
     //devide the sum
     cur = accumulator;
-    while (cur.IncrDimensions(in_max, dim_to_norm)) {
+    do {
       res_data[in_range.Flatten(cur)] /= sum_exp; 
-    }
+    } while (cur.IncrDimensions(in_max, dim_to_norm));
   } while (accumulator.IncrWithDimensionsFixed(res_max, dim_to_norm));
 }
 
@@ -456,21 +458,34 @@ void ActivationForward(const DataList& inputs, const DataList& outputs, Activati
 }
 
 
-void Index(const DataList& inputs, const DataList& outputs, IndexClosure& closure) {
-	CHECK_EQ(inputs.size(), 1) << "(activation forward) #inputs wrong";
-	CHECK_EQ(outputs.size(), 1) << "(activation forward) #outputs wrong";
-	float* input_data = inputs[0].data_;
-	float* output_data = outputs[0].data_;
-
-	size_t output_length = outputs[0].size_.Prod();
-	auto idx = closure.idx;
+void Slice(const DataList& inputs, const DataList& outputs, SliceClosure& closure) {
+  CHECK_EQ(inputs.size(), 1) << "(slice) #inputs wrong";
+  CHECK_EQ(outputs.size(), 1) << "(slice) #outputs wrong";
+  auto& in_size = inputs[0].size_;
+  // Column major: a run of `inner * slice_count` contiguous elements is copied
+  // for each index of the dimensions after `slice_dim`
+  size_t inner = 1;
+  for (int i = 0; i < closure.slice_dim; ++i) {
+    inner *= in_size[i];
+  }
+  size_t outer = in_size.Prod() / (inner * in_size[closure.slice_dim]);
+  size_t run = inner * closure.slice_count;
+  for (size_t i = 0; i < outer; ++i) {
+    memcpy(outputs[0].data_ + i * run, inputs[0].data_ + (i * in_size[closure.slice_dim] + closure.st_off) * inner, run * sizeof(float));
+  }
+}
 
-	memcpy(output_data, input_data + idx * output_length, output_length * sizeof(input_data[0]));
-	for (size_t i = 0; i < output_length; ++ i)
-		cout << output_data[i] << endl;
+void Index(const DataList& inputs, const DataList& outputs, IndexClosure& closure) {
+  CHECK_EQ(inputs.size(), 1) << "(index) #inputs wrong";
+  CHECK_EQ(outputs.size(), 1) << "(index) #outputs wrong";
+  size_t output_length = outputs[0].size_.Prod();
+  memcpy(outputs[0].data_, inputs[0].data_ + closure.idx * output_length, output_length * sizeof(float));
+}
 
-	for (size_t i = 0; i < output_length; ++ i)
-		output_data[i] = input_data[i + idx * output_length];
+void CopyToHost(const DataList& inputs, const DataList& outputs, CopyToHostClosure& closure) {
+  CHECK_EQ(inputs.size(), 1) << "(copy to host) #inputs wrong";
+  memcpy(closure.dst.get(), inputs[0].data_, inputs[0].size_.Prod() * sizeof(float));
+  closure.done->set_value();
 }
 
 }  // end of namespace basic
@@ -34,6 +34,8 @@ void ActivationForward(const DataList&, const DataList&, ActivationForwardClosur
 void ActivationBackward(const DataList&, const DataList&, ActivationBackwardClosure&);
 
 void SoftmaxForward(const DataList&, const DataList&, SoftmaxForwardClosure&);
+void Slice(const DataList&, const DataList&, SliceClosure&);
 void Index(const DataList&, const DataList&, IndexClosure&);
+void CopyToHost(const DataList&, const DataList&, CopyToHostClosure&);
 }  // end of namespace basic
 }  // end of namespace minerva
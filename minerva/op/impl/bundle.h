@@ -50,7 +50,8 @@ INSTALL_DATAGEN_FN(FillClosure, basic::Fill, NO_IMPL, cuda::Fill);
 INSTALL_COMPUTE_FN(LRNForwardClosure, NO_IMPL, NO_IMPL, cuda::LRNForward);
 INSTALL_COMPUTE_FN(LRNBackwardClosure, NO_IMPL, NO_IMPL, cuda::LRNBackward);
 INSTALL_COMPUTE_FN(ConcatClosure, NO_IMPL, NO_IMPL, cuda::Concat);
-INSTALL_COMPUTE_FN(SliceClosure, NO_IMPL, NO_IMPL, cuda::Slice);
-INSTALL_COMPUTE_FN(IndexClosure, basic::Index, NO_IMPL, NO_IMPL);
+INSTALL_COMPUTE_FN(SliceClosure, basic::Slice, NO_IMPL, cuda::Slice);
+INSTALL_COMPUTE_FN(IndexClosure, basic::Index, NO_IMPL, cuda::Index);
 INSTALL_COMPUTE_FN(SelectClosure, NO_IMPL, NO_IMPL, cuda::Select);
+INSTALL_COMPUTE_FN(CopyToHostClosure, basic::CopyToHost, NO_IMPL, cuda::CopyToHost);
 }  // namespace minerva
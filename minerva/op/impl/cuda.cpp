@@ -161,10 +161,10 @@ void MatMult(const DataList& inputs, const DataList& outputs, MatMultClosure& cl
   float* left_data = inputs[0].data_;
   float* right_data = inputs[1].data_;
   float* res_data = outputs[0].data_;
-  int m = inputs[0].size_[0];
-  int k = inputs[0].size_[1];
+  int m = outputs[0].size_[0];
+  int k = closure.trans_left ? inputs[0].size_[0] : inputs[0].size_[1];
   int n = outputs[0].size_[1];
-  CudaPerformMatMult(left_data, right_data, res_data, m, n, k, context.cublas_handle);
+  CudaPerformMatMult(left_data, right_data, res_data, m, n, k, closure.trans_left, closure.trans_right, context.cublas_handle);
 }
 
 void ArithmeticConst(const DataList& inputs, const DataList& outputs,
@@ -638,7 +638,10 @@ void SyncWithPS(const DataList& inputs, const DataList& outputs, SyncWithPSClosu
 }
 
 void Index(const DataList& inputs, const DataList& outputs, IndexClosure& closure, const Context& context) {
-	cout << "a" << endl;
+  CHECK_EQ(inputs.size(), 1) << "(index) #inputs wrong";
+  CHECK_EQ(outputs.size(), 1) << "(index) #outputs wrong";
+  size_t output_length = outputs[0].size_.Prod();
+  CudaPerformCopy(inputs[0].data_ + closure.idx * output_length, outputs[0].data_, output_length, context.cublas_handle);
 }
 
 void Select(DataList const& inputs, DataList const& outputs, SelectClosure& closure, const Context& context) {
@@ -654,6 +657,13 @@ void Select(DataList const& inputs, DataList const& outputs, SelectClosure& clos
   CudaPerformSelect(outputs[0].data_, inputs[0].data_, closure.indices, inputs[0].size_[1], inputs[0].size_[0], context.stream);
 }
 
+void CopyToHost(const DataList& inputs, const DataList& outputs, CopyToHostClosure& closure, const Context& context) {
+  CHECK_EQ(inputs.size(), 1) << "(copy to host) #inputs wrong";
+  CUDA_CALL(cudaMemcpyAsync(closure.dst.get(), inputs[0].data_, inputs[0].size_.Prod() * sizeof(float), cudaMemcpyDefault, context.stream));
+  CUDA_CALL(cudaStreamSynchronize(context.stream));
+  closure.done->set_value();
+}
+
 }
 #endif
 }
@@ -63,10 +63,10 @@ void CudaPerformSub(float* a, float* b, float* c, size_t size, cublasHandle_t ha
   CUBLAS_CALL(cublasSaxpy(handle, size, &minus_one, b, 1, c, 1));
 }
 
-void CudaPerformMatMult(float* a, float* b, float* c, int m, int n, int k, cublasHandle_t handle) {
+void CudaPerformMatMult(float* a, float* b, float* c, int m, int n, int k, bool trans_a, bool trans_b, cublasHandle_t handle) {
   float one = 1.0;
   float zero = 0.0;
-  CUBLAS_CALL(cublasSgemm(handle, CUBLAS_OP_N, CUBLAS_OP_N, m, n, k, &one, a, m, b, k, &zero, c, m));
+  CUBLAS_CALL(cublasSgemm(handle, trans_a ? CUBLAS_OP_T : CUBLAS_OP_N, trans_b ? CUBLAS_OP_T : CUBLAS_OP_N, m, n, k, &one, a, trans_a ? k : m, b, trans_b ? n : k, &zero, c, m));
 }
 
 void CudaPerformScale(float* in_data, float* res_data, size_t size, float val, cublasHandle_t handle) {
@@ -14,7 +14,7 @@ void CudaPerformDotDiv(float*, float*, float*, size_t, cudaStream_t);
 void CudaPerformAdd(float* a, float* b, float* c, size_t, cudaStream_t);
 void CudaPerformCopy(float* a, float* b, size_t, cublasHandle_t);
 void CudaPerformSub(float* a, float* b, float* c, size_t, cublasHandle_t);
-void CudaPerformMatMult(float*, float*, float*, int, int, int, cublasHandle_t);
+void CudaPerformMatMult(float*, float*, float*, int, int, int, bool, bool, cublasHandle_t);
 void CudaPerformScale(float* in_data, float* res_data, size_t, float val, cublasHandle_t);
 void CudaPerformTranspose(float* a, float* c, int m, int n, cublasHandle_t);
 
@@ -18,6 +18,8 @@ struct PhysicalData {
 struct PhysicalOp {
   std::shared_ptr<ComputeFn> compute_fn;
   uint64_t device_id;
+  // always run on the latency lane of the device
+  bool latency_critical;
 };
 
 }  // end of namespace minerva
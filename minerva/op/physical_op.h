@@ -9,6 +9,12 @@
 
 namespace minerva {
 
+// Element-wise ops slice all of their inputs together with the outputs
+inline bool PartitionElementwise(size_t num_inputs, std::vector<bool>* split) {
+  split->assign(num_inputs, true);
+  return true;
+}
+
 // Data generate functions
 
 class ArrayLoaderOp : public PhyDataGenFnWithClosure<ArrayLoaderClosure> {
@@ -18,6 +24,16 @@ class ArrayLoaderOp : public PhyDataGenFnWithClosure<ArrayLoaderClosure> {
   }
 };
 
+class MappedLoaderOp : public PhyDataGenFnWithClosure<ArrayLoaderClosure> {
+ public:
+  std::string Name() const {
+    return ":mapped file";
+  }
+  std::shared_ptr<float> SharedOutput() const override {
+    return closure.data;
+  }
+};
+
 class RandnOp : public PhyDataGenFnWithClosure<RandnClosure> {
  public:
   std::string Name() const {
@@ -39,6 +55,9 @@ class FillOp : public PhyDataGenFnWithClosure<FillClosure> {
     ss << ":const=" << closure.val;
     return ss.str();
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 // Compute functions
@@ -54,6 +73,15 @@ class MatMultOp : public ComputeFnWithClosure<MatMultClosure> {
   std::string Name() const {
     return "*";
   }
+  // Columns of the result only depend on the same columns of the right
+  // operand, which are only contiguous if it is not transposed
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    *split = {false, true};
+    return inputs.size() == 2 && !closure.trans_right;
+  }
+  uint64_t EstimateFlops(const std::vector<Scale>& inputs, const std::vector<Scale>& outputs) const override {
+    return 2ull * outputs[0].Prod() * (inputs[0].Prod() / outputs[0][0]);
+  }
 };
 
 class TransOp : public ComputeFnWithClosure<TransposeClosure> {
@@ -88,6 +116,10 @@ class ReshapeOp : public ComputeFnWithClosure<ReshapeClosure> {
   std::string Name() const {
     return "reshape";
   }
+  bool IsView(const Scale&, const Scale&, size_t* offset) const override {
+    *offset = 0;
+    return true;
+  }
 };
 
 class ElewiseOp : public ComputeFnWithClosure<ElewiseClosure> {
@@ -100,6 +132,9 @@ class ElewiseOp : public ComputeFnWithClosure<ElewiseClosure> {
     };
     return "NA";
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class ArithmeticOp : public ComputeFnWithClosure<ArithmeticClosure> {
@@ -113,6 +148,9 @@ class ArithmeticOp : public ComputeFnWithClosure<ArithmeticClosure> {
     };
     return "NA";
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class ArithmeticConstOp : public ComputeFnWithClosure<ArithmeticConstClosure> {
@@ -133,6 +171,9 @@ class ArithmeticConstOp : public ComputeFnWithClosure<ArithmeticConstClosure> {
     }
     return ss.str();
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class NormArithmeticOp : public ComputeFnWithClosure<NormArithmeticClosure> {
@@ -163,6 +204,9 @@ class SigmoidForwardOp : public ComputeFnWithClosure<SigmoidForwardClosure> {
   std::string Name() const {
     return "sigmoid forward";
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class SigmoidBackwardOp : public ComputeFnWithClosure<SigmoidBackwardClosure> {
@@ -177,6 +221,9 @@ class ReluForwardOp : public ComputeFnWithClosure<ReluForwardClosure> {
   std::string Name() const {
     return "relu forward";
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class ReluBackwardOp : public ComputeFnWithClosure<ReluBackwardClosure> {
@@ -191,6 +238,9 @@ class TanhForwardOp : public ComputeFnWithClosure<TanhForwardClosure> {
   std::string Name() const {
     return "tanh forward";
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class TanhBackwardOp : public ComputeFnWithClosure<TanhBackwardClosure> {
@@ -209,6 +259,10 @@ class ConvForwardOp : public ComputeFnWithClosure<ConvForwardClosure> {
     ss << " conv ff";
     return ss.str();
   }
+  // Each output element is a dot product over a filter window of all input channels
+  uint64_t EstimateFlops(const std::vector<Scale>& inputs, const std::vector<Scale>& outputs) const override {
+    return 2ull * outputs[0].Prod() * inputs[1][0] * inputs[1][1] * inputs[1][2];
+  }
 };
 
 class ConvBackwardDataOp : public ComputeFnWithClosure<ConvBackwardDataClosure> {
@@ -251,6 +305,12 @@ class SoftmaxForwardOp : public ComputeFnWithClosure<SoftmaxForwardClosure> {
     }
     return "unknown softmax ff";
   }
+  // Instances are normalized along the first dimension, which is the one
+  // partitioned if there is no other
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return closure.algorithm == SoftmaxAlgorithm::kInstance && inputs.size() == 1 &&
+      2 <= inputs[0].NumDims() && PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class SoftmaxBackwardOp : public ComputeFnWithClosure<SoftmaxBackwardClosure> {
@@ -279,6 +339,9 @@ class ActivationForwardOp : public ComputeFnWithClosure<ActivationForwardClosure
     }
     return "unknown activation ff";
   }
+  bool Partitionable(const std::vector<Scale>& inputs, std::vector<bool>* split) const override {
+    return PartitionElementwise(inputs.size(), split);
+  }
 };
 
 class ActivationBackwardOp : public ComputeFnWithClosure<ActivationBackwardClosure> {
@@ -358,6 +421,15 @@ class SliceOp : public ComputeFnWithClosure<SliceClosure> {
   std::string Name() const {
     return "Slice";
   }
+  // Slices along the last dimension are contiguous in column major order
+  bool IsView(const Scale& input, const Scale&, size_t* offset) const override {
+    int last = input.NumDims() - 1;
+    if (closure.slice_dim != last) {
+      return false;
+    }
+    *offset = static_cast<size_t>(closure.st_off) * (input.Prod() / input[last]);
+    return true;
+  }
 };
 
 class IndexOp : public ComputeFnWithClosure<IndexClosure> {
@@ -365,6 +437,10 @@ class IndexOp : public ComputeFnWithClosure<IndexClosure> {
   std::string Name() const {
     return "Index";
   }
+  bool IsView(const Scale&, const Scale& output, size_t* offset) const override {
+    *offset = static_cast<size_t>(closure.idx) * output.Prod();
+    return true;
+  }
 };
 
 class SelectOp : public ComputeFnWithClosure<SelectClosure> {
@@ -374,5 +450,14 @@ class SelectOp : public ComputeFnWithClosure<SelectClosure> {
   }
 };
 
+// Copies its input to host memory for readers outside the engine. The output
+// is a placeholder keeping the op alive.
+class CopyToHostOp : public ComputeFnWithClosure<CopyToHostClosure> {
+ public:
+  std::string Name() const {
+    return "copy to host";
+  }
+};
+
 }  // namespace minerva
 
@@ -0,0 +1,269 @@
+#include "profiler/scheduler_telemetry.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+
+namespace minerva {
+
+void LatencyHistogram::Add(uint64_t us) {
+  int bucket = 0;
+  while (bucket < kNumBuckets - 1 && (1ull << bucket) <= us) {
+    ++bucket;
+  }
+  ++buckets[bucket];
+  ++count;
+  total_us += us;
+  max_us = max(max_us, us);
+}
+
+uint64_t LatencyHistogram::Percentile(double q) const {
+  uint64_t target = static_cast<uint64_t>(q * count);
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets[i];
+    if (target < seen) {
+      return min(1ull << i, static_cast<unsigned long long>(max_us));
+    }
+  }
+  return max_us;
+}
+
+size_t constexpr SchedulerTelemetry::kTraceCapacity;
+size_t constexpr SchedulerTelemetry::kMaxBufferedEvents;
+
+SchedulerTelemetry::SchedulerTelemetry() : enabled_(false), epoch_(chrono::steady_clock::now()) {
+  static atomic<uint64_t> num_instances{0};
+  serial_ = ++num_instances;
+}
+
+void SchedulerTelemetry::SetEnabled(bool enabled) {
+  enabled_.store(enabled);
+}
+
+LatencyHistogram SchedulerTelemetry::GetHistogram(Interval i) {
+  lock_guard<mutex> l(m_);
+  Merge();
+  return histograms_[static_cast<size_t>(i)];
+}
+
+map<uint64_t, DeviceUtilization> SchedulerTelemetry::GetDeviceUtilization() {
+  lock_guard<mutex> l(m_);
+  Merge();
+  return devices_;
+}
+
+int SchedulerTelemetry::GetMaxDispatcherQueueDepth() {
+  lock_guard<mutex> l(m_);
+  Merge();
+  return max_dispatcher_queue_depth_;
+}
+
+vector<NodeTimeline> SchedulerTelemetry::GetTrace() {
+  lock_guard<mutex> l(m_);
+  Merge();
+  return vector<NodeTimeline>(trace_.begin(), trace_.end());
+}
+
+double SchedulerTelemetry::ElapsedMicrosecond() {
+  lock_guard<mutex> l(m_);
+  return Now() / 1e3;
+}
+
+string SchedulerTelemetry::ToString() {
+  static char const* interval_names[] = {
+    "wait for inputs", "dispatcher queue", "device queue", "execution", "resident"
+  };
+  lock_guard<mutex> l(m_);
+  Merge();
+  ostringstream ss;
+  ss << setw(18) << "interval (us)" << setw(10) << "count" << setw(12) << "mean"
+    << setw(12) << "p50" << setw(12) << "p99" << setw(12) << "max" << endl;
+  for (size_t i = 0; i < histograms_.size(); ++i) {
+    auto& h = histograms_[i];
+    ss << setw(18) << interval_names[i] << setw(10) << h.count
+      << setw(12) << (h.count ? h.total_us / h.count : 0) << setw(12) << h.Percentile(.5)
+      << setw(12) << h.Percentile(.99) << setw(12) << h.max_us << endl;
+  }
+  ss << "max dispatcher queue depth " << max_dispatcher_queue_depth_ << endl;
+  double elapsed = max<double>(Now() / 1e3, 1);
+  for (auto& d : devices_) {
+    ss << "device #" << d.first << ": " << d.second.num_tasks << " tasks, busy "
+      << d.second.busy_us << "us, " << fixed << setprecision(2) << d.second.busy_us / elapsed
+      << " busy threads on average, max queue depth " << d.second.max_queue_depth << endl;
+  }
+  return ss.str();
+}
+
+void SchedulerTelemetry::Reset() {
+  lock_guard<mutex> l(m_);
+  lock_guard<mutex> buffers_lock(buffers_mutex_);
+  vector<unique_lock<mutex>> locks;
+  for (auto& b : buffers_) {
+    locks.emplace_back(b->m);
+    b->events.clear();
+  }
+  epoch_ = chrono::steady_clock::now();
+  live_.clear();
+  trace_.clear();
+  histograms_ = decltype(histograms_)();
+  devices_.clear();
+  dispatcher_queue_depth_ = max_dispatcher_queue_depth_ = 0;
+}
+
+int64_t SchedulerTelemetry::Now() const {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch_).count();
+}
+
+SchedulerTelemetry::Buffer& SchedulerTelemetry::LocalBuffer() {
+  // By the serial of the instance
+  static thread_local unordered_map<uint64_t, Buffer*> buffers;
+  auto& buffer = buffers[serial_];
+  if (!buffer) {
+    // Owned by the instance, since events may be read after the thread exits
+    lock_guard<mutex> l(buffers_mutex_);
+    buffers_.emplace_back(new Buffer());
+    buffer = buffers_.back().get();
+  }
+  return *buffer;
+}
+
+void SchedulerTelemetry::Append(Kind kind, uint64_t node_id, uint64_t device_id, bool is_op, double busy_us) {
+  auto& buffer = LocalBuffer();
+  bool full;
+  {
+    lock_guard<mutex> l(buffer.m);
+    buffer.events.push_back(RawEvent{Now(), node_id, device_id, busy_us, kind, is_op});
+    full = kMaxBufferedEvents <= buffer.events.size();
+  }
+  if (full) {
+    lock_guard<mutex> l(m_);
+    Merge();
+  }
+}
+
+void SchedulerTelemetry::DoNodeCreated(uint64_t node_id, bool is_op, uint64_t device_id) {
+  Append(Kind::kCreated, node_id, device_id, is_op);
+}
+
+void SchedulerTelemetry::DoRecord(uint64_t node_id, Event e) {
+  static Kind const kinds[] = {Kind::kReady, Kind::kDispatched, Kind::kFinished, Kind::kFreed, Kind::kCancelled};
+  Append(kinds[static_cast<int>(e)], node_id);
+}
+
+void SchedulerTelemetry::DoTaskStarted(uint64_t device_id, uint64_t node_id) {
+  Append(Kind::kStarted, node_id, device_id);
+}
+
+void SchedulerTelemetry::DoTaskFinished(uint64_t device_id, uint64_t node_id, double busy_us) {
+  Append(Kind::kTaskFinished, node_id, device_id, false, busy_us);
+}
+
+void SchedulerTelemetry::Merge() {
+  vector<RawEvent> events;
+  {
+    // Timestamps are taken with the buffer locked, so events recorded after
+    // these locks are released are newer than all events taken here
+    lock_guard<mutex> buffers_lock(buffers_mutex_);
+    vector<unique_lock<mutex>> locks;
+    for (auto& b : buffers_) {
+      locks.emplace_back(b->m);
+    }
+    for (auto& b : buffers_) {
+      events.insert(events.end(), b->events.begin(), b->events.end());
+      b->events.clear();
+    }
+  }
+  sort(events.begin(), events.end(), [](const RawEvent& a, const RawEvent& b) {
+    return a.ns != b.ns ? a.ns < b.ns : a.kind < b.kind;
+  });
+  for (auto& e : events) {
+    Replay(e);
+  }
+}
+
+void SchedulerTelemetry::Replay(const RawEvent& e) {
+  int64_t now = e.ns / 1000;
+  if (e.kind == Kind::kCreated) {
+    live_[e.node_id] = NodeTimeline{e.node_id, e.device_id, e.is_op, now, -1, -1, -1, -1, -1};
+    return;
+  }
+  if (e.kind == Kind::kTaskFinished) {
+    auto& d = devices_[e.device_id];
+    ++d.num_tasks;
+    d.busy_us += e.busy_us;
+  }
+  auto it = live_.find(e.node_id);
+  if (it == live_.end()) {
+    return;
+  }
+  auto& t = it->second;
+  switch (e.kind) {
+    case Kind::kReady:
+      t.ready_us = now;
+      max_dispatcher_queue_depth_ = max(max_dispatcher_queue_depth_, ++dispatcher_queue_depth_);
+      break;
+    case Kind::kDispatched: {
+      t.dispatched_us = now;
+      if (0 <= t.ready_us) {
+        --dispatcher_queue_depth_;
+      }
+      auto& d = devices_[t.device_id];
+      d.max_queue_depth = max(d.max_queue_depth, ++d.queue_depth);
+      break;
+    }
+    case Kind::kStarted:
+      if (t.is_op && 0 <= t.dispatched_us) {
+        t.started_us = now;
+        --devices_[e.device_id].queue_depth;
+      }
+      break;
+    case Kind::kFinished:
+      t.finished_us = now;
+      break;
+    case Kind::kTaskFinished:
+      if (t.is_op && 0 <= t.started_us) {
+        t.finished_us = now;
+        Retire(it);
+      }
+      break;
+    case Kind::kFreed:
+      t.freed_us = now;
+      Retire(it);
+      break;
+    case Kind::kCancelled:
+      if (0 <= t.ready_us) {
+        --dispatcher_queue_depth_;
+      }
+      live_.erase(it);
+      break;
+    default:
+      break;
+  }
+}
+
+void SchedulerTelemetry::Retire(unordered_map<uint64_t, NodeTimeline>::iterator it) {
+  auto& t = it->second;
+  auto add = [this](Interval i, int64_t from, int64_t to) {
+    if (0 <= from && from <= to) {
+      histograms_[static_cast<size_t>(i)].Add(to - from);
+    }
+  };
+  if (t.is_op) {
+    add(Interval::kWaitForInputs, t.created_us, t.ready_us);
+    add(Interval::kDispatcherQueue, t.ready_us, t.dispatched_us);
+    add(Interval::kDeviceQueue, t.dispatched_us, t.started_us);
+    add(Interval::kExecution, t.started_us, t.finished_us);
+  } else {
+    add(Interval::kResident, t.finished_us, t.freed_us);
+  }
+  trace_.push_back(t);
+  if (kTraceCapacity < trace_.size()) {
+    trace_.pop_front();
+  }
+  live_.erase(it);
+}
+
+}  // namespace minerva
+
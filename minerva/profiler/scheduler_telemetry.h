@@ -0,0 +1,174 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/common.h"
+
+namespace minerva {
+
+// Timestamps of a node in microseconds since the last reset, -1 if not seen.
+// Op nodes go through created, ready, dispatched, started and finished. Data
+// nodes go through created, finished and freed.
+struct NodeTimeline {
+  uint64_t node_id;
+  uint64_t device_id;
+  bool is_op;
+  int64_t created_us;
+  int64_t ready_us;
+  int64_t dispatched_us;
+  int64_t started_us;
+  int64_t finished_us;
+  int64_t freed_us;
+};
+
+// Histogram of durations with power of two buckets
+struct LatencyHistogram {
+  static int constexpr kNumBuckets = 32;
+  uint64_t count = 0;
+  uint64_t total_us = 0;
+  uint64_t max_us = 0;
+  // Bucket `i` counts durations in [2^(i-1), 2^i) microseconds
+  std::array<uint64_t, kNumBuckets> buckets{};
+  void Add(uint64_t);
+  // Upper bound of the bucket holding the given quantile
+  uint64_t Percentile(double) const;
+};
+
+struct DeviceUtilization {
+  uint64_t num_tasks = 0;
+  uint64_t busy_us = 0;
+  // Tasks pushed to the device but not yet started
+  int queue_depth = 0;
+  int max_queue_depth = 0;
+};
+
+// Hooks append events to a buffer of the calling thread, so recording threads
+// only take their own lock. Reading the results replays the events of all
+// threads in time order. Node ids are those of the DAG nodes with the DAG
+// backend, and those of the ops and data with the simple backend.
+class SchedulerTelemetry {
+ public:
+  enum class Event {
+    kReady,
+    kDispatched,
+    kFinished,
+    kFreed,
+    // Op completed without being executed
+    kCancelled
+  };
+  enum class Interval {
+    // created -> ready
+    kWaitForInputs = 0,
+    // ready -> dispatched
+    kDispatcherQueue,
+    // dispatched -> started
+    kDeviceQueue,
+    // started -> finished
+    kExecution,
+    // finished -> freed, for data nodes
+    kResident,
+    kEnd
+  };
+  SchedulerTelemetry();
+  DISALLOW_COPY_AND_ASSIGN(SchedulerTelemetry);
+  ~SchedulerTelemetry() = default;
+  void SetEnabled(bool);
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  // Hooks of the backends and devices. They return immediately when disabled.
+  void OnNodeCreated(uint64_t node_id, bool is_op, uint64_t device_id) {
+    if (enabled()) {
+      DoNodeCreated(node_id, is_op, device_id);
+    }
+  }
+  void Record(uint64_t node_id, Event e) {
+    if (enabled()) {
+      DoRecord(node_id, e);
+    }
+  }
+  void OnTaskStarted(uint64_t device_id, uint64_t node_id) {
+    if (enabled()) {
+      DoTaskStarted(device_id, node_id);
+    }
+  }
+  void OnTaskFinished(uint64_t device_id, uint64_t node_id, double busy_us) {
+    if (enabled()) {
+      DoTaskFinished(device_id, node_id, busy_us);
+    }
+  }
+  // Results
+  LatencyHistogram GetHistogram(Interval);
+  std::map<uint64_t, DeviceUtilization> GetDeviceUtilization();
+  int GetMaxDispatcherQueueDepth();
+  // Timelines of the most recently retired nodes, oldest first
+  std::vector<NodeTimeline> GetTrace();
+  double ElapsedMicrosecond();
+  std::string ToString();
+  void Reset();
+
+ private:
+  static size_t constexpr kTraceCapacity = 1 << 16;
+  // Events buffered by a thread before it replays them all
+  static size_t constexpr kMaxBufferedEvents = 1 << 12;
+  // In the order of the events of a node, which breaks ties of timestamps
+  enum class Kind : uint8_t {
+    kCreated,
+    kReady,
+    kDispatched,
+    kStarted,
+    kFinished,
+    kTaskFinished,
+    kFreed,
+    kCancelled
+  };
+  struct RawEvent {
+    int64_t ns;
+    uint64_t node_id;
+    uint64_t device_id;
+    double busy_us;
+    Kind kind;
+    bool is_op;
+  };
+  struct Buffer {
+    std::mutex m;
+    std::vector<RawEvent> events;
+  };
+  // Called with the buffer of the thread or all buffers locked
+  int64_t Now() const;
+  Buffer& LocalBuffer();
+  void Append(Kind, uint64_t node_id, uint64_t device_id = 0, bool is_op = false, double busy_us = 0);
+  void DoNodeCreated(uint64_t, bool, uint64_t);
+  void DoRecord(uint64_t, Event);
+  void DoTaskStarted(uint64_t, uint64_t);
+  void DoTaskFinished(uint64_t, uint64_t, double);
+  // The following are called with `m_` held
+  void Merge();
+  void Replay(const RawEvent&);
+  void Retire(std::unordered_map<uint64_t, NodeTimeline>::iterator);
+  std::atomic<bool> enabled_;
+  // Distinguishes the buffers of instances living at the same address
+  uint64_t serial_;
+  std::mutex buffers_mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  // Guards the replayed state
+  std::mutex m_;
+  std::chrono::steady_clock::time_point epoch_;
+  std::unordered_map<uint64_t, NodeTimeline> live_;
+  std::deque<NodeTimeline> trace_;
+  std::array<LatencyHistogram, static_cast<size_t>(Interval::kEnd)> histograms_;
+  std::map<uint64_t, DeviceUtilization> devices_;
+  int dispatcher_queue_depth_ = 0;
+  int max_dispatcher_queue_depth_ = 0;
+};
+
+}  // namespace minerva
+
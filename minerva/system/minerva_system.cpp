@@ -13,6 +13,7 @@
 
 DEFINE_bool(use_dag, true, "Use dag engine");
 DEFINE_bool(no_init_glog, false, "Skip initializing Google Logging");
+DEFINE_bool(telemetry, false, "Collect scheduler telemetry from the start");
 
 using namespace std;
 
@@ -44,6 +45,7 @@ MinervaSystem::~MinervaSystem() {
   delete backend_;
   delete device_manager_;
   delete profiler_;
+  delete telemetry_;
   delete physical_dag_;
   //google::ShutdownGoogleLogging(); //XXX comment out since we switch to dmlc/logging
 }
@@ -52,6 +54,14 @@ pair<Device::MemType, float*> MinervaSystem::GetPtr(uint64_t device_id, uint64_t
   return device_manager_->GetDevice(device_id)->GetPtr(data_id);
 }
 
+void MinervaSystem::ReleasePtr(uint64_t device_id, uint64_t data_id) {
+  device_manager_->GetDevice(device_id)->ReleasePtr(data_id);
+}
+
+shared_ptr<const float> MinervaSystem::BorrowHostPtr(uint64_t device_id, uint64_t data_id) {
+  return device_manager_->GetDevice(device_id)->BorrowHostPtr(data_id);
+}
+
 uint64_t MinervaSystem::GenerateDataId() {
   return data_id_counter_++;
 }
@@ -59,18 +69,60 @@ uint64_t MinervaSystem::GenerateDataId() {
 uint64_t MinervaSystem::CreateCpuDevice() {
   return MinervaSystem::Instance().device_manager().CreateCpuDevice();
 }
+vector<uint64_t> MinervaSystem::CreateCpuDevicesPerNumaNode() {
+  return MinervaSystem::Instance().device_manager().CreateCpuDevicesPerNumaNode();
+}
 uint64_t MinervaSystem::CreateGpuDevice(int id) {
   return MinervaSystem::Instance().device_manager().CreateGpuDevice(id);
 }
 void MinervaSystem::SetDevice(uint64_t id) {
   current_device_id_ = id;
 }
+void MinervaSystem::SetLatencyCritical(bool c) {
+  latency_critical_ = c;
+}
+void MinervaSystem::SetRematerialize(bool r) {
+  rematerialize_ = r;
+}
+RematStats MinervaSystem::GetRematStats() {
+  auto dag_scheduler = dynamic_cast<DagScheduler*>(backend_);
+  return dag_scheduler ? dag_scheduler->GetRematStats() : RematStats();
+}
+void MinervaSystem::ResetRematStats() {
+  auto dag_scheduler = dynamic_cast<DagScheduler*>(backend_);
+  if (dag_scheduler) {
+    dag_scheduler->ResetRematStats();
+  }
+}
+vector<MemoryStats> MinervaSystem::GetMemoryStats() {
+  vector<MemoryStats> ret;
+  for (auto d : device_manager_->GetDevices()) {
+    ret.push_back(d->GetMemoryStats());
+  }
+  sort(ret.begin(), ret.end(), [](const MemoryStats& a, const MemoryStats& b) {
+    return a.device_id < b.device_id;
+  });
+  return ret;
+}
+void MinervaSystem::ResetMemoryStats() {
+  for (auto d : device_manager_->GetDevices()) {
+    d->ResetMemoryStats();
+  }
+}
+size_t MinervaSystem::EvictReplicas() {
+  backend_->WaitForAll();
+  size_t bytes = 0;
+  for (auto d : device_manager_->GetDevices()) {
+    bytes += d->EvictReplicas();
+  }
+  return bytes;
+}
 void MinervaSystem::WaitForAll() {
   backend_->WaitForAll();
 }
 
 MinervaSystem::MinervaSystem(int* argc, char*** argv)
-  : data_id_counter_(0), current_device_id_(0) {
+  : data_id_counter_(0), current_device_id_(0), latency_critical_(false), rematerialize_(false) {
   gflags::ParseCommandLineFlags(argc, argv, true);
 #ifndef HAS_PS
   // glog is initialized in PS::main, and also here, so we will hit a
@@ -81,13 +133,15 @@ MinervaSystem::MinervaSystem(int* argc, char*** argv)
 #endif
   physical_dag_ = new PhysicalDag();
   profiler_ = new ExecutionProfiler();
+  telemetry_ = new SchedulerTelemetry();
+  telemetry_->SetEnabled(FLAGS_telemetry);
   device_manager_ = new DeviceManager();
   if (FLAGS_use_dag) {
     LOG(INFO) << "dag engine enabled";
-    backend_ = new DagScheduler(physical_dag_, device_manager_);
+    backend_ = new DagScheduler(physical_dag_, device_manager_, telemetry_);
   } else {
     LOG(INFO) << "dag engine disabled";
-    backend_ = new SimpleBackend(*device_manager_);
+    backend_ = new SimpleBackend(*device_manager_, telemetry_);
   }
 }
 
@@ -4,9 +4,11 @@
 #include "common/singleton.h"
 #include "dag/physical_dag.h"
 #include "backend/backend.h"
+#include "backend/dag/remat_stats.h"
 #include "device/device_manager.h"
 #include "device/device.h"
 #include "profiler/execution_profiler.h"
+#include "profiler/scheduler_telemetry.h"
 
 namespace minerva {
 
@@ -33,17 +35,39 @@ class MinervaSystem :
   ExecutionProfiler& profiler() {
     return *profiler_;
   }
+  SchedulerTelemetry& telemetry() {
+    return *telemetry_;
+  }
   DeviceManager& device_manager() {
     return *device_manager_;
   }
   std::pair<Device::MemType, float*> GetPtr(uint64_t, uint64_t);
+  void ReleasePtr(uint64_t, uint64_t);
+  // Read-only view of data held in host memory, or null for other devices
+  std::shared_ptr<const float> BorrowHostPtr(uint64_t, uint64_t);
   uint64_t GenerateDataId();
 
   // device
   uint64_t CreateCpuDevice();
+  std::vector<uint64_t> CreateCpuDevicesPerNumaNode();
   uint64_t CreateGpuDevice(int);
   void SetDevice(uint64_t );
   uint64_t current_device_id() const { return current_device_id_; }
+  // ops created while set skip the queue of heavy ops on their device
+  void SetLatencyCritical(bool);
+  bool latency_critical() const { return latency_critical_; }
+  // outputs of ops created while set may be dropped once consumed and
+  // recomputed when read again (dag engine only)
+  void SetRematerialize(bool);
+  bool rematerialize() const { return rematerialize_; }
+  RematStats GetRematStats();
+  void ResetRematStats();
+  // memory held by the buffers of each device
+  std::vector<MemoryStats> GetMemoryStats();
+  void ResetMemoryStats();
+  // waits for all ops, then drops the copies devices keep of data computed
+  // elsewhere and returns the bytes freed
+  size_t EvictReplicas();
   // system
   void WaitForAll();
 
@@ -52,9 +76,12 @@ class MinervaSystem :
   PhysicalDag* physical_dag_;
   Backend* backend_;
   ExecutionProfiler* profiler_;
+  SchedulerTelemetry* telemetry_;
   DeviceManager* device_manager_;
   std::atomic<uint64_t> data_id_counter_;
   uint64_t current_device_id_;
+  std::atomic<bool> latency_critical_;
+  bool rematerialize_;
 };
 
 }  // end of namespace minerva
@@ -1,27 +1,43 @@
 import sys
-from cython.operator cimport dereference as deref
+import threading
+import numbers
+from cython.operator cimport dereference as deref, preincrement as inc
 import cython
 from libc.stdlib cimport calloc, free
 from libc.string cimport strcpy
 from libcpp.vector cimport vector
+from libcpp.map cimport map
+from libcpp.string cimport string
+from libcpp.memory cimport shared_ptr
+from cpython.ref cimport Py_INCREF
 import numpy as np
 cimport numpy as np
 cimport minerva as m
 
+np.import_array()
+
 cdef vector[int] _list_to_vector(l):
     cdef vector[int] ret
     for i in l:
         ret.push_back(i)
     return ret
 
-cdef NArray _wrap_cpp_narray(m.NArray n):
-    ret = NArray()
-    ret._d.assign(n)
+cdef NArray _wrap_cpp_narray(m.NArray& n):
+    # Takes `n` over rather than copying it, which would update its node
+    cdef NArray ret = NArray()
+    m.MoveNArray(ret._d, &n)
     return ret
 
+cdef class _HostValue(object):
+    # Host value of an NArray, kept alive by the numpy arrays viewing it
+    cdef shared_ptr[float] _p
+
 def create_cpu_device():
     return m.CreateCpuDevice()
 
+def create_cpu_devices_per_numa_node():
+    return list(m.CreateCpuDevicesPerNumaNode())
+
 def create_gpu_device(i):
     return m.CreateGpuDevice(i)
 
@@ -29,11 +45,81 @@ def get_gpu_device_count():
     return m.GetGpuDeviceCount()
 
 def wait_for_all():
-    m.WaitForAll()
+    with nogil:
+        m.WaitForAll()
 
 def set_device(i):
     m.SetDevice(i)
 
+def get_device():
+    return m.GetDevice()
+
+def set_latency_critical(c):
+    m.SetLatencyCritical(c)
+
+def set_rematerialize(r):
+    m.SetRematerialize(r)
+
+def get_remat_stats():
+    cdef m.RematStats s = m.GetRematStats()
+    return {
+        'num_dropped': s.num_dropped,
+        'dropped_bytes': s.dropped_bytes,
+        'saved_bytes': s.saved_bytes,
+        'peak_saved_bytes': s.peak_saved_bytes,
+        'segment_flops': s.segment_flops,
+        'num_recomputed': s.num_recomputed,
+        'recomputed_flops': s.recomputed_flops,
+    }
+
+def reset_remat_stats():
+    m.ResetRematStats()
+
+def get_memory_stats():
+    cdef vector[m.MemoryStats] stats = m.GetMemoryStats()
+    return [{
+        'device_id': s.device_id,
+        'live_bytes': s.live_bytes,
+        'pooled_bytes': s.pooled_bytes,
+        'spilled_bytes': s.spilled_bytes,
+        'peak_live_bytes': s.peak_live_bytes,
+        'num_allocations': s.num_allocations,
+        'num_frees': s.num_frees,
+        'fragmentation': s.fragmentation,
+        'live_bytes_by_op': s.live_bytes_by_op,
+    } for s in stats]
+
+def reset_memory_stats():
+    m.ResetMemoryStats()
+
+def evict_replicas():
+    cdef size_t ret
+    ret = m.EvictReplicas()
+    return ret
+
+def set_telemetry_enabled(e):
+    m.SetTelemetryEnabled(e)
+
+def get_telemetry_report():
+    return m.GetTelemetryReport()
+
+def get_telemetry_trace():
+    cdef vector[m.NodeTimeline] trace = m.GetTelemetryTrace()
+    return [{
+        'node_id': t.node_id,
+        'device_id': t.device_id,
+        'is_op': t.is_op,
+        'created': t.created_us,
+        'ready': t.ready_us,
+        'dispatched': t.dispatched_us,
+        'started': t.started_us,
+        'finished': t.finished_us,
+        'freed': t.freed_us,
+    } for t in trace]
+
+def reset_telemetry():
+    m.ResetTelemetry()
+
 def initialize():
     cdef int argc = len(sys.argv)
     cdef char** argv = <char**>(calloc(argc, sizeof(char*)))
@@ -45,9 +131,68 @@ def initialize():
         free(argv[i])
     free(argv)
 
+def has_lmdb():
+    return m.HasLmdb()
+
+def has_zlib():
+    return m.HasZlib()
+
 def has_cuda():
     return m.has_cuda_
 
+class PlanScalar(float):
+    # A number given to ops while tracing, which runs of the plan replace: it
+    # is `coef` times parameter `param` of the run
+    def __new__(cls, value, param, coef=1.0):
+        self = float.__new__(cls, value)
+        self.param = param
+        self.coef = coef
+        return self
+
+    def __mul__(self, rhs):
+        if not isinstance(rhs, numbers.Real):
+            return NotImplemented
+        if isinstance(rhs, PlanScalar):
+            return float(self) * float(rhs)
+        return PlanScalar(float(self) * rhs, self.param, self.coef * rhs)
+
+    __rmul__ = __mul__
+
+    def __div__(self, rhs):
+        if not isinstance(rhs, numbers.Real):
+            return NotImplemented
+        if isinstance(rhs, PlanScalar):
+            return float(self) / float(rhs)
+        return PlanScalar(float(self) / rhs, self.param, self.coef / rhs)
+
+    __truediv__ = __div__
+
+    def __neg__(self):
+        return PlanScalar(-float(self), self.param, -self.coef)
+
+class TraceError(RuntimeError):
+    """ Raised by what a plan could not do again, e.g. loading arrays from the host, inside a trace """
+    pass
+
+class _TraceState(threading.local):
+    # Each thread traces on its own
+    trace = None
+
+_trace_state = _TraceState()
+
+cdef inline NArray _bind_scalar(NArray ret, x):
+    # Ops on numbers from `Trace.param` take them from each run of the plan
+    cdef Trace t = _trace_state.trace
+    if t is not None and isinstance(x, PlanScalar):
+        t._b.BindParam(deref(ret._d), x.param, x.coef)
+    return ret
+
+cdef inline _load():
+    # Runs of a plan would load the same values again
+    cdef Trace t = _trace_state.trace
+    if t is not None and not t._feeding:
+        raise TraceError('arrays can only be loaded from the host in a feed block while tracing')
+
 cdef class NArray(object):
     cdef m.NArray* _d
 
@@ -58,6 +203,7 @@ cdef class NArray(object):
         del self._d
 
     def __add__(self, rhs):
+        cdef m.NArray ret
         cdef NArray l
         cdef NArray r
         cdef float f
@@ -65,16 +211,17 @@ cdef class NArray(object):
             l = self
             if isinstance(rhs, NArray):
                 r = rhs
-                return _wrap_cpp_narray(
-                    m.NArrayAddNArray(deref(l._d), deref(r._d)))
+                ret = m.NArrayAddNArray(deref(l._d), deref(r._d))
+                return _wrap_cpp_narray(ret)
             else:
                 f = rhs
-                return _wrap_cpp_narray(
-                    (m.NArrayAddNum(deref(l._d), f)))
+                ret = m.NArrayAddNum(deref(l._d), f)
+                return _bind_scalar(_wrap_cpp_narray(ret), rhs)
         else:
             f = self
             r = rhs
-            return _wrap_cpp_narray(m.NumAddNArray(f, deref(r._d)))
+            ret = m.NumAddNArray(f, deref(r._d))
+            return _bind_scalar(_wrap_cpp_narray(ret), self)
 
     def __iadd__(self, rhs):
         cdef NArray r
@@ -85,9 +232,11 @@ cdef class NArray(object):
         else:
             f = rhs
             self._d.AddAssignNum(f)
+            _bind_scalar(self, rhs)
         return self
 
     def __sub__(self, rhs):
+        cdef m.NArray ret
         cdef NArray l
         cdef NArray r
         cdef float f
@@ -95,16 +244,17 @@ cdef class NArray(object):
             l = self
             if isinstance(rhs, NArray):
                 r = rhs
-                return _wrap_cpp_narray(
-                    m.NArraySubNArray(deref(l._d), deref(r._d)))
+                ret = m.NArraySubNArray(deref(l._d), deref(r._d))
+                return _wrap_cpp_narray(ret)
             else:
                 f = rhs
-                return _wrap_cpp_narray(
-                    m.NArraySubNum(deref(l._d), f))
+                ret = m.NArraySubNum(deref(l._d), f)
+                return _bind_scalar(_wrap_cpp_narray(ret), rhs)
         else:
             f = self
             r = rhs
-            return _wrap_cpp_narray(m.NumSubNArray(f, deref(r._d)))
+            ret = m.NumSubNArray(f, deref(r._d))
+            return _bind_scalar(_wrap_cpp_narray(ret), self)
 
     def __isub__(self, rhs):
         cdef NArray r
@@ -115,9 +265,11 @@ cdef class NArray(object):
         else:
             f = rhs
             self._d.SubAssignNum(f)
+            _bind_scalar(self, rhs)
         return self
 
     def __mul__(self, rhs):
+        cdef m.NArray ret
         cdef NArray l
         cdef NArray r
         cdef float f
@@ -125,16 +277,17 @@ cdef class NArray(object):
             l = self
             if isinstance(rhs, NArray):
                 r = rhs
-                return _wrap_cpp_narray(
-                    m.NArrayMulNArray(deref(l._d), deref(r._d)))
+                ret = m.NArrayMulNArray(deref(l._d), deref(r._d))
+                return _wrap_cpp_narray(ret)
             else:
                 f = rhs
-                return _wrap_cpp_narray(
-                    m.NArrayMulNum(deref(l._d), f))
+                ret = m.NArrayMulNum(deref(l._d), f)
+                return _bind_scalar(_wrap_cpp_narray(ret), rhs)
         else:
             f = self
             r = rhs
-            return _wrap_cpp_narray(m.NumMulNArray(f, deref(r._d)))
+            ret = m.NumMulNArray(f, deref(r._d))
+            return _bind_scalar(_wrap_cpp_narray(ret), self)
 
     def __imul__(self, rhs):
         cdef NArray r
@@ -145,9 +298,11 @@ cdef class NArray(object):
         else:
             f = rhs
             self._d.MulAssignNum(f)
+            _bind_scalar(self, rhs)
         return self
 
     def __div__(self, rhs):
+        cdef m.NArray ret
         cdef NArray l
         cdef NArray r
         cdef float f
@@ -155,16 +310,17 @@ cdef class NArray(object):
             l = self
             if isinstance(rhs, NArray):
                 r = rhs
-                return _wrap_cpp_narray(
-                    m.NArrayDivNArray(deref(l._d), deref(r._d)))
+                ret = m.NArrayDivNArray(deref(l._d), deref(r._d))
+                return _wrap_cpp_narray(ret)
             else:
                 f = rhs
-                return _wrap_cpp_narray(
-                    m.NArrayDivNum(deref(l._d), f))
+                ret = m.NArrayDivNum(deref(l._d), f)
+                return _bind_scalar(_wrap_cpp_narray(ret), rhs)
         else:
             f = self
             r = rhs
-            return _wrap_cpp_narray(m.NumDivNArray(f, deref(r._d)))
+            ret = m.NumDivNArray(f, deref(r._d))
+            return _bind_scalar(_wrap_cpp_narray(ret), self)
 
     def __idiv__(self, rhs):
         cdef NArray r
@@ -175,110 +331,134 @@ cdef class NArray(object):
         else:
             f = rhs
             self._d.DivAssignNum(f)
+            _bind_scalar(self, rhs)
         return self
 
     @staticmethod
     def mult(NArray lhs, NArray rhs):
-        return _wrap_cpp_narray(m.Mult(deref(lhs._d), deref(rhs._d)))
+        cdef m.NArray ret
+        ret = m.Mult(deref(lhs._d), deref(rhs._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def exp(NArray lhs):
-        return _wrap_cpp_narray(m.Exp(deref(lhs._d)))
+        cdef m.NArray ret
+        ret = m.Exp(deref(lhs._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def ln(NArray lhs):
-        return _wrap_cpp_narray(m.Ln(deref(lhs._d)))
+        cdef m.NArray ret
+        ret = m.Ln(deref(lhs._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def sigm(NArray lhs):
-        return _wrap_cpp_narray(m.SigmoidForward(deref(lhs._d)))
+        cdef m.NArray ret
+        ret = m.SigmoidForward(deref(lhs._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def sigm_back(NArray diff, NArray top, NArray bottom):
-        return _wrap_cpp_narray(
-                m.SigmoidBackward(
-                    deref(diff._d)
-                ,   deref(top._d)
-                ,   deref(bottom._d)))
+        cdef m.NArray ret
+        ret = m.SigmoidBackward(
+                deref(diff._d)
+            ,   deref(top._d)
+            ,   deref(bottom._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def relu(NArray lhs):
-        return _wrap_cpp_narray(m.ReluForward(deref(lhs._d)))
+        cdef m.NArray ret
+        ret = m.ReluForward(deref(lhs._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def relu_back(NArray diff, NArray top, NArray bottom):
-        return _wrap_cpp_narray(
-                m.ReluBackward(
-                    deref(diff._d)
-                ,   deref(top._d)
-                ,   deref(bottom._d)))
+        cdef m.NArray ret
+        ret = m.ReluBackward(
+                deref(diff._d)
+            ,   deref(top._d)
+            ,   deref(bottom._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def tanh(NArray lhs):
-        return _wrap_cpp_narray(m.TanhForward(deref(lhs._d)))
+        cdef m.NArray ret
+        ret = m.TanhForward(deref(lhs._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def tanh_back(NArray diff, NArray top, NArray bottom):
-        return _wrap_cpp_narray(
-                m.TanhBackward(
-                    deref(diff._d)
-                ,   deref(top._d)
-                ,   deref(bottom._d)))
+        cdef m.NArray ret
+        ret = m.TanhBackward(
+                deref(diff._d)
+            ,   deref(top._d)
+            ,   deref(bottom._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def conv_forward(NArray src, NArray filter, NArray bias, ConvInfo info):
-        return _wrap_cpp_narray(
-                m.ConvForward(
-                    deref(src._d)
-                ,   deref(filter._d)
-                ,   deref(bias._d)
-                ,   deref(info._d)));
+        cdef m.NArray ret
+        ret = m.ConvForward(
+                deref(src._d)
+            ,   deref(filter._d)
+            ,   deref(bias._d)
+            ,   deref(info._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def conv_backward_data(
             NArray diff, NArray bottom, NArray filter, ConvInfo info):
-        return _wrap_cpp_narray(
-                m.ConvBackwardData(
-                    deref(diff._d)
-                ,   deref(bottom._d)
-                ,   deref(filter._d)
-                ,   deref(info._d)));
+        cdef m.NArray ret
+        ret = m.ConvBackwardData(
+                deref(diff._d)
+            ,   deref(bottom._d)
+            ,   deref(filter._d)
+            ,   deref(info._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def conv_backward_filter(
             NArray diff, NArray bottom, NArray filter, ConvInfo info):
-        return _wrap_cpp_narray(
-                m.ConvBackwardFilter(
-                    deref(diff._d)
-                ,   deref(bottom._d)
-                ,   deref(filter._d)
-                ,   deref(info._d)));
+        cdef m.NArray ret
+        ret = m.ConvBackwardFilter(
+                deref(diff._d)
+            ,   deref(bottom._d)
+            ,   deref(filter._d)
+            ,   deref(info._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def conv_backward_bias(NArray diff):
-        return _wrap_cpp_narray(m.ConvBackwardBias(deref(diff._d)));
+        cdef m.NArray ret
+        ret = m.ConvBackwardBias(deref(diff._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def softmax_forward(NArray src, SoftmaxAlgorithmWrapper algo):
-        return _wrap_cpp_narray(
-                m.SoftmaxForward(
-                    deref(src._d)
-                ,   m.ToSoftmaxAlgorithm(algo._d)));
+        cdef m.NArray ret
+        ret = m.SoftmaxForward(
+                deref(src._d)
+            ,   m.ToSoftmaxAlgorithm(algo._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def softmax_backward(NArray diff, NArray top, SoftmaxAlgorithmWrapper algo):
-        return _wrap_cpp_narray(
-                m.SoftmaxBackward(
-                    deref(diff._d)
-                ,   deref(top._d)
-                ,   m.ToSoftmaxAlgorithm(algo._d)));
+        cdef m.NArray ret
+        ret = m.SoftmaxBackward(
+                deref(diff._d)
+            ,   deref(top._d)
+            ,   m.ToSoftmaxAlgorithm(algo._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def activation_forward(NArray src, ActivationAlgorithmWrapper algo):
-        return _wrap_cpp_narray(
-                m.ActivationForward(
-                    deref(src._d)
-                ,   m.ToActivationAlgorithm(algo._d)));
+        cdef m.NArray ret
+        ret = m.ActivationForward(
+                deref(src._d)
+            ,   m.ToActivationAlgorithm(algo._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def activation_backward(
@@ -286,19 +466,21 @@ cdef class NArray(object):
         ,   NArray top
         ,   NArray bottom
         ,   ActivationAlgorithmWrapper algo):
-        return _wrap_cpp_narray(
-                m.ActivationBackward(
-                    deref(diff._d)
-                ,   deref(top._d)
-                ,   deref(bottom._d)
-                ,   m.ToActivationAlgorithm(algo._d)));
+        cdef m.NArray ret
+        ret = m.ActivationBackward(
+                deref(diff._d)
+            ,   deref(top._d)
+            ,   deref(bottom._d)
+            ,   m.ToActivationAlgorithm(algo._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def pooling_forward(NArray src, PoolingInfo algo):
-        return _wrap_cpp_narray(
-                m.PoolingForward(
-                    deref(src._d)
-                ,   deref(algo._d)));
+        cdef m.NArray ret
+        ret = m.PoolingForward(
+                deref(src._d)
+            ,   deref(algo._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def pooling_backward(
@@ -306,22 +488,24 @@ cdef class NArray(object):
         ,   NArray top
         ,   NArray bottom
         ,   PoolingInfo algo):
-        return _wrap_cpp_narray(
-                m.PoolingBackward(
-                    deref(diff._d)
-                ,   deref(top._d)
-                ,   deref(bottom._d)
-                ,   deref(algo._d)));
+        cdef m.NArray ret
+        ret = m.PoolingBackward(
+                deref(diff._d)
+            ,   deref(top._d)
+            ,   deref(bottom._d)
+            ,   deref(algo._d))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def lrn_forward(NArray src, NArray scale, int local_size, float a, float b):
-        return _wrap_cpp_narray(
-                m.LRNForward(
-                    deref(src._d)
-                ,   deref(scale._d)
-                ,   local_size
-                ,   a
-                ,   b));
+        cdef m.NArray ret
+        ret = m.LRNForward(
+                deref(src._d)
+            ,   deref(scale._d)
+            ,   local_size
+            ,   a
+            ,   b)
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def lrn_backward(
@@ -332,53 +516,74 @@ cdef class NArray(object):
         ,   int local_size
         ,   float a
         ,   float b):
-        return _wrap_cpp_narray(
-                m.LRNBackward(
-                    deref(bottom_data._d)
-                ,   deref(top_data._d)
-                ,   deref(scale._d)
-                ,   deref(top_diff._d)
-                ,   local_size
-                ,   a
-                ,   b));
+        cdef m.NArray ret
+        ret = m.LRNBackward(
+                deref(bottom_data._d)
+            ,   deref(top_data._d)
+            ,   deref(scale._d)
+            ,   deref(top_diff._d)
+            ,   local_size
+            ,   a
+            ,   b)
+        return _wrap_cpp_narray(ret)
 
     def sum(self, rhs):
+        cdef m.NArray ret
         cdef int i
         cdef vector[int] v
         # TODO yutian: use try catch to do type conversion
         if isinstance(rhs, int):
             i = rhs
-            return _wrap_cpp_narray(self._d.Sum(i))
+            ret = self._d.Sum(i)
+            return _wrap_cpp_narray(ret)
         else:
             v = _list_to_vector(rhs)
-            return _wrap_cpp_narray(self._d.Sum(m.ToScale(&v)))
+            ret = self._d.Sum(m.ToScale(&v))
+            return _wrap_cpp_narray(ret)
 
     def max(self, rhs):
+        cdef m.NArray ret
         cdef int i
         cdef vector[int] v
         # TODO yutian: use try catch to do type conversion
         if isinstance(rhs, int):
             i = rhs
-            return _wrap_cpp_narray(self._d.Max(i))
+            ret = self._d.Max(i)
+            return _wrap_cpp_narray(ret)
         else:
             v = _list_to_vector(rhs)
-            return _wrap_cpp_narray(self._d.Max(m.ToScale(&v)))
+            ret = self._d.Max(m.ToScale(&v))
+            return _wrap_cpp_narray(ret)
 
     def max_index(self, int rhs):
-        return _wrap_cpp_narray(self._d.MaxIndex(rhs))
+        cdef m.NArray ret
+        ret = self._d.MaxIndex(rhs)
+        return _wrap_cpp_narray(ret)
 
     def count_zero(self):
-        return self._d.CountZero()
+        cdef int ret
+        # Compacted while holding the GIL, as ops that other threads build on
+        # the array compact it too
+        self._d.Compact()
+        with nogil:
+            ret = self._d.CountZero()
+        return ret
 
     def trans(self):
-        return _wrap_cpp_narray(self._d.Trans())
+        cdef m.NArray ret
+        ret = self._d.Trans()
+        return _wrap_cpp_narray(ret)
 
     def reshape(self, s):
+        cdef m.NArray ret
         cdef vector[int] v = _list_to_vector(s)
-        return _wrap_cpp_narray(self._d.Reshape(m.ToScale(&v)))
+        ret = self._d.Reshape(m.ToScale(&v))
+        return _wrap_cpp_narray(ret)
 
     def wait_for_eval(self):
-        self._d.Wait()
+        self._d.Compact()
+        with nogil:
+            self._d.Wait()
 
     property shape:
         def __get__(self):
@@ -387,60 +592,102 @@ cdef class NArray(object):
 
     @staticmethod
     def zeros(s):
+        cdef m.NArray ret
         cdef vector[int] v = _list_to_vector(s)
-        return _wrap_cpp_narray(m.NArray.Zeros(m.ToScale(&v)))
+        ret = m.NArray.Zeros(m.ToScale(&v))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def ones(s):
+        cdef m.NArray ret
         cdef vector[int] v = _list_to_vector(s)
-        return _wrap_cpp_narray(m.NArray.Ones(m.ToScale(&v)))
+        ret = m.NArray.Ones(m.ToScale(&v))
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def randn(s, float mean, float var):
+        cdef m.NArray ret
         cdef vector[int] v = _list_to_vector(s)
-        return _wrap_cpp_narray(m.NArray.Randn(m.ToScale(&v), mean, var))
+        ret = m.NArray.Randn(m.ToScale(&v), mean, var)
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def randb(s, float p):
+        cdef m.NArray ret
+        cdef vector[int] v = _list_to_vector(s)
+        ret = m.NArray.RandBernoulli(m.ToScale(&v), p)
+        return _wrap_cpp_narray(ret)
+
+    @staticmethod
+    def from_file(filename, s, size_t offset):
+        _load()
         cdef vector[int] v = _list_to_vector(s)
-        return _wrap_cpp_narray(m.NArray.RandBernoulli(m.ToScale(&v), p))
+        cdef m.NArray ret = m.NArray.FromFile(filename, m.ToScale(&v), offset)
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def concat(arrays, int dim):
+        cdef m.NArray ret
         cdef vector[m.NArray] v
         cdef NArray n
         for i in arrays:
             n = i
             v.push_back(deref(n._d))
-        return _wrap_cpp_narray(m.Concat(v, dim))
+        ret = m.Concat(v, dim)
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
     def slice(NArray n, int slice_dim, int st_off, int slice_count):
-        return _wrap_cpp_narray(
-                m.Slice(deref(n._d), slice_dim, st_off, slice_count))
+        cdef m.NArray ret
+        ret = m.Slice(deref(n._d), slice_dim, st_off, slice_count)
+        return _wrap_cpp_narray(ret)
 
     @staticmethod
-    @cython.boundscheck(False)
-    @cython.wraparound(False)
-    def from_numpy(np.ndarray n):
+    def from_numpy(n, borrow=False):
         s = list(np.shape(n))
-        n = n.astype(np.float32)
-        return NArray._from_numpy(n.flatten(), s)
+        src = np.ascontiguousarray(n, dtype=np.float32)
+        return NArray._from_numpy(src, s, borrow or src is not n)
 
     @staticmethod
-    @cython.boundscheck(False)
-    @cython.wraparound(False)
-    def _from_numpy(np.ndarray[np.float32_t, ndim=1, mode='c'] n, list s):
+    def _from_numpy(np.ndarray src, list s, bint borrow):
+        cdef m.NArray ret
         cdef vector[int] shape = _list_to_vector(reversed(s))
-        return _wrap_cpp_narray(m.FromNumpy(&n[0], m.ToScale(&shape)))
-
-    def to_numpy(self):
-        cdef int size = 1
+        cdef float* data = <float*>np.PyArray_DATA(src)
+        _load()
+        m.ReleaseBorrowedBuffers()
+        if not borrow:
+            ret = m.FromNumpy(data, m.ToScale(&shape))
+            return _wrap_cpp_narray(ret)
+        # released once the loader has read it, by a pending call or by the
+        # next `from_numpy` or `to_numpy`
+        Py_INCREF(src)
+        ret = m.FromBorrowedBuffer(data, m.ToScale(&shape), <void*>src)
+        return _wrap_cpp_narray(ret)
+
+    def to_numpy(self, np.ndarray out=None):
+        shape = tuple(reversed(self.shape))
+        if out is None:
+            out = np.empty(shape, dtype=np.float32)
+        elif out.dtype != np.float32 or not out.flags.c_contiguous or not out.flags.writeable or out.size != np.prod(shape):
+            raise ValueError('out must be a writeable C-contiguous float32 array of %d elements' % np.prod(shape))
+        cdef float* dst = <float*>np.PyArray_DATA(out)
+        self._d.Compact()
+        with nogil:
+            self._d.GetInto(dst)
+        m.ReleaseBorrowedBuffers()
+        return out
+
+    def borrow_numpy(self):
+        cdef np.npy_intp size = 1
         for i in self.shape:
             size *= i
-        cdef np.ndarray[np.float32_t, ndim=1, mode='c'] dest
-        dest = np.empty(size, dtype=np.float32, order='c')
-        m.ToNumpy(&dest[0], deref(self._d))
+        cdef _HostValue value = _HostValue()
+        self._d.Compact()
+        with nogil:
+            value._p = m.BorrowHost(deref(self._d))
+        cdef np.ndarray dest = np.PyArray_SimpleNewFromData(1, &size, np.NPY_FLOAT32, value._p.get())
+        np.set_array_base(dest, value)
+        dest.flags.writeable = False
         return dest.reshape(tuple(reversed(self.shape)))
 
 cdef class PoolingAlgorithmWrapper(object):
@@ -666,3 +913,223 @@ cdef class PoolingInfo(object):
         def __get__(self):
             return self._d.pad_width
 
+
+cdef class Graph(object):
+    # Builder open while the block runs
+    cdef m.GraphBuilder* _b
+
+    def __cinit__(self):
+        self._b = NULL
+
+    def __dealloc__(self):
+        del self._b
+
+    def __enter__(self):
+        self._b = new m.GraphBuilder()
+        return self
+
+    def __exit__(self, *args):
+        with nogil:
+            self._b.Close()
+        del self._b
+        self._b = NULL
+        return False
+
+    def flush(self):
+        with nogil:
+            m.GraphBuilder.Flush()
+
+def graph():
+    return Graph()
+
+cdef class Trace(object):
+    # Builder recording the block into a plan, until `plan` is called
+    cdef m.PlanBuilder* _b
+    cdef int _feeding
+    cdef list _params
+
+    def __cinit__(self):
+        self._b = NULL
+        self._params = []
+
+    def __dealloc__(self):
+        del self._b
+
+    def __enter__(self):
+        if _trace_state.trace is not None:
+            raise RuntimeError('traces do not nest')
+        if self._b != NULL or self._params:
+            raise RuntimeError('a trace is entered once')
+        self._b = new m.PlanBuilder()
+        _trace_state.trace = self
+        return self
+
+    def __exit__(self, *args):
+        if _trace_state.trace is self:
+            _trace_state.trace = None
+        # a builder without a plan drops what it recorded
+        del self._b
+        self._b = NULL
+        return False
+
+    cdef _check(self):
+        if _trace_state.trace is not self:
+            raise RuntimeError('the trace is not recording')
+
+    def input(self, NArray a):
+        self._check()
+        cdef m.NArray ret = self._b.Input(deref(a._d))
+        return _wrap_cpp_narray(ret)
+
+    def param(self, value):
+        self._check()
+        self._params.append(value)
+        return PlanScalar(value, len(self._params) - 1)
+
+    def feed(self):
+        self._check()
+        cdef _Feed ret = _Feed()
+        ret._trace = self
+        return ret
+
+    def plan(self, outputs):
+        self._check()
+        cdef vector[m.NArray] v
+        cdef NArray a
+        for a in outputs:
+            v.push_back(deref(a._d))
+        cdef Plan ret = Plan()
+        ret._p = self._b.Build(v)
+        ret.params = list(self._params)
+        _trace_state.trace = None
+        return ret
+
+def trace():
+    return Trace()
+
+cdef class _Feed(object):
+    # Block of a trace creating its ops right away, e.g. to load inputs
+    cdef Trace _trace
+
+    def __enter__(self):
+        if not self._trace._feeding:
+            self._trace._b.Pause()
+        self._trace._feeding += 1
+        return self
+
+    def __exit__(self, *args):
+        self._trace._feeding -= 1
+        if not self._trace._feeding:
+            self._trace._b.Resume()
+        return False
+
+cdef class Plan(object):
+    cdef m.Plan* _p
+    cdef readonly list params
+
+    def __cinit__(self):
+        self._p = NULL
+
+    def __dealloc__(self):
+        del self._p
+
+    property num_ops:
+        def __get__(self):
+            return self._p.NumOps()
+
+    def run(self, inputs, params=None):
+        cdef vector[m.NArray] v
+        cdef vector[float] p = self.params if params is None else params
+        cdef vector[m.NArray] results
+        cdef NArray a
+        cdef size_t i
+        for a in inputs:
+            a._d.Compact()
+            v.push_back(deref(a._d))
+        with nogil:
+            results = self._p.Run(v, p)
+        return [_wrap_cpp_narray(results[i]) for i in range(results.size())]
+
+cdef class CheckpointWriter(object):
+    cdef m.CheckpointWriter* _w
+
+    def __cinit__(self, filename, arrays):
+        cdef map[string, m.NArray] v
+        cdef NArray n
+        for name, a in arrays.items():
+            n = a
+            v[name] = deref(n._d)
+        self._w = new m.CheckpointWriter(filename, v)
+
+    def __dealloc__(self):
+        del self._w
+
+    def wait(self):
+        with nogil:
+            self._w.Wait()
+
+def load_checkpoint(filename, bint verify):
+    cdef string fn = filename
+    cdef map[string, m.NArray] arrays
+    _load()
+    with nogil:
+        arrays = m.LoadCheckpoint(fn, verify)
+    cdef map[string, m.NArray].iterator it = arrays.begin()
+    ret = {}
+    while it != arrays.end():
+        ret[deref(it).first] = _wrap_cpp_narray(deref(it).second)
+        inc(it)
+    return ret
+
+cdef class DataPipeline(object):
+    cdef m.DataPipeline* _p
+
+    def __cinit__(self):
+        self._p = NULL
+
+    def __dealloc__(self):
+        del self._p
+
+    @staticmethod
+    def from_raw_files(files, sample_shapes, batch_size, header_bytes, num_batches, num_workers, prefetch):
+        ret = DataPipeline()
+        ret._p = m.CreateRawFilePipeline(files, sample_shapes, batch_size, header_bytes, num_batches, num_workers, prefetch)
+        return ret
+
+    @staticmethod
+    def from_lmdb(source, batch_size, crop_size, random_crop, mirror, mean, num_workers, prefetch):
+        ret = DataPipeline()
+        ret._p = m.CreateLmdbPipeline(source, batch_size, crop_size, random_crop, mirror, mean, num_workers, prefetch)
+        return ret
+
+    @staticmethod
+    def from_shards(shards, batch_size, shuffle_size, crop_size, random_crop, mirror, mean, num_workers, prefetch):
+        ret = DataPipeline()
+        ret._p = m.CreateShardPipeline(shards, batch_size, shuffle_size, crop_size, random_crop, mirror, mean, num_workers, prefetch)
+        return ret
+
+    def next(self):
+        cdef vector[m.NArray] arrays
+        cdef bint more
+        cdef size_t i
+        _load()
+        with nogil:
+            more = self._p.Next(&arrays)
+        if not more:
+            return None
+        return [_wrap_cpp_narray(arrays[i]) for i in range(arrays.size())]
+
+cdef class RecordShardWriter(object):
+    cdef m.RecordShardWriter* _w
+
+    def __cinit__(self, filename, compress):
+        self._w = m.CreateRecordShardWriter(filename, compress)
+
+    def __dealloc__(self):
+        del self._w
+
+    def write(self, record):
+        self._w.Write(record)
+
+    def close(self):
+        self._w.Close()
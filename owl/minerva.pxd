@@ -1,23 +1,48 @@
 from libc.stdint cimport *
 from libcpp cimport bool
 from libcpp.vector cimport vector
+from libcpp.string cimport string
+from libcpp.map cimport map
+from libcpp.memory cimport shared_ptr
 
-cdef extern from './minerva_utils.h' namespace 'libowl':
+cdef extern from './minerva_utils.h' namespace 'libowl' nogil:
   uint64_t CreateCpuDevice() except +
+  vector[uint64_t] CreateCpuDevicesPerNumaNode() except +
   uint64_t CreateGpuDevice(int) except +
   int GetGpuDeviceCount() except +
   void WaitForAll() except +
   void SetDevice(uint64_t) except +
+  uint64_t GetDevice() except +
+  void SetLatencyCritical(bool) except +
+  void SetRematerialize(bool) except +
+  RematStats GetRematStats() except +
+  void ResetRematStats() except +
+  vector[MemoryStats] GetMemoryStats() except +
+  void ResetMemoryStats() except +
+  size_t EvictReplicas() except +
+  void SetTelemetryEnabled(bool) except +
+  string GetTelemetryReport() except +
+  vector[NodeTimeline] GetTelemetryTrace() except +
+  void ResetTelemetry() except +
   Scale ToScale(vector[int]*) except +
   vector[int] OfScale(const Scale&) except +
   NArray FromNumpy(const float*, const Scale&) except +
-  void ToNumpy(float*, const NArray&) except +
+  NArray FromBorrowedBuffer(const float*, const Scale&, void*) except +
+  void ReleaseBorrowedBuffers()
+  shared_ptr[float] BorrowHost(const NArray&) except +
+  void MoveNArray(NArray*, NArray*)
+  bool HasLmdb() except +
+  DataPipeline* CreateLmdbPipeline(const string&, int, int, bool, bool, const vector[float]&, size_t, size_t) except +
+  bool HasZlib() except +
+  RecordShardWriter* CreateRecordShardWriter(const string&, bool) except +
+  DataPipeline* CreateShardPipeline(const vector[string]&, int, size_t, int, bool, bool, const vector[float]&, size_t, size_t) except +
+  DataPipeline* CreateRawFilePipeline(const vector[string]&, const vector[vector[int]]&, int, size_t, int, size_t, size_t) except +
 
-cdef extern from '../minerva/minerva.h' namespace 'minerva::MinervaSystem':
+cdef extern from '../minerva/minerva.h' namespace 'minerva::MinervaSystem' nogil:
   void Initialize(int*, char***) except +
   int has_cuda_
 
-cdef extern from '../minerva/minerva.h' namespace 'minerva::Elewise':
+cdef extern from '../minerva/minerva.h' namespace 'minerva::Elewise' nogil:
   NArray Mult(const NArray&, const NArray&) except +
   NArray Exp(const NArray&) except +
   NArray Ln(const NArray&) except +
@@ -28,7 +53,7 @@ cdef extern from '../minerva/minerva.h' namespace 'minerva::Elewise':
   NArray TanhForward(const NArray&) except +
   NArray TanhBackward(const NArray&, const NArray&, const NArray&) except +
 
-cdef extern from '../minerva/minerva.h' namespace 'minerva::Convolution':
+cdef extern from '../minerva/minerva.h' namespace 'minerva::Convolution' nogil:
   NArray ConvForward(NArray, NArray, NArray, ConvInfo) except +
   NArray ConvBackwardData(NArray, NArray, NArray, ConvInfo) except +
   NArray ConvBackwardFilter(NArray, NArray, NArray, ConvInfo) except +
@@ -44,7 +69,7 @@ cdef extern from '../minerva/minerva.h' namespace 'minerva::Convolution':
   NArray LRNBackward(
       NArray, NArray, NArray, NArray, int, float, float) except +
 
-cdef extern from '../minerva/minerva.h' namespace 'minerva':
+cdef extern from '../minerva/minerva.h' namespace 'minerva' nogil:
   NArray NArrayAddNArray 'operator+'(const NArray&, const NArray&) except +
   NArray NArraySubNArray 'operator-'(const NArray&, const NArray&) except +
   NArray NArrayMulNArray 'operator*'(const NArray&, const NArray&) except +
@@ -63,17 +88,48 @@ cdef extern from '../minerva/minerva.h' namespace 'minerva':
   cppclass Scale:
     pass
 
+  cppclass RematStats:
+    uint64_t num_dropped
+    uint64_t dropped_bytes
+    uint64_t saved_bytes
+    uint64_t peak_saved_bytes
+    uint64_t segment_flops
+    uint64_t num_recomputed
+    uint64_t recomputed_flops
+
+  cppclass MemoryStats:
+    uint64_t device_id
+    size_t live_bytes
+    size_t pooled_bytes
+    size_t spilled_bytes
+    size_t peak_live_bytes
+    uint64_t num_allocations
+    uint64_t num_frees
+    double fragmentation
+    map[string, size_t] live_bytes_by_op
+
+  cppclass NodeTimeline:
+    uint64_t node_id
+    uint64_t device_id
+    bool is_op
+    int64_t created_us
+    int64_t ready_us
+    int64_t dispatched_us
+    int64_t started_us
+    int64_t finished_us
+    int64_t freed_us
+
   cppclass NArray:
     NArray() except +
-    NArray assign 'operator='(const NArray&) except +
-    NArray AddAssignNArray 'operator+='(const NArray&) except +
-    NArray SubAssignNArray 'operator-='(const NArray&) except +
-    NArray MulAssignNArray 'operator*='(const NArray&) except +
-    NArray DivAssignNArray 'operator/='(const NArray&) except +
-    NArray AddAssignNum 'operator+='(float) except +
-    NArray SubAssignNum 'operator-='(float) except +
-    NArray MulAssignNum 'operator*='(float) except +
-    NArray DivAssignNum 'operator/='(float) except +
+    NArray& assign 'operator='(const NArray&) except +
+    NArray& AddAssignNArray 'operator+='(const NArray&) except +
+    NArray& SubAssignNArray 'operator-='(const NArray&) except +
+    NArray& MulAssignNArray 'operator*='(const NArray&) except +
+    NArray& DivAssignNArray 'operator/='(const NArray&) except +
+    NArray& AddAssignNum 'operator+='(float) except +
+    NArray& SubAssignNum 'operator-='(float) except +
+    NArray& MulAssignNum 'operator*='(float) except +
+    NArray& DivAssignNum 'operator/='(float) except +
     NArray Sum(int) except +
     NArray Sum(const Scale&) except +
     NArray Max(int) except +
@@ -82,8 +138,10 @@ cdef extern from '../minerva/minerva.h' namespace 'minerva':
     int CountZero() except +
     NArray Trans() except +
     NArray Reshape(const Scale&) except +
+    void Compact() except +
     void Wait() except +
     Scale Size() except +
+    void GetInto(float*) except +
     @staticmethod
     NArray Zeros(const Scale&) except +
     @staticmethod
@@ -92,6 +150,38 @@ cdef extern from '../minerva/minerva.h' namespace 'minerva':
     NArray Randn(const Scale&, float, float) except +
     @staticmethod
     NArray RandBernoulli(const Scale&, float) except +
+    @staticmethod
+    NArray FromFile(const string&, const Scale&, size_t) except +
+
+  cppclass CheckpointWriter:
+    CheckpointWriter(const string&, const map[string, NArray]&) except +
+    void Wait() except +
+  map[string, NArray] LoadCheckpoint(const string&, bool) except +
+
+  cppclass GraphBuilder:
+    GraphBuilder() except +
+    void Close() except +
+    @staticmethod
+    void Flush() except +
+
+  cppclass Plan:
+    vector[NArray] Run(const vector[NArray]&, const vector[float]&) except +
+    size_t NumOps()
+
+  cppclass PlanBuilder:
+    PlanBuilder() except +
+    NArray Input(const NArray&) except +
+    void BindParam(const NArray&, size_t, float) except +
+    void Pause() except +
+    void Resume() except +
+    Plan* Build(const vector[NArray]&) except +
+
+  cppclass DataPipeline:
+    bool Next(vector[NArray]*) except +
+
+  cppclass RecordShardWriter:
+    void Write(const string&) except +
+    void Close() except +
 
   ctypedef enum PoolingAlgorithm 'minerva::PoolingInfo::Algorithm':
     kPoolingAlgorithmMax 'minerva::PoolingInfo::Algorithm::kMax'
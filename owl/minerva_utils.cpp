@@ -1,5 +1,8 @@
+#include <Python.h>
 #include "./minerva_utils.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <cstring>
 #include <iostream>
 
@@ -10,6 +13,11 @@ uint64_t CreateCpuDevice() {
   return ms.device_manager().CreateCpuDevice();
 }
 
+std::vector<uint64_t> CreateCpuDevicesPerNumaNode() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.device_manager().CreateCpuDevicesPerNumaNode();
+}
+
 uint64_t CreateGpuDevice(int id) {
   auto&& ms = minerva::MinervaSystem::Instance();
   return ms.device_manager().CreateGpuDevice(id);
@@ -22,6 +30,7 @@ int GetGpuDeviceCount() {
 
 void WaitForAll() {
   auto&& ms = minerva::MinervaSystem::Instance();
+  minerva::GraphBuilder::Flush();
   ms.backend().WaitForAll();
 }
 
@@ -30,6 +39,66 @@ void SetDevice(uint64_t id) {
   ms.SetDevice(id);
 }
 
+uint64_t GetDevice() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.current_device_id();
+}
+
+void SetLatencyCritical(bool c) {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  ms.SetLatencyCritical(c);
+}
+
+void SetRematerialize(bool r) {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  ms.SetRematerialize(r);
+}
+
+minerva::RematStats GetRematStats() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.GetRematStats();
+}
+
+void ResetRematStats() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  ms.ResetRematStats();
+}
+
+std::vector<minerva::MemoryStats> GetMemoryStats() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.GetMemoryStats();
+}
+
+void ResetMemoryStats() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  ms.ResetMemoryStats();
+}
+
+size_t EvictReplicas() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.EvictReplicas();
+}
+
+void SetTelemetryEnabled(bool e) {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  ms.telemetry().SetEnabled(e);
+}
+
+std::string GetTelemetryReport() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.telemetry().ToString();
+}
+
+std::vector<minerva::NodeTimeline> GetTelemetryTrace() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  return ms.telemetry().GetTrace();
+}
+
+void ResetTelemetry() {
+  auto&& ms = minerva::MinervaSystem::Instance();
+  ms.telemetry().Reset();
+}
+
 minerva::Scale ToScale(std::vector<int>* v) {
   minerva::Scale r(std::move(*v));
   return r;
@@ -52,10 +121,94 @@ minerva::NArray FromNumpy(float const* data, minerva::Scale const& scale) {
   return minerva::NArray::MakeNArray(scale, ptr);
 }
 
-void ToNumpy(float* dst, minerva::NArray const& n) {
-  auto size = n.Size().Prod();
-  auto ptr = n.Get();
-  memcpy(dst, ptr.get(), size * sizeof(float));
+namespace {
+
+std::mutex released_mutex;
+std::vector<void*> released_buffers;
+// Whether a pending call to `DrainReleasedBuffers` is queued
+std::atomic<bool> release_queued(false);
+
+int DrainReleasedBuffers(void*) {
+  // Cleared first, so that owners released from now on queue a new call
+  release_queued = false;
+  ReleaseBorrowedBuffers();
+  return 0;
+}
+
+}  // namespace
+
+void ReleaseBorrowedBuffers() {
+  std::vector<void*> owners;
+  {
+    std::lock_guard<std::mutex> lock(released_mutex);
+    owners.swap(released_buffers);
+  }
+  for (auto owner : owners) {
+    Py_DECREF(static_cast<PyObject*>(owner));
+  }
+}
+
+minerva::NArray FromBorrowedBuffer(float const* data, minerva::Scale const& scale, void* owner) {
+  std::shared_ptr<float> ptr(const_cast<float*>(data), [owner](float*) {
+    if (!Py_IsInitialized()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(released_mutex);
+      released_buffers.push_back(owner);
+    }
+    if (!release_queued.exchange(true) && Py_AddPendingCall(DrainReleasedBuffers, nullptr) != 0) {
+      // The queue is full. The next owner released queues the call again, and
+      // the next `from_numpy` or `to_numpy` drains the list meanwhile.
+      release_queued = false;
+    }
+  });
+  return minerva::NArray::MakeNArray(scale, ptr);
+}
+
+std::shared_ptr<float> BorrowHost(minerva::NArray const& n) {
+  return std::const_pointer_cast<float>(n.Borrow());
+}
+
+void MoveNArray(minerva::NArray* dst, minerva::NArray* src) {
+  *dst = std::move(*src);
+}
+
+bool HasLmdb() {
+  return minerva::kHasLmdb;
+}
+
+minerva::DataPipeline* CreateLmdbPipeline(std::string const& source, int batch_size, int crop_size, bool random_crop, bool mirror, std::vector<float> const& mean, size_t num_workers, size_t prefetch) {
+  minerva::DatumTransform transform;
+  transform.crop_size = crop_size;
+  transform.random_crop = random_crop;
+  transform.mirror = mirror;
+  transform.mean = mean;
+  return new minerva::DataPipeline(minerva::CreateLmdbDatumReader(source, batch_size, transform), num_workers, prefetch);
+}
+
+bool HasZlib() {
+  return minerva::kHasZlib;
+}
+
+minerva::RecordShardWriter* CreateRecordShardWriter(std::string const& filename, bool compress) {
+  return new minerva::RecordShardWriter(filename, compress ? minerva::RecordCodec::kZlib : minerva::RecordCodec::kNone);
+}
+
+minerva::DataPipeline* CreateShardPipeline(std::vector<std::string> const& shards, int batch_size, size_t shuffle_size, int crop_size, bool random_crop, bool mirror, std::vector<float> const& mean, size_t num_workers, size_t prefetch) {
+  minerva::DatumTransform transform;
+  transform.crop_size = crop_size;
+  transform.random_crop = random_crop;
+  transform.mirror = mirror;
+  transform.mean = mean;
+  std::unique_ptr<minerva::BatchReader> reader(new minerva::ShardDatumReader(shards, batch_size, shuffle_size, transform));
+  return new minerva::DataPipeline(std::move(reader), num_workers, prefetch);
+}
+
+minerva::DataPipeline* CreateRawFilePipeline(std::vector<std::string> const& files, std::vector<std::vector<int>> const& sample_sizes, int batch_size, size_t header_bytes, int num_batches, size_t num_workers, size_t prefetch) {
+  std::vector<minerva::Scale> sizes(sample_sizes.begin(), sample_sizes.end());
+  std::unique_ptr<minerva::BatchReader> reader(new minerva::RawFileReader(files, sizes, batch_size, header_bytes, num_batches));
+  return new minerva::DataPipeline(std::move(reader), num_workers, prefetch);
 }
 
 }  // namespace libowl
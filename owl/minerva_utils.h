@@ -1,15 +1,29 @@
 #pragma once
 #include "minerva.h"
 #include <vector>
+#include <string>
 #include <memory>
 
 namespace libowl {
 
 uint64_t CreateCpuDevice();
+std::vector<uint64_t> CreateCpuDevicesPerNumaNode();
 uint64_t CreateGpuDevice(int);
 int GetGpuDeviceCount();
 void WaitForAll();
 void SetDevice(uint64_t);
+uint64_t GetDevice();
+void SetLatencyCritical(bool);
+void SetRematerialize(bool);
+minerva::RematStats GetRematStats();
+void ResetRematStats();
+std::vector<minerva::MemoryStats> GetMemoryStats();
+void ResetMemoryStats();
+size_t EvictReplicas();
+void SetTelemetryEnabled(bool);
+std::string GetTelemetryReport();
+std::vector<minerva::NodeTimeline> GetTelemetryTrace();
+void ResetTelemetry();
 minerva::Scale ToScale(std::vector<int>*);
 std::vector<int> OfScale(minerva::Scale const&);
 
@@ -25,7 +39,25 @@ T ToEvilEnumClass(int a) {
 }
 
 minerva::NArray FromNumpy(float const*, minerva::Scale const&);
-void ToNumpy(float*, minerva::NArray const&);
+// Loads an array straight from a buffer owned by a Python object, without a
+// host copy. The buffer is freed on a worker that may run while the
+// interpreter holds the GIL, so the owner is released by a pending call on the
+// interpreter thread rather than by the worker.
+minerva::NArray FromBorrowedBuffer(float const*, minerva::Scale const&, void* owner);
+// Releases the owners of the borrowed buffers freed so far. Needs the GIL.
+void ReleaseBorrowedBuffers();
+// `NArray::Borrow` without const, which Cython cannot template on. The buffer
+// must not be written.
+std::shared_ptr<float> BorrowHost(minerva::NArray const&);
+// Hands the array of `src` over to `dst`, without the reference count updates
+// of a copy
+void MoveNArray(minerva::NArray* dst, minerva::NArray* src);
+bool HasLmdb();
+minerva::DataPipeline* CreateLmdbPipeline(std::string const&, int, int, bool, bool, std::vector<float> const&, size_t, size_t);
+bool HasZlib();
+minerva::RecordShardWriter* CreateRecordShardWriter(std::string const&, bool);
+minerva::DataPipeline* CreateShardPipeline(std::vector<std::string> const&, int, size_t, int, bool, bool, std::vector<float> const&, size_t, size_t);
+minerva::DataPipeline* CreateRawFilePipeline(std::vector<std::string> const&, std::vector<std::vector<int>> const&, int, size_t, int, size_t, size_t);
 
 }  // namespace libowl
 
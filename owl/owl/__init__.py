@@ -20,6 +20,7 @@ import numpy as np
 import libowl as _owl
 
 NArray = _owl.NArray
+TraceError = _owl.TraceError
 _owl.initialize()
 
 # def initialize():
@@ -38,16 +39,72 @@ def has_cuda():
     """
     return _owl.has_cuda()
 
+def has_lmdb():
+    """ Check if the native LMDB reader is built
+
+    :return: LMDB status
+    :rtype: bool
+    """
+    return _owl.has_lmdb()
+
+def has_zlib():
+    """ Check if record shards can be compressed with zlib
+
+    :return: zlib status
+    :rtype: bool
+    """
+    return _owl.has_zlib()
+
 def wait_for_all():
     """ Wait for all evaluation to complete
 
     .. note::
         The user thread (python) will be blocked until all previous operations are finished.
+        Like the other calls that block on Minerva (reading arrays, the data pipelines and
+        checkpoints), it lets other Python threads run meanwhile. Ops still hold the GIL, and
+        arrays are not thread-safe: an array must not be shared between threads.
 
     :return: None
     """
     _owl.wait_for_all()
 
+def graph():
+    """ Record the ops of a block and create them all in one call when the block is left
+
+    Inside ``with owl.graph():``, ops that the thread calls on arrays are only recorded, and
+    their results know their ``shape`` right away. The recorded ops are created together by a
+    single call to the scheduler when the outermost block is left, on ``flush`` or
+    :py:func:`wait_for_all`, or when the value of a result is read (e.g. ``to_numpy``), which
+    is best kept for after the block. Each op runs on the device that was current when it was
+    recorded. Results that are dropped before the ops are created are not computed.
+
+    :return: the recording context
+    """
+    return _owl.graph()
+
+def trace():
+    """ Record the ops of a block into a plan that creates them again on new inputs
+
+    Inside ``with owl.trace() as t:``, ops that the thread calls on arrays are only recorded,
+    with their devices and shapes. ``t.input(x)`` returns an array standing for an input of the
+    plan, whose value is that of ``x`` while recording, and numbers from ``t.param(v)`` stand
+    for parameters of the plan when given to ops. ``t.plan(outputs)`` ends the recording and
+    returns the plan. ``plan.run(inputs, params)`` creates all its ops in one call to the
+    scheduler, on new inputs in the order of the ``input`` calls, and returns the values of
+    ``outputs``. Inputs that ops read keep their shapes, and Python code in the block is not run
+    again. Ops may only read inputs and arrays recorded in the block: ``t.plan`` raises
+    ``RuntimeError`` if an op read, or an output is, another array, whose value runs would keep
+    from the recording.
+
+    Arrays recorded in the block can not be read (e.g. ``to_numpy`` or
+    :py:func:`wait_for_all`), which raises ``RuntimeError``. Loading arrays from the host (e.g.
+    ``from_numpy``) raises :py:class:`TraceError` outside of a ``with t.feed():`` block, whose
+    ops are created right away. A trace left without a plan drops what it recorded.
+
+    :return: the tracing context
+    """
+    return _owl.trace()
+
 def create_cpu_device():
     """ Create device for running on CPU cores
 
@@ -60,6 +117,17 @@ def create_cpu_device():
     """
     return _owl.create_cpu_device()
 
+def create_cpu_devices_per_numa_node():
+    """ Create one CPU device per NUMA node
+
+    Each device runs one thread per CPU of its node, pinned to those CPUs, and allocates
+    its memory on that node.
+
+    :return: Unique ids of the devices, ordered by node
+    :rtype: list of int
+    """
+    return _owl.create_cpu_devices_per_numa_node()
+
 def create_gpu_device(which):
     """ Create device for running on GPU card
 
@@ -91,6 +159,115 @@ def set_device(dev):
     """
     _owl.set_device(dev)
 
+def get_device():
+    """ Get the device computations currently run on
+
+    :return: the id of the device
+    :rtype: int
+    """
+    return _owl.get_device()
+
+def set_latency_critical(critical):
+    """ Mark subsequent operations as latency critical
+
+    Latency critical operations are executed on a lane of the device reserved for
+    small operations, so they are not queued behind heavy training work. When the
+    ``--latency_lane_threshold`` flag is set, small operations may also use an idle
+    lane thread while all other threads of the device are busy.
+
+    :param bool critical: whether the following operations are latency critical
+    """
+    _owl.set_latency_critical(critical)
+
+def set_rematerialize(remat):
+    """ Mark subsequent operations as a rematerialization segment
+
+    Outputs of operations in the segment are freed as soon as no queued operation reads them,
+    and recomputed from the arrays the segment started from when they are read again. Reads
+    from outside the segment (e.g. the backward pass) recompute only the outputs that were
+    dropped and keep them, so each op is recomputed at most once. Only effective with the dag
+    engine.
+
+    :param bool remat: whether the following operations form a rematerialization segment
+    """
+    _owl.set_rematerialize(remat)
+
+def get_remat_stats():
+    """ Get memory saved and computation spent by rematerialization
+
+    :return: bytes dropped and currently saved, FLOPs of segments and of recomputation
+    :rtype: dict
+    """
+    return _owl.get_remat_stats()
+
+def reset_remat_stats():
+    """ Reset the counters returned by ``get_remat_stats``
+    """
+    _owl.reset_remat_stats()
+
+def get_memory_stats():
+    """ Get the memory held by the buffers of each device
+
+    Live bytes are held by buffers that are still referenced and are also broken down by the
+    type of the op that produced them, e.g. ``MatMultOp``. Pooled bytes are kept by the memory
+    pool for reuse.
+
+    :return: one entry per device, ordered by device id
+    :rtype: list of dict
+    """
+    return _owl.get_memory_stats()
+
+def reset_memory_stats():
+    """ Restart the peak and the allocation counters returned by ``get_memory_stats``
+    """
+    _owl.reset_memory_stats()
+
+def evict_replicas():
+    """ Wait for all ops, then drop the copies devices keep of data computed on other devices
+
+    The copies are made again when needed.
+
+    :return: bytes freed
+    :rtype: int
+    """
+    return _owl.evict_replicas()
+
+def set_telemetry_enabled(enabled):
+    """ Enable or disable scheduler telemetry
+
+    When enabled, the scheduler records when each node is created, becomes ready, is dispatched
+    to a device, starts, finishes and is freed. It can also be enabled from the start with the
+    ``--telemetry`` flag.
+
+    :param bool enabled: whether to collect telemetry
+    """
+    _owl.set_telemetry_enabled(enabled)
+
+def get_telemetry_report():
+    """ Get a summary of the collected telemetry
+
+    The summary contains histograms of the time nodes spend waiting for inputs, in the dispatcher
+    queue, in the device queue, executing and resident in memory, as well as per device
+    utilization.
+
+    :return: human readable report
+    :rtype: str
+    """
+    return _owl.get_telemetry_report()
+
+def get_telemetry_trace():
+    """ Get the timelines of the most recently finished nodes
+
+    :return: one dict per node with its timestamps in microseconds (-1 if not reached)
+    :rtype: list dict
+    """
+    return _owl.get_telemetry_trace()
+
+def reset_telemetry():
+    """ Clear the collected telemetry and restart the clock
+    """
+    _owl.reset_telemetry()
+
 def zeros(shape):
     """ Create ndarray of zero values
 
@@ -134,7 +311,129 @@ def randb(shape, prob):
     """
     return NArray.randb(shape, prob)
 
-def from_numpy(nparr):
+def from_file(filename, shape, offset=0):
+    """ Create an ndarray from the raw floats of a binary file
+
+    The file is mapped into memory rather than read. CPU devices use the mapping directly, so
+    large files load instantly and are shared with other processes through the page cache.
+
+    :param str filename: file written by ``numpy.ndarray.tofile`` in ``float32``
+    :param shape: shape of the ndarray to create
+    :type shape: list int
+    :param int offset: bytes to skip at the start of the file
+    :return: result ndarray
+    :rtype: owl.NArray
+    """
+    return NArray.from_file(filename, shape, offset)
+
+def save_checkpoint(filename, arrays):
+    """ Save ndarrays to a checkpoint file in the background
+
+    Background threads copy a few ndarrays at a time to host memory once computed and write them,
+    so training continues meanwhile without a host copy of the whole model. The file holds the name and shape of each ndarray
+    with a checksum, and only appears under ``filename`` once complete.
+
+    :param str filename: path of the checkpoint
+    :param dict arrays: ndarrays by name
+    :return: handle whose ``wait()`` blocks until the file is complete and raises if it could not
+        be written, also called on deletion
+    :rtype: owl.CheckpointWriter
+    """
+    return _owl.CheckpointWriter(filename, arrays)
+
+def load_checkpoint(filename, verify=False):
+    """ Load the ndarrays of a checkpoint file written by ``save_checkpoint``
+
+    The file is mapped into memory, and ndarrays are only read when used.
+
+    :param str filename: path of the checkpoint
+    :param bool verify: read the whole file to verify the checksums
+    :return: ndarrays by name
+    :rtype: dict
+    """
+    return _owl.load_checkpoint(filename, verify)
+
+def raw_file_pipeline(files, sample_shapes, batch_size, header_bytes=0, num_batches=0, num_workers=1, prefetch=4):
+    """ Create a pipeline reading minibatches of raw float files in the background
+
+    File ``i`` holds samples of shape ``sample_shapes[i]``, such as the MNIST data and label files.
+    Up to ``prefetch`` minibatches are read ahead and loaded to the current device, so the next
+    ones are ready while the current one trains.
+
+    :param files: paths of the files, one for each field of a minibatch
+    :type files: list str
+    :param sample_shapes: shape of a sample in each file
+    :type sample_shapes: list list int
+    :param int batch_size: samples in a minibatch
+    :param int header_bytes: bytes to skip at the start of each file
+    :param int num_batches: minibatches of a pass over the files, or 0 to read them to the end
+    :param int num_workers: threads transforming minibatches
+    :param int prefetch: minibatches read ahead
+    :return: pipeline whose ``next()`` gives the ndarrays of the next minibatch, or ``None`` once at
+        the end of each pass
+    :rtype: owl.DataPipeline
+    """
+    return _owl.DataPipeline.from_raw_files(files, sample_shapes, batch_size, header_bytes, num_batches, num_workers, prefetch)
+
+def lmdb_pipeline(source, batch_size, crop_size, random_crop, mirror, mean, num_workers=4, prefetch=4):
+    """ Create a pipeline reading minibatches of Caffe datums from LMDB in the background
+
+    Worker threads subtract the mean, crop and mirror the samples. Needs Minerva built with LMDB.
+
+    :param str source: path of the LMDB database
+    :param int batch_size: samples in a minibatch
+    :param int crop_size: side of the square cropped out of each image, or 0 to keep it whole
+    :param bool random_crop: crop at random offsets rather than at the center
+    :param bool mirror: flip half of the samples horizontally at random
+    :param mean: one value per channel, or a flattened mean image, or empty
+    :type mean: list float
+    :param int num_workers: threads decoding minibatches
+    :param int prefetch: minibatches read ahead
+    :return: pipeline whose ``next()`` gives the samples and labels of the next minibatch, or
+        ``None`` once at the end of each pass
+    :rtype: owl.DataPipeline
+    """
+    return _owl.DataPipeline.from_lmdb(source, batch_size, crop_size, random_crop, mirror, mean, num_workers, prefetch)
+
+def shard_pipeline(shards, batch_size, crop_size, random_crop, mirror, mean, shuffle_size=0, num_workers=4, prefetch=4):
+    """ Create a pipeline reading minibatches of Caffe datums from record shards in the background
+
+    Shards are read sequentially in large blocks. With a ``shuffle_size`` above 1 the shards are
+    visited in a random order each pass and minibatches are drawn at random from a buffer of that
+    many records. Worker threads decompress and decode the records, subtract the mean, crop and
+    mirror the samples.
+
+    :param shards: paths of the shards, as written by ``owl.record_shard_writer``
+    :type shards: list str
+    :param int batch_size: samples in a minibatch
+    :param int crop_size: side of the square cropped out of each image, or 0 to keep it whole
+    :param bool random_crop: crop at random offsets rather than at the center
+    :param bool mirror: flip half of the samples horizontally at random
+    :param mean: one value per channel, or a flattened mean image, or empty
+    :type mean: list float
+    :param int shuffle_size: records buffered for shuffling, or 0 to keep their order
+    :param int num_workers: threads decoding minibatches
+    :param int prefetch: minibatches read ahead
+    :return: pipeline whose ``next()`` gives the samples and labels of the next minibatch, or
+        ``None`` once at the end of each pass
+    :rtype: owl.DataPipeline
+    """
+    return _owl.DataPipeline.from_shards(shards, batch_size, shuffle_size, crop_size, random_crop, mirror, mean, num_workers, prefetch)
+
+def record_shard_writer(filename, compress=False):
+    """ Create a writer of a record shard
+
+    Records are written as given, followed by an index when the writer is closed. Compressed
+    records are only kept compressed when that makes them smaller.
+
+    :param str filename: path of the shard
+    :param bool compress: compress records with zlib, which needs Minerva built with zlib
+    :return: writer with ``write(record)`` and ``close()``
+    :rtype: owl.RecordShardWriter
+    """
+    return _owl.RecordShardWriter(filename, compress)
+
+def from_numpy(nparr, borrow=False):
     """ Create an owl.NArray from numpy.ndarray
 
     .. note::
@@ -148,15 +447,21 @@ def from_numpy(nparr):
         >>> print b.shape
         [50, 300, 200]
 
+        A C-contiguous float32 array is copied once into a host buffer before it is loaded.
+        With ``borrow`` it is loaded from its own buffer instead, so it must not be modified
+        until the result is evaluated. Any other array is converted and its converted copy is
+        borrowed.
+
     .. seealso::
 
         :py:func:`owl.NArray.to_numpy`
 
     :param numpy.ndarray nparr: numpy ndarray
+    :param bool borrow: load straight from the buffer of ``nparr`` without a host copy
     :return: Minerva's ndarray
     :rtype: owl.NArray
     """
-    return NArray.from_numpy(np.require(nparr, dtype=np.float32, requirements=['C']))
+    return NArray.from_numpy(nparr, borrow)
 
 def concat(narrays, concat_dim):
     """  Concatenate NArrays according to concat_dim
@@ -8,6 +8,8 @@ of:
 2. Demonstrate the power of ``owl`` package (it takes only several hundreds LOC to implement Caffe and run it on dataflow engine).
 '''
 
+import os
+import glob
 import numpy as np
 import math
 import Queue
@@ -18,6 +20,8 @@ import owl.conv as co
 from caffe import *
 
 from netio import LMDBDataProvider
+from netio import NativeLMDBDataProvider
+from netio import ShardDataProvider
 from netio import ImageListDataProvider
 from netio import ImageWindowDataProvider
 
@@ -35,12 +39,18 @@ class ComputeUnit(object):
     :ivar top_names: names of the top units
     :vartype top_names: list str
     :ivar list int out_shape:
+    :ivar bool compilable: whether :py:meth:`Net.compile` can trace the unit; units whose forward
+        reads values from arrays cannot be replayed
+    :ivar bool fed: set by a compiling net once it called :py:meth:`feed` for the next forward pass
 
     .. note::
         ``params``, ``name``, ``btm_names`` and ``top_names`` will be parsed from Caffe's network
         description file. ``out_shape`` should be set in :py:meth:`compute_size`
 
     '''
+    compilable = True
+    fed = False
+
     def __init__(self, params):
         self.params = params
         self.name = params.name
@@ -70,6 +80,20 @@ class ComputeUnit(object):
             :py:meth:`Net.compute_size`
         '''
         pass
+    def feed(self, from_btm, to_top, phase):
+        ''' Function for loading the inputs of a forward pass from the host
+
+        Units that take inputs from outside the network (e.g. data and labels) should create them
+        here, and have :py:meth:`forward` call ``feed`` first unless ``fed`` is set, so that
+        ``forward`` keeps working on its own. A net being compiled (see :py:meth:`Net.compile`)
+        feeds all units before the forward pass and sets ``fed``, and a compiled net only calls
+        ``feed``. Ops on arrays belong in :py:meth:`forward`.
+
+        :param dict from_btm: what bottom units fed
+        :param dict to_top: host inputs for top units
+        :param str phase: name of the phase of the running. Currently either ``"TRAIN"`` or ``"TEST"``
+        '''
+        pass
     def forward(self, from_btm, to_top, phase):
         ''' Function for forward propagation
 
@@ -387,16 +411,20 @@ class SoftmaxUnit(ComputeUnit):
         self.start_on_ori = to_top[self.top_names[0]]['start_on_ori']
         self.rec_on_ori = to_top[self.top_names[0]]['rec_on_ori']
     
-    def forward(self, from_btm, to_top, phase):
-        to_top[self.top_names[0]] = co.softmax(from_btm[self.btm_names[0]], co.soft_op.instance)
-        self.ff_y = to_top[self.top_names[0]]
-        #turn label into matrix form
+    def feed(self, from_btm, to_top, phase):
+        #turn label into matrix form, sized like the output of the last forward pass
         nplabel = np.zeros([self.ff_y.shape[1], self.ff_y.shape[0]], dtype=np.float32)
         self.strlabel = from_btm[self.btm_names[1]]
         
         for i in range(len(self.strlabel)):
             nplabel[i, self.strlabel[i]] = 1
         self.y = owl.from_numpy(nplabel)
+
+    def forward(self, from_btm, to_top, phase):
+        to_top[self.top_names[0]] = co.softmax(from_btm[self.btm_names[0]], co.soft_op.instance)
+        self.ff_y = to_top[self.top_names[0]]
+        if not self.fed:
+            self.feed(from_btm, to_top, phase)
         
     def backward(self, from_top, to_btm, phase):
         if len(self.loss_weight) == 1:
@@ -408,7 +436,7 @@ class SoftmaxUnit(ComputeUnit):
         ''' Get the loss of the softmax (cross entropy)
         '''
         lossmat = ele.mult(ele.ln(self.ff_y), self.y)
-        res = lossmat.sum(0).sum(1).to_numpy()
+        res = lossmat.sum(0).sum(1).borrow_numpy()
         return -res[0][0] / lossmat.shape[1]
 
     def __str__(self):
@@ -421,6 +449,8 @@ class AccuracyUnit(ComputeUnit):
         In terms of Minerva's lazy evaluation, the unit is a **non-lazy** one since it gets the actual
         contents (accuracy) out of an ``owl.NArray``.
     '''
+    compilable = False
+
     def __init__(self, params):
         super(AccuracyUnit, self).__init__(params)
         self.acc = 0
@@ -447,7 +477,7 @@ class AccuracyUnit(ComputeUnit):
             correct = (predict - ground_truth).count_zero()
             self.acc = correct * 1.0 / self.batch_size
         elif self.top_k == 5:
-            predict = from_btm[self.btm_names[0]].to_numpy()
+            predict = from_btm[self.btm_names[0]].borrow_numpy()
             top_5 = np.argsort(predict, axis=1)[:,::-1]
             ground_truth = from_btm[self.btm_names[1]]
             self.batch_size = np.shape(ground_truth)[0]
@@ -698,8 +728,8 @@ class DataUnit(ComputeUnit):
     def compute_size(self, from_btm, to_top):
         pass
 
-    def forward(self, from_btm, to_top, phase):
-        ''' Feed-forward of data unit will get a batch of a fixed batch_size from data provider. 
+    def feed(self, from_btm, to_top, phase):
+        ''' Feed of data unit will get a batch of a fixed batch_size from data provider. 
 
         .. note::
             
@@ -721,14 +751,27 @@ class DataUnit(ComputeUnit):
                 continue
             break
 
-        to_top[self.top_names[0]] = owl.from_numpy(samples).reshape(
-                [self.crop_size, self.crop_size, 3, samples.shape[0]])
+        if isinstance(samples, owl.NArray):
+            to_top[self.top_names[0]] = samples
+        else:
+            to_top[self.top_names[0]] = owl.from_numpy(samples.reshape(
+                    [samples.shape[0], 3, self.crop_size, self.crop_size]))
         #may have multiplier labels
         for i in range (1, len(self.top_names)):
             to_top[self.top_names[i]] = labels[:,i - 1]
 
         #the output of datalayer is the data not label
         self.out = to_top[self.top_names[0]]
+        self.labels = labels
+
+    def forward(self, from_btm, to_top, phase):
+        ''' Pass on the batch loaded by :py:meth:`feed`, loading it first unless the net did
+        '''
+        if not self.fed:
+            self.feed(from_btm, to_top, phase)
+        to_top[self.top_names[0]] = self.out
+        for i in range (1, len(self.top_names)):
+            to_top[self.top_names[i]] = self.labels[:,i - 1]
 
     def backward(self, from_top, to_btm, phase):
         # no bp pass
@@ -737,7 +780,7 @@ class DataUnit(ComputeUnit):
         return 'data'
 
 class LMDBDataUnit(DataUnit):
-    ''' DataUnit load from LMDB.
+    ''' DataUnit load from LMDB, or from record shards when the source is a directory of ``*.rec`` shards.
 
     :ivar caffe.LayerParameter params: lmdb data layer param defined by Caffe, params.data_param contains information about data source, parmas.transform_param mainly defines data augmentation operations
     
@@ -746,10 +789,16 @@ class LMDBDataUnit(DataUnit):
     
     def __init__(self, params, num_gpu):
         super(LMDBDataUnit, self).__init__(params, num_gpu)
+        if glob.glob(os.path.join(params.data_param.source, '*.rec')):
+            provider = ShardDataProvider
+        elif owl.has_lmdb():
+            provider = NativeLMDBDataProvider
+        else:
+            provider = LMDBDataProvider
         if params.include[0].phase == Phase.Value('TRAIN'):
-            self.dp = LMDBDataProvider(params.data_param, params.transform_param, num_gpu)
+            self.dp = provider(params.data_param, params.transform_param, num_gpu)
         else:
-            self.dp = LMDBDataProvider(params.data_param, params.transform_param, 1)
+            self.dp = provider(params.data_param, params.transform_param, 1)
         self.params = params
         self.crop_size = params.transform_param.crop_size
         self.generator = None
@@ -770,8 +819,8 @@ class LMDBDataUnit(DataUnit):
         self.start_on_ori = 0
 
    
-    def forward(self, from_btm, to_top, phase):
-        ''' Feed-forward operation may vary according to phase. 
+    def feed(self, from_btm, to_top, phase):
+        ''' Feed operation may vary according to phase. 
 
         .. note::
 
@@ -797,11 +846,15 @@ class LMDBDataUnit(DataUnit):
                     self.generator = self.dp.get_multiview_mb()
                 continue
             break
-        to_top[self.top_names[0]] = owl.from_numpy(samples).reshape(
-                [self.crop_size, self.crop_size, 3, samples.shape[0]])
+        if isinstance(samples, owl.NArray):
+            to_top[self.top_names[0]] = samples
+        else:
+            to_top[self.top_names[0]] = owl.from_numpy(samples.reshape(
+                    [samples.shape[0], 3, self.crop_size, self.crop_size]))
         for i in range (1, len(self.top_names)):
             to_top[self.top_names[i]] = labels[:,i - 1]
         self.out = to_top[self.top_names[0]]
+        self.labels = labels
 
     def __str__(self):
         return 'lmdb_data'
@@ -903,6 +956,8 @@ class Net:
         self.name_to_uid = {}
         self.loss_uids = []
         self.accuracy_uids = []
+        self._trace = None
+        self._plan = None
 
     def add_unit(self, unit):
         ''' Method for adding units into the graph
@@ -1047,15 +1102,63 @@ class Net:
         exit(0)
         '''
 
+    def _unit_arrays(self):
+        arrays = []
+        for uid in range(len(self.units)):
+            for name, a in vars(self.units[uid]).items():
+                if isinstance(a, owl.NArray):
+                    arrays.append((uid, name, a))
+        return arrays
+
+    def _feed(self, phase):
+        # arrays loaded by the units are plan inputs, loaded again for each run
+        before = dict(((uid, name), a) for uid, name, a in self._unit_arrays())
+        with self._trace.feed():
+            unit_to_tops = self._feed_units(phase)
+        for u in self._toporder(phase):
+            self.units[u].fed = True
+        keys = []
+        inputs = {}
+        for uid, name, a in self._unit_arrays():
+            if before.get((uid, name)) is a:
+                continue
+            if not id(a) in inputs:
+                inputs[id(a)] = self._trace.input(a)
+                self._plan_sources.append(('feed', len(self._plan_feeds), len(keys)))
+                self._plan_inputs.append(a)
+                keys.append((uid, name))
+            setattr(self.units[uid], name, inputs[id(a)])
+        for to_top in unit_to_tops:
+            for name, a in to_top.items():
+                if isinstance(a, owl.NArray) and id(a) in inputs:
+                    to_top[name] = inputs[id(a)]
+        self._plan_feeds.append((owl.get_device(), keys))
+        return unit_to_tops
+
+    def _feed_units(self, phase):
+        unit_to_tops = [{} for name in self.units]
+        for u in self._toporder(phase):
+            from_btm = {}
+            for btm in self.reverse_adjacent[u]:
+                from_btm.update(unit_to_tops[btm])
+            self.units[u].feed(from_btm, unit_to_tops[u], phase)
+        return unit_to_tops
+
     def forward(self, phase = 'TRAIN'):
         ''' Perform the forward pass
         '''
-        unit_to_tops = [{} for name in self.units]
+        if self._trace is None:
+            unit_to_tops = [{} for name in self.units]
+        else:
+            unit_to_tops = self._feed(phase)
         for u in self._toporder(phase):
             from_btm = {}
             for btm in self.reverse_adjacent[u]:
                 from_btm.update(unit_to_tops[btm])
             self.units[u].forward(from_btm, unit_to_tops[u], phase)
+        if self._trace is not None:
+            for u in self._toporder(phase):
+                self.units[u].fed = False
 
     def backward(self, phase = 'TRAIN'):
         ''' Perform the backward pass
@@ -1087,6 +1190,103 @@ class Net:
         for i in range(len(self.units)):
             self.update(i)
 
+    def compile(self, step, phase = 'TRAIN'):
+        ''' Compile an iteration of training into a plan for :py:meth:`run_compiled`
+
+        ``step`` runs one iteration, i.e. :py:meth:`forward`, :py:meth:`backward` and the weight
+        updates, on any devices. Its ops are recorded once into a plan (see ``owl.trace``), with
+        their shapes and devices, and the plan then runs the iteration. The inputs of the plan
+        are the arrays the units hold, e.g. weights and their momentum, and the host inputs of
+        each forward pass, which :py:meth:`run_compiled` loads again through
+        :py:meth:`ComputeUnit.feed`. The outputs are the arrays the units hold after the step.
+        ``current_lr`` is given again to each run; other settings, e.g. ``batch_size``, are
+        fixed by the plan. Weights and their momentum have to exist, so at least one iteration
+        should have run before.
+
+        A step that reads arrays, loads them from the host other than in
+        :py:meth:`ComputeUnit.feed`, or computes on arrays that no unit holds (whose values the
+        plan would keep from the recording), can not be compiled. The units then get back their arrays,
+        ``step`` runs without a plan, and training goes on eagerly.
+
+        :param step: function running one iteration
+        :param str phase: the phase ``step`` runs
+        :return: whether the iteration was compiled
+        :rtype: bool
+        '''
+        for u in self._toporder(phase):
+            unit = self.units[u]
+            if not unit.compilable:
+                raise ValueError('%s unit %s can not be compiled' % (unit, unit.name))
+            if isinstance(unit, WeightedComputeUnit) and (unit.weightdelta is None or unit.biasdelta is None):
+                raise ValueError('unit %s has no weights yet; run an iteration first' % unit.name)
+        t = owl.trace()
+        lr = self.current_lr
+        saved = self._unit_arrays()
+        self._plan_sources = []
+        self._plan_inputs = []
+        self._plan_feeds = []
+        self._trace = t
+        try:
+            with t:
+                inputs = {}
+                for uid, name, a in saved:
+                    if not id(a) in inputs:
+                        inputs[id(a)] = t.input(a)
+                        self._plan_sources.append(('unit', uid, name))
+                        self._plan_inputs.append(a)
+                    setattr(self.units[uid], name, inputs[id(a)])
+                self.current_lr = t.param(lr)
+                step()
+                outputs = self._unit_arrays()
+                self._plan = t.plan([a for uid, name, a in outputs])
+        except RuntimeError:
+            traced = False
+        else:
+            traced = True
+        finally:
+            self.current_lr = lr
+            self._trace = None
+            for unit in self.units:
+                unit.fed = False
+        if not traced:
+            # arrays of the recording can not be read, so the units get theirs back
+            for uid, name, a in self._unit_arrays():
+                setattr(self.units[uid], name, None)
+            for uid, name, a in saved:
+                setattr(self.units[uid], name, a)
+            self._plan = None
+            step()
+            return False
+        self._plan_outputs = [(uid, name) for uid, name, a in outputs]
+        self._plan_phase = phase
+        # the recorded iteration is the first run
+        inputs, self._plan_inputs = self._plan_inputs, None
+        self._run_plan(inputs)
+        return True
+
+    def _run_plan(self, inputs):
+        outputs = self._plan.run(inputs, [self.current_lr])
+        for (uid, name), a in zip(self._plan_outputs, outputs):
+            setattr(self.units[uid], name, a)
+
+    def run_compiled(self):
+        ''' Run an iteration compiled by :py:meth:`compile`, on new host inputs
+        '''
+        device = owl.get_device()
+        loaded = []
+        for dev, keys in self._plan_feeds:
+            owl.set_device(dev)
+            self._feed_units(self._plan_phase)
+            loaded.append([getattr(self.units[uid], name) for uid, name in keys])
+        owl.set_device(device)
+        inputs = []
+        for s in self._plan_sources:
+            if s[0] == 'feed':
+                inputs.append(loaded[s[1]][s[2]])
+            else:
+                inputs.append(getattr(self.units[s[1]], s[2]))
+        self._run_plan(inputs)
+
     def __str__(self):
         ret = 'digraph G {\n'
         for uid in range(len(self.units)):
@@ -159,6 +159,10 @@ class CaffeNetBuilder:
         :ivar str weightpath: the folder storing parameters 
         :ivar int snapshotidx: the index of the snapshot
         '''
+        ckptname = "%ssnapshot%d.ckpt" % (weightpath, snapshotidx)
+        if os.path.isfile(ckptname):
+            self._init_net_from_checkpoint(owl_net, ckptname)
+            return
         weightpath = "%ssnapshot%d/" % (weightpath, snapshotidx)
         for i in range(len(owl_net.units)):
             if isinstance(owl_net.units[i], net.FullyConnection):
@@ -235,39 +239,41 @@ class CaffeNetBuilder:
                     print "Conv Bias Need Reinit %s" % (owl_net.units[i].name)
 
     
+    def _init_net_from_checkpoint(self, owl_net, ckptname):
+        arrays = owl.load_checkpoint(ckptname)
+        for i in range(len(owl_net.units)):
+            if isinstance(owl_net.units[i], net.ConvConnection) or isinstance(owl_net.units[i], net.FullyConnection):
+                layername = owl_net.units[i].name
+                for field, shape in [('weight', owl_net.units[i].wshape), ('weightdelta', owl_net.units[i].wshape),
+                                     ('bias', owl_net.units[i].bshape), ('biasdelta', owl_net.units[i].bshape)]:
+                    key = '%s/%s' % (layername, field)
+                    if key in arrays and arrays[key].shape == list(shape):
+                        setattr(owl_net.units[i], field, arrays[key])
+                    elif not field.endswith('delta'):
+                        print "%s Need Reinit %s" % (field, layername)
+
     def save_net_to_file(self, owl_net, weightpath, snapshotidx):
-        '''Save network parameters to a saved snapshot.
+        '''Save network parameters to a snapshot checkpoint.
+
+        The checkpoint is written in the background, so training goes on meanwhile. A snapshot waits
+        for the previous one to complete.
+
         :ivar owl_net: the network to save parameters from
         :ivar str weightpath: the folder storing parameters 
         :ivar int snapshotidx: the index of the snapshot
         '''
-        weightpath = "%ssnapshot%d/" % (weightpath, snapshotidx)
-        cmd = "mkdir %s" % (weightpath)
-        res = subprocess.call(cmd, shell=True)
+        if not os.path.isdir(weightpath):
+            os.makedirs(weightpath)
+        arrays = {}
         for i in range(len(owl_net.units)):
             if isinstance(owl_net.units[i], net.ConvConnection) or isinstance(owl_net.units[i], net.FullyConnection):
-                #print owl_net.units[i].name
                 layername = owl_net.units[i].name
-                layername = layername.replace("/","_")
-                weightname = '%s%s_weights.dat' % (weightpath, layername)
-                wshape = owl_net.units[i].weight.shape 
-                length = np.prod(wshape)
-                npweight = owl_net.units[i].weight.to_numpy().reshape(length)
-                npweight.tofile(weightname)
-
-                weightname = '%s%s_weightdelta.dat' % (weightpath, layername)
-                npweightdelta = owl_net.units[i].weightdelta.to_numpy().reshape(length)
-                npweightdelta.tofile(weightname)
-                
-                biasname = '%s%s_bias.dat' % (weightpath, layername)
-                bshape = owl_net.units[i].bias.shape
-                length = np.prod(bshape)
-                npbias = owl_net.units[i].bias.to_numpy().reshape(length)
-                npbias.tofile(biasname)
-
-                biasname = '%s%s_biasdelta.dat' % (weightpath, layername)
-                npbiasdetla = owl_net.units[i].biasdelta.to_numpy().reshape(length)
-                npbiasdetla.tofile(biasname)
+                for field in ['weight', 'weightdelta', 'bias', 'biasdelta']:
+                    if getattr(owl_net.units[i], field) is not None:
+                        arrays['%s/%s' % (layername, field)] = getattr(owl_net.units[i], field)
+        if getattr(self, 'pending_snapshot', None) is not None:
+            self.pending_snapshot.wait()
+        self.pending_snapshot = owl.save_checkpoint("%ssnapshot%d.ckpt" % (weightpath, snapshotidx), arrays)
 
 class CaffeModelLoader:
     ''' Class to convert Caffe's caffemodel into numpy array files. Minerva use numpy array files to store and save model snapshots.
@@ -1,4 +1,5 @@
 import sys,os,gc
+import glob
 import time
 import lmdb
 import numpy as np
@@ -8,6 +9,7 @@ from PIL import Image
 from google.protobuf import text_format
 
 from caffe import *
+import owl
 
 class ImageWindowDataProvider:
     ''' Class for Image Window Data Provider. This data provider will read the original image
@@ -387,6 +389,163 @@ class LMDBDataProvider:
                 yield (left_samples[i,:,:], left_labels)
 
 
+class NativeLMDBDataProvider(LMDBDataProvider):
+    ''' LMDB data provider reading and decoding datums in Minerva's native data pipeline.
+
+    Worker threads subtract the mean, crop and mirror the samples into the buffers of the
+    minibatches, and the next minibatches are read ahead while the current one trains. Minibatches
+    are the same as :py:class:`LMDBDataProvider`, except that samples come as ``owl.NArray`` of
+    shape ``[crop_size, crop_size, 3, batch_size]``.
+
+    .. note::
+        Requires Minerva built with ``BUILD_WITH_LMDB``. Layer type in Caffe's configure file: DATA
+
+    '''
+
+    def __init__(self, data_param, transform_param, mm_batch_num, num_workers=4, prefetch=4):
+        LMDBDataProvider.__init__(self, data_param, transform_param, mm_batch_num)
+        if len(transform_param.mean_file) == 0:
+            self.mean = list(transform_param.mean_value)
+        else:
+            self.mean = list(self.mean_data.flatten())
+        self.num_workers = num_workers
+        self.prefetch = prefetch
+        self.pipeline = None
+
+    def get_mb(self, phase = 'TRAIN'):
+        ''' Get next minibatch
+        '''
+        if self.pipeline is None:
+            self.pipeline = owl.lmdb_pipeline(self.source, self.batch_size, self.crop_size,
+                    phase == 'TRAIN', self.mirror, self.mean, self.num_workers, self.prefetch)
+        while True:
+            arrays = self.pipeline.next()
+            if arrays is None:
+                return
+            yield (arrays[0], arrays[1].to_numpy())
+
+
+class ShardDataProvider(NativeLMDBDataProvider):
+    ''' Data provider reading datums from record shards in Minerva's native data pipeline.
+
+    The data source is a directory of ``*.rec`` shards, as written by
+    :py:func:`convert_lmdb_to_shards` or :py:func:`convert_image_list_to_shards`. Shards are read
+    in large sequential blocks instead of the random page reads of LMDB. In the training phase the
+    shards are visited in a random order and samples are drawn from a buffer of ``shuffle_size``
+    records, so the order differs every epoch. Minibatches are the same as
+    :py:class:`NativeLMDBDataProvider`.
+
+    .. note::
+        Layer type in Caffe's configure file: DATA
+
+    '''
+
+    def __init__(self, data_param, transform_param, mm_batch_num, num_workers=4, prefetch=4, shuffle_size=1024):
+        NativeLMDBDataProvider.__init__(self, data_param, transform_param, mm_batch_num, num_workers, prefetch)
+        self.shards = sorted(glob.glob(os.path.join(self.source, '*.rec')))
+        self.shuffle_size = shuffle_size
+
+    def get_mb(self, phase = 'TRAIN'):
+        ''' Get next minibatch
+        '''
+        if self.pipeline is None:
+            train = phase == 'TRAIN'
+            self.pipeline = owl.shard_pipeline(self.shards, self.batch_size, self.crop_size, train,
+                    self.mirror, self.mean, self.shuffle_size if train else 0, self.num_workers, self.prefetch)
+        while True:
+            arrays = self.pipeline.next()
+            if arrays is None:
+                return
+            yield (arrays[0], arrays[1].to_numpy())
+
+class _ShardSetWriter:
+    ''' Writes records to consecutive shards ``shard-%05d.rec`` of a directory '''
+
+    def __init__(self, outdir, records_per_shard, compress):
+        if not os.path.exists(outdir):
+            os.makedirs(outdir)
+        self.outdir = outdir
+        self.records_per_shard = records_per_shard
+        self.compress = compress
+        self.writer = None
+        self.num_shards = 0
+        self.count = 0
+
+    def write(self, record):
+        if self.count % self.records_per_shard == 0:
+            self.close()
+            self.writer = owl.record_shard_writer(os.path.join(self.outdir, 'shard-%05d.rec' % self.num_shards), self.compress)
+            self.num_shards += 1
+        self.writer.write(record)
+        self.count += 1
+
+    def close(self):
+        if self.writer is not None:
+            self.writer.close()
+            self.writer = None
+
+def convert_lmdb_to_shards(source, outdir, records_per_shard=10000, compress=False):
+    ''' Copy the datums of an LMDB database to record shards, in the order of its keys
+
+    :param str source: path of the LMDB database
+    :param str outdir: directory of the shards
+    :param int records_per_shard: datums in each shard
+    :param bool compress: compress the datums with zlib
+    :return: the number of datums copied
+    :rtype: int
+    '''
+    shards = _ShardSetWriter(outdir, records_per_shard, compress)
+    env = lmdb.open(source, readonly=True)
+    with env.begin(write=False, buffers=False) as txn:
+        for key, value in txn.cursor():
+            shards.write(value)
+    shards.close()
+    return shards.count
+
+def convert_image_list_to_shards(list_file, outdir, new_height, new_width, records_per_shard=10000, compress=False):
+    ''' Decode and resize the images of an image list into datums in record shards
+
+    Images are converted like :py:class:`ImageListDataProvider` does, to BGR of ``new_height`` by
+    ``new_width``, so they are decoded once instead of every epoch. Images that fail to decode are
+    skipped.
+
+    :param str list_file: lines of an image path followed by its labels
+    :param str outdir: directory of the shards
+    :param int new_height: height images are resized to
+    :param int new_width: width images are resized to
+    :param int records_per_shard: datums in each shard
+    :param bool compress: compress the datums with zlib
+    :return: the number of datums written
+    :rtype: int
+    '''
+    shards = _ShardSetWriter(outdir, records_per_shard, compress)
+    with open(list_file, 'r') as f:
+        for line in f:
+            line_info = line.split()
+            if len(line_info) < 2:
+                continue
+            try:
+                img = Image.open(line_info[0])
+                if img.mode not in ('RGB'):
+                    img = img.convert('RGB')
+                img = img.resize((new_width, new_height), Image.ANTIALIAS)
+            except IOError, e:
+                print e
+                print "skip image %s" % (line_info[0])
+                continue
+            npimg = np.transpose(np.array(img, dtype=np.uint8).reshape([new_height * new_width, 3]))
+            npimg = npimg.reshape([3, new_height, new_width])[::-1,:,:]
+            d = Datum()
+            d.channels = 3
+            d.height = new_height
+            d.width = new_width
+            d.data = npimg.tostring()
+            d.label.extend([int(l) for l in line_info[1:]])
+            shards.write(d.SerializeToString())
+    shards.close()
+    return shards.count
+
+
 if __name__ == '__main__':
     ''' 
     if sys.argv[1] == 'lmdb':
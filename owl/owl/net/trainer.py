@@ -1,3 +1,4 @@
+import logging
 import math
 import sys
 import time
@@ -8,6 +9,8 @@ from net_helper import CaffeNetBuilder
 from caffe import *
 from PIL import Image
 
+logger = logging.getLogger(__name__)
+
 class NetTrainer:
     ''' Class for training neural network
 
@@ -21,11 +24,13 @@ class NetTrainer:
     :ivar str solver_file: path of the solver file in Caffe's proto format
     :ivar int snapshot: the idx of snapshot to start with
     :ivar int num_gpu: the number of gpu to use
+    :ivar bool compiled: whether to run iterations as a plan compiled by :py:meth:`Net.compile`
     '''
-    def __init__(self, solver_file, snapshot = 0, num_gpu = 1):
+    def __init__(self, solver_file, snapshot = 0, num_gpu = 1, compiled = True):
         self.solver_file = solver_file
         self.snapshot = snapshot
         self.num_gpu = num_gpu
+        self.compiled = compiled
         self.gpu = [owl.create_gpu_device(i) for i in range(num_gpu)]
 
     def build_net(self):
@@ -91,20 +96,19 @@ class NetTrainer:
         Since the update of each layer is independent among each others, the update could be paralleled affluently. Minerva's
         dataflow engine transparently handles the dependency resolving, scheduling and memory copying among different devices,
         so users don't need to care about that.
-        '''       
-        wgrad = [[] for i in range(s.num_gpu)]
-        bgrad = [[] for i in range(s.num_gpu)]
+
+        Creating the ops of an iteration costs the same every time, so after the first one the iteration is
+        compiled once with :py:meth:`Net.compile` and later ones only load their minibatches and run the plan.
+        Nets that can not be compiled keep running eagerly.
+        '''
         last = time.time()
         wunits = s.owl_net.get_weighted_unit_ids()
         last_start = time.time()
+        compiled = False
 
-        for iteridx in range(s.snapshot * s.owl_net.solver.snapshot, s.owl_net.solver.max_iter):
-            # get the learning rate
-            if s.owl_net.solver.lr_policy == "poly":
-                s.owl_net.current_lr = s.owl_net.base_lr * pow(1 - float(iteridx) / s.owl_net.solver.max_iter, s.owl_net.solver.power)
-            elif s.owl_net.solver.lr_policy == "step":
-                s.owl_net.current_lr = s.owl_net.base_lr * pow(s.owl_net.solver.gamma, iteridx / s.owl_net.solver.stepsize)
-
+        def step():
+            wgrad = [[] for i in range(s.num_gpu)]
+            bgrad = [[] for i in range(s.num_gpu)]
             # train on multi-gpu
             for gpuid in range(s.num_gpu):
                 owl.set_device(s.gpu[gpuid])
@@ -128,15 +132,38 @@ class NetTrainer:
                 s.owl_net.units[wid].biasgrad = bgrad[upd_gpu][i]
                 s.owl_net.update(wid)
 
+        first_iter = s.snapshot * s.owl_net.solver.snapshot
+        for iteridx in range(first_iter, s.owl_net.solver.max_iter):
+            # get the learning rate
+            if s.owl_net.solver.lr_policy == "poly":
+                s.owl_net.current_lr = s.owl_net.base_lr * pow(1 - float(iteridx) / s.owl_net.solver.max_iter, s.owl_net.solver.power)
+            elif s.owl_net.solver.lr_policy == "step":
+                s.owl_net.current_lr = s.owl_net.base_lr * pow(s.owl_net.solver.gamma, iteridx / s.owl_net.solver.stepsize)
+
+            if compiled:
+                s.owl_net.run_compiled()
+            elif s.compiled and iteridx > first_iter:
+                # weights and momentum exist after the first iteration; tracing runs this one
+                try:
+                    compiled = s.owl_net.compile(step)
+                    if compiled:
+                        logger.info('Compiled training iteration into %d ops', s.owl_net._plan.num_ops)
+                    else:
+                        logger.warning('Training without compiling: the iteration can not be traced')
+                        s.compiled = False
+                except ValueError as e:
+                    logger.warning('Training without compiling: %s', e)
+                    s.compiled = False
+                    step()
+            else:
+                step()
+
             if iteridx % 2 == 0:
                 owl.wait_for_all()
                 thistime = time.time() - last
                 print "Finished training %d minibatch (time: %s)" % (iteridx, thistime)
                 last = time.time()
 
-            wgrad = [[] for i in range(s.num_gpu)] # reset gradients
-            bgrad = [[] for i in range(s.num_gpu)]
-
             # decide whether to display loss
             if (iteridx + 1) % (s.owl_net.solver.display) == 0:
                 lossunits = s.owl_net.get_loss_units()
@@ -222,9 +249,9 @@ class NetTester:
                         softmax_val = softmax_val + loss_unit.ff_y
                 test_num += batch_size
                 if accunit.top_k == 5:
-                    predict = softmax_val.to_numpy()
+                    predict = softmax_val.borrow_numpy()
                     top_5 = np.argsort(predict, axis=1)[:,::-1]
-                    ground_truth = softmax_label.max_index(0).to_numpy()
+                    ground_truth = softmax_label.max_index(0).borrow_numpy()
                     correct = 0
                     for i in range(batch_size):
                         for t in range(5):
@@ -0,0 +1,124 @@
+import numpy as np
+import owl
+import owl.net as net
+
+# Small MLP with a softmax loss, built without a Caffe configuration
+class Params(object):
+    def __init__(self, name, **kw):
+        self.name = name
+        self.include = []
+        self.blobs_lr = []
+        self.weight_decay = []
+        self.loss_weight = []
+        self.__dict__.update(kw)
+
+class DataUnit(net.ComputeUnit):
+    def __init__(self, params, batches):
+        super(DataUnit, self).__init__(params)
+        self.batches = batches
+        self.next = 0
+    def compute_size(self, from_btm, to_top):
+        to_top[self.top_names[0]] = dict(out_shape=[16, 8], rec_on_ori=1, stride_on_ori=1, start_on_ori=0)
+        self.out_shape = [16, 8]
+    def feed(self, from_btm, to_top, phase):
+        samples, labels = self.batches[self.next % len(self.batches)]
+        self.next += 1
+        self.out = owl.from_numpy(samples)
+        self.labels = labels
+        to_top[self.top_names[0]] = self.out
+        to_top[self.top_names[1]] = labels
+    def forward(self, from_btm, to_top, phase):
+        if not self.fed:
+            self.feed(from_btm, to_top, phase)
+        to_top[self.top_names[0]] = self.out
+        to_top[self.top_names[1]] = self.labels
+
+def build(with_accuracy):
+    rng = np.random.RandomState(0)
+    batches = [(rng.randn(8, 16).astype(np.float32), rng.randint(0, 4, size=8)) for i in range(4)]
+    filler = Params('filler', type='gaussian', mean=0, std=0.1)
+    fc_params = Params('fc', inner_product_param=Params('ip', num_output=4,
+        weight_filler=filler, bias_filler=Params('bias', type='constant', value=0)))
+    units = [DataUnit(Params('data'), batches), net.FullyConnection(fc_params), net.SoftmaxUnit(Params('loss'))]
+    units[0].top_names = ['data', 'label']
+    units[1].btm_names, units[1].top_names = ['data'], ['fc']
+    units[2].btm_names, units[2].top_names = ['fc', 'label'], ['loss']
+    if with_accuracy:
+        units.append(net.AccuracyUnit(Params('accuracy', accuracy_param=Params('acc', top_k=1))))
+        units[3].btm_names, units[3].top_names = ['fc', 'label'], ['accuracy']
+    n = net.Net()
+    for u in units:
+        n.add_unit(u)
+    n.connect(0, 1)
+    n.connect(1, 2)
+    n.connect(0, 2)
+    if with_accuracy:
+        n.connect(1, 3)
+        n.connect(0, 3)
+    n.loss_uids = [2]
+    n.base_lr, n.base_weight_decay, n.momentum, n.batch_size = 0.1, 0.0005, 0.9, 8
+    n.current_lr = 0.1
+    n.compute_size('TRAIN')
+    return n
+
+def step(n):
+    n.forward('TRAIN')
+    n.backward('TRAIN')
+    for wid in n.get_weighted_unit_ids():
+        n.update(wid)
+
+owl.set_device(owl.create_cpu_device())
+
+# forward of the units loads their inputs on its own
+n = build(False)
+n.forward('TRAIN')
+assert n.units[2].y.shape == n.units[2].ff_y.shape
+
+# a compiled net trains like the eager one
+eager, compiled = build(False), build(False)
+for n in [eager, compiled]:
+    # the first forward pass initializes the weights from numpy
+    np.random.seed(0)
+    step(n)
+assert compiled.compile(lambda: step(compiled))
+step(eager)
+for i in range(3):
+    eager.current_lr = compiled.current_lr = 0.1 / (i + 2)
+    step(eager)
+    compiled.run_compiled()
+diff = np.abs(eager.units[1].weight.to_numpy() - compiled.units[1].weight.to_numpy()).max()
+assert diff < 1e-5, diff
+print 'compiled training matches eager training'
+
+# a step reading arrays is not compiled, runs eagerly and keeps the weights readable
+n = build(False)
+step(n)
+def reading_step():
+    step(n)
+    n.units[2].getloss()
+assert not n.compile(reading_step)
+assert n.units[1].weight.to_numpy().shape == (16, 4)
+step(n)
+print 'reading step falls back to eager training'
+
+# so does a step computing on arrays no unit holds
+n = build(False)
+step(n)
+captured = owl.zeros([4, 8])
+def capturing_step():
+    step(n)
+    n.units[2].ff_y += captured
+assert not n.compile(capturing_step)
+step(n)
+print 'capturing step falls back to eager training'
+
+# nets with an accuracy unit can not be compiled and keep training eagerly
+n = build(True)
+step(n)
+try:
+    n.compile(lambda: step(n))
+    assert False, 'compiled a net with an accuracy unit'
+except ValueError as e:
+    print 'not compiled:', e
+step(n)
+print 'accuracy %f' % n.units[3].acc
@@ -0,0 +1,22 @@
+#!/usr/bin/env python
+
+import sys, argparse
+import owl
+from owl.net.netio import convert_lmdb_to_shards, convert_image_list_to_shards
+
+if __name__ == "__main__":
+    # parse command line arguments
+    parser = argparse.ArgumentParser()
+    parser.add_argument('source', help='LMDB database, or image list file with --new_size')
+    parser.add_argument('outdir', help='directory to write the shards to')
+    parser.add_argument('--records_per_shard', help='datums in each shard', type=int, default=10000)
+    parser.add_argument('--compress', help='compress datums with zlib', type=int, default=0)
+    parser.add_argument('--new_size', help='height and width to resize the images of a list to', type=int, nargs=2)
+
+    (args, remain) = parser.parse_known_args()
+    if args.new_size is None:
+        count = convert_lmdb_to_shards(args.source, args.outdir, args.records_per_shard, bool(args.compress))
+    else:
+        count = convert_image_list_to_shards(args.source, args.outdir, args.new_size[0], args.new_size[1],
+                args.records_per_shard, bool(args.compress))
+    print ' === Wrote %d datums to %s === ' % (count, args.outdir)
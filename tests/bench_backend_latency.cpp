@@ -0,0 +1,55 @@
+// Per-op latency of small ops issued one at a time. Run once per backend to
+// compare them:
+//   ./bench_backend_latency --use_dag=true
+//   ./bench_backend_latency --use_dag=false
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <minerva.h>
+#include <gflags/gflags.h>
+
+using namespace std;
+using namespace minerva;
+
+DEFINE_int32(bench_iterations, 2000, "Number of ops to time");
+DEFINE_int32(bench_size, 16, "Side length of the square operands");
+DECLARE_bool(use_dag);
+
+int main(int argc, char** argv) {
+  MinervaSystem::Initialize(&argc, &argv);
+  auto& ms = MinervaSystem::Instance();
+  ms.SetDevice(ms.device_manager().CreateCpuDevice());
+  Scale size{FLAGS_bench_size, FLAGS_bench_size};
+  NArray a = NArray::Constant(size, 1);
+  NArray b = NArray::Constant(size, 2);
+  vector<double> latencies;
+  latencies.reserve(FLAGS_bench_iterations);
+  for (int i = 0; i < FLAGS_bench_iterations; ++i) {
+    auto start = chrono::steady_clock::now();
+    a = Elewise::Mult(a, b) * 0.5;
+    a.Wait();
+    auto end = chrono::steady_clock::now();
+    latencies.push_back(chrono::duration<double, micro>(end - start).count());
+  }
+  auto res = a.Get();
+  for (int i = 0; i < size.Prod(); ++i) {
+    if (res.get()[i] != 1) {
+      fprintf(stderr, "wrong result at %d: %f\n", i, res.get()[i]);
+      return 1;
+    }
+  }
+  sort(latencies.begin(), latencies.end());
+  double total = 0;
+  for (auto l : latencies) {
+    total += l;
+  }
+  auto percentile = [&](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  printf("backend=%s iterations=%d size=%dx%d\n", FLAGS_use_dag ? "dag" : "simple",
+      FLAGS_bench_iterations, FLAGS_bench_size, FLAGS_bench_size);
+  printf("per op (2 ops) latency us: mean %.2f p50 %.2f p99 %.2f max %.2f\n",
+      total / latencies.size(), percentile(0.5), percentile(0.99), latencies.back());
+  return 0;
+}
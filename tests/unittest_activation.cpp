@@ -92,3 +92,23 @@ TEST(Activation, CpuTanhForward) {
     EXPECT_FLOAT_EQ(output_ptr.get()[i], tanh(input_ptr.get()[i]));
   }
 }
+
+TEST(Activation, CpuSoftmaxForward) {
+  auto& ms = MinervaSystem::Instance();
+  Scale input_size{5, 1, 1, 3};
+
+  ms.SetDevice(cpu_device);
+  ImageBatch input = NArray::Randn(input_size, 0, 1);
+  ImageBatch output = Convolution::SoftmaxForward(input, SoftmaxAlgorithm::kInstance);
+  auto input_ptr = input.Get();
+  auto output_ptr = output.Get();
+  for (int n = 0; n < 3; ++n) {
+    float sum_exp = 0;
+    for (int c = 0; c < 5; ++c) {
+      sum_exp += exp(input_ptr.get()[n * 5 + c]);
+    }
+    for (int c = 0; c < 5; ++c) {
+      EXPECT_NEAR(output_ptr.get()[n * 5 + c], exp(input_ptr.get()[n * 5 + c]) / sum_exp, 1e-6);
+    }
+  }
+}
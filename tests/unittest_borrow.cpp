@@ -0,0 +1,80 @@
+#include "unittest_main.h"
+
+using namespace std;
+using namespace minerva;
+
+class BorrowTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    device_ = ms.CreateCpuDevice();
+    ms.SetDevice(device_);
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+  }
+  // Array of the given size holding 1, 2, 3, ... in storage order
+  static NArray Iota(const Scale& size) {
+    shared_ptr<float> ptr(new float[size.Prod()], [](float* p) { delete[] p; });
+    for (int i = 0; i < size.Prod(); ++i) {
+      ptr.get()[i] = i;
+    }
+    return NArray::MakeNArray(size, ptr) + 1;
+  }
+  uint64_t device_;
+};
+
+TEST_F(BorrowTest, GetIntoCallerBuffer) {
+  NArray a = Iota({6, 4});
+  vector<float> dst(24, -1);
+  for (int pass = 0; pass < 2; ++pass) {
+    a.GetInto(dst.data());
+    for (int i = 0; i < 24; ++i) {
+      ASSERT_EQ(dst[i], i + 1) << "mismatch at " << i;
+    }
+    a = a * 1;
+  }
+}
+
+TEST_F(BorrowTest, ReadsInPlace) {
+  NArray a = Iota({6, 4});
+  auto first = a.Borrow();
+  auto second = a.Borrow();
+  EXPECT_EQ(first.get(), second.get());
+  for (int i = 0; i < 24; ++i) {
+    ASSERT_EQ(first.get()[i], i + 1) << "mismatch at " << i;
+  }
+}
+
+TEST_F(BorrowTest, SliceInPlace) {
+  NArray a = Iota({6, 4});
+  auto whole = a.Borrow();
+  auto part = Slice(a, 1, 2, 2).Borrow();
+  EXPECT_EQ(part.get(), whole.get() + 12);
+}
+
+TEST_F(BorrowTest, OutlivesArray) {
+  NArray a = Iota({6, 4});
+  auto value = a.Borrow();
+  a = NArray();
+  // Buffers freed meanwhile would be taken by new arrays
+  vector<NArray> others;
+  for (int i = 0; i < 4; ++i) {
+    others.push_back(NArray::Zeros({6, 4}) + 0);
+  }
+  MinervaSystem::Instance().WaitForAll();
+  for (int i = 0; i < 24; ++i) {
+    ASSERT_EQ(value.get()[i], i + 1) << "mismatch at " << i;
+  }
+}
+
+#ifdef HAS_CUDA
+TEST_F(BorrowTest, CopiesFromGpu) {
+  MinervaSystem::Instance().SetDevice(gpu_device);
+  NArray a = Iota({6, 4});
+  auto value = a.Borrow();
+  for (int i = 0; i < 24; ++i) {
+    ASSERT_EQ(value.get()[i], i + 1) << "mismatch at " << i;
+  }
+}
+#endif
@@ -0,0 +1,98 @@
+#include "unittest_main.h"
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace minerva;
+
+class CheckpointTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+    filename_ = "/tmp/minerva_checkpoint_test." + to_string(getpid());
+  }
+  void TearDown() override {
+    remove(filename_.c_str());
+  }
+  static void ExpectEqual(const NArray& a, const NArray& b) {
+    ASSERT_EQ(a.Size(), b.Size());
+    auto a_res = a.Get();
+    auto b_res = b.Get();
+    for (int i = 0; i < a.Size().Prod(); ++i) {
+      ASSERT_EQ(a_res.get()[i], b_res.get()[i]) << "mismatch at " << i;
+    }
+  }
+  string filename_;
+};
+
+TEST_F(CheckpointTest, SaveAndLoad) {
+  map<string, NArray> arrays;
+  arrays["conv1/weights"] = NArray::Randn({5, 5, 3, 16}, 0, 1);
+  arrays["conv1/bias"] = NArray::Constant({16}, 0.5);
+  arrays["fc/weights"] = NArray::Randn({100, 10}, 0, 1).Trans();
+  {
+    CheckpointWriter writer(filename_, arrays);
+  }
+  auto loaded = LoadCheckpoint(filename_, true);
+  ASSERT_EQ(loaded.size(), arrays.size());
+  for (auto& i : arrays) {
+    ASSERT_EQ(loaded.count(i.first), 1) << "missing " << i.first;
+    ExpectEqual(loaded[i.first], i.second);
+  }
+  struct stat st;
+  ASSERT_EQ(stat(filename_.c_str(), &st), 0);
+  EXPECT_EQ(st.st_size % kCheckpointAlignment, 0);
+}
+
+TEST_F(CheckpointTest, WrittenOnceComputed) {
+  NArray a = NArray::Constant({64, 64}, 1);
+  for (int i = 0; i < 20; ++i) {
+    a = a + 1;
+  }
+  CheckpointWriter writer(filename_, {{"a", a}});
+  // Work issued afterwards is not waited for by the writer
+  NArray b = a * a;
+  writer.Wait();
+  struct stat st;
+  ASSERT_EQ(stat((filename_ + ".tmp").c_str(), &st), -1);
+  auto loaded = LoadCheckpoint(filename_);
+  auto res = loaded["a"].Get();
+  for (int i = 0; i < 64 * 64; ++i) {
+    ASSERT_EQ(res.get()[i], 21) << "mismatch at " << i;
+  }
+  b.Wait();
+}
+
+TEST_F(CheckpointTest, MoreArraysThanCopiesInFlight) {
+  // Sizes vary, so buffers are both reused and replaced
+  map<string, NArray> arrays;
+  for (int i = 0; i < 40; ++i) {
+    arrays["layer" + to_string(i)] = NArray::Constant({(i % 7 + 1) * 64, 32}, i) * 2;
+  }
+  auto expected = arrays;
+  {
+    CheckpointWriter writer(filename_, arrays);
+    // The writer keeps the arrays until they are copied
+    arrays.clear();
+  }
+  auto loaded = LoadCheckpoint(filename_, true);
+  ASSERT_EQ(loaded.size(), expected.size());
+  for (auto& i : expected) {
+    ExpectEqual(loaded[i.first], i.second);
+  }
+}
+
+TEST_F(CheckpointTest, ErrorsRaisedByWait) {
+  // The temporary file is written, but cannot replace a directory
+  ASSERT_EQ(mkdir(filename_.c_str(), 0755), 0);
+  {
+    CheckpointWriter writer(filename_, {{"a", NArray::Constant({16, 16}, 1)}});
+    EXPECT_THROW(writer.Wait(), std::exception);
+    // Raised once
+    writer.Wait();
+  }
+  struct stat st;
+  EXPECT_EQ(stat((filename_ + ".tmp").c_str(), &st), -1);
+  rmdir(filename_.c_str());
+}
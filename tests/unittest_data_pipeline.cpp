@@ -0,0 +1,136 @@
+#include "unittest_main.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <unistd.h>
+
+using namespace std;
+using namespace minerva;
+
+namespace {
+
+// Batch `i` of a pass holds `i` in every element. Transforms add one.
+class CountingReader : public BatchReader {
+ public:
+  CountingReader(int num_batches, atomic<int>* num_transforms) : num_batches_(num_batches), num_transforms_(num_transforms) {
+  }
+  vector<Scale> FieldSizes() const override {
+    return {{4, 2}, {1, 2}};
+  }
+  bool Read(Batch& batch) override {
+    if (idx_ == num_batches_) {
+      idx_ = 0;
+      return false;
+    }
+    batch.records.push_back(to_string(idx_++));
+    return true;
+  }
+  void Transform(Batch& batch, int) override {
+    float val = stof(batch.records[0]) + 1;
+    for (size_t i = 0; i < batch.fields.size(); ++i) {
+      fill_n(batch.fields[i].get(), FieldSizes()[i].Prod(), val);
+    }
+    ++*num_transforms_;
+  }
+
+ private:
+  int num_batches_;
+  int idx_ = 0;
+  atomic<int>* num_transforms_;
+};
+
+}  // namespace
+
+TEST(DataPipeline, BatchesInOrder) {
+  atomic<int> num_transforms{0};
+  DataPipeline pipeline(common::MakeUnique<CountingReader>(20, &num_transforms), 4, 3);
+  for (int pass = 0; pass < 2; ++pass) {
+    Batch batch;
+    for (int i = 0; i < 20; ++i) {
+      ASSERT_TRUE(pipeline.NextBatch(&batch));
+      ASSERT_EQ(batch.fields.size(), 2);
+      for (int j = 0; j < 8; ++j) {
+        ASSERT_EQ(batch.fields[0].get()[j], i + 1) << "mismatch of batch #" << i;
+      }
+    }
+    EXPECT_FALSE(pipeline.NextBatch(&batch));
+  }
+}
+
+TEST(DataPipeline, PrefetchIsBounded) {
+  atomic<int> num_transforms{0};
+  DataPipeline pipeline(common::MakeUnique<CountingReader>(100, &num_transforms), 2, 3);
+  usleep(100000);
+  EXPECT_LE(num_transforms, 3);
+  Batch batch;
+  ASSERT_TRUE(pipeline.NextBatch(&batch));
+  usleep(100000);
+  EXPECT_LE(num_transforms, 4);
+}
+
+TEST(DataPipeline, BuffersAreReused) {
+  atomic<int> num_transforms{0};
+  DataPipeline pipeline(common::MakeUnique<CountingReader>(100, &num_transforms), 1, 1);
+  set<float*> buffers;
+  Batch batch;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(pipeline.NextBatch(&batch));
+    buffers.insert(batch.fields[0].get());
+  }
+  // Buffers of released batches are handed out again
+  EXPECT_LE(buffers.size(), 3);
+}
+
+TEST(DataPipeline, Arrays) {
+  MinervaSystem::Instance().SetDevice(cpu_device);
+  atomic<int> num_transforms{0};
+  DataPipeline pipeline(common::MakeUnique<CountingReader>(5, &num_transforms), 2, 2);
+  vector<NArray> arrays;
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_TRUE(pipeline.Next(&arrays));
+    ASSERT_EQ(arrays.size(), 2);
+    EXPECT_EQ(arrays[1].Size(), Scale({1, 2}));
+    auto res = (arrays[0] * 2).Get();
+    for (int j = 0; j < 8; ++j) {
+      ASSERT_EQ(res.get()[j], 2 * (i + 1)) << "mismatch of batch #" << i;
+    }
+  }
+  EXPECT_FALSE(pipeline.Next(&arrays));
+  ASSERT_TRUE(pipeline.Next(&arrays));
+}
+
+TEST(DataPipeline, RawFiles) {
+  string data_file = "/tmp/minerva_pipeline_data." + to_string(getpid());
+  string label_file = "/tmp/minerva_pipeline_label." + to_string(getpid());
+  {
+    // Two int header like the MNIST files, then 10 samples of 3 floats
+    ofstream data(data_file, ios::binary);
+    ofstream label(label_file, ios::binary);
+    int header[2] = {0, 0};
+    data.write(reinterpret_cast<char*>(header), sizeof(header));
+    label.write(reinterpret_cast<char*>(header), sizeof(header));
+    for (int i = 0; i < 10; ++i) {
+      float f[3] = {float(i), float(i), float(i)};
+      data.write(reinterpret_cast<char*>(f), sizeof(f));
+      label.write(reinterpret_cast<char*>(f), sizeof(float));
+    }
+  }
+  DataPipeline pipeline(common::MakeUnique<RawFileReader>(vector<string>{data_file, label_file}, vector<Scale>{{3}, {1}}, 4, 2 * sizeof(int)), 1, 2);
+  EXPECT_EQ(pipeline.FieldSizes()[0], Scale({3, 4}));
+  for (int pass = 0; pass < 2; ++pass) {
+    Batch batch;
+    // The last two samples do not fill a batch
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_TRUE(pipeline.NextBatch(&batch));
+      for (int j = 0; j < 4; ++j) {
+        ASSERT_EQ(batch.fields[0].get()[3 * j + 2], 4 * i + j);
+        ASSERT_EQ(batch.fields[1].get()[j], 4 * i + j);
+      }
+    }
+    EXPECT_FALSE(pipeline.NextBatch(&batch));
+  }
+  remove(data_file.c_str());
+  remove(label_file.c_str());
+}
+
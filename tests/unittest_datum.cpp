@@ -0,0 +1,145 @@
+#include "unittest_main.h"
+#include <cstdio>
+#include <unistd.h>
+
+using namespace std;
+using namespace minerva;
+
+namespace {
+
+void AppendVarint(string* s, uint64_t v) {
+  while (v >= 0x80) {
+    s->push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  s->push_back(static_cast<char>(v));
+}
+
+// Serializes a datum of a 3 x `side` x `side` image whose pixel values are
+// `base` plus their index modulo 200
+string MakeDatum(int side, int base, const vector<int>& labels) {
+  string s;
+  for (int field : {1, 2, 3}) {
+    AppendVarint(&s, field << 3);
+    AppendVarint(&s, field == 1 ? 3 : side);
+  }
+  string pixels;
+  for (int i = 0; i < 3 * side * side; ++i) {
+    pixels.push_back(static_cast<char>(base + i % 200));
+  }
+  AppendVarint(&s, 4 << 3 | 2);
+  AppendVarint(&s, pixels.size());
+  s += pixels;
+  for (int l : labels) {
+    AppendVarint(&s, 5 << 3);
+    AppendVarint(&s, l);
+  }
+  return s;
+}
+
+}  // namespace
+
+TEST(Datum, Parse) {
+  auto record = MakeDatum(4, 10, {7, 300});
+  Datum datum;
+  ParseDatum(record, &datum);
+  EXPECT_EQ(datum.channels, 3);
+  EXPECT_EQ(datum.height, 4);
+  EXPECT_EQ(datum.width, 4);
+  ASSERT_EQ(datum.data_size, 48);
+  EXPECT_EQ(datum.data[47], 57);
+  EXPECT_EQ(datum.labels, vector<int>({7, 300}));
+}
+
+TEST(Datum, CenterCropAndMean) {
+  Datum first;
+  auto record = MakeDatum(4, 0, {1});
+  ParseDatum(record, &first);
+  DatumTransform transform;
+  transform.crop_size = 2;
+  transform.mean = {1, 2, 3};
+  DatumBatchDecoder decoder(transform, first, 2);
+  auto sizes = decoder.FieldSizes();
+  ASSERT_EQ(sizes[0], Scale({2, 2, 3, 2}));
+  ASSERT_EQ(sizes[1], Scale({1, 2}));
+  Batch batch;
+  batch.fields = {shared_ptr<float>(new float[24], default_delete<float[]>()), shared_ptr<float>(new float[2], default_delete<float[]>())};
+  batch.records = {record, MakeDatum(4, 20, {5})};
+  decoder.Decode(batch);
+  for (int s = 0; s < 2; ++s) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 2; ++h) {
+        for (int w = 0; w < 2; ++w) {
+          float expected = 20 * s + c * 16 + (h + 1) * 4 + w + 1 - (c + 1);
+          EXPECT_EQ(batch.fields[0].get()[((s * 3 + c) * 2 + h) * 2 + w], expected);
+        }
+      }
+    }
+  }
+  EXPECT_EQ(batch.fields[1].get()[0], 1);
+  EXPECT_EQ(batch.fields[1].get()[1], 5);
+}
+
+TEST(Datum, RandomCropAndMirrorStayInImage) {
+  Datum first;
+  auto record = MakeDatum(8, 0, {1});
+  ParseDatum(record, &first);
+  DatumTransform transform;
+  transform.crop_size = 5;
+  transform.random_crop = true;
+  transform.mirror = true;
+  DatumBatchDecoder decoder(transform, first, 1);
+  Batch batch;
+  batch.fields = {shared_ptr<float>(new float[75], default_delete<float[]>()), shared_ptr<float>(new float[1], default_delete<float[]>())};
+  batch.records = {record};
+  for (int i = 0; i < 20; ++i) {
+    decoder.Decode(batch);
+    // Rows of a crop are runs of 5 consecutive pixels, possibly reversed
+    for (int row = 0; row < 15; ++row) {
+      auto p = batch.fields[0].get() + row * 5;
+      EXPECT_EQ(abs(p[4] - p[0]), 4);
+      EXPECT_LE(p[0] < p[4] ? p[4] : p[0], 3 * 64);
+    }
+  }
+}
+
+#ifdef HAS_LMDB
+TEST(Datum, LmdbPipeline) {
+  string dir = "/tmp/minerva_lmdb_test." + to_string(getpid());
+  ASSERT_EQ(system(("mkdir -p " + dir).c_str()), 0);
+  {
+    MDB_env* env;
+    MDB_txn* txn;
+    MDB_dbi dbi;
+    ASSERT_EQ(mdb_env_create(&env), MDB_SUCCESS);
+    ASSERT_EQ(mdb_env_set_mapsize(env, 1 << 24), MDB_SUCCESS);
+    ASSERT_EQ(mdb_env_open(env, dir.c_str(), 0, 0664), MDB_SUCCESS);
+    ASSERT_EQ(mdb_txn_begin(env, nullptr, 0, &txn), MDB_SUCCESS);
+    ASSERT_EQ(mdb_dbi_open(txn, nullptr, 0, &dbi), MDB_SUCCESS);
+    for (int i = 0; i < 5; ++i) {
+      auto key = to_string(i);
+      auto value = MakeDatum(4, 0, {i});
+      MDB_val k = {key.size(), &key[0]};
+      MDB_val v = {value.size(), &value[0]};
+      ASSERT_EQ(mdb_put(txn, dbi, &k, &v, 0), MDB_SUCCESS);
+    }
+    ASSERT_EQ(mdb_txn_commit(txn), MDB_SUCCESS);
+    mdb_env_close(env);
+  }
+  DataPipeline pipeline(CreateLmdbDatumReader(dir, 2, DatumTransform()), 2, 2);
+  for (int pass = 0; pass < 2; ++pass) {
+    Batch batch;
+    // The last batch holds the sample left
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(pipeline.NextBatch(&batch));
+      ASSERT_EQ(batch.num_samples, i < 2 ? 2 : 1);
+      for (int j = 0; j < batch.num_samples; ++j) {
+        EXPECT_EQ(batch.fields[1].get()[j], 2 * i + j);
+      }
+    }
+    EXPECT_FALSE(pipeline.NextBatch(&batch));
+  }
+  ASSERT_EQ(system(("rm -rf " + dir).c_str()), 0);
+}
+#endif
+
@@ -0,0 +1,125 @@
+#include "unittest_main.h"
+#include <gflags/gflags.h>
+#include "device/data_directory.h"
+
+using namespace std;
+using namespace minerva;
+
+DECLARE_bool(cpu_share_buffers);
+
+TEST(DataDirectory, AddRemove) {
+  DataDirectory directory;
+  directory.Add(7, 1);
+  directory.Add(7, 3);
+  directory.Add(8, 3);
+  EXPECT_EQ(directory.Holders(7), vector<uint64_t>({1, 3}));
+  EXPECT_TRUE(directory.Remove(7, 1));
+  EXPECT_FALSE(directory.Remove(7, 1));
+  EXPECT_EQ(directory.Holders(7), vector<uint64_t>({3}));
+  EXPECT_EQ(directory.Erase(7), vector<uint64_t>({3}));
+  EXPECT_TRUE(directory.Holders(7).empty());
+  EXPECT_FALSE(directory.Remove(9, 3));
+  EXPECT_TRUE(directory.Erase(9).empty());
+  EXPECT_EQ(directory.Holders(8), vector<uint64_t>({3}));
+}
+
+class ReplicaTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    owner_ = ms.CreateCpuDevice();
+    reader_ = ms.CreateCpuDevice();
+    FLAGS_cpu_share_buffers = false;
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+    FLAGS_cpu_share_buffers = true;
+  }
+  size_t RemoteBytes(uint64_t device) {
+    auto stats = MinervaSystem::Instance().device_manager().GetDevice(device)->GetMemoryStats();
+    return stats.live_bytes_by_op["remote copy"];
+  }
+  size_t LiveBytes(uint64_t device) {
+    return MinervaSystem::Instance().device_manager().GetDevice(device)->GetMemoryStats().live_bytes;
+  }
+  uint64_t owner_;
+  uint64_t reader_;
+};
+
+static void ExpectAll(const NArray& a, float expected) {
+  auto res = a.Get();
+  for (int i = 0; i < a.Size().Prod(); ++i) {
+    ASSERT_EQ(res.get()[i], expected) << "mismatch at " << i;
+  }
+}
+
+TEST_F(ReplicaTest, ReusedAndFreed) {
+  auto& ms = MinervaSystem::Instance();
+  size_t bytes = 32 * 8 * sizeof(float);
+  {
+    ms.SetDevice(owner_);
+    NArray a = NArray::Constant({32, 8}, 1) + 1;
+    ms.SetDevice(reader_);
+    NArray b = a * 2;
+    NArray c = a + 1;
+    ms.WaitForAll();
+    // Both readers share a single copy
+    EXPECT_EQ(RemoteBytes(reader_), bytes);
+    ExpectAll(b, 4);
+    ExpectAll(c, 3);
+  }
+  ms.WaitForAll();
+  EXPECT_EQ(LiveBytes(owner_), 0);
+  EXPECT_EQ(LiveBytes(reader_), 0);
+}
+
+TEST_F(ReplicaTest, Evict) {
+  auto& ms = MinervaSystem::Instance();
+  size_t bytes = 32 * 8 * sizeof(float);
+  ms.SetDevice(owner_);
+  NArray a = NArray::Constant({32, 8}, 1) + 1;
+  ms.SetDevice(reader_);
+  NArray b = a * 2;
+  EXPECT_EQ(ms.EvictReplicas(), bytes);
+  EXPECT_EQ(RemoteBytes(reader_), 0);
+  EXPECT_EQ(LiveBytes(owner_), bytes);
+  // Copied again when read after eviction
+  NArray c = a * 3;
+  ExpectAll(c, 6);
+  EXPECT_EQ(RemoteBytes(reader_), bytes);
+  ExpectAll(b, 4);
+}
+
+TEST_F(ReplicaTest, SharedBetweenCpuDevices) {
+  FLAGS_cpu_share_buffers = true;
+  auto& ms = MinervaSystem::Instance();
+  ms.SetDevice(owner_);
+  NArray a = NArray::Constant({32, 8}, 1) + 1;
+  ms.SetDevice(reader_);
+  NArray b = a * 2;
+  ExpectAll(b, 4);
+  EXPECT_EQ(RemoteBytes(reader_), 0);
+  EXPECT_EQ(LiveBytes(reader_), 32 * 8 * sizeof(float));
+  EXPECT_EQ(ms.EvictReplicas(), 0);
+}
+
+TEST_F(ReplicaTest, CopiedAcrossNumaNodes) {
+  FLAGS_cpu_share_buffers = true;
+  auto& ms = MinervaSystem::Instance();
+  CpuDeviceOptions options;
+  options.numa_node = 0;
+  auto near = ms.device_manager().CreateCpuDevice(options);
+  options.numa_node = 1;
+  auto far = ms.device_manager().CreateCpuDevice(options);
+  ms.SetDevice(near);
+  NArray a = NArray::Constant({32, 8}, 1) + 1;
+  ms.SetDevice(far);
+  NArray b = a * 2;
+  ExpectAll(b, 4);
+  EXPECT_EQ(RemoteBytes(far), 32 * 8 * sizeof(float));
+  // Devices not bound to a node share buffers with all others
+  ms.SetDevice(reader_);
+  NArray c = a * 3;
+  ExpectAll(c, 6);
+  EXPECT_EQ(RemoteBytes(reader_), 0);
+}
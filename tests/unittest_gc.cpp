@@ -1,5 +1,9 @@
+#include <op/context.h>
 #include <minerva.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstring>
+#include <thread>
 
 using namespace minerva;
 using namespace std;
@@ -79,3 +83,118 @@ TEST(GCCorrectness, ChangeBothRCAfterEval) {
     ASSERT_EQ(bptr.get()[i], 2);
   }
 }
+
+namespace {
+
+atomic<bool> gate_open(false);
+atomic<int> num_executed(0);
+
+// Holds back its consumers until the gate is opened
+class GateOp : public ComputeFn {
+ public:
+  void Execute(const DataList&, const DataList& outputs, const Context&) {
+    while (!gate_open) {
+      this_thread::yield();
+    }
+    memset(outputs[0].data_, 0, outputs[0].size_.Prod() * sizeof(float));
+  }
+  std::string Name() const {
+    return "gate";
+  }
+};
+
+class CountOp : public ComputeFn {
+ public:
+  void Execute(const DataList& inputs, const DataList& outputs, const Context&) {
+    ++num_executed;
+    for (int i = 0; i < outputs[0].size_.Prod(); ++i) {
+      outputs[0].data_[i] = inputs[0].data_[i] + 1;
+    }
+  }
+  std::string Name() const {
+    return "count";
+  }
+};
+
+NArray Count(const NArray& a) {
+  return NArray::ComputeOne({a}, a.Size(), new CountOp());
+}
+
+}  // namespace
+
+TEST(GCCorrectness, PruneUnusedOps) {
+  MinervaSystem& ms = MinervaSystem::Instance();
+  ms.backend().WaitForAll();
+  size_t num_nodes = ms.physical_dag().NumNodes();
+  gate_open = false;
+  num_executed = 0;
+  {
+    NArray a = NArray::GenerateOne({10, 8}, new GateOp());
+    NArray b = Count(Count(a));
+    NArray c = Count(b);
+    NArray d = Count(Count(b));
+    // `d` is never read, so the ops only leading to it are cancelled, while `b`
+    // is still needed by `c`
+    d = NArray();
+    gate_open = true;
+    shared_ptr<float> cptr = c.Get();
+    for (int i = 0; i < 80; ++i) {
+      ASSERT_EQ(cptr.get()[i], 3);
+    }
+  }
+  ms.backend().WaitForAll();
+  EXPECT_EQ(num_executed, 3);
+  EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+}
+
+TEST(GCCorrectness, PruneUnusedChain) {
+  MinervaSystem& ms = MinervaSystem::Instance();
+  ms.backend().WaitForAll();
+  size_t num_nodes = ms.physical_dag().NumNodes();
+  gate_open = false;
+  num_executed = 0;
+  {
+    NArray a = NArray::GenerateOne({10, 8}, new GateOp());
+    for (int i = 0; i < 100; ++i) {
+      a = Count(a);
+    }
+  }
+  gate_open = true;
+  ms.backend().WaitForAll();
+  EXPECT_EQ(num_executed, 0);
+  EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+}
+
+TEST(GCCorrectness, PruneFromManyThreads) {
+  MinervaSystem& ms = MinervaSystem::Instance();
+  ms.backend().WaitForAll();
+  size_t num_nodes = ms.physical_dag().NumNodes();
+  gate_open = false;
+  num_executed = 0;
+  {
+    NArray a = NArray::GenerateOne({10, 8}, new GateOp());
+    vector<vector<NArray>> kept(4);
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      // Each thread keeps one chain and drops the other
+      threads.emplace_back([&a, &kept, t]() {
+        for (int i = 0; i < 20; ++i) {
+          kept[t].push_back(Count(a));
+          NArray dropped = Count(Count(a));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    gate_open = true;
+    for (auto& k : kept) {
+      for (auto& i : k) {
+        i.Wait();
+      }
+    }
+  }
+  ms.backend().WaitForAll();
+  EXPECT_EQ(num_executed, 80);
+  EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+}
@@ -0,0 +1,310 @@
+#include "unittest_main.h"
+#include <thread>
+
+using namespace std;
+using namespace minerva;
+
+class GraphTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    ms.SetDevice(cpu_device);
+    ms.WaitForAll();
+    ms.telemetry().Reset();
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().telemetry().SetEnabled(false);
+  }
+};
+
+static void ExpectAll(const NArray& a, float val) {
+  auto ptr = a.Get();
+  for (int i = 0; i < a.Size().Prod(); ++i) {
+    ASSERT_FLOAT_EQ(ptr.get()[i], val) << "value mismatch at i=" << i;
+  }
+}
+
+TEST_F(GraphTest, CreatedOnClose) {
+  auto& ms = MinervaSystem::Instance();
+  auto num_nodes = ms.physical_dag().NumNodes();
+  NArray b;
+  {
+    GraphBuilder g;
+    NArray a = NArray::Constant({10, 8}, 1);
+    b = a;
+    for (int i = 0; i < 10; ++i) {
+      b = b * 2 + a;
+    }
+    EXPECT_EQ(b.Size(), Scale({10, 8}));
+    ms.WaitForAll();
+    EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+  }
+  ExpectAll(b, 2047);
+}
+
+TEST_F(GraphTest, ReadWhileRecording) {
+  GraphBuilder g;
+  NArray a = NArray::Constant({4, 6}, 2);
+  NArray b = a + 1;
+  ExpectAll(b, 3);
+  // Recorded again after the read
+  NArray c = Elewise::Mult(b, a);
+  ExpectAll(c, 6);
+  GraphBuilder::Flush();
+  NArray d = c - b;
+  ExpectAll(d, 3);
+}
+
+TEST_F(GraphTest, ReadFromOtherThread) {
+  NArray c;
+  {
+    GraphBuilder g;
+    NArray a = NArray::Constant({4, 6}, 2);
+    NArray b = a + 1;
+    thread reader([&] {
+      ExpectAll(b, 3);
+    });
+    reader.join();
+    c = b + a;
+  }
+  ExpectAll(c, 5);
+}
+
+TEST_F(GraphTest, Nested) {
+  auto& ms = MinervaSystem::Instance();
+  auto num_nodes = ms.physical_dag().NumNodes();
+  NArray c;
+  {
+    GraphBuilder outer;
+    NArray a = NArray::Constant({4, 6}, 2);
+    NArray b;
+    {
+      GraphBuilder inner;
+      b = a + 1;
+      inner.Close();
+    }
+    EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+    c = b * 2;
+  }
+  ExpectAll(c, 6);
+}
+
+TEST_F(GraphTest, MatMultAndTranspose) {
+  NArray c, d;
+  {
+    GraphBuilder g;
+    NArray a = NArray::Constant({3, 5}, 1);
+    NArray b = NArray::Constant({3, 4}, 2);
+    c = a.Trans() * b;
+    d = a.Trans() + 1;
+  }
+  EXPECT_EQ(c.Size(), Scale({5, 4}));
+  ExpectAll(c, 6);
+  EXPECT_EQ(d.Size(), Scale({5, 3}));
+  ExpectAll(d, 2);
+}
+
+TEST_F(GraphTest, UnreadResultsNotComputed) {
+  auto& ms = MinervaSystem::Instance();
+  ms.telemetry().SetEnabled(true);
+  NArray b;
+  {
+    GraphBuilder g;
+    NArray a = NArray::Constant({10, 8}, 1);
+    NArray unread = a * 3 + 1;
+    b = a + 1;
+  }
+  ExpectAll(b, 2);
+  ms.WaitForAll();
+  EXPECT_EQ(ms.telemetry().GetDeviceUtilization()[cpu_device].num_tasks, 2);
+}
+
+TEST_F(GraphTest, SameAsEager) {
+  auto build = [](const NArray& x, const NArray& w) {
+    NArray h = x;
+    for (int i = 0; i < 5; ++i) {
+      h = Elewise::SigmoidForward(w * h + 0.5);
+    }
+    return h;
+  };
+  NArray x = NArray::Randn({8, 3}, 0, 1);
+  NArray w = NArray::Randn({8, 8}, 0, 1);
+  NArray eager = build(x, w);
+  NArray recorded;
+  {
+    GraphBuilder g;
+    recorded = build(x, w);
+  }
+  auto eager_ptr = eager.Get();
+  auto recorded_ptr = recorded.Get();
+  for (int i = 0; i < eager.Size().Prod(); ++i) {
+    ASSERT_FLOAT_EQ(eager_ptr.get()[i], recorded_ptr.get()[i]) << "value mismatch at i=" << i;
+  }
+}
+
+TEST_F(GraphTest, InactiveOnceRecordedArraysReleased) {
+  EXPECT_FALSE(GraphBuilder::Active());
+  NArray eager = NArray::Constant({4, 6}, 1);
+  {
+    NArray b;
+    {
+      GraphBuilder g;
+      EXPECT_TRUE(GraphBuilder::Active());
+      b = eager + 1;
+    }
+    // Results of the recording still resolve through it
+    EXPECT_TRUE(GraphBuilder::Active());
+    ExpectAll(b + eager, 3);
+  }
+  EXPECT_FALSE(GraphBuilder::Active());
+  ExpectAll(eager * 2, 2);
+}
+
+TEST_F(GraphTest, PlanRunsOnNewInputs) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({4, 6}, 1);
+  NArray w = NArray::Constant({4, 6}, 2);
+  ms.WaitForAll();
+  auto num_nodes = ms.physical_dag().NumNodes();
+  unique_ptr<Plan> plan;
+  {
+    PlanBuilder b;
+    NArray xi = b.Input(x);
+    NArray wi = b.Input(w);
+    NArray y = Elewise::Mult(xi, wi) + wi * 2;
+    plan.reset(b.Build({y, wi}));
+  }
+  EXPECT_EQ(plan->NumOps(), 3);
+  EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+  auto outputs = plan->Run({x, w}, {});
+  ASSERT_EQ(outputs.size(), 2);
+  ExpectAll(outputs[0], 6);
+  ExpectAll(outputs[1], 2);
+  outputs = plan->Run({NArray::Constant({4, 6}, 3), outputs[0]}, {});
+  ExpectAll(outputs[0], 30);
+  ExpectAll(outputs[1], 6);
+  EXPECT_THROW(plan->Run({NArray::Constant({6, 4}, 3), w}, {}), std::exception);
+}
+
+TEST_F(GraphTest, PlanReturnsUnreadInputs) {
+  NArray x = NArray::Constant({4, 6}, 1);
+  unique_ptr<Plan> plan;
+  {
+    PlanBuilder b;
+    NArray xi = b.Input(x);
+    NArray unread = b.Input(x);
+    plan.reset(b.Build({xi + 1, unread}));
+  }
+  // Inputs only returned may change shape
+  auto outputs = plan->Run({x, NArray::Constant({2, 3}, 7)}, {});
+  ExpectAll(outputs[0], 2);
+  EXPECT_EQ(outputs[1].Size(), Scale({2, 3}));
+  ExpectAll(outputs[1], 7);
+}
+
+TEST_F(GraphTest, PlanBindsParams) {
+  NArray x = NArray::Constant({3, 5}, 2);
+  NArray fixed = NArray::Constant({3, 5}, 1);
+  unique_ptr<Plan> plan;
+  {
+    PlanBuilder b;
+    NArray xi = b.Input(x);
+    NArray fi = b.Input(fixed);
+    NArray scaled = 0.5 * xi;
+    b.BindParam(scaled, 0, -0.1);
+    plan.reset(b.Build({scaled + fi}));
+  }
+  ExpectAll(plan->Run({x, fixed}, {10})[0], -1);
+  ExpectAll(plan->Run({x, fixed}, {-5})[0], 2);
+}
+
+TEST_F(GraphTest, PlanRunsFromThreads) {
+  NArray x = NArray::Constant({3, 5}, 2);
+  unique_ptr<Plan> plan;
+  {
+    PlanBuilder b;
+    NArray scaled = 1 * b.Input(x);
+    b.BindParam(scaled, 0, 1);
+    plan.reset(b.Build({scaled}));
+  }
+  // Each run keeps its own constant
+  vector<thread> runs;
+  for (int i = 1; i <= 4; ++i) {
+    runs.emplace_back([&, i] {
+      for (int j = 0; j < 20; ++j) {
+        ExpectAll(plan->Run({x}, {float(i)})[0], 2 * i);
+      }
+    });
+  }
+  for (auto& t : runs) {
+    t.join();
+  }
+}
+
+TEST_F(GraphTest, PlanRejectsExternalReads) {
+  NArray x = NArray::Constant({3, 5}, 2);
+  NArray captured = NArray::Constant({3, 5}, 1);
+  PlanBuilder b;
+  NArray xi = b.Input(x);
+  EXPECT_THROW(b.Build({xi + captured}), std::exception);
+}
+
+TEST_F(GraphTest, PlanRejectsExternalOutputs) {
+  NArray x = NArray::Constant({3, 5}, 2);
+  PlanBuilder b;
+  NArray xi = b.Input(x);
+  EXPECT_THROW(b.Build({xi + 1, x}), std::exception);
+}
+
+TEST_F(GraphTest, PlanSameAsEager) {
+  // Gradient steps on a weight carried from run to run
+  auto step = [](const NArray& x, const NArray& w, float lr) {
+    NArray h = Elewise::SigmoidForward(w * x);
+    return w - lr * (h * x.Trans());
+  };
+  NArray w = NArray::Randn({8, 8}, 0, 1);
+  vector<NArray> xs;
+  for (int i = 0; i < 3; ++i) {
+    xs.push_back(NArray::Randn({8, 3}, 0, 1));
+  }
+  NArray eager = w;
+  for (int i = 0; i < 3; ++i) {
+    eager = step(xs[i], eager, 0.1 * (i + 1));
+  }
+  unique_ptr<Plan> plan;
+  {
+    PlanBuilder b;
+    NArray xi = b.Input(xs[0]);
+    NArray wi = b.Input(w);
+    NArray h = Elewise::SigmoidForward(wi * xi);
+    NArray update = 1 * (h * xi.Trans());
+    b.BindParam(update, 0, 1);
+    plan.reset(b.Build({wi - update}));
+  }
+  NArray planned = w;
+  for (int i = 0; i < 3; ++i) {
+    planned = plan->Run({xs[i], planned}, {0.1f * (i + 1)})[0];
+  }
+  auto eager_ptr = eager.Get();
+  auto planned_ptr = planned.Get();
+  for (int i = 0; i < eager.Size().Prod(); ++i) {
+    ASSERT_NEAR(eager_ptr.get()[i], planned_ptr.get()[i], 1e-5) << "value mismatch at i=" << i;
+  }
+}
+
+TEST_F(GraphTest, PlanLoadsWhilePaused) {
+  unique_ptr<Plan> plan;
+  {
+    PlanBuilder b;
+    b.Pause();
+    NArray loaded = NArray::Constant({4, 6}, 2);
+    ExpectAll(loaded, 2);
+    b.Resume();
+    NArray li = b.Input(loaded);
+    NArray y = li + 1;
+    EXPECT_THROW(y.Get(), std::exception);
+    EXPECT_THROW(GraphBuilder::Flush(), std::exception);
+    plan.reset(b.Build({y}));
+  }
+  ExpectAll(plan->Run({NArray::Constant({4, 6}, 5)}, {})[0], 6);
+}
@@ -0,0 +1,71 @@
+#include "unittest_main.h"
+#include <op/context.h>
+
+using namespace std;
+using namespace minerva;
+
+class FillOp : public ComputeFn {
+ public:
+  void Execute(const DataList&, const DataList& outputs, const Context&) {
+    for (int i = 0; i < outputs[0].size_.Prod(); ++i) {
+      outputs[0].data_[i] = 1;
+    }
+  }
+  std::string Name() const {
+    return "fill for stats";
+  }
+};
+
+class MemoryStatsTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    device_ = ms.CreateCpuDevice();
+    ms.SetDevice(device_);
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+  }
+  MemoryStats Stats() {
+    auto& ms = MinervaSystem::Instance();
+    ms.WaitForAll();
+    for (auto& s : ms.GetMemoryStats()) {
+      if (s.device_id == device_) {
+        return s;
+      }
+    }
+    ADD_FAILURE() << "no stats for device #" << device_;
+    return MemoryStats();
+  }
+  uint64_t device_;
+};
+
+TEST_F(MemoryStatsTest, LiveAndPooled) {
+  {
+    NArray a = NArray::GenerateOne({100, 10}, new FillOp());
+    NArray b = NArray::GenerateOne({100, 10}, new FillOp());
+    auto stats = Stats();
+    EXPECT_EQ(stats.live_bytes, 2 * 1000 * sizeof(float));
+    EXPECT_EQ(stats.live_bytes_by_op["FillOp"], 2 * 1000 * sizeof(float));
+    EXPECT_EQ(stats.num_allocations, 2);
+    EXPECT_GT(stats.pooled_bytes, 0);
+  }
+  auto stats = Stats();
+  EXPECT_EQ(stats.live_bytes, 0);
+  EXPECT_TRUE(stats.live_bytes_by_op.empty());
+  EXPECT_EQ(stats.peak_live_bytes, 2 * 1000 * sizeof(float));
+  EXPECT_EQ(stats.num_frees, 2);
+}
+
+TEST_F(MemoryStatsTest, Reset) {
+  NArray a = NArray::GenerateOne({100}, new FillOp());
+  {
+    NArray b = NArray::GenerateOne({1000}, new FillOp());
+    Stats();
+  }
+  MinervaSystem::Instance().ResetMemoryStats();
+  auto stats = Stats();
+  EXPECT_EQ(stats.peak_live_bytes, 100 * sizeof(float));
+  EXPECT_EQ(stats.num_allocations, 0);
+  EXPECT_EQ(stats.num_frees, 0);
+}
@@ -0,0 +1,66 @@
+#include "unittest_main.h"
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+using namespace std;
+using namespace minerva;
+
+class MmapTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    device_ = ms.CreateCpuDevice();
+    ms.SetDevice(device_);
+    filename_ = "/tmp/minerva_mmap_test." + to_string(getpid());
+    // A header of one float followed by 0, 1, 2, ...
+    ofstream out(filename_, ios::binary);
+    for (int i = -1; i < kLength; ++i) {
+      float f = i;
+      out.write(reinterpret_cast<char*>(&f), sizeof(f));
+    }
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+    remove(filename_.c_str());
+  }
+  static int constexpr kLength = 3000;
+  uint64_t device_;
+  string filename_;
+};
+
+int constexpr MmapTest::kLength;
+
+TEST_F(MmapTest, ReadInPlace) {
+  auto& ms = MinervaSystem::Instance();
+  NArray a = NArray::FromFile(filename_, {10, kLength / 10}, sizeof(float));
+  auto res = a.Get();
+  for (int i = 0; i < kLength; ++i) {
+    ASSERT_EQ(res.get()[i], i) << "mismatch at " << i;
+  }
+  // The mapping is not copied into the device memory
+  EXPECT_EQ(ms.device_manager().GetDevice(device_)->GetMemoryStats().live_bytes, 0);
+}
+
+TEST_F(MmapTest, Compute) {
+  NArray a = NArray::FromFile(filename_, {kLength / 2}, (1 + kLength / 2) * sizeof(float));
+  // Removing the file keeps the mapping valid
+  remove(filename_.c_str());
+  // The second half of the columns
+  NArray b = Slice(a.Reshape({10, kLength / 20}), 1, kLength / 40, kLength / 40) + 1;
+  auto res = b.Get();
+  for (int i = 0; i < kLength / 4; ++i) {
+    ASSERT_EQ(res.get()[i], kLength / 2 + kLength / 4 + i + 1) << "mismatch at " << i;
+  }
+}
+
+TEST_F(MmapTest, ReadByOtherDevice) {
+  auto& ms = MinervaSystem::Instance();
+  NArray a = NArray::FromFile(filename_, {kLength}, sizeof(float));
+  ms.SetDevice(ms.CreateCpuDevice());
+  NArray b = a * 2;
+  auto res = b.Get();
+  for (int i = 0; i < kLength; ++i) {
+    ASSERT_EQ(res.get()[i], 2 * i) << "mismatch at " << i;
+  }
+}
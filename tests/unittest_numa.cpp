@@ -0,0 +1,64 @@
+#include "unittest_main.h"
+#include <sched.h>
+#include <cstring>
+#include <op/context.h>
+#include "device/numa.h"
+
+using namespace std;
+using namespace minerva;
+
+TEST(Numa, ParseCpuList) {
+  EXPECT_EQ(ParseCpuList("0-3,8,10-11"), vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCpuList("5"), vector<int>({5}));
+  EXPECT_TRUE(ParseCpuList("").empty());
+}
+
+TEST(Numa, NodesCoverCpus) {
+  auto nodes = GetNumaNodes();
+  ASSERT_FALSE(nodes.empty());
+  for (auto& node : nodes) {
+    EXPECT_FALSE(node.cpus.empty()) << "node #" << node.id;
+  }
+}
+
+class RecordCpuOp : public ComputeFn {
+ public:
+  void Execute(const DataList&, const DataList& outputs, const Context&) {
+    for (int i = 0; i < outputs[0].size_.Prod(); ++i) {
+      outputs[0].data_[i] = sched_getcpu();
+    }
+  }
+  std::string Name() const {
+    return "record cpu";
+  }
+};
+
+TEST(Numa, PinnedDevice) {
+  auto& ms = MinervaSystem::Instance();
+  auto node = GetNumaNodes()[0];
+  CpuDeviceOptions options;
+  options.num_threads = 2;
+  options.cpus = {node.cpus.back()};
+  options.numa_node = node.id;
+  ms.SetDevice(ms.device_manager().CreateCpuDevice(options));
+  vector<NArray> arrays;
+  for (int i = 0; i < 8; ++i) {
+    arrays.push_back(NArray::GenerateOne({4}, new RecordCpuOp()));
+  }
+  for (auto& a : arrays) {
+    EXPECT_EQ(a.Get().get()[0], node.cpus.back());
+  }
+  ms.SetDevice(cpu_device);
+}
+
+TEST(Numa, DevicePerNode) {
+  auto& ms = MinervaSystem::Instance();
+  auto devices = ms.CreateCpuDevicesPerNumaNode();
+  EXPECT_EQ(devices.size(), GetNumaNodes().size());
+  for (auto d : devices) {
+    ms.SetDevice(d);
+    NArray a = NArray::Constant({16, 16}, 1) * 2;
+    EXPECT_EQ(a.Get().get()[255], 2);
+  }
+  ms.SetDevice(cpu_device);
+}
@@ -0,0 +1,127 @@
+#include "unittest_main.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <gflags/gflags.h>
+#include "op/context.h"
+#include "op/physical_op.h"
+
+using namespace std;
+using namespace minerva;
+
+DECLARE_int32(partition_threshold);
+
+class PartitionTest : public testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    auto& ms = MinervaSystem::Instance();
+    helper_devices_.push_back(ms.CreateCpuDevice());
+    helper_devices_.push_back(ms.CreateCpuDevice());
+  }
+  void SetUp() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+    FLAGS_partition_threshold = 1;
+  }
+  void TearDown() override {
+    FLAGS_partition_threshold = 0;
+  }
+  static vector<uint64_t> helper_devices_;
+};
+
+vector<uint64_t> PartitionTest::helper_devices_;
+
+TEST_F(PartitionTest, MatMult) {
+  int m = 7, k = 5, n = 11;
+  shared_ptr<float> a_ptr(new float[m * k], [](float* p) { delete[] p; });
+  shared_ptr<float> b_ptr(new float[k * n], [](float* p) { delete[] p; });
+  for (int i = 0; i < m * k; ++i) {
+    a_ptr.get()[i] = i % 13 - 6;
+  }
+  for (int i = 0; i < k * n; ++i) {
+    b_ptr.get()[i] = i % 7 - 3;
+  }
+  NArray a = NArray::MakeNArray({m, k}, a_ptr);
+  NArray b = NArray::MakeNArray({k, n}, b_ptr);
+  NArray c = a * b;
+  auto res = c.Get();
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float expected = 0;
+      for (int l = 0; l < k; ++l) {
+        expected += a_ptr.get()[i + l * m] * b_ptr.get()[l + j * k];
+      }
+      ASSERT_EQ(res.get()[i + j * m], expected) << "mismatch at " << i << "," << j;
+    }
+  }
+}
+
+TEST_F(PartitionTest, Elementwise) {
+  NArray a = NArray::Constant({3, 4, 5}, 2);
+  NArray b = NArray::Constant({3, 4, 5}, 3);
+  NArray c = Elewise::Mult(a, b) + 1;
+  auto res = c.Get();
+  for (int i = 0; i < 60; ++i) {
+    ASSERT_EQ(res.get()[i], 7) << "mismatch at " << i;
+  }
+}
+
+TEST_F(PartitionTest, MorePartsThanColumns) {
+  NArray a = NArray::Constant({8, 1}, 1);
+  NArray c = a * 5;
+  auto res = c.Get();
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_EQ(res.get()[i], 5) << "mismatch at " << i;
+  }
+}
+
+TEST_F(PartitionTest, SoftmaxNeedsInstanceDimension) {
+  SoftmaxForwardOp op;
+  op.closure.algorithm = SoftmaxAlgorithm::kInstance;
+  vector<bool> split;
+  // A vector is a single instance normalized along its only dimension
+  EXPECT_FALSE(op.Partitionable({{10}}, &split));
+  EXPECT_TRUE(op.Partitionable({{10, 4}}, &split));
+  op.closure.algorithm = SoftmaxAlgorithm::kChannel;
+  EXPECT_FALSE(op.Partitionable({{10, 4}}, &split));
+}
+
+// Copies its input, recording the alignment each part is given
+class AlignedCopyOp : public ComputeFn {
+ public:
+  void Execute(const DataList& inputs, const DataList& outputs, const Context& ctx) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(inputs[0].data_) % ctx.alignment, 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(outputs[0].data_) % ctx.alignment, 0);
+    memcpy(outputs[0].data_, inputs[0].data_, inputs[0].size_.Prod() * sizeof(float));
+    lock_guard<mutex> lck(m_);
+    alignments_.push_back(ctx.alignment);
+  }
+  bool Partitionable(const vector<Scale>& inputs, vector<bool>* split) const override {
+    split->assign(inputs.size(), true);
+    return true;
+  }
+  std::string Name() const {
+    return "aligned copy";
+  }
+  static mutex m_;
+  static vector<size_t> alignments_;
+};
+
+mutex AlignedCopyOp::m_;
+vector<size_t> AlignedCopyOp::alignments_;
+
+TEST_F(PartitionTest, AlignmentOfParts) {
+  // Columns of three floats, so parts start 12 bytes apart
+  NArray a = NArray::Constant({3, 4}, 1);
+  NArray c = NArray::ComputeOne({a}, a.Size(), new AlignedCopyOp());
+  auto res = c.Get();
+  for (int i = 0; i < 12; ++i) {
+    ASSERT_EQ(res.get()[i], 1) << "mismatch at " << i;
+  }
+  lock_guard<mutex> lck(AlignedCopyOp::m_);
+  auto& alignments = AlignedCopyOp::alignments_;
+  EXPECT_EQ(alignments.size(), 3);
+  // The first part starts at the beginning of the buffers
+  EXPECT_EQ(*max_element(alignments.begin(), alignments.end()), CpuDevice::kAlignment);
+  EXPECT_EQ(*min_element(alignments.begin(), alignments.end()), sizeof(float));
+}
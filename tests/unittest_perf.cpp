@@ -1,11 +1,19 @@
 #include <op/context.h>
 #include <minerva.h>
 #include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <device/latency_classifier.h>
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 using namespace std;
 using namespace minerva;
 
+DECLARE_double(latency_lane_threshold);
+
 TEST(PerfTest, LotsOfUnusedNArray) {
   vector<NArray> narrs;
   for (int i = 0; i < 1000; ++i) {
@@ -50,3 +58,125 @@ TEST(PerfTest, LongChainInOne) {
   b.Wait();
 }
 
+
+class NoopOp : public ComputeFn {
+ public:
+  void Execute(const DataList&, const DataList&, const Context&) {
+  }
+  std::string Name() const {
+    return "noop";
+  }
+};
+
+static Task MakeTask(const Scale& input, const Scale& output, bool critical) {
+  Task task;
+  task.inputs.emplace_back(PhysicalData(input, 0, 0), 0);
+  task.outputs.emplace_back(PhysicalData(output, 0, 1), 1);
+  task.op = PhysicalOp{make_shared<NoopOp>(), 0, critical};
+  return task;
+}
+
+TEST(PerfTest, LatencyLaneRouting) {
+  LatencyClassifier classifier;
+  auto small = MakeTask({4, 4}, {4, 4}, false);
+  // Tagged ops always take the lane; others only when classification is enabled
+  EXPECT_TRUE(classifier.UseLatencyLane(MakeTask({1000, 1000}, {1000, 1000}, true), 0, 4, 1, 1));
+  EXPECT_FALSE(classifier.UseLatencyLane(small, 4, 4, 0, 1));
+  FLAGS_latency_lane_threshold = 200;
+  EXPECT_TRUE(classifier.UseLatencyLane(small, 4, 4, 0, 1));
+  // Idle main pool threads or a busy lane keep small ops on the main pool
+  EXPECT_FALSE(classifier.UseLatencyLane(small, 3, 4, 0, 1));
+  EXPECT_FALSE(classifier.UseLatencyLane(small, 4, 4, 1, 1));
+  // Reductions of large inputs are not small
+  EXPECT_FALSE(classifier.UseLatencyLane(MakeTask({1000, 1000}, {1, 1}, false), 4, 4, 0, 1));
+  // Element counts past the int range are not small either
+  EXPECT_FALSE(classifier.UseLatencyLane(MakeTask({40000, 40000}, {40000, 40000}, false), 4, 4, 0, 1));
+  // Timing is kept per input and output shape
+  classifier.RecordTime(small, 1000);
+  EXPECT_FALSE(classifier.UseLatencyLane(small, 4, 4, 0, 1));
+  EXPECT_TRUE(classifier.UseLatencyLane(MakeTask({4, 4}, {2, 8}, false), 4, 4, 0, 1));
+  FLAGS_latency_lane_threshold = 0;
+}
+
+TEST(PerfTest, LatencyLaneTimingIsBounded) {
+  LatencyClassifier classifier(2);
+  FLAGS_latency_lane_threshold = 200;
+  auto slow = MakeTask({4, 4}, {4, 4}, false);
+  classifier.RecordTime(slow, 1000);
+  classifier.RecordTime(MakeTask({4, 4}, {2, 8}, false), 10);
+  // Timing `slow` again keeps it while older shapes are forgotten
+  classifier.RecordTime(slow, 1000);
+  classifier.RecordTime(MakeTask({4, 4}, {8, 2}, false), 10);
+  EXPECT_EQ(2u, classifier.NumTimed());
+  EXPECT_FALSE(classifier.UseLatencyLane(slow, 4, 4, 0, 1));
+  FLAGS_latency_lane_threshold = 0;
+  EXPECT_FALSE(LatencyClassifier::Enabled());
+}
+
+// Order in which ops finish. Blocking ops wait for `Release`, or give up after
+// a long timeout so that a broken lane fails the test instead of hanging it.
+struct FinishOrder {
+  std::mutex m;
+  std::condition_variable cv;
+  bool released = false;
+  vector<string> order;
+  void Finish(const string& name) {
+    lock_guard<mutex> lck(m);
+    order.push_back(name);
+  }
+  void Block() {
+    unique_lock<mutex> lck(m);
+    cv.wait_for(lck, chrono::seconds(10), [this] {
+      return released;
+    });
+  }
+  void Release() {
+    lock_guard<mutex> lck(m);
+    released = true;
+    cv.notify_all();
+  }
+};
+
+class FinishOp : public ComputeFn {
+ public:
+  FinishOp(FinishOrder* order, const string& name, bool block) : order_(order), name_(name), block_(block) {}
+  void Execute(const DataList&, const DataList&, const Context&) {
+    if (block_) {
+      order_->Block();
+    }
+    order_->Finish(name_);
+  }
+  std::string Name() const {
+    return name_;
+  }
+
+ private:
+  FinishOrder* order_;
+  string name_;
+  bool block_;
+};
+
+TEST(PerfTest, LatencyLaneNotBlockedByHeavyOps) {
+  auto& ms = MinervaSystem::Instance();
+  auto previous_device = ms.current_device_id();
+  CpuDeviceOptions options;
+  options.num_threads = 2;
+  ms.SetDevice(ms.device_manager().CreateCpuDevice(options));
+  FinishOrder order;
+  // Occupy both main pool threads and queue more ops behind them
+  vector<NArray> heavy;
+  for (int i = 0; i < 4; ++i) {
+    heavy.push_back(NArray::GenerateOne({10, 10}, new FinishOp(&order, "heavy", true)));
+  }
+  ms.SetLatencyCritical(true);
+  NArray small = NArray::GenerateOne({1}, new FinishOp(&order, "small", false));
+  ms.SetLatencyCritical(false);
+  small.Wait();
+  order.Release();
+  for (auto& h : heavy) {
+    h.Wait();
+  }
+  ms.SetDevice(previous_device);
+  ASSERT_EQ(order.order.size(), 5u);
+  EXPECT_EQ(order.order[0], "small");
+}
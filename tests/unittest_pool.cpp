@@ -0,0 +1,174 @@
+#include "unittest_main.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <op/context.h>
+#include "device/pooled_data_store.h"
+#include "device/huge_page_allocator.h"
+
+using namespace std;
+using namespace minerva;
+
+class PoolTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    num_allocated_ = 0;
+    store_.reset(new PooledDataStore(4 * PooledDataStore::kArenaSize, [this](size_t len) {
+      ++num_allocated_;
+      return malloc(len);
+    }, [](void* ptr) {
+      free(ptr);
+    }));
+  }
+  int num_allocated_;
+  unique_ptr<PooledDataStore> store_;
+};
+
+TEST(PoolSizeClass, Classes) {
+  EXPECT_EQ(PooledDataStore::SizeClass(1), 256);
+  EXPECT_EQ(PooledDataStore::SizeClass(256), 256);
+  EXPECT_EQ(PooledDataStore::SizeClass(257), 512);
+  EXPECT_EQ(PooledDataStore::SizeClass(1025), 1280);
+  EXPECT_EQ(PooledDataStore::SizeClass(1 << 20), 1 << 20);
+  EXPECT_EQ(PooledDataStore::SizeClass((1 << 20) + 1), 5 << 18);
+}
+
+TEST_F(PoolTest, SplitAndCoalesce) {
+  size_t quarter = PooledDataStore::kArenaSize / 4;
+  vector<float*> ptrs;
+  for (uint64_t id = 0; id < 4; ++id) {
+    ptrs.push_back(store_->CreateData(id, quarter));
+  }
+  EXPECT_EQ(num_allocated_, 1);
+  for (uint64_t id = 0; id < 4; ++id) {
+    EXPECT_EQ(reinterpret_cast<char*>(ptrs[id]), reinterpret_cast<char*>(ptrs[0]) + id * quarter);
+  }
+  store_->FreeData(1);
+  store_->FreeData(2);
+  auto stats = store_->GetPoolStats();
+  EXPECT_EQ(stats.largest_free_block, 2 * quarter);
+  EXPECT_EQ(stats.ExternalFragmentation(), 0);
+  // Served from the coalesced hole
+  EXPECT_EQ(store_->CreateData(4, 2 * quarter), ptrs[1]);
+  EXPECT_EQ(num_allocated_, 1);
+}
+
+TEST_F(PoolTest, ReuseAcrossIterations) {
+  for (int iter = 0; iter < 10; ++iter) {
+    for (uint64_t id = 0; id < 16; ++id) {
+      store_->CreateData(id, (id + 1) * 1000);
+    }
+    for (uint64_t id = 0; id < 16; ++id) {
+      store_->FreeData(id);
+    }
+  }
+  EXPECT_EQ(num_allocated_, 1);
+  auto stats = store_->GetPoolStats();
+  EXPECT_EQ(stats.num_arenas, 1);
+  EXPECT_EQ(stats.num_idle_arenas, 1);
+  EXPECT_EQ(stats.block_bytes, 0);
+}
+
+TEST_F(PoolTest, ReuseFreedBlocks) {
+  auto ptr = store_->CreateData(0, 1000);
+  store_->FreeData(0);
+  // Taken back from the slots of its size class
+  EXPECT_EQ(store_->CreateData(1, 1000), ptr);
+  store_->FreeData(1);
+  // Other size classes are served by the pool
+  EXPECT_NE(store_->CreateData(2, 4000), ptr);
+  store_->FreeData(2);
+  auto stats = store_->GetPoolStats();
+  EXPECT_EQ(stats.block_bytes, 0);
+  EXPECT_EQ(stats.num_idle_arenas, 1);
+}
+
+TEST_F(PoolTest, ConcurrentCreateAndFree) {
+  vector<thread> threads;
+  for (uint64_t t = 0; t < 4; ++t) {
+    threads.emplace_back([this, t]() {
+      for (uint64_t i = 0; i < 1000; ++i) {
+        uint64_t id = t * 1000 + i;
+        size_t length = (i % 16 + 1) * 1000;
+        auto ptr = reinterpret_cast<char*>(store_->CreateData(id, length));
+        memset(ptr, static_cast<int>(t), length);
+        ASSERT_EQ(ptr[length - 1], static_cast<char>(t));
+        store_->FreeData(id);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto stats = store_->GetPoolStats();
+  EXPECT_EQ(stats.allocated_bytes, 0);
+  EXPECT_EQ(stats.block_bytes, 0);
+}
+
+TEST_F(PoolTest, TrimLeastRecentlyUsed) {
+  size_t arena = PooledDataStore::kArenaSize;
+  store_->CreateData(0, 2 * arena);
+  store_->CreateData(1, arena);
+  store_->FreeData(0);
+  store_->FreeData(1);
+  EXPECT_EQ(store_->GetPoolStats().reserved_bytes, 3 * arena);
+  // Only the least recently used idle arena is given back
+  store_->CreateData(2, 3 * arena);
+  auto stats = store_->GetPoolStats();
+  EXPECT_EQ(stats.num_trimmed_arenas, 1);
+  EXPECT_EQ(stats.num_arenas, 2);
+  EXPECT_EQ(stats.num_idle_arenas, 1);
+  EXPECT_EQ(stats.reserved_bytes, 4 * arena);
+}
+
+TEST(HugePageAllocator, Aligned) {
+  HugePageAllocator allocator(true, true);
+  auto ptr = static_cast<char*>(allocator.Allocate(3 << 20));
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % HugePageAllocator::kHugePageSize, 0);
+  // Rounded up to whole 2MB pages
+  memset(ptr, 1, 4 << 20);
+  allocator.Free(ptr);
+}
+
+class CheckAlignmentOp : public ComputeFn {
+ public:
+  explicit CheckAlignmentOp(size_t alignment = CpuDevice::kAlignment) : alignment_(alignment) {}
+  void Execute(const DataList& inputs, const DataList& outputs, const Context& ctx) {
+    EXPECT_EQ(ctx.alignment, alignment_);
+    for (auto& i : inputs) {
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(i.data_) % ctx.alignment, 0);
+    }
+    for (auto& i : outputs) {
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(i.data_) % ctx.alignment, 0);
+    }
+    memcpy(outputs[0].data_, inputs[0].data_, inputs[0].size_.Prod() * sizeof(float));
+  }
+  std::string Name() const {
+    return "check alignment";
+  }
+
+ private:
+  size_t alignment_;
+};
+
+TEST(PoolDevice, AlignedBuffers) {
+  MinervaSystem::Instance().SetDevice(cpu_device);
+  vector<NArray> arrays;
+  for (int i = 1; i < 20; ++i) {
+    NArray a = NArray::Constant({i, 3}, i);
+    arrays.push_back(NArray::ComputeOne({a}, a.Size(), new CheckAlignmentOp()));
+  }
+  for (auto& a : arrays) {
+    a.Wait();
+  }
+}
+
+TEST(PoolDevice, AlignmentOfViews) {
+  MinervaSystem::Instance().SetDevice(cpu_device);
+  NArray a = NArray::Constant({4, 5}, 1);
+  // Columns of four floats, so the view starts 16 bytes into the buffer
+  NArray view = Slice(a, 1, 1, 2);
+  NArray::ComputeOne({view}, view.Size(), new CheckAlignmentOp(4 * sizeof(float))).Wait();
+}
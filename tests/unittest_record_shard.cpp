@@ -0,0 +1,112 @@
+#include "unittest_main.h"
+#include <cstdio>
+#include <set>
+#include <unistd.h>
+
+using namespace std;
+using namespace minerva;
+
+namespace {
+
+void AppendVarint(string* s, uint64_t v) {
+  while (v >= 0x80) {
+    s->push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  s->push_back(static_cast<char>(v));
+}
+
+// Serializes a datum of a 1 x 2 x 2 image labelled `label`
+string MakeDatum(int label) {
+  string s;
+  for (int field : {1, 2, 3}) {
+    AppendVarint(&s, field << 3);
+    AppendVarint(&s, field == 1 ? 1 : 2);
+  }
+  AppendVarint(&s, 4 << 3 | 2);
+  AppendVarint(&s, 4);
+  s += string(4, static_cast<char>(label));
+  AppendVarint(&s, 5 << 3);
+  AppendVarint(&s, label);
+  return s;
+}
+
+}  // namespace
+
+class RecordShardTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    for (auto& f : files_) {
+      remove(f.c_str());
+    }
+  }
+  string NewFile() {
+    files_.push_back("/tmp/minerva_shard_test." + to_string(getpid()) + "." + to_string(files_.size()));
+    return files_.back();
+  }
+  // Writes shards of `per_shard` datums labelled from 0 up
+  vector<string> WriteShards(int num_shards, int per_shard) {
+    vector<string> shards;
+    for (int i = 0; i < num_shards; ++i) {
+      shards.push_back(NewFile());
+      RecordShardWriter writer(shards.back());
+      for (int j = 0; j < per_shard; ++j) {
+        writer.Write(MakeDatum(i * per_shard + j));
+      }
+    }
+    return shards;
+  }
+  vector<string> files_;
+};
+
+TEST_F(RecordShardTest, RandomAccess) {
+  auto filename = NewFile();
+  vector<string> records = {"", "a", string(1000, 'x'), string("\0\1\2", 3)};
+  {
+    RecordShardWriter writer(filename, kHasZlib ? RecordCodec::kZlib : RecordCodec::kNone);
+    for (auto& r : records) {
+      writer.Write(r);
+    }
+  }
+  RecordShardReader reader(filename);
+  ASSERT_EQ(reader.NumRecords(), records.size());
+  for (int i = records.size() - 1; i >= 0; --i) {
+    EXPECT_EQ(reader.Read(i), records[i]) << "mismatch of record #" << i;
+  }
+}
+
+TEST_F(RecordShardTest, SequentialPass) {
+  auto shards = WriteShards(2, 5);
+  DataPipeline pipeline(common::MakeUnique<ShardDatumReader>(shards, 4, 0, DatumTransform()), 2, 2);
+  for (int pass = 0; pass < 2; ++pass) {
+    Batch batch;
+    int label = 0;
+    while (pipeline.NextBatch(&batch)) {
+      for (int i = 0; i < batch.num_samples; ++i) {
+        EXPECT_EQ(batch.fields[1].get()[i], label);
+        EXPECT_EQ(batch.fields[0].get()[4 * i], label);
+        ++label;
+      }
+    }
+    EXPECT_EQ(label, 10);
+  }
+}
+
+TEST_F(RecordShardTest, ShuffledPassCoversEveryRecord) {
+  auto shards = WriteShards(3, 7);
+  DataPipeline pipeline(common::MakeUnique<ShardDatumReader>(shards, 4, 8, DatumTransform()), 2, 2);
+  for (int pass = 0; pass < 2; ++pass) {
+    Batch batch;
+    multiset<int> labels;
+    while (pipeline.NextBatch(&batch)) {
+      for (int i = 0; i < batch.num_samples; ++i) {
+        labels.insert(batch.fields[1].get()[i]);
+      }
+    }
+    ASSERT_EQ(labels.size(), 21);
+    for (int i = 0; i < 21; ++i) {
+      EXPECT_EQ(labels.count(i), 1) << "label " << i;
+    }
+  }
+}
+
@@ -0,0 +1,210 @@
+#include "unittest_main.h"
+#include <gflags/gflags.h>
+
+using namespace std;
+using namespace minerva;
+
+DECLARE_int32(cpu_memory_budget_mb);
+
+class RematTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    ms.SetDevice(cpu_device);
+    ms.WaitForAll();
+    ms.ResetRematStats();
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().SetRematerialize(false);
+  }
+};
+
+static void ExpectAll(const NArray& a, float expected) {
+  auto res = a.Get();
+  for (int i = 0; i < a.Size().Prod(); ++i) {
+    ASSERT_EQ(res.get()[i], expected) << "mismatch at " << i;
+  }
+}
+
+TEST_F(RematTest, DropAfterForward) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({16, 8}, 1);
+  ms.SetRematerialize(true);
+  NArray a1 = x * 2;
+  NArray a2 = a1 + 1;
+  NArray a3 = Elewise::Mult(a2, a2);
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  auto stats = ms.GetRematStats();
+  EXPECT_EQ(stats.num_dropped, 3);
+  EXPECT_EQ(stats.saved_bytes, 3 * 16 * 8 * sizeof(float));
+  EXPECT_GT(stats.segment_flops, 0);
+}
+
+TEST_F(RematTest, RecomputeOutsideSegment) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({16, 8}, 1);
+  ms.SetRematerialize(true);
+  NArray a1 = x * 2;
+  NArray a2 = a1 + 1;
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  ms.ResetRematStats();
+  // Both outputs were dropped after the forward pass. Recomputing `a2` reuses
+  // the recomputed `a1`.
+  NArray g = a1 + a2;
+  ExpectAll(g, 5);
+  auto stats = ms.GetRematStats();
+  EXPECT_EQ(stats.num_recomputed, 2);
+  EXPECT_EQ(stats.recomputed_flops, 2 * 16 * 8);
+  // Recomputed buffers are kept for later reads
+  ExpectAll(a2, 3);
+  ExpectAll(a1 * 3, 6);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 2);
+}
+
+TEST_F(RematTest, RecomputeEachOpOnce) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({16, 8}, 1);
+  ms.SetRematerialize(true);
+  vector<NArray> a{x};
+  for (int i = 0; i < 10; ++i) {
+    a.push_back(a.back() + 1);
+  }
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  ms.ResetRematStats();
+  // Backward sweep over the activations
+  NArray g = NArray::Constant({16, 8}, 0);
+  for (int i = 10; i > 0; --i) {
+    g = g + a[i];
+  }
+  ExpectAll(g, 65);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 10);
+}
+
+TEST_F(RematTest, RecomputeDroppedInsideSegment) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({16, 8}, 1);
+  ms.SetRematerialize(true);
+  NArray a1 = x * 2;
+  NArray a2 = a1 + 1;
+  ms.WaitForAll();
+  ms.ResetRematStats();
+  // The transpose is read in place by the multiplication
+  NArray a3 = a1 * a2.Trans();
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  EXPECT_GE(ms.GetRematStats().num_recomputed, 2);
+  ExpectAll(a3, 2 * 3 * 8);
+}
+
+TEST_F(RematTest, WaitsForOtherInputs) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({16, 8}, 1);
+  ms.SetRematerialize(true);
+  NArray a1 = x * 2;
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  ms.ResetRematStats();
+  // Recomputation of `a1` is held back until `b` is ready
+  NArray b = NArray::Constant({16, 8}, 1);
+  for (int i = 0; i < 10; ++i) {
+    b = b + 1;
+  }
+  NArray g = Elewise::Mult(a1, b);
+  ms.WaitForAll();
+  ExpectAll(g, 22);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 1);
+}
+
+TEST_F(RematTest, ReleasedWithArrays) {
+  auto& ms = MinervaSystem::Instance();
+  size_t num_nodes = ms.physical_dag().NumNodes();
+  {
+    NArray x = NArray::Constant({16, 8}, 1);
+    ms.SetRematerialize(true);
+    NArray a1 = x * 2;
+    NArray a2 = a1 + 1;
+    ms.SetRematerialize(false);
+    ExpectAll(a2 + a1, 5);
+  }
+  ms.WaitForAll();
+  EXPECT_EQ(ms.physical_dag().NumNodes(), num_nodes);
+  EXPECT_EQ(ms.GetRematStats().saved_bytes, 0);
+}
+
+TEST_F(RematTest, ReadAfterBatch) {
+  auto& ms = MinervaSystem::Instance();
+  NArray x = NArray::Constant({16, 8}, 1);
+  ms.SetRematerialize(true);
+  NArray a1 = x * 2;
+  NArray a2 = a1 + 1;
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  ms.ResetRematStats();
+  // A batch on other arrays leaves the dropped buffers alone
+  NArray b;
+  {
+    GraphBuilder g;
+    b = (x + 1) * 2;
+  }
+  ExpectAll(b, 4);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 0);
+  ExpectAll(a1, 2);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 1);
+  // A batch reading dropped buffers is created op by op and recomputes them
+  NArray c;
+  {
+    GraphBuilder g;
+    c = (a1 + a2) * 2;
+  }
+  ExpectAll(c, 10);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 2);
+}
+
+TEST_F(RematTest, ReadWhileSpilled) {
+  auto& ms = MinervaSystem::Instance();
+  FLAGS_cpu_memory_budget_mb = 1;
+  auto device = ms.CreateCpuDevice();
+  FLAGS_cpu_memory_budget_mb = 0;
+  ms.SetDevice(device);
+  auto spilled_bytes = [&]() {
+    for (auto& s : ms.GetMemoryStats()) {
+      if (s.device_id == device) {
+        return s.spilled_bytes;
+      }
+    }
+    return size_t(0);
+  };
+  // 1MB each
+  NArray x = NArray::Constant({512, 512}, 1);
+  ms.SetRematerialize(true);
+  NArray a1 = x * 2;
+  NArray a2 = a1 + 1;
+  ms.SetRematerialize(false);
+  ms.WaitForAll();
+  ms.ResetRematStats();
+  // Push the checkpoint out of memory before the dropped buffers are read
+  vector<NArray> others;
+  for (int i = 0; i < 4; ++i) {
+    others.push_back(NArray::Constant({512, 512}, i) + 1);
+  }
+  ms.WaitForAll();
+  EXPECT_GT(spilled_bytes(), 0);
+  ExpectAll(a1 + a2, 5);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 2);
+  // The kept buffers are read back after being spilled themselves
+  for (int i = 0; i < 4; ++i) {
+    others.push_back(NArray::Constant({512, 512}, i) + 1);
+  }
+  ms.WaitForAll();
+  EXPECT_GT(spilled_bytes(), 0);
+  ExpectAll(a2, 3);
+  ExpectAll(a1, 2);
+  EXPECT_EQ(ms.GetRematStats().num_recomputed, 2);
+  for (size_t i = 0; i < others.size(); ++i) {
+    ExpectAll(others[i], i % 4 + 1);
+  }
+  ms.SetDevice(cpu_device);
+}
@@ -0,0 +1,118 @@
+#include "unittest_main.h"
+#include <atomic>
+#include <thread>
+#include "common/sharded_map.h"
+
+using namespace std;
+using namespace minerva;
+
+TEST(ShardedMap, Basic) {
+  ShardedMap<uint64_t, int> map;
+  EXPECT_TRUE(map.Insert(1, 10));
+  EXPECT_FALSE(map.Insert(1, 11));
+  int v = 0;
+  EXPECT_TRUE(map.Get(1, &v));
+  EXPECT_EQ(v, 10);
+  EXPECT_FALSE(map.Get(2, &v));
+  EXPECT_EQ(map.Count(1), 1);
+  EXPECT_EQ(map.Erase(1, &v), 1);
+  EXPECT_EQ(v, 10);
+  EXPECT_EQ(map.Erase(1), 0);
+  EXPECT_EQ(map.Count(1), 0);
+}
+
+TEST(ShardedMap, ConcurrentAccess) {
+  ShardedMap<uint64_t, uint64_t> map;
+  int constexpr kNumThreads = 8;
+  uint64_t constexpr kNumKeys = 20000;
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&map, t]() {
+      for (uint64_t k = t; k < kNumKeys; k += kNumThreads) {
+        ASSERT_TRUE(map.Insert(k, k * 2));
+      }
+      // Read keys owned by other threads while they are being inserted
+      for (uint64_t k = 0; k < kNumKeys; ++k) {
+        uint64_t v;
+        if (map.Get(k, &v)) {
+          ASSERT_EQ(v, k * 2);
+        }
+      }
+      for (uint64_t k = t; k < kNumKeys; k += kNumThreads) {
+        if (k % 2) {
+          ASSERT_EQ(map.Erase(k), 1);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  size_t size = 0;
+  map.ForEach([&size](uint64_t k, uint64_t v) {
+    EXPECT_EQ(k % 2, 0);
+    EXPECT_EQ(v, k * 2);
+    ++size;
+  });
+  EXPECT_EQ(size, kNumKeys / 2);
+}
+
+TEST(ShardedMap, Update) {
+  ShardedMap<uint64_t, int> map;
+  map.Update(1, [](int& v) {
+    ++v;
+    return true;
+  });
+  map.Update(1, [](int& v) {
+    ++v;
+    return true;
+  });
+  int v = 0;
+  EXPECT_TRUE(map.Get(1, &v));
+  EXPECT_EQ(v, 2);
+  // Absent entries are not inserted when `fn` returns false
+  map.Update(2, [](int&) {
+    return false;
+  });
+  EXPECT_EQ(map.Count(2), 0);
+  map.Update(1, [](int&) {
+    return false;
+  });
+  EXPECT_EQ(map.Count(1), 0);
+}
+
+TEST(ShardedMap, ReadWhileUpdating) {
+  // Few keys, so that readers keep reading shards being replaced
+  ShardedMap<uint64_t, uint64_t, 2> map;
+  uint64_t constexpr kNumKeys = 8;
+  for (uint64_t k = 0; k < kNumKeys; ++k) {
+    map.Insert(k, 0);
+  }
+  atomic<bool> done{false};
+  vector<thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&map, &done]() {
+      uint64_t last = 0;
+      while (!done) {
+        uint64_t v;
+        ASSERT_TRUE(map.Get(0, &v));
+        // Updates of a key are seen in order
+        ASSERT_LE(last, v);
+        last = v;
+      }
+    });
+  }
+  for (uint64_t i = 0; i < 20000; ++i) {
+    map.Update(i % kNumKeys, [](uint64_t& v) {
+      ++v;
+      return true;
+    });
+  }
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+  uint64_t v;
+  EXPECT_TRUE(map.Get(0, &v));
+  EXPECT_EQ(v, 20000 / kNumKeys);
+}
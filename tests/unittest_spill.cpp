@@ -0,0 +1,157 @@
+#include "unittest_main.h"
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <gflags/gflags.h>
+#include "device/spilling_data_store.h"
+
+using namespace std;
+using namespace minerva;
+
+DECLARE_int32(cpu_memory_budget_mb);
+
+class SpillTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    page_ = sysconf(_SC_PAGESIZE);
+    store_.reset(new SpillingDataStore(3 * page_, "/tmp", [](size_t len) {
+      return malloc(len);
+    }, [](void* ptr) {
+      free(ptr);
+    }));
+  }
+  // Creates an unpinned buffer of `n` floats filled with `id`
+  void Create(uint64_t id, size_t n) {
+    float* ptr = store_->CreateData(id, n * sizeof(float));
+    for (size_t i = 0; i < n; ++i) {
+      ptr[i] = id;
+    }
+    store_->UnpinData(id);
+  }
+  void Check(uint64_t id, size_t n) {
+    float* ptr = store_->PinData(id);
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(ptr[i], id) << "mismatch of data #" << id << " at " << i;
+    }
+    store_->UnpinData(id);
+  }
+  size_t page_;
+  unique_ptr<SpillingDataStore> store_;
+};
+
+TEST_F(SpillTest, SpillLeastRecentlyUsed) {
+  size_t n = page_ / sizeof(float);
+  for (uint64_t id = 0; id < 3; ++id) {
+    Create(id, n);
+  }
+  EXPECT_EQ(store_->GetSpilledBytes(), 0);
+  store_->GetData(0);
+  Create(3, n);
+  EXPECT_EQ(store_->GetTotalBytes(), 3 * page_);
+  EXPECT_EQ(store_->GetSpilledBytes(), page_);
+  // #1 is the least recently used one
+  Check(1, n);
+  Check(0, n);
+  Check(2, n);
+  Check(3, n);
+  EXPECT_EQ(store_->GetTotalBytes() + store_->GetSpilledBytes(), 4 * page_);
+}
+
+TEST_F(SpillTest, PinnedNotSpilled) {
+  size_t n = page_ / sizeof(float);
+  for (uint64_t id = 0; id < 4; ++id) {
+    store_->CreateData(id, n * sizeof(float));
+  }
+  EXPECT_EQ(store_->GetTotalBytes(), 4 * page_);
+  EXPECT_EQ(store_->GetSpilledBytes(), 0);
+  // Unpinning brings the store back within budget
+  for (uint64_t id = 0; id < 4; ++id) {
+    store_->UnpinData(id);
+  }
+  EXPECT_EQ(store_->GetTotalBytes(), 3 * page_);
+}
+
+TEST_F(SpillTest, PinNewBuffer) {
+  size_t n = page_ / sizeof(float);
+  float* ptr = store_->CreateData(0, n * sizeof(float));
+  EXPECT_EQ(store_->PinData(0), ptr);
+  store_->UnpinData(0);
+  for (uint64_t id = 1; id < 4; ++id) {
+    Create(id, n);
+  }
+  // Still pinned once, so others are spilled instead
+  EXPECT_EQ(store_->GetData(0), ptr);
+  EXPECT_EQ(store_->GetSpilledBytes(), page_);
+  store_->UnpinData(0);
+  EXPECT_EQ(store_->GetTotalBytes(), 3 * page_);
+  EXPECT_TRUE(store_->ExistData(0));
+  store_->FreeData(0);
+  EXPECT_FALSE(store_->ExistData(0));
+}
+
+TEST_F(SpillTest, FreeSpilled) {
+  size_t n = page_ / sizeof(float) + 7;
+  for (uint64_t id = 0; id < 8; ++id) {
+    Create(id, n);
+  }
+  for (uint64_t id = 0; id < 8; id += 2) {
+    store_->FreeData(id);
+  }
+  for (uint64_t id = 8; id < 12; ++id) {
+    Create(id, n);
+  }
+  for (uint64_t id = 1; id < 12; id += 2) {
+    Check(id, n);
+  }
+  for (uint64_t id = 8; id < 12; ++id) {
+    Check(id, n);
+  }
+}
+
+TEST_F(SpillTest, ConcurrentAccess) {
+  size_t n = page_ / sizeof(float);
+  vector<thread> threads;
+  for (uint64_t t = 0; t < 4; ++t) {
+    // Buffers of other threads are spilled and paged in while one is copied
+    threads.emplace_back([this, t, n]() {
+      for (uint64_t id = 8 * t; id < 8 * t + 8; ++id) {
+        Create(id, n);
+      }
+      for (int round = 0; round < 10; ++round) {
+        for (uint64_t id = 8 * t; id < 8 * t + 8; ++id) {
+          Check(id, n);
+        }
+      }
+      for (uint64_t id = 8 * t; id < 8 * t + 8; ++id) {
+        store_->FreeData(id);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(store_->GetTotalBytes(), 0);
+  EXPECT_EQ(store_->GetSpilledBytes(), 0);
+}
+
+TEST(SpillDevice, ComputeOverBudget) {
+  auto& ms = MinervaSystem::Instance();
+  FLAGS_cpu_memory_budget_mb = 1;
+  auto device = ms.CreateCpuDevice();
+  FLAGS_cpu_memory_budget_mb = 0;
+  ms.SetDevice(device);
+  // 8MB of arrays alive at the same time
+  vector<NArray> arrays;
+  for (int i = 0; i < 8; ++i) {
+    arrays.push_back(NArray::Constant({512, 512}, i) + 1);
+  }
+  NArray sum = NArray::Zeros({512, 512});
+  for (auto& a : arrays) {
+    sum += a;
+  }
+  auto res = sum.Get();
+  for (int i = 0; i < 512 * 512; ++i) {
+    ASSERT_EQ(res.get()[i], 36) << "mismatch at " << i;
+  }
+  ms.SetDevice(cpu_device);
+}
@@ -0,0 +1,145 @@
+#include "unittest_main.h"
+#include <thread>
+#include "backend/simple_backend.h"
+#include "device/device_manager.h"
+#include "op/physical_op.h"
+
+using namespace std;
+using namespace minerva;
+
+class TelemetryTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    ms.SetDevice(cpu_device);
+    ms.WaitForAll();
+    ms.telemetry().Reset();
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().telemetry().SetEnabled(false);
+  }
+};
+
+TEST_F(TelemetryTest, Disabled) {
+  auto& ms = MinervaSystem::Instance();
+  NArray a = NArray::Constant({10, 10}, 1);
+  NArray b = a + 1;
+  b.Wait();
+  EXPECT_EQ(ms.telemetry().GetHistogram(SchedulerTelemetry::Interval::kExecution).count, 0);
+  EXPECT_TRUE(ms.telemetry().GetTrace().empty());
+  EXPECT_TRUE(ms.telemetry().GetDeviceUtilization().empty());
+}
+
+TEST_F(TelemetryTest, OpTimeline) {
+  auto& ms = MinervaSystem::Instance();
+  ms.telemetry().SetEnabled(true);
+  {
+    NArray a = NArray::Constant({10, 10}, 1);
+    for (int i = 0; i < 5; ++i) {
+      a = a + 1;
+    }
+    a.Wait();
+  }
+  ms.WaitForAll();
+  auto& telemetry = ms.telemetry();
+  EXPECT_EQ(telemetry.GetHistogram(SchedulerTelemetry::Interval::kExecution).count, 6);
+  EXPECT_EQ(telemetry.GetHistogram(SchedulerTelemetry::Interval::kDeviceQueue).count, 6);
+  EXPECT_EQ(telemetry.GetHistogram(SchedulerTelemetry::Interval::kResident).count, 6);
+  int num_ops = 0;
+  for (auto& t : telemetry.GetTrace()) {
+    if (!t.is_op) {
+      EXPECT_LE(t.finished_us, t.freed_us);
+      continue;
+    }
+    ++num_ops;
+    EXPECT_EQ(t.device_id, cpu_device);
+    EXPECT_LE(0, t.created_us);
+    EXPECT_LE(t.created_us, t.ready_us);
+    EXPECT_LE(t.ready_us, t.dispatched_us);
+    EXPECT_LE(t.dispatched_us, t.started_us);
+    EXPECT_LE(t.started_us, t.finished_us);
+  }
+  EXPECT_EQ(num_ops, 6);
+  auto devices = telemetry.GetDeviceUtilization();
+  EXPECT_EQ(devices[cpu_device].num_tasks, 6);
+  EXPECT_EQ(devices[cpu_device].queue_depth, 0);
+  EXPECT_GE(devices[cpu_device].max_queue_depth, 1);
+  EXPECT_GE(telemetry.GetMaxDispatcherQueueDepth(), 1);
+  EXPECT_FALSE(telemetry.ToString().empty());
+}
+
+TEST(Telemetry, EventsFromManyThreads) {
+  SchedulerTelemetry telemetry;
+  telemetry.SetEnabled(true);
+  int constexpr kNumThreads = 4;
+  // More than a thread buffers before replaying
+  uint64_t constexpr kNumOps = 2000;
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&telemetry, t]() {
+      for (uint64_t i = 0; i < kNumOps; ++i) {
+        uint64_t id = t * kNumOps + i;
+        telemetry.OnNodeCreated(id, true, t);
+        telemetry.Record(id, SchedulerTelemetry::Event::kReady);
+        telemetry.Record(id, SchedulerTelemetry::Event::kDispatched);
+        telemetry.OnTaskStarted(t, id);
+        telemetry.OnTaskFinished(t, id, 1);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(telemetry.GetHistogram(SchedulerTelemetry::Interval::kExecution).count, kNumThreads * kNumOps);
+  auto devices = telemetry.GetDeviceUtilization();
+  for (int t = 0; t < kNumThreads; ++t) {
+    EXPECT_EQ(devices[t].num_tasks, kNumOps);
+    EXPECT_EQ(devices[t].queue_depth, 0);
+  }
+  for (auto& t : telemetry.GetTrace()) {
+    EXPECT_LE(t.created_us, t.ready_us);
+    EXPECT_LE(t.dispatched_us, t.started_us);
+    EXPECT_LE(t.started_us, t.finished_us);
+  }
+  telemetry.Reset();
+  EXPECT_TRUE(telemetry.GetTrace().empty());
+}
+
+TEST_F(TelemetryTest, SimpleBackend) {
+  auto& ms = MinervaSystem::Instance();
+  ms.telemetry().SetEnabled(true);
+  {
+    DeviceManager dm;
+    SimpleBackend backend(dm, &ms.telemetry());
+    auto device = dm.CreateCpuDevice();
+    ms.SetDevice(device);
+    auto fill = make_shared<FillOp>();
+    fill->closure.val = 1;
+    // Executed before `Create` returns
+    auto outputs = backend.Create({}, {Scale{4, 4}}, fill);
+    delete outputs[0];
+    ms.SetDevice(cpu_device);
+    auto& telemetry = ms.telemetry();
+    EXPECT_EQ(telemetry.GetHistogram(SchedulerTelemetry::Interval::kExecution).count, 1);
+    EXPECT_EQ(telemetry.GetHistogram(SchedulerTelemetry::Interval::kResident).count, 1);
+    EXPECT_EQ(telemetry.GetDeviceUtilization()[device].num_tasks, 1);
+    auto trace = telemetry.GetTrace();
+    ASSERT_EQ(trace.size(), 2);
+    EXPECT_TRUE(trace[0].is_op);
+    EXPECT_LE(0, trace[0].started_us);
+    EXPECT_FALSE(trace[1].is_op);
+    EXPECT_NE(trace[0].node_id, trace[1].node_id);
+  }
+}
+
+TEST(LatencyHistogram, Percentile) {
+  LatencyHistogram h;
+  for (int i = 0; i < 99; ++i) {
+    h.Add(3);
+  }
+  h.Add(1000);
+  EXPECT_EQ(h.count, 100);
+  EXPECT_EQ(h.max_us, 1000);
+  EXPECT_EQ(h.Percentile(.5), 4);
+  EXPECT_EQ(h.Percentile(.999), 1000);
+}
@@ -0,0 +1,158 @@
+#include "unittest_main.h"
+
+using namespace std;
+using namespace minerva;
+
+class ViewTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto& ms = MinervaSystem::Instance();
+    device_ = ms.CreateCpuDevice();
+    ms.SetDevice(device_);
+  }
+  void TearDown() override {
+    MinervaSystem::Instance().SetDevice(cpu_device);
+  }
+  // Array of the given size holding 0, 1, 2, ... in storage order
+  static NArray Iota(const Scale& size, shared_ptr<float>* values = nullptr) {
+    shared_ptr<float> ptr(new float[size.Prod()], [](float* p) { delete[] p; });
+    for (int i = 0; i < size.Prod(); ++i) {
+      ptr.get()[i] = i;
+    }
+    if (values) {
+      *values = ptr;
+    }
+    return NArray::MakeNArray(size, ptr);
+  }
+  size_t LiveBytes() {
+    auto& ms = MinervaSystem::Instance();
+    ms.WaitForAll();
+    return ms.device_manager().GetDevice(device_)->GetMemoryStats().live_bytes;
+  }
+  uint64_t device_;
+};
+
+TEST_F(ViewTest, ReshapeSharesBuffer) {
+  NArray a = Iota({6, 4});
+  NArray r = a.Reshape({3, 8});
+  EXPECT_EQ(r.Size(), Scale({3, 8}));
+  auto res = r.Get();
+  for (int i = 0; i < 24; ++i) {
+    ASSERT_EQ(res.get()[i], i) << "mismatch at " << i;
+  }
+  EXPECT_EQ(LiveBytes(), 24 * sizeof(float));
+}
+
+TEST_F(ViewTest, OutlivesParent) {
+  NArray v;
+  {
+    NArray a = Iota({6, 4}) + 1;
+    v = Slice(a, 1, 2, 2).Reshape({12});
+  }
+  EXPECT_EQ(LiveBytes(), 24 * sizeof(float));
+  auto res = v.Get();
+  for (int i = 0; i < 12; ++i) {
+    ASSERT_EQ(res.get()[i], 12 + i + 1) << "mismatch at " << i;
+  }
+  v = NArray();
+  EXPECT_EQ(LiveBytes(), 0);
+}
+
+TEST_F(ViewTest, SliceInnerDimension) {
+  NArray a = Iota({4, 3, 2});
+  NArray s = Slice(a, 1, 1, 2);
+  EXPECT_EQ(s.Size(), Scale({4, 2, 2}));
+  auto res = s.Get();
+  for (int k = 0; k < 2; ++k) {
+    for (int j = 0; j < 2; ++j) {
+      for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(res.get()[i + 4 * (j + 2 * k)], i + 4 * (j + 1 + 3 * k));
+      }
+    }
+  }
+}
+
+TEST_F(ViewTest, Index) {
+  NArray a = Iota({3, 4});
+  NArray row = a[2];
+  EXPECT_EQ(row.Size(), Scale({4}));
+  auto res = row.Get();
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(res.get()[i], 8 + i) << "mismatch at " << i;
+  }
+}
+
+TEST_F(ViewTest, LazyTranspose) {
+  shared_ptr<float> values;
+  NArray a = Iota({3, 5}, &values);
+  NArray t = a.Trans();
+  EXPECT_EQ(t.Size(), Scale({5, 3}));
+  EXPECT_EQ(t.Trans().Size(), Scale({3, 5}));
+  // Read by a matrix multiplication without being computed
+  NArray p = t * a;
+  EXPECT_EQ(LiveBytes(), (15 + 25) * sizeof(float));
+  auto res = p.Get();
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      float expected = 0;
+      for (int k = 0; k < 3; ++k) {
+        expected += values.get()[k + i * 3] * values.get()[k + j * 3];
+      }
+      ASSERT_EQ(res.get()[i + j * 5], expected) << "mismatch at " << i << "," << j;
+    }
+  }
+  NArray q = a * t;
+  auto q_res = q.Get();
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      float expected = 0;
+      for (int k = 0; k < 5; ++k) {
+        expected += values.get()[i + k * 3] * values.get()[j + k * 3];
+      }
+      ASSERT_EQ(q_res.get()[i + j * 3], expected) << "mismatch at " << i << "," << j;
+    }
+  }
+}
+
+TEST_F(ViewTest, TransposeComputedWhenRead) {
+  NArray a = Iota({3, 5});
+  NArray t = a.Trans();
+  auto sum = (t + 1).Get();
+  auto res = t.Get();
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      ASSERT_EQ(res.get()[i + j * 5], j + i * 3) << "mismatch at " << i << "," << j;
+      ASSERT_EQ(sum.get()[i + j * 5], j + i * 3 + 1) << "mismatch at " << i << "," << j;
+    }
+  }
+  auto back = t.Trans().Get();
+  for (int i = 0; i < 15; ++i) {
+    ASSERT_EQ(back.get()[i], i) << "mismatch at " << i;
+  }
+}
+
+TEST_F(ViewTest, TransposeComputedOnce) {
+  auto& ms = MinervaSystem::Instance();
+  NArray a = Iota({3, 5});
+  ms.WaitForAll();
+  ms.telemetry().Reset();
+  ms.telemetry().SetEnabled(true);
+  {
+    NArray b = a.Trans();
+    NArray c = b + 1;
+    NArray d = Elewise::Exp(b);
+    NArray e = b;
+    auto res = e.Get();
+    for (int i = 0; i < 5; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        ASSERT_EQ(res.get()[i + j * 5], j + i * 3) << "mismatch at " << i << "," << j;
+      }
+    }
+    d.Wait();
+    c.Wait();
+  }
+  ms.WaitForAll();
+  ms.telemetry().SetEnabled(false);
+  // One TransOp besides the addition and the exponential
+  EXPECT_EQ(ms.telemetry().GetDeviceUtilization()[device_].num_tasks, 3);
+}